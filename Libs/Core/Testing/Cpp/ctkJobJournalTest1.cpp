@@ -0,0 +1,130 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QFile>
+#include <QTemporaryDir>
+
+// CTK includes
+#include "ctkCoreTestingMacros.h"
+#include "ctkJobJournal.h"
+
+// STD includes
+#include <cstdlib>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+QVariantMap jobParameters(int jobIndex)
+{
+  QVariantMap parameters;
+  parameters["index"] = jobIndex;
+  parameters["seriesInstanceUID"] = QString("1.2.826.0.1.3680043.2.1125.25.%1").arg(jobIndex);
+  return parameters;
+}
+
+} // end of anonymous namespace
+
+// Checks the pending jobs of a journal after reopening it, a record interrupted
+// by a crash, and the compaction.
+int ctkJobJournalTest1(int argc, char* argv[])
+{
+  QCoreApplication app(argc, argv);
+
+  QTemporaryDir temporaryDirectory;
+  CHECK_BOOL(temporaryDirectory.isValid(), true);
+  QString journalFilePath = temporaryDirectory.path() + "/ctkJobJournalTest1.journal";
+
+  ctkJobJournal journal;
+  CHECK_BOOL(journal.isOpen(), false);
+  journal.addJob("ignored", "ctkJobJournalTestJob", jobParameters(0));
+  CHECK_INT(journal.numberOfPendingJobs(), 0);
+
+  CHECK_BOOL(journal.open(journalFilePath), true);
+  CHECK_QSTRING(journal.filePath(), journalFilePath);
+  for (int jobIndex = 0; jobIndex < 4; ++jobIndex)
+  {
+    journal.addJob(QString::number(jobIndex), "ctkJobJournalTestJob", jobParameters(jobIndex));
+  }
+  journal.setJobStatus("0", ctkAbstractJob::JobStatus::Running);
+  journal.setJobStatus("0", ctkAbstractJob::JobStatus::Finished);
+  journal.setJobStatus("1", ctkAbstractJob::JobStatus::Running);
+  journal.setJobStatus("2", ctkAbstractJob::JobStatus::AttemptFailed);
+  // A failed attempt is retried: the job is only completed when it finally fails
+  CHECK_INT(journal.numberOfPendingJobs(), 3);
+  journal.setJobStatus("2", ctkAbstractJob::JobStatus::Failed);
+  journal.addJob("4", "ctkJobJournalTestJob", jobParameters(4));
+  journal.removeJob("3");
+  // Completed jobs are not journaled anymore
+  journal.setJobStatus("0", ctkAbstractJob::JobStatus::Running);
+  CHECK_INT(journal.numberOfPendingJobs(), 2);
+  CHECK_INT(journal.numberOfRecords(), 11);
+  journal.flush();
+
+  // The pending jobs are loaded in submission order, with their parameters
+  ctkJobJournal reopenedJournal;
+  CHECK_BOOL(reopenedJournal.open(journalFilePath), true);
+  QList<ctkJobJournal::JobRecord> pendingJobs = reopenedJournal.pendingJobs();
+  CHECK_INT(pendingJobs.count(), 2);
+  CHECK_QSTRING(pendingJobs.at(0).JobUID, QString("1"));
+  CHECK_QSTRING(pendingJobs.at(0).ClassName, QString("ctkJobJournalTestJob"));
+  CHECK_INT(pendingJobs.at(0).Parameters.value("index").toInt(), 1);
+  CHECK_QSTRING(pendingJobs.at(1).JobUID, QString("4"));
+  CHECK_QSTRING(pendingJobs.at(1).Parameters.value("seriesInstanceUID").toString(), jobParameters(4).value("seriesInstanceUID").toString());
+  reopenedJournal.close();
+  journal.close();
+  CHECK_BOOL(journal.isOpen(), false);
+
+  // A record interrupted by a crash is skipped, and does not corrupt the next one
+  {
+    QFile journalFile(journalFilePath);
+    CHECK_BOOL(journalFile.open(QIODevice::WriteOnly | QIODevice::Append), true);
+    journalFile.write("{\"op\":\"status\",\"uid\":\"1\",\"sta");
+  }
+  CHECK_BOOL(journal.open(journalFilePath), true);
+  CHECK_INT(journal.numberOfPendingJobs(), 2);
+  journal.setJobStatus("1", ctkAbstractJob::JobStatus::Finished);
+  journal.close();
+  CHECK_BOOL(journal.open(journalFilePath), true);
+  CHECK_INT(journal.numberOfPendingJobs(), 1);
+
+  // Compaction keeps the submissions of the pending jobs only
+  journal.setCompactionThreshold(20);
+  CHECK_INT(journal.compactionThreshold(), 20);
+  for (int jobIndex = 5; jobIndex < 50; ++jobIndex)
+  {
+    journal.addJob(QString::number(jobIndex), "ctkJobJournalTestJob", jobParameters(jobIndex));
+    journal.setJobStatus(QString::number(jobIndex), ctkAbstractJob::JobStatus::Finished);
+  }
+  CHECK_BOOL(journal.numberOfRecords() <= 20, true);
+  CHECK_INT(journal.numberOfPendingJobs(), 1);
+  CHECK_BOOL(journal.compact(), true);
+  CHECK_INT(journal.numberOfRecords(), 1);
+  journal.close();
+
+  CHECK_BOOL(reopenedJournal.open(journalFilePath), true);
+  CHECK_INT(reopenedJournal.numberOfRecords(), 1);
+  CHECK_INT(reopenedJournal.pendingJobs().count(), 1);
+  CHECK_QSTRING(reopenedJournal.pendingJobs().first().JobUID, QString("4"));
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,405 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTemporaryDir>
+
+// CTK includes
+#include "ctkAbstractJob.h"
+#include "ctkAbstractWorker.h"
+#include "ctkCoreTestingMacros.h"
+#include "ctkJobJournal.h"
+#include "ctkJobScheduler.h"
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+const int NumberOfJobs = 100000;
+const int MaximumConcurrentJobsPerType = 8;
+
+QAtomicInt NumberOfRunJobs;
+QMutex RunningJobsMutex;
+QMap<QString, int> RunningJobs;
+QMap<QString, int> MaximumRunningJobs;
+
+} // end of anonymous namespace
+
+//------------------------------------------------------------------------------
+class ctkJobSchedulerTestJob : public ctkAbstractJob
+{
+  Q_OBJECT
+
+public:
+  ctkAbstractWorker* createWorker() override;
+
+  ctkAbstractJob* clone() const override
+  {
+    ctkJobSchedulerTestJob* job = new ctkJobSchedulerTestJob;
+    job->setPriority(this->priority());
+    job->setMaximumConcurrentJobsPerType(this->maximumConcurrentJobsPerType());
+    job->setDuration(this->duration());
+    return job;
+  }
+
+  QString loggerReport(const QString& status) override
+  {
+    return QString("ctkJobSchedulerTestJob: job %1 %2").arg(this->jobUID()).arg(status);
+  }
+
+  void releaseResources() override
+  {
+  }
+
+  QVariantMap parameters() const override
+  {
+    QVariantMap parameters = ctkAbstractJob::parameters();
+    parameters["duration"] = this->Duration;
+    return parameters;
+  }
+
+  bool setParameters(const QVariantMap& parameters) override
+  {
+    this->Duration = parameters.value("duration", this->Duration).toInt();
+    return ctkAbstractJob::setParameters(parameters);
+  }
+
+  /// Time spent running, in milliseconds
+  int duration() const
+  {
+    return this->Duration;
+  }
+  void setDuration(int duration)
+  {
+    this->Duration = duration;
+  }
+
+protected:
+  int Duration{0};
+};
+
+//------------------------------------------------------------------------------
+class ctkJobSchedulerTestWorker : public ctkAbstractWorker
+{
+  Q_OBJECT
+
+public:
+  void run() override
+  {
+    QSharedPointer<ctkJobSchedulerTestJob> job =
+      qSharedPointerObjectCast<ctkJobSchedulerTestJob>(this->Job);
+    if (!job)
+    {
+      return;
+    }
+
+    QString className = job->className();
+    {
+      QMutexLocker locker(&RunningJobsMutex);
+      int& running = RunningJobs[className];
+      running++;
+      MaximumRunningJobs[className] = qMax(MaximumRunningJobs.value(className), running);
+    }
+    job->setStatus(ctkAbstractJob::JobStatus::Running);
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < job->duration() && !this->Canceled.loadAcquire())
+    {
+      QThread::msleep(1);
+    }
+    NumberOfRunJobs.ref();
+    {
+      QMutexLocker locker(&RunningJobsMutex);
+      RunningJobs[className]--;
+    }
+    if (this->Canceled.loadAcquire())
+    {
+      this->onJobCanceled(true);
+      return;
+    }
+    job->setStatus(ctkAbstractJob::JobStatus::Finished);
+  }
+
+  void requestCancel() override
+  {
+    this->Canceled.storeRelease(1);
+  }
+
+protected:
+  QAtomicInt Canceled;
+};
+
+//------------------------------------------------------------------------------
+ctkAbstractWorker* ctkJobSchedulerTestJob::createWorker()
+{
+  ctkJobSchedulerTestWorker* worker = new ctkJobSchedulerTestWorker;
+  worker->setJob(*this);
+  return worker;
+}
+
+//------------------------------------------------------------------------------
+class ctkJobSchedulerOtherTestJob : public ctkJobSchedulerTestJob
+{
+  Q_OBJECT
+
+public:
+  ctkAbstractJob* clone() const override
+  {
+    ctkJobSchedulerOtherTestJob* job = new ctkJobSchedulerOtherTestJob;
+    job->setPriority(this->priority());
+    job->setMaximumConcurrentJobsPerType(this->maximumConcurrentJobsPerType());
+    job->setDuration(this->duration());
+    return job;
+  }
+};
+
+//------------------------------------------------------------------------------
+// Schedules many short synthetic jobs of two types and priorities, and checks
+// that all of them run without exceeding the maximum number of concurrent jobs per type.
+// Then checks the waits for given jobs, the lanes, the job events subscriptions and
+// the resumption of the jobs from the journal.
+int ctkJobSchedulerTest1(int argc, char* argv[])
+{
+  QCoreApplication app(argc, argv);
+
+  ctkJobScheduler scheduler;
+  scheduler.setMaximumThreadCount(2 * MaximumConcurrentJobsPerType + 4);
+
+  QElapsedTimer timer;
+  timer.start();
+  for (int jobIndex = 0; jobIndex < NumberOfJobs; ++jobIndex)
+  {
+    ctkJobSchedulerTestJob* job = jobIndex % 2 ? new ctkJobSchedulerOtherTestJob : new ctkJobSchedulerTestJob;
+    job->setPriority(jobIndex % 3 ? QThread::NormalPriority : QThread::HighPriority);
+    job->setMaximumConcurrentJobsPerType(MaximumConcurrentJobsPerType);
+    job->setDestroyAfterUse(true);
+    scheduler.addJob(job);
+  }
+  qint64 schedulingTime = timer.elapsed();
+  CHECK_BOOL(scheduler.numberOfJobs() > 0, true);
+
+  scheduler.waitForFinish(false, true);
+  qint64 totalTime = timer.elapsed();
+
+  std::cout << "Scheduled " << NumberOfJobs << " jobs in " << schedulingTime << " ms, "
+            << "run all of them in " << totalTime << " ms" << std::endl;
+
+  CHECK_INT(scheduler.numberOfJobs(), 0);
+  CHECK_INT(NumberOfRunJobs.load(), NumberOfJobs);
+  CHECK_INT(MaximumRunningJobs.count(), 2);
+  foreach (int maximumRunningJobs, MaximumRunningJobs)
+  {
+    CHECK_BOOL(maximumRunningJobs <= MaximumConcurrentJobsPerType, true);
+  }
+
+  // Waiting for given jobs, without processing events: the completion in the
+  // thread of the worker wakes up the waiting thread.
+  ctkJobSchedulerTestJob* slowJob = new ctkJobSchedulerTestJob;
+  slowJob->setDuration(300);
+  QString slowJobUID = slowJob->jobUID();
+  ctkJobSchedulerTestJob* fastJob = new ctkJobSchedulerOtherTestJob;
+  QString fastJobUID = fastJob->jobUID();
+  scheduler.addJob(slowJob);
+  scheduler.addJob(fastJob);
+  CHECK_BOOL(scheduler.waitForJobs(QStringList() << fastJobUID), true);
+  CHECK_BOOL(scheduler.waitForJobs(QStringList() << fastJobUID << slowJobUID, 10), false);
+  CHECK_BOOL(scheduler.waitForJobs(QStringList() << fastJobUID << slowJobUID), true);
+  CHECK_INT(scheduler.getJobByUID(slowJobUID)->status(), ctkAbstractJob::JobStatus::Finished);
+  CHECK_BOOL(scheduler.waitForJobs(QStringList() << "unknown job"), true);
+
+  scheduler.waitForFinish(false, true);
+  CHECK_INT(scheduler.numberOfRunningJobs(), 0);
+
+  // Lanes: the jobs of a busy lane do not delay the jobs of the other lanes
+  QString otherJobClassName = ctkJobSchedulerOtherTestJob::staticMetaObject.className();
+  scheduler.setLane("Other", 2);
+  scheduler.setJobClassLane(otherJobClassName, "Other");
+  CHECK_BOOL(scheduler.lanes().contains("Other"), true);
+  CHECK_QSTRING(scheduler.jobClassLane(otherJobClassName), QString("Other"));
+  CHECK_QSTRING(scheduler.jobClassLane("ctkJobSchedulerTestJob"), QString());
+  CHECK_NOT_NULL(scheduler.laneThreadPool("Other"));
+  CHECK_NULL(scheduler.laneThreadPool("Unknown"));
+
+  QStringList otherJobUIDs;
+  for (int jobIndex = 0; jobIndex < 4; ++jobIndex)
+  {
+    ctkJobSchedulerTestJob* otherJob = new ctkJobSchedulerOtherTestJob;
+    otherJob->setDuration(500);
+    otherJobUIDs.append(otherJob->jobUID());
+    scheduler.addJob(otherJob);
+  }
+  CHECK_INT(scheduler.laneActiveThreadCount("Other"), 2);
+  CHECK_INT(scheduler.laneQueueDepth("Other"), 2);
+  CHECK_BOOL(scheduler.laneUtilization("Other") > 0.99, true);
+  CHECK_INT(scheduler.laneQueueDepth(""), 0);
+
+  fastJob = new ctkJobSchedulerTestJob;
+  fastJobUID = fastJob->jobUID();
+  scheduler.addJob(fastJob);
+  CHECK_BOOL(scheduler.waitForJobs(QStringList() << fastJobUID, 400), true);
+  CHECK_BOOL(scheduler.waitForJobs(otherJobUIDs), true);
+  scheduler.waitForFinish(false, true);
+  CHECK_INT(scheduler.laneQueueDepth("Other"), 0);
+
+  // Job events: the subscriptions receive only the events of their types, job classes and job UIDs
+  QList<ctkJobEventPointer> finishedJobEvents;
+  QList<ctkJobEventPointer> otherJobEvents;
+  QObject context;
+  int finishedSubscriptionID = scheduler.subscribeToJobEvents(&context,
+    [&finishedJobEvents](const QList<ctkJobEventPointer>& jobEvents){
+      finishedJobEvents << jobEvents;
+    },
+    ctkJobEvent::Finished, QStringList() << "ctkJobSchedulerTestJob");
+  CHECK_BOOL(finishedSubscriptionID > 0, true);
+  ctkJobSchedulerTestJob* eventJob = new ctkJobSchedulerTestJob;
+  QString eventJobUID = eventJob->jobUID();
+  ctkJobSchedulerTestJob* otherEventJob = new ctkJobSchedulerOtherTestJob;
+  QString otherEventJobUID = otherEventJob->jobUID();
+  int otherSubscriptionID = scheduler.subscribeToJobEvents(&context,
+    [&otherJobEvents](const QList<ctkJobEventPointer>& jobEvents){
+      otherJobEvents << jobEvents;
+    },
+    ctkJobEvent::AllEvents, QStringList(), QStringList() << otherEventJobUID);
+  CHECK_BOOL(otherSubscriptionID != finishedSubscriptionID, true);
+  {
+    // The subscription ends with its context
+    QObject temporaryContext;
+    scheduler.subscribeToJobEvents(&temporaryContext, [](const QList<ctkJobEventPointer>&){});
+  }
+  CHECK_INT(scheduler.subscribeToJobEvents(nullptr, [](const QList<ctkJobEventPointer>&){}), 0);
+
+  scheduler.addJob(eventJob);
+  scheduler.addJob(otherEventJob);
+  scheduler.waitForFinish(false, true);
+  timer.restart();
+  while (otherJobEvents.count() < 2 && timer.elapsed() < 5000)
+  {
+    QCoreApplication::processEvents();
+    QThread::msleep(10);
+  }
+
+  CHECK_INT(finishedJobEvents.count(), 1);
+  CHECK_INT(finishedJobEvents.first()->Type, ctkJobEvent::Finished);
+  CHECK_QSTRING(finishedJobEvents.first()->JobUID, eventJobUID);
+  CHECK_INT(finishedJobEvents.first()->Status, ctkAbstractJob::JobStatus::Finished);
+  CHECK_NOT_NULL(finishedJobEvents.first()->Job.data());
+  CHECK_INT(otherJobEvents.count(), 2);
+  CHECK_INT(otherJobEvents.at(0)->Type, ctkJobEvent::Started);
+  CHECK_INT(otherJobEvents.at(1)->Type, ctkJobEvent::Finished);
+  CHECK_QSTRING(otherJobEvents.at(1)->JobClass, otherJobClassName);
+
+  // Details of the events, as emitted by the signals
+  QList<QVariant> jobEventsDetails = ctkJobScheduler::jobEventsDetails(otherJobEvents);
+  CHECK_INT(jobEventsDetails.count(), 2);
+  CHECK_QSTRING(jobEventsDetails.at(1).value<ctkJobDetail>().JobUID, otherEventJobUID);
+  CHECK_QSTRING(jobEventsDetails.at(1).value<ctkJobDetail>().JobClass, otherJobClassName);
+
+  scheduler.unsubscribeFromJobEvents(finishedSubscriptionID);
+  scheduler.unsubscribeFromJobEvents(otherSubscriptionID);
+
+  // Journal: the jobs pending when a scheduler is destroyed are resumed by the next one
+  QTemporaryDir temporaryDirectory;
+  CHECK_BOOL(temporaryDirectory.isValid(), true);
+  QString journalFilePath = temporaryDirectory.path() + "/ctkJobSchedulerTest1.journal";
+  ctkJobScheduler::JobFactory jobFactory = [](const QVariantMap& parameters) -> ctkAbstractJob* {
+    ctkJobSchedulerTestJob* job = new ctkJobSchedulerTestJob;
+    job->setParameters(parameters);
+    return job;
+  };
+  QStringList journaledJobUIDs;
+  {
+    ctkJobScheduler journaledScheduler;
+    journaledScheduler.registerJobFactory("ctkJobSchedulerTestJob", jobFactory);
+    CHECK_BOOL(journaledScheduler.setJournalFilePath(journalFilePath), true);
+    CHECK_QSTRING(journaledScheduler.journalFilePath(), journalFilePath);
+    for (int jobIndex = 0; jobIndex < 4; ++jobIndex)
+    {
+      ctkJobSchedulerTestJob* journaledJob = new ctkJobSchedulerTestJob;
+      journaledJob->setDuration(200);
+      journaledJob->setMaximumConcurrentJobsPerType(1);
+      journaledJobUIDs.append(journaledJob->jobUID());
+      journaledScheduler.addJob(journaledJob);
+    }
+    // Jobs without job factory are not journaled
+    journaledScheduler.addJob(new ctkJobSchedulerOtherTestJob);
+    CHECK_INT(journaledScheduler.journal()->numberOfPendingJobs(), 4);
+
+    CHECK_BOOL(journaledScheduler.waitForJobs(QStringList() << journaledJobUIDs.first(), -1, true), true);
+    QCoreApplication::processEvents();
+    CHECK_INT(journaledScheduler.journal()->numberOfPendingJobs(), 3);
+  }
+
+  ctkJobScheduler resumedScheduler;
+  resumedScheduler.registerJobFactory("ctkJobSchedulerTestJob", jobFactory);
+  CHECK_BOOL(resumedScheduler.setJournalFilePath(journalFilePath), true);
+  CHECK_INT(resumedScheduler.resumeJobsFromJournal(), 3);
+  CHECK_NULL(resumedScheduler.getJobByUID(journaledJobUIDs.first()));
+  ctkJobSchedulerTestJob* resumedJob =
+    qobject_cast<ctkJobSchedulerTestJob*>(resumedScheduler.getJobByUID(journaledJobUIDs.last()));
+  CHECK_NOT_NULL(resumedJob);
+  CHECK_INT(resumedJob->duration(), 200);
+  CHECK_INT(resumedJob->maximumConcurrentJobsPerType(), 1);
+  CHECK_BOOL(resumedScheduler.waitForJobs(journaledJobUIDs, -1, true), true);
+  QCoreApplication::processEvents();
+  CHECK_INT(resumedScheduler.journal()->numberOfPendingJobs(), 0);
+  CHECK_INT(resumedScheduler.resumeJobsFromJournal(), 0);
+
+  // Journal: a job running when the jobs are suspended (e.g. when the application is closed)
+  // stays pending, even if its worker reports the stop later, and is resumed
+  ctkJobSchedulerTestJob* suspendedJob = new ctkJobSchedulerTestJob;
+  suspendedJob->setDuration(2000);
+  QString suspendedJobUID = suspendedJob->jobUID();
+  resumedScheduler.addJob(suspendedJob);
+  timer.restart();
+  while (suspendedJob->status() != ctkAbstractJob::JobStatus::Running && timer.elapsed() < 5000)
+  {
+    QCoreApplication::processEvents();
+    QThread::msleep(10);
+  }
+  CHECK_INT(suspendedJob->status(), ctkAbstractJob::JobStatus::Running);
+  CHECK_BOOL(resumedScheduler.suspendAllJobs().contains(suspendedJobUID), true);
+  QCoreApplication::processEvents();
+  CHECK_NULL(resumedScheduler.getJobByUID(suspendedJobUID));
+  CHECK_QSTRING(resumedScheduler.journalFilePath(), journalFilePath);
+  CHECK_INT(resumedScheduler.journal()->numberOfPendingJobs(), 1);
+  CHECK_QSTRING(resumedScheduler.journal()->pendingJobs().first().JobUID, suspendedJobUID);
+
+  CHECK_INT(resumedScheduler.resumeJobsFromJournal(), 1);
+  ctkJobSchedulerTestJob* resumedSuspendedJob =
+    qobject_cast<ctkJobSchedulerTestJob*>(resumedScheduler.getJobByUID(suspendedJobUID));
+  CHECK_NOT_NULL(resumedSuspendedJob);
+  CHECK_INT(resumedSuspendedJob->duration(), 2000);
+  CHECK_BOOL(resumedScheduler.waitForJobs(QStringList() << suspendedJobUID, -1, true), true);
+  QCoreApplication::processEvents();
+  CHECK_INT(resumedScheduler.journal()->numberOfPendingJobs(), 0);
+
+  return EXIT_SUCCESS;
+}
+
+#include "moc_ctkJobSchedulerTest1.cpp"
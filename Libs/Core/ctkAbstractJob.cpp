@@ -236,6 +236,35 @@ void ctkAbstractJob::setDestroyAfterUse(bool destroyAfterUse)
   this->DestroyAfterUse = destroyAfterUse;
 }
 
+//----------------------------------------------------------------------------
+QVariantMap ctkAbstractJob::parameters() const
+{
+  QVariantMap parameters;
+  parameters["persistent"] = this->Persistent;
+  parameters["retryCounter"] = this->RetryCounter;
+  parameters["retryDelay"] = this->RetryDelay;
+  parameters["maximumNumberOfRetry"] = this->MaximumNumberOfRetry;
+  parameters["maximumConcurrentJobsPerType"] = this->MaximumConcurrentJobsPerType;
+  parameters["priority"] = static_cast<int>(this->Priority);
+  parameters["destroyAfterUse"] = this->DestroyAfterUse;
+  return parameters;
+}
+
+//----------------------------------------------------------------------------
+bool ctkAbstractJob::setParameters(const QVariantMap& parameters)
+{
+  this->Persistent = parameters.value("persistent", this->Persistent).toBool();
+  this->RetryCounter = parameters.value("retryCounter", this->RetryCounter).toInt();
+  this->RetryDelay = parameters.value("retryDelay", this->RetryDelay).toInt();
+  this->MaximumNumberOfRetry = parameters.value("maximumNumberOfRetry", this->MaximumNumberOfRetry).toInt();
+  this->MaximumConcurrentJobsPerType =
+    parameters.value("maximumConcurrentJobsPerType", this->MaximumConcurrentJobsPerType).toInt();
+  this->Priority = static_cast<QThread::Priority>(
+    parameters.value("priority", static_cast<int>(this->Priority)).toInt());
+  this->DestroyAfterUse = parameters.value("destroyAfterUse", this->DestroyAfterUse).toBool();
+  return true;
+}
+
 //----------------------------------------------------------------------------
 QVariant ctkAbstractJob::toVariant()
 {
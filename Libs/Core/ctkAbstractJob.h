@@ -28,6 +28,7 @@
 #include <QDateTime>
 #include <QMetaEnum>
 #include <QObject>
+#include <QSharedPointer>
 #include <QThread>
 #include <QVariant>
 
@@ -168,6 +169,15 @@ public:
   /// Create a copy of this job
   Q_INVOKABLE virtual ctkAbstractJob* clone() const = 0;
 
+  ///@{
+  /// Parameters of the job, i.e. what clone() copies, as values that can be saved
+  /// (e.g. in the journal of ctkJobScheduler) to create the job again.
+  /// Derived classes add their own parameters to the ones of their superclass.
+  /// setParameters returns false if the parameters cannot be applied.
+  Q_INVOKABLE virtual QVariantMap parameters() const;
+  Q_INVOKABLE virtual bool setParameters(const QVariantMap& parameters);
+  ///@}
+
   /// Logger report string formatting for specific job
   Q_INVOKABLE virtual QString loggerReport(const QString& status) = 0;
 
@@ -241,4 +251,34 @@ struct CTK_CORE_EXPORT ctkJobDetail {
 };
 Q_DECLARE_METATYPE(ctkJobDetail);
 
+//------------------------------------------------------------------------------
+/// \ingroup Core
+/// Job event delivered by ctkJobScheduler to its subscribers (see ctkJobScheduler::subscribeToJobEvents).
+/// Events are shared between the subscribers (ctkJobEventPointer) and reference their job
+/// instead of serializing it: subscribers read only what they need from the job.
+struct CTK_CORE_EXPORT ctkJobEvent {
+  enum EventType {
+    Started = 0x01,
+    UserStopped = 0x02,
+    Finished = 0x04,
+    AttemptFailed = 0x08,
+    Failed = 0x10,
+    Progress = 0x20,
+    AllEvents = 0x3f
+  };
+  Q_DECLARE_FLAGS(EventTypes, EventType)
+
+  EventType Type{Started};
+  QString JobClass;
+  QString JobUID;
+  /// Status of the job when the event occurred
+  ctkAbstractJob::JobStatus Status{ctkAbstractJob::JobStatus::Initialized};
+  /// Job of the event, kept alive by the event
+  QSharedPointer<ctkAbstractJob> Job;
+  /// Detail of the progress, as emitted by the job (Progress events only)
+  QVariant Detail;
+};
+Q_DECLARE_OPERATORS_FOR_FLAGS(ctkJobEvent::EventTypes)
+typedef QSharedPointer<const ctkJobEvent> ctkJobEventPointer;
+
 #endif // ctkAbstractJob_h
@@ -0,0 +1,513 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+// CTK includes
+#include "ctkJobJournal.h"
+#include "ctkLogger.h"
+
+static ctkLogger logger("org.commontk.core.JobJournal");
+
+//------------------------------------------------------------------------------
+// A failed attempt is retried: the job is completed only once user stopped, failed or finished
+static bool isCompletedStatus(int status)
+{
+  return status == ctkAbstractJob::JobStatus::UserStopped
+    || status == ctkAbstractJob::JobStatus::Failed
+    || status == ctkAbstractJob::JobStatus::Finished;
+}
+
+//------------------------------------------------------------------------------
+class ctkJobJournalPrivate
+{
+public:
+  ctkJobJournalPrivate();
+
+  ///@{
+  /// These methods must be called with the Mutex locked.
+  /// loadRecord applies a record read from the file, appendRecord writes a new one,
+  /// then flushes and compacts the file if needed.
+  bool loadRecord(const QJsonObject& record);
+  void appendRecord(const QJsonObject& record);
+  void addPendingJob(const ctkJobJournal::JobRecord& jobRecord);
+  void removePendingJob(const QString& jobUID);
+  void flush();
+  bool compact();
+  ///@}
+
+  struct PendingJob
+  {
+    ctkJobJournal::JobRecord Record;
+    quint64 Sequence;
+  };
+
+  mutable QMutex Mutex;
+  QFile File;
+  /// Pending jobs by job UID, and their UIDs in submission order
+  QHash<QString, PendingJob> PendingJobs;
+  QMap<quint64, QString> PendingJobsOrder;
+  quint64 Sequence;
+  int NumberOfRecords;
+  int CompactionThreshold;
+  int FlushInterval;
+  bool Unflushed;
+  QElapsedTimer FlushTimer;
+};
+
+//------------------------------------------------------------------------------
+// ctkJobJournalPrivate methods
+
+//------------------------------------------------------------------------------
+ctkJobJournalPrivate::ctkJobJournalPrivate()
+  : Sequence(0)
+  , NumberOfRecords(0)
+  , CompactionThreshold(10000)
+  , FlushInterval(1000)
+  , Unflushed(false)
+{
+}
+
+//------------------------------------------------------------------------------
+bool ctkJobJournalPrivate::loadRecord(const QJsonObject& record)
+{
+  QString operation = record.value("op").toString();
+  QString jobUID = record.value("uid").toString();
+  if (jobUID.isEmpty())
+  {
+    return false;
+  }
+
+  if (operation == "add")
+  {
+    ctkJobJournal::JobRecord jobRecord;
+    jobRecord.JobUID = jobUID;
+    jobRecord.ClassName = record.value("class").toString();
+    jobRecord.Parameters = record.value("parameters").toObject().toVariantMap();
+    this->addPendingJob(jobRecord);
+  }
+  else if (operation == "status")
+  {
+    if (isCompletedStatus(record.value("status").toInt()))
+    {
+      this->removePendingJob(jobUID);
+    }
+  }
+  else if (operation == "remove")
+  {
+    this->removePendingJob(jobUID);
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkJobJournalPrivate::appendRecord(const QJsonObject& record)
+{
+  if (!this->File.isOpen())
+  {
+    return;
+  }
+
+  QByteArray line = QJsonDocument(record).toJson(QJsonDocument::Compact);
+  line.append('\n');
+  if (this->File.write(line) != line.size())
+  {
+    logger.warn(QString("ctkJobJournal: failed to write in %1: %2")
+      .arg(this->File.fileName())
+      .arg(this->File.errorString()));
+    return;
+  }
+  this->NumberOfRecords++;
+  this->Unflushed = true;
+
+  if (this->NumberOfRecords > this->CompactionThreshold &&
+      this->NumberOfRecords >= 2 * this->PendingJobs.count())
+  {
+    this->compact();
+  }
+  else if (this->FlushTimer.elapsed() >= this->FlushInterval)
+  {
+    this->flush();
+  }
+}
+
+//------------------------------------------------------------------------------
+void ctkJobJournalPrivate::addPendingJob(const ctkJobJournal::JobRecord& jobRecord)
+{
+  QHash<QString, PendingJob>::iterator it = this->PendingJobs.find(jobRecord.JobUID);
+  if (it != this->PendingJobs.end())
+  {
+    it->Record = jobRecord;
+    return;
+  }
+
+  PendingJob pendingJob;
+  pendingJob.Record = jobRecord;
+  pendingJob.Sequence = this->Sequence++;
+  this->PendingJobs.insert(jobRecord.JobUID, pendingJob);
+  this->PendingJobsOrder.insert(pendingJob.Sequence, jobRecord.JobUID);
+}
+
+//------------------------------------------------------------------------------
+void ctkJobJournalPrivate::removePendingJob(const QString& jobUID)
+{
+  QHash<QString, PendingJob>::iterator it = this->PendingJobs.find(jobUID);
+  if (it == this->PendingJobs.end())
+  {
+    return;
+  }
+
+  this->PendingJobsOrder.remove(it->Sequence);
+  this->PendingJobs.erase(it);
+}
+
+//------------------------------------------------------------------------------
+void ctkJobJournalPrivate::flush()
+{
+  if (this->Unflushed && this->File.isOpen())
+  {
+    this->File.flush();
+  }
+  this->Unflushed = false;
+  this->FlushTimer.start();
+}
+
+//------------------------------------------------------------------------------
+bool ctkJobJournalPrivate::compact()
+{
+  if (!this->File.isOpen())
+  {
+    return false;
+  }
+
+  this->File.close();
+
+  // The journal is replaced only once the compacted file is complete
+  QSaveFile compactedFile(this->File.fileName());
+  bool success = compactedFile.open(QIODevice::WriteOnly);
+  int numberOfRecords = 0;
+  foreach (const QString& jobUID, this->PendingJobsOrder)
+  {
+    if (!success)
+    {
+      break;
+    }
+    const ctkJobJournal::JobRecord& jobRecord = this->PendingJobs[jobUID].Record;
+    QJsonObject record;
+    record.insert("op", QString("add"));
+    record.insert("uid", jobRecord.JobUID);
+    record.insert("class", jobRecord.ClassName);
+    record.insert("parameters", QJsonObject::fromVariantMap(jobRecord.Parameters));
+    QByteArray line = QJsonDocument(record).toJson(QJsonDocument::Compact);
+    line.append('\n');
+    success = compactedFile.write(line) == line.size();
+    numberOfRecords++;
+  }
+  success = success && compactedFile.commit();
+  if (!success)
+  {
+    logger.warn(QString("ctkJobJournal: failed to compact %1: %2")
+      .arg(this->File.fileName())
+      .arg(compactedFile.errorString()));
+  }
+  else
+  {
+    this->NumberOfRecords = numberOfRecords;
+  }
+
+  if (!this->File.open(QIODevice::WriteOnly | QIODevice::Append))
+  {
+    logger.error(QString("ctkJobJournal: failed to open %1: %2")
+      .arg(this->File.fileName())
+      .arg(this->File.errorString()));
+    return false;
+  }
+  this->Unflushed = false;
+  this->FlushTimer.start();
+  return success;
+}
+
+//------------------------------------------------------------------------------
+// ctkJobJournal methods
+
+//------------------------------------------------------------------------------
+ctkJobJournal::ctkJobJournal()
+  : d_ptr(new ctkJobJournalPrivate)
+{
+}
+
+//------------------------------------------------------------------------------
+ctkJobJournal::~ctkJobJournal()
+{
+  this->close();
+}
+
+//------------------------------------------------------------------------------
+bool ctkJobJournal::open(const QString& filePath)
+{
+  Q_D(ctkJobJournal);
+
+  this->close();
+
+  QMutexLocker locker(&d->Mutex);
+  d->File.setFileName(filePath);
+
+  bool missingEndOfLine = false;
+  if (d->File.exists())
+  {
+    QFile journalFile(filePath);
+    if (!journalFile.open(QIODevice::ReadOnly))
+    {
+      logger.error(QString("ctkJobJournal: failed to read %1: %2")
+        .arg(filePath)
+        .arg(journalFile.errorString()));
+      return false;
+    }
+
+    while (!journalFile.atEnd())
+    {
+      QByteArray line = journalFile.readLine();
+      missingEndOfLine = !line.endsWith('\n');
+      if (line.trimmed().isEmpty())
+      {
+        continue;
+      }
+      d->NumberOfRecords++;
+      QJsonDocument document = QJsonDocument::fromJson(line);
+      if (!document.isObject() || !d->loadRecord(document.object()))
+      {
+        logger.warn(QString("ctkJobJournal: skipping invalid record %1 of %2")
+          .arg(d->NumberOfRecords)
+          .arg(filePath));
+      }
+    }
+  }
+
+  if (!d->File.open(QIODevice::WriteOnly | QIODevice::Append))
+  {
+    logger.error(QString("ctkJobJournal: failed to open %1: %2")
+      .arg(filePath)
+      .arg(d->File.errorString()));
+    d->PendingJobs.clear();
+    d->PendingJobsOrder.clear();
+    d->NumberOfRecords = 0;
+    return false;
+  }
+  // A record interrupted by a crash must not be continued by the next one
+  if (missingEndOfLine)
+  {
+    d->File.write("\n");
+  }
+  d->FlushTimer.start();
+
+  if (d->NumberOfRecords > d->CompactionThreshold &&
+      d->NumberOfRecords >= 2 * d->PendingJobs.count())
+  {
+    d->compact();
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkJobJournal::close()
+{
+  Q_D(ctkJobJournal);
+  QMutexLocker locker(&d->Mutex);
+  if (d->File.isOpen())
+  {
+    d->File.close();
+  }
+  d->PendingJobs.clear();
+  d->PendingJobsOrder.clear();
+  d->NumberOfRecords = 0;
+  d->Unflushed = false;
+}
+
+//------------------------------------------------------------------------------
+bool ctkJobJournal::isOpen() const
+{
+  Q_D(const ctkJobJournal);
+  QMutexLocker locker(&d->Mutex);
+  return d->File.isOpen();
+}
+
+//------------------------------------------------------------------------------
+QString ctkJobJournal::filePath() const
+{
+  Q_D(const ctkJobJournal);
+  QMutexLocker locker(&d->Mutex);
+  return d->File.isOpen() ? d->File.fileName() : QString();
+}
+
+//------------------------------------------------------------------------------
+QList<ctkJobJournal::JobRecord> ctkJobJournal::pendingJobs() const
+{
+  Q_D(const ctkJobJournal);
+  QMutexLocker locker(&d->Mutex);
+  QList<JobRecord> pendingJobs;
+  foreach (const QString& jobUID, d->PendingJobsOrder)
+  {
+    pendingJobs.append(d->PendingJobs.value(jobUID).Record);
+  }
+  return pendingJobs;
+}
+
+//------------------------------------------------------------------------------
+int ctkJobJournal::numberOfPendingJobs() const
+{
+  Q_D(const ctkJobJournal);
+  QMutexLocker locker(&d->Mutex);
+  return d->PendingJobs.count();
+}
+
+//------------------------------------------------------------------------------
+void ctkJobJournal::addJob(const QString& jobUID,
+                           const QString& className,
+                           const QVariantMap& parameters)
+{
+  Q_D(ctkJobJournal);
+  QMutexLocker locker(&d->Mutex);
+  if (!d->File.isOpen() || jobUID.isEmpty())
+  {
+    return;
+  }
+
+  JobRecord jobRecord;
+  jobRecord.JobUID = jobUID;
+  jobRecord.ClassName = className;
+  jobRecord.Parameters = parameters;
+  d->addPendingJob(jobRecord);
+
+  QJsonObject record;
+  record.insert("op", QString("add"));
+  record.insert("uid", jobUID);
+  record.insert("class", className);
+  record.insert("parameters", QJsonObject::fromVariantMap(parameters));
+  d->appendRecord(record);
+}
+
+//------------------------------------------------------------------------------
+void ctkJobJournal::setJobStatus(const QString& jobUID, ctkAbstractJob::JobStatus status)
+{
+  Q_D(ctkJobJournal);
+  QMutexLocker locker(&d->Mutex);
+  if (!d->PendingJobs.contains(jobUID))
+  {
+    return;
+  }
+
+  if (isCompletedStatus(status))
+  {
+    d->removePendingJob(jobUID);
+  }
+
+  QJsonObject record;
+  record.insert("op", QString("status"));
+  record.insert("uid", jobUID);
+  record.insert("status", static_cast<int>(status));
+  d->appendRecord(record);
+}
+
+//------------------------------------------------------------------------------
+void ctkJobJournal::removeJob(const QString& jobUID)
+{
+  Q_D(ctkJobJournal);
+  QMutexLocker locker(&d->Mutex);
+  if (!d->PendingJobs.contains(jobUID))
+  {
+    return;
+  }
+
+  d->removePendingJob(jobUID);
+
+  QJsonObject record;
+  record.insert("op", QString("remove"));
+  record.insert("uid", jobUID);
+  d->appendRecord(record);
+}
+
+//------------------------------------------------------------------------------
+void ctkJobJournal::flush()
+{
+  Q_D(ctkJobJournal);
+  QMutexLocker locker(&d->Mutex);
+  d->flush();
+}
+
+//------------------------------------------------------------------------------
+bool ctkJobJournal::compact()
+{
+  Q_D(ctkJobJournal);
+  QMutexLocker locker(&d->Mutex);
+  return d->compact();
+}
+
+//------------------------------------------------------------------------------
+int ctkJobJournal::numberOfRecords() const
+{
+  Q_D(const ctkJobJournal);
+  QMutexLocker locker(&d->Mutex);
+  return d->NumberOfRecords;
+}
+
+//------------------------------------------------------------------------------
+void ctkJobJournal::setCompactionThreshold(int compactionThreshold)
+{
+  Q_D(ctkJobJournal);
+  QMutexLocker locker(&d->Mutex);
+  d->CompactionThreshold = compactionThreshold;
+}
+
+//------------------------------------------------------------------------------
+int ctkJobJournal::compactionThreshold() const
+{
+  Q_D(const ctkJobJournal);
+  QMutexLocker locker(&d->Mutex);
+  return d->CompactionThreshold;
+}
+
+//------------------------------------------------------------------------------
+void ctkJobJournal::setFlushInterval(int flushInterval)
+{
+  Q_D(ctkJobJournal);
+  QMutexLocker locker(&d->Mutex);
+  d->FlushInterval = flushInterval;
+}
+
+//------------------------------------------------------------------------------
+int ctkJobJournal::flushInterval() const
+{
+  Q_D(const ctkJobJournal);
+  QMutexLocker locker(&d->Mutex);
+  return d->FlushInterval;
+}
@@ -0,0 +1,122 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+#ifndef __ctkJobJournal_h
+#define __ctkJobJournal_h
+
+// Qt includes
+#include <QList>
+#include <QScopedPointer>
+#include <QString>
+#include <QVariant>
+
+// CTK includes
+#include "ctkAbstractJob.h"
+#include "ctkCoreExport.h"
+class ctkJobJournalPrivate;
+
+//------------------------------------------------------------------------------
+/// \ingroup Core
+///
+/// \brief Append-only journal of job submissions and status changes.
+///
+/// Each record is a line of JSON appended to the journal file: the submission of
+/// a job with its class name and parameters (see ctkAbstractJob::parameters()), or
+/// a change of its status. Pending jobs are the jobs submitted and not completed yet
+/// (i.e. neither user stopped, failed nor finished); they are loaded when the journal
+/// is opened, so that they can be submitted again after a restart.
+///
+/// Records are buffered and flushed to the operating system at most every flushInterval()
+/// milliseconds, or by flush(). The file is never synchronized to the disk explicitly.
+/// When the number of records exceeds compactionThreshold() and most of them are about
+/// completed jobs, the file is rewritten with the submissions of the pending jobs only.
+///
+/// This class is thread-safe.
+class CTK_CORE_EXPORT ctkJobJournal
+{
+public:
+  ctkJobJournal();
+  virtual ~ctkJobJournal();
+
+  struct JobRecord
+  {
+    QString JobUID;
+    QString ClassName;
+    QVariantMap Parameters;
+  };
+
+  ///@{
+  /// Open the journal file, creating it if it does not exist, and load its pending jobs.
+  /// A record that cannot be read (e.g. the last one after a crash) is skipped.
+  /// Return false if the file cannot be opened.
+  bool open(const QString& filePath);
+  void close();
+  bool isOpen() const;
+  QString filePath() const;
+  ///@}
+
+  /// Pending jobs, in submission order
+  QList<JobRecord> pendingJobs() const;
+  int numberOfPendingJobs() const;
+
+  /// Append the submission of a job. Submitting a pending job again replaces its parameters.
+  void addJob(const QString& jobUID, const QString& className, const QVariantMap& parameters);
+
+  /// Append the status of a pending job. Jobs user stopped, failed or finished are completed,
+  /// a failed attempt does not complete a job.
+  /// The status of the jobs that are not pending is ignored.
+  void setJobStatus(const QString& jobUID, ctkAbstractJob::JobStatus status);
+
+  /// Append the removal of a pending job, which is completed.
+  void removeJob(const QString& jobUID);
+
+  /// Write the buffered records
+  void flush();
+
+  /// Rewrite the file with the submissions of the pending jobs only
+  bool compact();
+
+  /// Number of records in the file
+  int numberOfRecords() const;
+
+  ///@{
+  /// Number of records above which the journal is compacted, if at least half of
+  /// them are about completed jobs.
+  /// default: 10000
+  void setCompactionThreshold(int compactionThreshold);
+  int compactionThreshold() const;
+  ///@}
+
+  ///@{
+  /// Maximum time in milliseconds between writing a record and flushing it.
+  /// default: 1000
+  void setFlushInterval(int flushInterval);
+  int flushInterval() const;
+  ///@}
+
+protected:
+  QScopedPointer<ctkJobJournalPrivate> d_ptr;
+
+private:
+  Q_DECLARE_PRIVATE(ctkJobJournal);
+  Q_DISABLE_COPY(ctkJobJournal);
+};
+
+#endif
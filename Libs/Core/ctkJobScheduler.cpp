@@ -24,14 +24,21 @@
 // Qt includes
 #include <QCoreApplication>
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QMetaMethod>
+#include <QMutexLocker>
 #include <QReadLocker>
 #include <QWriteLocker>
 #include <QSharedPointer>
 #include <QThreadPool>
 #include <QUuid>
 
+// STD includes
+#include <climits>
+
 // CTK includes
 #include "ctkAbstractJob.h"
+#include "ctkJobJournal.h"
 #include "ctkJobScheduler.h"
 #include "ctkJobScheduler_p.h"
 #include "ctkAbstractWorker.h"
@@ -58,6 +65,7 @@ void ctkJobSchedulerPrivate::init()
 
   this->ThreadPool = QSharedPointer<QThreadPool>(new QThreadPool(this));
   this->ThreadPool->setMaxThreadCount(20);
+  this->Journal = QSharedPointer<ctkJobJournal>(new ctkJobJournal);
   this->ThrottleTimer = QSharedPointer<QTimer>(new QTimer(this));
   this->ThrottleTimer->setSingleShot(true);
 
@@ -68,7 +76,6 @@ void ctkJobSchedulerPrivate::init()
 //------------------------------------------------------------------------------
 void ctkJobSchedulerPrivate::queueJobsInThreadPool()
 {
-  Q_Q(ctkJobScheduler);
   // NOTE: No need to queue jobs with a signal/slot mechanism, since the mutex makes
   // sure that concurrent threads append/clean/delete the jobs map.
 
@@ -88,45 +95,45 @@ void ctkJobSchedulerPrivate::queueJobsInThreadPool()
                                           << QThread::Priority::LowPriority
                                           << QThread::Priority::LowestPriority))
     {
-      foreach (QSharedPointer<ctkAbstractJob> job, this->JobsQueue)
+      QMap<int, QMap<QString, QMap<quint64, QString>>>::iterator priorityIt =
+        this->ReadyJobs.find(priority);
+      if (priorityIt == this->ReadyJobs.end())
       {
-        if (this->FreezeJobsScheduling)
-        {
-          return;
-        }
-
-        if (job->priority() != priority)
-        {
-          continue;
-        }
-
-        if (job->status() != ctkAbstractJob::JobStatus::Initialized)
-        {
-          continue;
-        }
+        continue;
+      }
 
-        int numberOfRunningJobsWithSameType = this->getSameTypeJobsInThreadPoolQueueOrRunning(job);
-        if (numberOfRunningJobsWithSameType >= job->maximumConcurrentJobsPerType())
+      // Empty lists are kept in the index (there is at most one by priority and job class),
+      // so that taking jobs does not invalidate these iterators.
+      for (QMap<QString, QMap<quint64, QString>>::iterator classIt = priorityIt.value().begin();
+           classIt != priorityIt.value().end(); ++classIt)
+      {
+        QMap<quint64, QString>& readyJobs = classIt.value();
+        while (!readyJobs.isEmpty())
         {
-          // When the maximum number of concurrent jobs of the same type is reached,
-          // return early instead of adding more jobs to an already crowded queue.
-          // This allows the scheduler time to finish the currently running jobs,
-          // preventing a jobs traffic jam.
-          return;
+          if (this->FreezeJobsScheduling)
+          {
+            return;
+          }
+
+          QString jobUID = readyJobs.first();
+          QSharedPointer<ctkAbstractJob> job = this->JobsQueue.value(jobUID);
+          if (!job || job->status() != ctkAbstractJob::JobStatus::Initialized)
+          {
+            this->takeReadyJob(jobUID);
+            continue;
+          }
+
+          if (this->RunningJobsByJobClass.value(classIt.key()) >= job->maximumConcurrentJobsPerType())
+          {
+            // When the maximum number of concurrent jobs of the same type is reached,
+            // skip the remaining jobs of this type instead of adding more jobs to an
+            // already crowded queue. This allows the scheduler time to finish the
+            // currently running jobs, preventing a jobs traffic jam.
+            break;
+          }
+
+          this->dispatchJob(job);
         }
-
-        logger.debug(QString("ctkDICOMScheduler: creating worker for job %1 in thread %2.\n")
-                   .arg(job->jobUID())
-                   .arg(QString::number(reinterpret_cast<quint64>(QThread::currentThreadId())), 16));
-
-        QSharedPointer<ctkAbstractWorker> worker = QSharedPointer<ctkAbstractWorker>(job->createWorker());
-        worker->setScheduler(*q);
-        this->Workers.insert(job->jobUID(), worker);
-
-        job->setStatus(ctkAbstractJob::JobStatus::Queued);
-        emit q->jobQueued(job->toVariant());
-
-        this->ThreadPool->start(worker.data(), job->priority());
       }
     }
   }
@@ -176,6 +183,23 @@ bool ctkJobSchedulerPrivate::insertJob(QSharedPointer<ctkAbstractJob> job)
     QObject::connect(job.data(), SIGNAL(progressJobDetail(QVariant)),
                      q, SLOT(onProgressJobDetail(QVariant)));
 
+  // The jobs are completed in the threads of the workers: direct connections wake up
+  // the threads waiting for them without waiting for the event loop of the scheduler.
+  // They are made last, so that the slots above are already queued when waiters wake up.
+  QString jobUID = job->jobUID();
+  QMetaObject::Connection userStoppedCompletionConnection = QObject::connect(job.data(), &ctkAbstractJob::userStopped, this, [this, jobUID](){
+    this->notifyJobsCompletion(QStringList(jobUID));
+  }, Qt::DirectConnection);
+  QMetaObject::Connection finishedCompletionConnection = QObject::connect(job.data(), &ctkAbstractJob::finished, this, [this, jobUID](){
+    this->notifyJobsCompletion(QStringList(jobUID));
+  }, Qt::DirectConnection);
+  QMetaObject::Connection attemptFailedCompletionConnection = QObject::connect(job.data(), &ctkAbstractJob::attemptFailed, this, [this, jobUID](){
+    this->notifyJobsCompletion(QStringList(jobUID));
+  }, Qt::DirectConnection);
+  QMetaObject::Connection failedCompletionConnection = QObject::connect(job.data(), &ctkAbstractJob::failed, this, [this, jobUID](){
+    this->notifyJobsCompletion(QStringList(jobUID));
+  }, Qt::DirectConnection);
+
   QMap<QString, QMetaObject::Connection> connections =
   {
     {"started", startedConnection},
@@ -184,40 +208,32 @@ bool ctkJobSchedulerPrivate::insertJob(QSharedPointer<ctkAbstractJob> job)
     {"attemptFailed", attemptFailedConnection},
     {"failed", failedConnection},
     {"progress", progressConnection},
+    {"userStoppedCompletion", userStoppedCompletionConnection},
+    {"finishedCompletion", finishedCompletionConnection},
+    {"attemptFailedCompletion", attemptFailedCompletionConnection},
+    {"failedCompletion", failedCompletionConnection},
   };
 
-  emit q->jobInitialized(job->toVariant());
-
-  logger.debug(QString("ctkDICOMScheduler: creating worker for job %1 in thread %2.\n")
-                     .arg(job->jobUID())
-                     .arg(QString::number(reinterpret_cast<quint64>(QThread::currentThreadId())), 16));
+  if (q->isSignalConnected(QMetaMethod::fromSignal(&ctkJobScheduler::jobInitialized)))
+  {
+    emit q->jobInitialized(job->toVariant());
+  }
 
-  QSharedPointer<ctkAbstractWorker> worker;
   {
     // The QWriteLocker is enclosed within brackets to restrict its scope and
     // prevent conflicts with other QWriteLockers within the scheduler's methods.
     QWriteLocker locker(&this->QueueLock);
     this->JobsQueue.insert(job->jobUID(), job);
     this->JobsConnections.insert(job->jobUID(), connections);
+    this->insertReadyJob(job);
+    this->journalJobSubmission(job);
 
-    int numberOfRunningJobsWithSameType = this->getSameTypeJobsInThreadPoolQueueOrRunning(job);
-    if (numberOfRunningJobsWithSameType >= job->maximumConcurrentJobsPerType())
+    if (this->RunningJobsByJobClass.value(job->className()) >= job->maximumConcurrentJobsPerType())
     {
       return false;
     }
 
-    logger.debug(QString("ctkDICOMScheduler: creating worker for job %1 in thread %2.\n")
-                   .arg(job->jobUID())
-                   .arg(QString::number(reinterpret_cast<quint64>(QThread::currentThreadId())), 16));
-
-    QSharedPointer<ctkAbstractWorker> worker = QSharedPointer<ctkAbstractWorker>(job->createWorker());
-    worker->setScheduler(*q);
-    this->Workers.insert(job->jobUID(), worker);
-
-    job->setStatus(ctkAbstractJob::JobStatus::Queued);
-    emit q->jobQueued(job->toVariant());
-
-    this->ThreadPool->start(worker.data(), job->priority());
+    this->dispatchJob(job);
   }
 
   return true;
@@ -240,6 +256,10 @@ bool ctkJobSchedulerPrivate::cleanJob(const QString &jobUID)
       return false;
     }
 
+    if (job->status() > ctkAbstractJob::JobStatus::Running)
+    {
+      this->releaseDispatchedJob(jobUID);
+    }
     job->releaseResources();
   }
 
@@ -252,6 +272,8 @@ void ctkJobSchedulerPrivate::cleanJobs(const QStringList &jobUIDs)
 {
   Q_Q(ctkJobScheduler);
 
+  bool jobUserStoppedConnected =
+    q->isSignalConnected(QMetaMethod::fromSignal(&ctkJobScheduler::jobUserStopped));
   QList<QVariant> dataObjects;
   {
     // The QReadLocker is enclosed within brackets to restrict its scope and
@@ -266,12 +288,18 @@ void ctkJobSchedulerPrivate::cleanJobs(const QStringList &jobUIDs)
         continue;
       }
 
-      dataObjects.append(job->toVariant());
+      if (jobUserStoppedConnected)
+      {
+        dataObjects.append(job->toVariant());
+      }
       job->releaseResources();
     }
   }
 
-  emit q->jobUserStopped(dataObjects);
+  if (jobUserStoppedConnected)
+  {
+    emit q->jobUserStopped(dataObjects);
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -292,17 +320,18 @@ bool ctkJobSchedulerPrivate::removeJob(const QString& jobUID)
     }
 
     QMap<QString, QMetaObject::Connection> connections = this->JobsConnections.value(jobUID);
-    QObject::disconnect(connections.value("started"));
-    QObject::disconnect(connections.value("userStopped"));
-    QObject::disconnect(connections.value("finished"));
-    QObject::disconnect(connections.value("attemptFailed"));
-    QObject::disconnect(connections.value("failed"));
-    QObject::disconnect(connections.value("progress"));
+    foreach (QMetaObject::Connection connection, connections)
+    {
+      QObject::disconnect(connection);
+    }
 
     this->JobsConnections.remove(jobUID);
     this->JobsQueue.remove(jobUID);
+    this->takeReadyJob(jobUID);
+    this->releaseDispatchedJob(jobUID);
   }
 
+  this->notifyJobsCompletion(QStringList(jobUID));
   this->queueJobsInThreadPool();
   return true;
 }
@@ -324,36 +353,28 @@ void ctkJobSchedulerPrivate::removeJobs(const QStringList &jobUIDs)
       }
 
       QMap<QString, QMetaObject::Connection> connections = this->JobsConnections.value(jobUID);
-      QObject::disconnect(connections.value("started"));
-      QObject::disconnect(connections.value("userStopped"));
-      QObject::disconnect(connections.value("finished"));
-      QObject::disconnect(connections.value("attemptFailed"));
-      QObject::disconnect(connections.value("failed"));
-      QObject::disconnect(connections.value("progress"));
+      foreach (QMetaObject::Connection connection, connections)
+      {
+        QObject::disconnect(connection);
+      }
 
       this->JobsConnections.remove(jobUID);
       this->JobsQueue.remove(jobUID);
+      this->takeReadyJob(jobUID);
+      this->releaseDispatchedJob(jobUID);
     }
   }
+
+  this->notifyJobsCompletion(jobUIDs);
 }
 
 //------------------------------------------------------------------------------
 int ctkJobSchedulerPrivate::getSameTypeJobsInThreadPoolQueueOrRunning(QSharedPointer<ctkAbstractJob> job)
 {
-  int count = 0;
-  foreach (QSharedPointer<ctkAbstractJob> queuedJob, this->JobsQueue)
+  int count = this->RunningJobsByJobClass.value(job->className());
+  if (this->DispatchedJobs.contains(job->jobUID()))
   {
-    if (queuedJob->jobUID() == job->jobUID())
-    {
-      continue;
-    }
-
-    if ((queuedJob->status() == ctkAbstractJob::JobStatus::Queued ||
-         queuedJob->status() == ctkAbstractJob::JobStatus::Running) &&
-        queuedJob->className() == job->className())
-    {
-      count++;
-    }
+    count--;
   }
 
   return count;
@@ -376,6 +397,405 @@ void ctkJobSchedulerPrivate::clearBactchedJobsLists()
   this->BatchedJobsProgress.clear();
 }
 
+//------------------------------------------------------------------------------
+void ctkJobSchedulerPrivate::setMaximumThreadCount(int maximumThreadCount)
+{
+  this->ThreadPool->setMaxThreadCount(maximumThreadCount);
+}
+
+//------------------------------------------------------------------------------
+QString ctkJobSchedulerPrivate::progressJobUID(const QVariant& data) const
+{
+  if (!data.canConvert<ctkJobDetail>())
+  {
+    return QString();
+  }
+  return data.value<ctkJobDetail>().JobUID;
+}
+
+//------------------------------------------------------------------------------
+void ctkJobSchedulerPrivate::insertReadyJob(QSharedPointer<ctkAbstractJob> job)
+{
+  if (!job)
+  {
+    return;
+  }
+
+  QString jobUID = job->jobUID();
+  this->takeReadyJob(jobUID);
+  this->releaseDispatchedJob(jobUID);
+
+  ReadyJobEntry entry;
+  entry.Priority = job->priority();
+  entry.ClassName = job->className();
+  entry.Lane = this->laneForJobClass(entry.ClassName);
+  entry.Sequence = this->ReadyJobsSequence++;
+  this->ReadyJobs[entry.Priority][entry.ClassName].insert(entry.Sequence, jobUID);
+  this->ReadyJobsEntries.insert(jobUID, entry);
+  this->ReadyJobsByLane[entry.Lane]++;
+  this->addPendingJob(job);
+}
+
+//------------------------------------------------------------------------------
+bool ctkJobSchedulerPrivate::takeReadyJob(const QString& jobUID)
+{
+  QHash<QString, ReadyJobEntry>::iterator it = this->ReadyJobsEntries.find(jobUID);
+  if (it == this->ReadyJobsEntries.end())
+  {
+    return false;
+  }
+
+  this->ReadyJobs[it->Priority][it->ClassName].remove(it->Sequence);
+  this->ReadyJobsByLane[it->Lane]--;
+  this->ReadyJobsEntries.erase(it);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkJobSchedulerPrivate::setJobPriority(QSharedPointer<ctkAbstractJob> job, QThread::Priority priority)
+{
+  if (!job)
+  {
+    return;
+  }
+
+  job->setPriority(priority);
+
+  QString jobUID = job->jobUID();
+  QHash<QString, ReadyJobEntry>::iterator it = this->ReadyJobsEntries.find(jobUID);
+  if (it == this->ReadyJobsEntries.end() || it->Priority == priority)
+  {
+    return;
+  }
+
+  // The insertion order is kept, so that the job is not moved behind the jobs added after it
+  this->ReadyJobs[it->Priority][it->ClassName].remove(it->Sequence);
+  it->Priority = priority;
+  this->ReadyJobs[it->Priority][it->ClassName].insert(it->Sequence, jobUID);
+}
+
+//------------------------------------------------------------------------------
+void ctkJobSchedulerPrivate::dispatchJob(QSharedPointer<ctkAbstractJob> job)
+{
+  Q_Q(ctkJobScheduler);
+
+  if (!job)
+  {
+    return;
+  }
+
+  logger.debug(QString("ctkJobScheduler: creating worker for job %1 in thread %2.\n")
+               .arg(job->jobUID())
+               .arg(QString::number(reinterpret_cast<quint64>(QThread::currentThreadId())), 16));
+
+  QString jobUID = job->jobUID();
+  this->takeReadyJob(jobUID);
+
+  QSharedPointer<ctkAbstractWorker> worker = QSharedPointer<ctkAbstractWorker>(job->createWorker());
+  worker->setScheduler(*q);
+  this->Workers.insert(jobUID, worker);
+
+  DispatchedJobEntry entry;
+  entry.ClassName = job->className();
+  entry.Lane = this->laneForJobClass(entry.ClassName);
+  if (!this->DispatchedJobs.contains(jobUID))
+  {
+    this->DispatchedJobs.insert(jobUID, entry);
+    this->RunningJobsByJobClass[entry.ClassName]++;
+    this->DispatchedJobsByLane[entry.Lane]++;
+  }
+
+  job->setStatus(ctkAbstractJob::JobStatus::Queued);
+  if (q->isSignalConnected(QMetaMethod::fromSignal(&ctkJobScheduler::jobQueued)))
+  {
+    emit q->jobQueued(job->toVariant());
+  }
+
+  this->laneThreadPool(entry.Lane)->start(worker.data(), job->priority());
+}
+
+//------------------------------------------------------------------------------
+void ctkJobSchedulerPrivate::releaseDispatchedJob(const QString& jobUID)
+{
+  QHash<QString, DispatchedJobEntry>::iterator it = this->DispatchedJobs.find(jobUID);
+  if (it == this->DispatchedJobs.end())
+  {
+    return;
+  }
+
+  QMap<QString, int>::iterator counterIt = this->RunningJobsByJobClass.find(it->ClassName);
+  if (counterIt != this->RunningJobsByJobClass.end() && --counterIt.value() <= 0)
+  {
+    this->RunningJobsByJobClass.erase(counterIt);
+  }
+  this->DispatchedJobsByLane[it->Lane]--;
+  this->DispatchedJobs.erase(it);
+}
+
+//------------------------------------------------------------------------------
+QString ctkJobSchedulerPrivate::laneForJobClass(const QString& className) const
+{
+  QString lane = this->JobClassesLanes.value(className);
+  if (!this->LanesThreadPools.contains(lane))
+  {
+    return QString();
+  }
+  return lane;
+}
+
+//------------------------------------------------------------------------------
+QSharedPointer<QThreadPool> ctkJobSchedulerPrivate::laneThreadPool(const QString& lane) const
+{
+  return this->LanesThreadPools.value(lane, this->ThreadPool);
+}
+
+//------------------------------------------------------------------------------
+void ctkJobSchedulerPrivate::addPendingJob(QSharedPointer<ctkAbstractJob> job)
+{
+  if (!job)
+  {
+    return;
+  }
+
+  QMutexLocker locker(&this->CompletionMutex);
+  QString jobUID = job->jobUID();
+  if (this->PendingJobs.contains(jobUID))
+  {
+    return;
+  }
+
+  bool persistent = job->isPersistent();
+  this->PendingJobs.insert(jobUID, persistent);
+  if (persistent)
+  {
+    this->NumberOfPendingPersistentJobs++;
+  }
+}
+
+//------------------------------------------------------------------------------
+void ctkJobSchedulerPrivate::notifyJobsCompletion(const QStringList& jobUIDs)
+{
+  QMutexLocker locker(&this->CompletionMutex);
+  foreach (const QString& jobUID, jobUIDs)
+  {
+    QHash<QString, bool>::iterator it = this->PendingJobs.find(jobUID);
+    if (it == this->PendingJobs.end())
+    {
+      continue;
+    }
+
+    if (it.value())
+    {
+      this->NumberOfPendingPersistentJobs--;
+    }
+    this->PendingJobs.erase(it);
+  }
+
+  this->CompletionCount++;
+  this->CompletionCondition.wakeAll();
+}
+
+//------------------------------------------------------------------------------
+bool ctkJobSchedulerPrivate::isJobPending(const QString& jobUID)
+{
+  QMutexLocker locker(&this->CompletionMutex);
+  return this->PendingJobs.contains(jobUID);
+}
+
+//------------------------------------------------------------------------------
+int ctkJobSchedulerPrivate::numberOfPendingJobs(bool includePersistentJobs)
+{
+  QMutexLocker locker(&this->CompletionMutex);
+  if (includePersistentJobs)
+  {
+    return this->PendingJobs.count();
+  }
+  return this->PendingJobs.count() - this->NumberOfPendingPersistentJobs;
+}
+
+//------------------------------------------------------------------------------
+bool ctkJobSchedulerPrivate::waitForCompletion(std::function<bool()> isCompleted,
+                                               int msec,
+                                               bool processEvents)
+{
+  QElapsedTimer timer;
+  timer.start();
+  while (true)
+  {
+    // The count is read before checking the jobs, so that completions happening
+    // in the meanwhile are not missed.
+    quint64 completionCount = 0;
+    {
+      QMutexLocker locker(&this->CompletionMutex);
+      completionCount = this->CompletionCount;
+    }
+
+    if (processEvents)
+    {
+      qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
+    }
+
+    if (isCompleted())
+    {
+      return true;
+    }
+
+    unsigned long waitTime = ULONG_MAX;
+    if (processEvents)
+    {
+      // Completions wake up the thread immediately, the events posted to this thread
+      // in the meanwhile (e.g. to the slots of the scheduler) are processed regularly.
+      waitTime = 100;
+    }
+    if (msec >= 0)
+    {
+      qint64 remainingTime = msec - timer.elapsed();
+      if (remainingTime <= 0)
+      {
+        return false;
+      }
+      waitTime = qMin(waitTime, static_cast<unsigned long>(remainingTime));
+    }
+
+    QMutexLocker locker(&this->CompletionMutex);
+    if (this->CompletionCount == completionCount)
+    {
+      this->CompletionCondition.wait(&this->CompletionMutex, waitTime);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void ctkJobSchedulerPrivate::journalJobSubmission(QSharedPointer<ctkAbstractJob> job)
+{
+  if (!job || job->isPersistent() || !this->JobFactories.contains(job->className()) ||
+      !this->Journal->isOpen())
+  {
+    return;
+  }
+
+  this->Journal->addJob(job->jobUID(), job->className(), job->parameters());
+}
+
+//------------------------------------------------------------------------------
+void ctkJobSchedulerPrivate::batchJobEvent(ctkJobEvent::EventType type,
+                                           ctkAbstractJob* job,
+                                           const QVariant& detail)
+{
+  Q_Q(ctkJobScheduler);
+
+  if (!job)
+  {
+    return;
+  }
+
+  // The details of the jobs are built only for the connected signals
+  QList<QVariant>* batchedJobs = nullptr;
+  QMetaMethod signal;
+  switch (type)
+  {
+    case ctkJobEvent::Started:
+      batchedJobs = &this->BatchedJobsStarted;
+      signal = QMetaMethod::fromSignal(&ctkJobScheduler::jobStarted);
+      break;
+    case ctkJobEvent::UserStopped:
+      batchedJobs = &this->BatchedJobsUserStopped;
+      signal = QMetaMethod::fromSignal(&ctkJobScheduler::jobUserStopped);
+      break;
+    case ctkJobEvent::Finished:
+      batchedJobs = &this->BatchedJobsFinished;
+      signal = QMetaMethod::fromSignal(&ctkJobScheduler::jobFinished);
+      break;
+    case ctkJobEvent::AttemptFailed:
+      batchedJobs = &this->BatchedJobsAttemptFailed;
+      signal = QMetaMethod::fromSignal(&ctkJobScheduler::jobAttemptFailed);
+      break;
+    case ctkJobEvent::Failed:
+      batchedJobs = &this->BatchedJobsFailed;
+      signal = QMetaMethod::fromSignal(&ctkJobScheduler::jobFailed);
+      break;
+    case ctkJobEvent::Progress:
+      batchedJobs = &this->BatchedJobsProgress;
+      signal = QMetaMethod::fromSignal(&ctkJobScheduler::progressJobDetail);
+      break;
+    default:
+      break;
+  }
+  if (batchedJobs && q->isSignalConnected(signal))
+  {
+    batchedJobs->append(type == ctkJobEvent::Progress ? detail : job->toVariant());
+  }
+
+  QString jobClass = job->className();
+  QString jobUID = job->jobUID();
+  if (!this->isJobEventSubscribed(type, jobClass, jobUID))
+  {
+    return;
+  }
+
+  QSharedPointer<ctkJobEvent> jobEvent(new ctkJobEvent);
+  jobEvent->Type = type;
+  jobEvent->JobClass = jobClass;
+  jobEvent->JobUID = jobUID;
+  jobEvent->Status = job->status();
+  jobEvent->Job = q->getJobSharedByUID(jobUID);
+  jobEvent->Detail = detail;
+  this->BatchedJobEvents.append(jobEvent);
+}
+
+//------------------------------------------------------------------------------
+bool ctkJobSchedulerPrivate::isJobEventSubscribed(ctkJobEvent::EventType type,
+                                                  const QString& jobClass,
+                                                  const QString& jobUID) const
+{
+  foreach (const JobEventsSubscription& subscription, this->JobEventsSubscriptions)
+  {
+    if (subscription.accepts(type, jobClass, jobUID))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+void ctkJobSchedulerPrivate::deliverJobEvents()
+{
+  if (this->BatchedJobEvents.isEmpty())
+  {
+    return;
+  }
+
+  QList<ctkJobEventPointer> jobEvents = this->BatchedJobEvents;
+  this->BatchedJobEvents.clear();
+
+  // The callbacks may subscribe or unsubscribe
+  foreach (int subscriptionID, this->JobEventsSubscriptions.keys())
+  {
+    QMap<int, JobEventsSubscription>::const_iterator it =
+      this->JobEventsSubscriptions.constFind(subscriptionID);
+    if (it == this->JobEventsSubscriptions.constEnd() || !it->Context)
+    {
+      continue;
+    }
+
+    QList<ctkJobEventPointer> subscriptionJobEvents;
+    foreach (const ctkJobEventPointer& jobEvent, jobEvents)
+    {
+      if (it->accepts(jobEvent->Type, jobEvent->JobClass, jobEvent->JobUID))
+      {
+        subscriptionJobEvents.append(jobEvent);
+      }
+    }
+
+    if (!subscriptionJobEvents.isEmpty())
+    {
+      ctkJobScheduler::JobEventsCallback callback = it->Callback;
+      callback(subscriptionJobEvents);
+    }
+  }
+}
+
 //---------------------------------------------------------------------------
 // ctkJobScheduler methods
 
@@ -400,6 +820,9 @@ ctkJobScheduler::ctkJobScheduler(ctkJobSchedulerPrivate* pimpl, QObject* parent)
 // --------------------------------------------------------------------------
 ctkJobScheduler::~ctkJobScheduler()
 {
+  Q_D(ctkJobScheduler);
+  // The jobs stopped below stay pending in the journal, to be resumed at the next start
+  d->Journal->close();
   this->stopAllJobs(true);
   // stopAllJobs is not main thread blocking. Therefore we need actually
   // to wait the jobs to end (either finished or stopped) before closing the application.
@@ -407,6 +830,8 @@ ctkJobScheduler::~ctkJobScheduler()
   // We should avoid the application crash at exiting.
   // The job scheduler currently waits all the jobs to be properly stopped.
   this->waitForFinish(true);
+  // Wait for the workers to return, they are deleted with the scheduler.
+  this->waitForDone();
 }
 
 //------------------------------------------------------------------------------
@@ -495,6 +920,7 @@ void ctkJobScheduler::deleteJob(const QString& jobUID)
 {
   Q_D(ctkJobScheduler);
   d->removeJob(jobUID);
+  d->Journal->removeJob(jobUID);
 }
 
 //----------------------------------------------------------------------------
@@ -502,6 +928,10 @@ void ctkJobScheduler::deleteJobs(const QStringList &jobUIDs)
 {
   Q_D(ctkJobScheduler);
   d->removeJobs(jobUIDs);
+  foreach (QString jobUID, jobUIDs)
+  {
+    d->Journal->removeJob(jobUID);
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -554,33 +984,65 @@ ctkAbstractJob* ctkJobScheduler::getJobByUID(const QString& jobUID)
 void ctkJobScheduler::waitForFinish(bool waitForPersistentJobs,
                                     bool processEvents)
 {
-  this->waitForDone(500);
-  if (processEvents)
+  Q_D(ctkJobScheduler);
+  d->waitForCompletion([d, waitForPersistentJobs]()
   {
-    qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
-  }
+    return d->numberOfPendingJobs(waitForPersistentJobs) == 0;
+  }, -1, processEvents);
+}
 
-  int numberOfPersistentJobs = this->numberOfPersistentJobs();
-  if (waitForPersistentJobs)
-  {
-    numberOfPersistentJobs = 0;
-  }
+//----------------------------------------------------------------------------
+bool ctkJobScheduler::waitForJobs(const QStringList& jobUIDs, int msec, bool processEvents)
+{
+  Q_D(ctkJobScheduler);
 
-  while (this->numberOfRunningJobs() > numberOfPersistentJobs)
+  // Completed jobs are dropped from the list, so that each job is checked
+  // until it is completed, and not again at each following completion.
+  QStringList pendingJobUIDs = jobUIDs;
+  return d->waitForCompletion([d, &pendingJobUIDs]()
   {
-    this->waitForDone(500);
-    if (processEvents)
+    while (!pendingJobUIDs.isEmpty())
     {
-      qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
+      if (d->isJobPending(pendingJobUIDs.first()))
+      {
+        return false;
+      }
+      pendingJobUIDs.removeFirst();
     }
-  }
+    return true;
+  }, msec, processEvents);
 }
 
 //----------------------------------------------------------------------------
 void ctkJobScheduler::waitForDone(int msec)
 {
   Q_D(ctkJobScheduler);
-  d->ThreadPool->waitForDone(msec);
+
+  QList<QSharedPointer<QThreadPool>> threadPools;
+  {
+    // The QReadLocker is enclosed within brackets to restrict its scope and
+    // prevent conflicts with other QReadLockers within the scheduler's methods.
+    QReadLocker locker(&d->QueueLock);
+    threadPools = d->LanesThreadPools.values();
+  }
+  threadPools.prepend(d->ThreadPool);
+
+  QElapsedTimer timer;
+  timer.start();
+  foreach (QSharedPointer<QThreadPool> threadPool, threadPools)
+  {
+    if (msec < 0)
+    {
+      threadPool->waitForDone();
+      continue;
+    }
+
+    int remainingTime = msec - static_cast<int>(timer.elapsed());
+    if (!threadPool->waitForDone(qMax(0, remainingTime)))
+    {
+      return;
+    }
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -591,9 +1053,9 @@ QStringList ctkJobScheduler::stopAllJobs(bool stopPersistentJobs, bool removeJob
   d->FreezeJobsScheduling = true;
   QStringList stoppedJobsUIDs;
   {
-    // The QReadLocker is enclosed within brackets to restrict its scope and
-    // prevent conflicts with other QReadLockers within the scheduler's methods.
-    QReadLocker locker(&d->QueueLock);
+    // The QWriteLocker is enclosed within brackets to restrict its scope and
+    // prevent conflicts with other QWriteLockers within the scheduler's methods.
+    QWriteLocker locker(&d->QueueLock);
 
     // Stops jobs without a worker (in waiting, still in main thread).
     foreach (QSharedPointer<ctkAbstractJob> job, d->JobsQueue)
@@ -623,11 +1085,17 @@ QStringList ctkJobScheduler::stopAllJobs(bool stopPersistentJobs, bool removeJob
       QMap<QString, QMetaObject::Connection> connections = d->JobsConnections.value(jobUID);
       QObject::disconnect(connections.value("userStopped"));
       job->setStatus(ctkAbstractJob::JobStatus::UserStopped);
-      d->BatchedJobsUserStopped.append(job->toVariant());
+      d->takeReadyJob(jobUID);
       stoppedJobsUIDs.append(jobUID);
     }
   }
 
+  foreach (QString jobUID, stoppedJobsUIDs)
+  {
+    d->batchJobEvent(ctkJobEvent::UserStopped, this->getJobByUID(jobUID));
+    d->Journal->setJobStatus(jobUID, ctkAbstractJob::JobStatus::UserStopped);
+  }
+
   if (removeJobs)
   {
     d->removeJobs(stoppedJobsUIDs);
@@ -705,11 +1173,17 @@ void ctkJobScheduler::stopJobsByJobUIDs(const QStringList &jobUIDs, bool removeJ
       QMap<QString, QMetaObject::Connection> connections = d->JobsConnections.value(jobUID);
       QObject::disconnect(connections.value("userStopped"));
       job->setStatus(ctkAbstractJob::JobStatus::UserStopped);
-      d->BatchedJobsUserStopped.append(job->toVariant());
+      d->takeReadyJob(jobUID);
       initializedStoppedJobsUIDs.append(job->jobUID());
     }
   }
 
+  foreach (QString jobUID, initializedStoppedJobsUIDs)
+  {
+    d->batchJobEvent(ctkJobEvent::UserStopped, this->getJobByUID(jobUID));
+    d->Journal->setJobStatus(jobUID, ctkAbstractJob::JobStatus::UserStopped);
+  }
+
   if (removeJobs)
   {
     d->removeJobs(initializedStoppedJobsUIDs);
@@ -759,7 +1233,17 @@ bool ctkJobScheduler::retryJob(const QString &jobUID)
   }
 
   job->setStatus(ctkAbstractJob::JobStatus::Initialized);
-  emit this->jobInitialized(job->toVariant());
+  {
+    // The QWriteLocker is enclosed within brackets to restrict its scope and
+    // prevent conflicts with other QWriteLockers within the scheduler's methods.
+    QWriteLocker locker(&d->QueueLock);
+    d->insertReadyJob(job);
+    d->journalJobSubmission(job);
+  }
+  if (this->isSignalConnected(QMetaMethod::fromSignal(&ctkJobScheduler::jobInitialized)))
+  {
+    emit this->jobInitialized(job->toVariant());
+  }
   d->queueJobsInThreadPool();
   return true;
 }
@@ -785,7 +1269,7 @@ int ctkJobScheduler::maximumThreadCount() const
 void ctkJobScheduler::setMaximumThreadCount(const int& maximumThreadCount)
 {
   Q_D(ctkJobScheduler);
-  d->ThreadPool->setMaxThreadCount(maximumThreadCount);
+  d->setMaximumThreadCount(maximumThreadCount);
 }
 
 //----------------------------------------------------------------------------
@@ -802,6 +1286,302 @@ QSharedPointer<QThreadPool> ctkJobScheduler::threadPoolShared() const
   return d->ThreadPool;
 }
 
+//----------------------------------------------------------------------------
+void ctkJobScheduler::setLane(const QString& lane, int maximumThreadCount)
+{
+  Q_D(ctkJobScheduler);
+
+  if (lane.isEmpty())
+  {
+    this->setMaximumThreadCount(maximumThreadCount);
+    return;
+  }
+
+  // The QWriteLocker is enclosed within brackets to restrict its scope and
+  // prevent conflicts with other QWriteLockers within the scheduler's methods.
+  QWriteLocker locker(&d->QueueLock);
+  QSharedPointer<QThreadPool> threadPool = d->LanesThreadPools.value(lane);
+  if (!threadPool)
+  {
+    threadPool = QSharedPointer<QThreadPool>(new QThreadPool);
+    d->LanesThreadPools.insert(lane, threadPool);
+  }
+  threadPool->setMaxThreadCount(qMax(1, maximumThreadCount));
+}
+
+//----------------------------------------------------------------------------
+QStringList ctkJobScheduler::lanes()
+{
+  Q_D(ctkJobScheduler);
+
+  // The QReadLocker is enclosed within brackets to restrict its scope and
+  // prevent conflicts with other QReadLockers within the scheduler's methods.
+  QReadLocker locker(&d->QueueLock);
+  return QStringList(QString()) << d->LanesThreadPools.keys();
+}
+
+//----------------------------------------------------------------------------
+void ctkJobScheduler::setJobClassLane(const QString& jobClassName, const QString& lane)
+{
+  Q_D(ctkJobScheduler);
+
+  // The QWriteLocker is enclosed within brackets to restrict its scope and
+  // prevent conflicts with other QWriteLockers within the scheduler's methods.
+  QWriteLocker locker(&d->QueueLock);
+  if (lane.isEmpty())
+  {
+    d->JobClassesLanes.remove(jobClassName);
+  }
+  else
+  {
+    d->JobClassesLanes.insert(jobClassName, lane);
+  }
+}
+
+//----------------------------------------------------------------------------
+QString ctkJobScheduler::jobClassLane(const QString& jobClassName)
+{
+  Q_D(ctkJobScheduler);
+
+  // The QReadLocker is enclosed within brackets to restrict its scope and
+  // prevent conflicts with other QReadLockers within the scheduler's methods.
+  QReadLocker locker(&d->QueueLock);
+  return d->laneForJobClass(jobClassName);
+}
+
+//----------------------------------------------------------------------------
+QThreadPool* ctkJobScheduler::laneThreadPool(const QString& lane)
+{
+  Q_D(ctkJobScheduler);
+
+  // The QReadLocker is enclosed within brackets to restrict its scope and
+  // prevent conflicts with other QReadLockers within the scheduler's methods.
+  QReadLocker locker(&d->QueueLock);
+  if (!lane.isEmpty() && !d->LanesThreadPools.contains(lane))
+  {
+    return nullptr;
+  }
+  return d->laneThreadPool(lane).data();
+}
+
+//----------------------------------------------------------------------------
+int ctkJobScheduler::laneQueueDepth(const QString& lane)
+{
+  Q_D(ctkJobScheduler);
+
+  // The QReadLocker is enclosed within brackets to restrict its scope and
+  // prevent conflicts with other QReadLockers within the scheduler's methods.
+  QReadLocker locker(&d->QueueLock);
+  if (!lane.isEmpty() && !d->LanesThreadPools.contains(lane))
+  {
+    return 0;
+  }
+
+  // Jobs waiting in the scheduler, and jobs given to the thread pool waiting for a thread
+  int waitingInThreadPool = d->DispatchedJobsByLane.value(lane) - d->laneThreadPool(lane)->activeThreadCount();
+  return d->ReadyJobsByLane.value(lane) + qMax(0, waitingInThreadPool);
+}
+
+//----------------------------------------------------------------------------
+int ctkJobScheduler::laneActiveThreadCount(const QString& lane)
+{
+  QThreadPool* threadPool = this->laneThreadPool(lane);
+  if (!threadPool)
+  {
+    return 0;
+  }
+  return threadPool->activeThreadCount();
+}
+
+//----------------------------------------------------------------------------
+double ctkJobScheduler::laneUtilization(const QString& lane)
+{
+  QThreadPool* threadPool = this->laneThreadPool(lane);
+  if (!threadPool || threadPool->maxThreadCount() <= 0)
+  {
+    return 0.;
+  }
+  return qMin(1., static_cast<double>(threadPool->activeThreadCount()) / threadPool->maxThreadCount());
+}
+
+//----------------------------------------------------------------------------
+int ctkJobScheduler::subscribeToJobEvents(QObject* context,
+                                          JobEventsCallback callback,
+                                          ctkJobEvent::EventTypes eventTypes,
+                                          const QStringList& jobClasses,
+                                          const QStringList& jobUIDs)
+{
+  Q_D(ctkJobScheduler);
+
+  if (!context || !callback)
+  {
+    logger.warn("ctkJobScheduler::subscribeToJobEvents failed: invalid context or callback.");
+    return 0;
+  }
+
+  ctkJobSchedulerPrivate::JobEventsSubscription subscription;
+  subscription.Context = context;
+  subscription.Callback = callback;
+  subscription.EventTypes = eventTypes;
+  foreach (const QString& jobClass, jobClasses)
+  {
+    subscription.JobClasses.insert(jobClass);
+  }
+  foreach (const QString& jobUID, jobUIDs)
+  {
+    subscription.JobUIDs.insert(jobUID);
+  }
+
+  int subscriptionID = ++d->LastJobEventsSubscriptionID;
+  subscription.ContextConnection = QObject::connect(context, &QObject::destroyed, this, [this, subscriptionID](){
+    this->unsubscribeFromJobEvents(subscriptionID);
+  });
+  d->JobEventsSubscriptions.insert(subscriptionID, subscription);
+  return subscriptionID;
+}
+
+//----------------------------------------------------------------------------
+void ctkJobScheduler::unsubscribeFromJobEvents(int subscriptionID)
+{
+  Q_D(ctkJobScheduler);
+
+  QMap<int, ctkJobSchedulerPrivate::JobEventsSubscription>::iterator it =
+    d->JobEventsSubscriptions.find(subscriptionID);
+  if (it == d->JobEventsSubscriptions.end())
+  {
+    return;
+  }
+
+  QObject::disconnect(it->ContextConnection);
+  d->JobEventsSubscriptions.erase(it);
+}
+
+//----------------------------------------------------------------------------
+QList<QVariant> ctkJobScheduler::jobEventsDetails(const QList<ctkJobEventPointer>& jobEvents)
+{
+  QList<QVariant> details;
+  foreach (const ctkJobEventPointer& jobEvent, jobEvents)
+  {
+    if (jobEvent->Type == ctkJobEvent::Progress)
+    {
+      details.append(jobEvent->Detail);
+    }
+    else if (jobEvent->Job)
+    {
+      details.append(jobEvent->Job->toVariant());
+    }
+  }
+  return details;
+}
+
+//----------------------------------------------------------------------------
+void ctkJobScheduler::registerJobFactory(const QString& jobClassName, JobFactory jobFactory)
+{
+  Q_D(ctkJobScheduler);
+
+  // The QWriteLocker is enclosed within brackets to restrict its scope and
+  // prevent conflicts with other QWriteLockers within the scheduler's methods.
+  QWriteLocker locker(&d->QueueLock);
+  if (jobFactory)
+  {
+    d->JobFactories.insert(jobClassName, jobFactory);
+  }
+  else
+  {
+    d->JobFactories.remove(jobClassName);
+  }
+}
+
+//----------------------------------------------------------------------------
+bool ctkJobScheduler::setJournalFilePath(const QString& filePath)
+{
+  Q_D(ctkJobScheduler);
+
+  if (filePath.isEmpty())
+  {
+    d->Journal->close();
+    return true;
+  }
+
+  if (!d->Journal->open(filePath))
+  {
+    logger.error(QString("ctkJobScheduler::setJournalFilePath failed: cannot open %1").arg(filePath));
+    return false;
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+QString ctkJobScheduler::journalFilePath() const
+{
+  Q_D(const ctkJobScheduler);
+  return d->Journal->filePath();
+}
+
+//----------------------------------------------------------------------------
+int ctkJobScheduler::resumeJobsFromJournal()
+{
+  Q_D(ctkJobScheduler);
+
+  int numberOfResumedJobs = 0;
+  foreach (const ctkJobJournal::JobRecord& jobRecord, d->Journal->pendingJobs())
+  {
+    if (this->getJobSharedByUID(jobRecord.JobUID))
+    {
+      continue;
+    }
+
+    JobFactory jobFactory;
+    {
+      // The QReadLocker is enclosed within brackets to restrict its scope and
+      // prevent conflicts with other QReadLockers within the scheduler's methods.
+      QReadLocker locker(&d->QueueLock);
+      jobFactory = d->JobFactories.value(jobRecord.ClassName);
+    }
+    ctkAbstractJob* job = jobFactory ? jobFactory(jobRecord.Parameters) : nullptr;
+    if (!job)
+    {
+      logger.warn(QString("ctkJobScheduler: job %1 of type %2 cannot be resumed from the journal.")
+        .arg(jobRecord.JobUID)
+        .arg(jobRecord.ClassName));
+      d->Journal->removeJob(jobRecord.JobUID);
+      continue;
+    }
+
+    job->setJobUID(jobRecord.JobUID);
+    this->addJob(job);
+    numberOfResumedJobs++;
+  }
+  return numberOfResumedJobs;
+}
+
+//----------------------------------------------------------------------------
+QStringList ctkJobScheduler::suspendAllJobs()
+{
+  Q_D(ctkJobScheduler);
+
+  // The workers report the stop of their jobs later, through queued connections:
+  // the journal is reopened only once they have returned and their reports are processed.
+  QString journalFilePath = d->Journal->filePath();
+  d->Journal->close();
+  QStringList stoppedJobsUIDs = this->stopAllJobs(true);
+  this->waitForFinish(true);
+  this->waitForDone();
+  QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+  if (!journalFilePath.isEmpty() && !d->Journal->open(journalFilePath))
+  {
+    logger.error(QString("ctkJobScheduler::suspendAllJobs failed: cannot open %1").arg(journalFilePath));
+  }
+  return stoppedJobsUIDs;
+}
+
+//----------------------------------------------------------------------------
+ctkJobJournal* ctkJobScheduler::journal() const
+{
+  Q_D(const ctkJobScheduler);
+  return d->Journal.data();
+}
+
 //----------------------------------------------------------------------------
 void ctkJobScheduler::onJobStarted(ctkAbstractJob* job)
 {
@@ -813,7 +1593,8 @@ void ctkJobScheduler::onJobStarted(ctkAbstractJob* job)
 
   logger.debug(job->loggerReport(tr("started")));
 
-  d->BatchedJobsStarted.append(job->toVariant());
+  d->batchJobEvent(ctkJobEvent::Started, job);
+  d->Journal->setJobStatus(job->jobUID(), ctkAbstractJob::JobStatus::Running);
   if (!d->ThrottleTimer->isActive())
   {
     d->ThrottleTimer->start(d->ThrottleTimeInterval);
@@ -831,8 +1612,9 @@ void ctkJobScheduler::onJobUserStopped(ctkAbstractJob* job)
 
   logger.debug(job->loggerReport(tr("user stopped")));
 
-  QVariant data = job->toVariant();
+  d->batchJobEvent(ctkJobEvent::UserStopped, job);
   QString jobUID = job->jobUID();
+  d->Journal->setJobStatus(jobUID, ctkAbstractJob::JobStatus::UserStopped);
   this->deleteWorker(jobUID);
   if (job->destroyAfterUse())
   {
@@ -843,7 +1625,6 @@ void ctkJobScheduler::onJobUserStopped(ctkAbstractJob* job)
     this->resetJob(jobUID);
   }
 
-  d->BatchedJobsUserStopped.append(job->toVariant());
   if (!d->ThrottleTimer->isActive())
   {
     d->ThrottleTimer->start(d->ThrottleTimeInterval);
@@ -861,8 +1642,9 @@ void ctkJobScheduler::onJobFinished(ctkAbstractJob* job)
 
   logger.debug(job->loggerReport(tr("finished")));
 
-  QVariant data = job->toVariant();
+  d->batchJobEvent(ctkJobEvent::Finished, job);
   QString jobUID = job->jobUID();
+  d->Journal->setJobStatus(jobUID, ctkAbstractJob::JobStatus::Finished);
   this->deleteWorker(jobUID);
   if (job->destroyAfterUse())
   {
@@ -873,7 +1655,6 @@ void ctkJobScheduler::onJobFinished(ctkAbstractJob* job)
     this->resetJob(jobUID);
   }
 
-  d->BatchedJobsFinished.append(job->toVariant());
   if (!d->ThrottleTimer->isActive())
   {
     d->ThrottleTimer->start(d->ThrottleTimeInterval);
@@ -891,8 +1672,12 @@ void ctkJobScheduler::onJobAttemptFailed(ctkAbstractJob* job)
 
   logger.debug(job->loggerReport(tr("attempt failed")));
 
-  QVariant data = job->toVariant();
+  d->batchJobEvent(ctkJobEvent::AttemptFailed, job);
   QString jobUID = job->jobUID();
+  d->Journal->setJobStatus(jobUID, ctkAbstractJob::JobStatus::AttemptFailed);
+  // The retry is a new job, submitted (and journaled) by the worker before the attempt
+  // is reported failed: it replaces this job in the journal.
+  d->Journal->removeJob(jobUID);
   this->deleteWorker(jobUID);
   if (job->destroyAfterUse())
   {
@@ -903,7 +1688,6 @@ void ctkJobScheduler::onJobAttemptFailed(ctkAbstractJob* job)
     this->resetJob(jobUID);
   }
 
-  d->BatchedJobsAttemptFailed.append(job->toVariant());
   if (!d->ThrottleTimer->isActive())
   {
     d->ThrottleTimer->start(d->ThrottleTimeInterval);
@@ -921,8 +1705,9 @@ void ctkJobScheduler::onJobFailed(ctkAbstractJob* job)
 
   logger.debug(job->loggerReport(tr("failed")));
 
-  QVariant data = job->toVariant();
+  d->batchJobEvent(ctkJobEvent::Failed, job);
   QString jobUID = job->jobUID();
+  d->Journal->setJobStatus(jobUID, ctkAbstractJob::JobStatus::Failed);
   this->deleteWorker(jobUID);
   if (job->destroyAfterUse())
   {
@@ -933,7 +1718,6 @@ void ctkJobScheduler::onJobFailed(ctkAbstractJob* job)
     this->resetJob(jobUID);
   }
 
-  d->BatchedJobsFailed.append(job->toVariant());
   if (!d->ThrottleTimer->isActive())
   {
     d->ThrottleTimer->start(d->ThrottleTimeInterval);
@@ -945,7 +1729,16 @@ void ctkJobScheduler::onProgressJobDetail(QVariant data)
 {
   Q_D(ctkJobScheduler);
 
-  d->BatchedJobsProgress.append(data);
+  // The job may have been removed since the detail was emitted
+  QSharedPointer<ctkAbstractJob> job = this->getJobSharedByUID(d->progressJobUID(data));
+  if (job)
+  {
+    d->batchJobEvent(ctkJobEvent::Progress, job.data(), data);
+  }
+  else if (this->isSignalConnected(QMetaMethod::fromSignal(&ctkJobScheduler::progressJobDetail)))
+  {
+    d->BatchedJobsProgress.append(data);
+  }
   if (!d->ThrottleTimer->isActive())
   {
     d->ThrottleTimer->start(d->ThrottleTimeInterval);
@@ -957,6 +1750,9 @@ void ctkJobScheduler::emitThrottledSignals()
 {
   Q_D(ctkJobScheduler);
 
+  d->deliverJobEvents();
+  d->Journal->flush();
+
   int totalEmitted = 0;
   if (!d->BatchedJobsStarted.isEmpty() && totalEmitted < d->MaximumBatchedSignalsForTimeInterval)
   {
@@ -30,9 +30,13 @@
 #include <QVariant>
 class QThreadPool;
 
+// STD includes
+#include <functional>
+
 // CTK includes
+#include "ctkAbstractJob.h"
 #include "ctkCoreExport.h"
-class ctkAbstractJob;
+class ctkJobJournal;
 class ctkJobSchedulerPrivate;
 
 //------------------------------------------------------------------------------
@@ -68,6 +72,12 @@ public:
   Q_INVOKABLE void waitForFinish(bool waitForPersistentJobs = false,
                                  bool processEvents = false);
   Q_INVOKABLE void waitForDone(int msec = -1);
+  /// Wait until the jobs are completed (i.e. neither initialized, queued nor running)
+  /// or removed. It returns as soon as the last one is completed, or false if \a msec
+  /// elapses before (a negative value waits without limit).
+  /// A job that failed an attempt is completed: its retry is a new job.
+  Q_INVOKABLE bool waitForJobs(const QStringList& jobUIDs, int msec = -1,
+                               bool processEvents = false);
   Q_INVOKABLE QStringList stopAllJobs(bool stopPersistentJobs = false, bool removeJobs = true);
   Q_INVOKABLE void stopJobsByJobUIDs(const QStringList& jobUIDs, bool removeJobs = false);
   Q_INVOKABLE bool retryJob(const QString& jobUID);
@@ -83,6 +93,7 @@ public:
 
   ///@{
   /// Maximum number of concurrent QThreads spawned by the threadPool in the Job pool
+  /// (default lane). Subclasses may derive the size of their other lanes from it.
   /// default: 20
   int maximumThreadCount() const;
   void setMaximumThreadCount(const int& maximumThreadCount);
@@ -109,6 +120,78 @@ public:
   /// (not Python-wrappable).
   QSharedPointer<QThreadPool> threadPoolShared() const;
 
+  ///@{
+  /// Lanes: each lane runs the jobs of the job classes assigned to it in its own
+  /// thread pool, so that jobs bound by different resources (e.g. network bound
+  /// retrieves and CPU bound thumbnails) do not wait for the threads of each other.
+  /// The default lane ("") is threadPool(): it runs the jobs of the classes without lane.
+  /// setLane creates a lane, or changes its maximum number of threads.
+  /// Assigning a job class to a lane applies to the jobs that are not queued yet.
+  Q_INVOKABLE void setLane(const QString& lane, int maximumThreadCount);
+  Q_INVOKABLE QStringList lanes();
+  Q_INVOKABLE void setJobClassLane(const QString& jobClassName, const QString& lane);
+  Q_INVOKABLE QString jobClassLane(const QString& jobClassName);
+  Q_INVOKABLE QThreadPool* laneThreadPool(const QString& lane);
+  ///@}
+
+  ///@{
+  /// Lane metrics.
+  /// Queue depth: number of jobs of the lane waiting for a thread, in the scheduler or in
+  /// the thread pool of the lane.
+  /// Active thread count and utilization: number and fraction of the threads of the lane
+  /// running jobs.
+  Q_INVOKABLE int laneQueueDepth(const QString& lane);
+  Q_INVOKABLE int laneActiveThreadCount(const QString& lane);
+  Q_INVOKABLE double laneUtilization(const QString& lane);
+  ///@}
+
+  typedef std::function<void(const QList<ctkJobEventPointer>&)> JobEventsCallback;
+
+  ///@{
+  /// Job events subscriptions (not Python-wrappable).
+  /// The callback receives, in the thread of the scheduler and at the rate of the signals,
+  /// the batches of events of the types \a eventTypes, of the jobs of the classes \a jobClasses
+  /// and with the UIDs \a jobUIDs (empty lists do not filter).
+  /// Events are created only if a subscription accepts them, and the jobs are referenced by
+  /// the events instead of being converted to QVariant as for the signals.
+  /// The subscription ends with unsubscribeFromJobEvents or when \a context is destroyed.
+  /// subscribeToJobEvents returns the ID of the subscription, or 0 if it failed.
+  /// These methods must be called from the thread of the scheduler.
+  int subscribeToJobEvents(QObject* context, JobEventsCallback callback,
+                           ctkJobEvent::EventTypes eventTypes = ctkJobEvent::AllEvents,
+                           const QStringList& jobClasses = QStringList(),
+                           const QStringList& jobUIDs = QStringList());
+  void unsubscribeFromJobEvents(int subscriptionID);
+  /// Return the details of the events as emitted by the signals: the QVariant of the job,
+  /// or the detail of the progress for Progress events. Subscribers can use it to keep
+  /// handling the details, building them only for the events they subscribed to.
+  static QList<QVariant> jobEventsDetails(const QList<ctkJobEventPointer>& jobEvents);
+  ///@}
+
+  typedef std::function<ctkAbstractJob*(const QVariantMap&)> JobFactory;
+
+  ///@{
+  /// Job journal (optional, disabled by default).
+  /// When a journal file is set, the submissions and status changes of the jobs of the classes
+  /// with a job factory are appended to it (persistent jobs are not journaled).
+  /// resumeJobsFromJournal submits again the jobs that were pending when the journal was last
+  /// written, e.g. before a crash or the destruction of the scheduler, which does not journal
+  /// the stop of the jobs. It returns the number of resumed jobs.
+  /// A job factory creates a job from the parameters saved in the journal
+  /// (see ctkAbstractJob::parameters), or returns null if it cannot.
+  /// setJournalFilePath returns false if the file cannot be opened, an empty path disables the journal.
+  /// suspendAllJobs stops all the jobs (including the persistent ones) and waits for their workers,
+  /// without journaling their stop: they stay pending in the journal, to be resumed by
+  /// resumeJobsFromJournal (e.g. when the application is closed). It returns the stopped jobs.
+  /// \sa ctkJobJournal
+  void registerJobFactory(const QString& jobClassName, JobFactory jobFactory);
+  Q_INVOKABLE bool setJournalFilePath(const QString& filePath);
+  Q_INVOKABLE QString journalFilePath() const;
+  Q_INVOKABLE int resumeJobsFromJournal();
+  Q_INVOKABLE QStringList suspendAllJobs();
+  ctkJobJournal* journal() const;
+  ///@}
+
 Q_SIGNALS:
   void jobInitialized(QVariant);
   void jobQueued(QVariant);
@@ -22,15 +22,26 @@
 #define __ctkJobSchedulerPrivate_h
 
 // Qt includes
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QPointer>
 #include <QReadWriteLock>
+#include <QSet>
 #include <QSharedPointer>
+#include <QThread>
 #include <QTimer>
+#include <QWaitCondition>
 class QThreadPool;
 
+// STD includes
+#include <functional>
+
 // ctkCore includes
 #include "ctkCoreExport.h"
 class ctkAbstractJob;
 class ctkAbstractWorker;
+class ctkJobJournal;
 
 // ctkDICOMCore includes
 #include "ctkJobScheduler.h"
@@ -60,6 +71,65 @@ public:
   virtual QString generateUniqueJobUID();
   virtual void queueJobsInThreadPool();
   virtual void clearBactchedJobsLists();
+  /// Set the maximum number of threads of the default lane.
+  /// Subclasses can override it to size their lanes accordingly.
+  virtual void setMaximumThreadCount(int maximumThreadCount);
+  /// Return the UID of the job of a progress detail emitted by a job (empty if unknown).
+  /// Subclasses handling other detail types than ctkJobDetail should override it.
+  virtual QString progressJobUID(const QVariant& data) const;
+
+  ///@{
+  /// Run-queue of the jobs waiting for a worker (status Initialized), indexed by
+  /// priority and job class, and counters of the jobs with a worker (status Queued
+  /// or Running) by job class. They are used by queueJobsInThreadPool instead of
+  /// scanning the whole JobsQueue.
+  /// These methods must be called with the QueueLock locked for writing.
+  virtual void insertReadyJob(QSharedPointer<ctkAbstractJob> job);
+  virtual bool takeReadyJob(const QString& jobUID);
+  virtual void setJobPriority(QSharedPointer<ctkAbstractJob> job, QThread::Priority priority);
+  virtual void dispatchJob(QSharedPointer<ctkAbstractJob> job);
+  virtual void releaseDispatchedJob(const QString& jobUID);
+  ///@}
+
+  ///@{
+  /// Lanes: thread pools running the jobs of the job classes assigned to them.
+  /// The default lane ("") is ThreadPool.
+  /// These methods must be called with the QueueLock locked.
+  QString laneForJobClass(const QString& className) const;
+  QSharedPointer<QThreadPool> laneThreadPool(const QString& lane) const;
+  ///@}
+
+  ///@{
+  /// Pending jobs are the jobs neither completed nor removed (status Initialized,
+  /// Queued or Running). notifyJobsCompletion wakes up the threads waiting for jobs,
+  /// it is called when jobs are completed or removed.
+  /// These methods are thread safe.
+  void addPendingJob(QSharedPointer<ctkAbstractJob> job);
+  void notifyJobsCompletion(const QStringList& jobUIDs);
+  bool isJobPending(const QString& jobUID);
+  int numberOfPendingJobs(bool includePersistentJobs);
+  ///@}
+
+  ///@{
+  /// Job events. batchJobEvent batches the event for the subscriptions accepting it and,
+  /// only if the corresponding signal is connected, the detail of the job for the signal.
+  /// It must be called from the thread of the scheduler, with the QueueLock unlocked.
+  /// deliverJobEvents calls the callbacks of the subscriptions with their batched events.
+  virtual void batchJobEvent(ctkJobEvent::EventType type, ctkAbstractJob* job,
+                             const QVariant& detail = QVariant());
+  bool isJobEventSubscribed(ctkJobEvent::EventType type, const QString& jobClass,
+                            const QString& jobUID) const;
+  void deliverJobEvents();
+  ///@}
+
+  /// Append the submission of the job to the journal, if its class has a job factory.
+  /// It must be called with the QueueLock locked.
+  void journalJobSubmission(QSharedPointer<ctkAbstractJob> job);
+
+  /// Wait until \a isCompleted returns true, checking it each time jobs are completed
+  /// or removed. Return false if \a msec elapses before (a negative value waits without limit).
+  /// \a isCompleted is called without locking the QueueLock.
+  bool waitForCompletion(std::function<bool()> isCompleted, int msec, bool processEvents);
 
   QReadWriteLock QueueLock;
 
@@ -72,6 +142,63 @@ public:
   QMap<QString, QMap<QString, QMetaObject::Connection>> JobsConnections;
   QMap<QString, QSharedPointer<ctkAbstractWorker>> Workers;
   QMap<QString, int> RunningJobsByJobClass;
+
+  /// Thread pools of the lanes other than the default one, and lanes of the job classes
+  QMap<QString, QSharedPointer<QThreadPool>> LanesThreadPools;
+  QMap<QString, QString> JobClassesLanes;
+
+  struct ReadyJobEntry
+  {
+    int Priority;
+    QString ClassName;
+    QString Lane;
+    quint64 Sequence;
+  };
+  /// UIDs of the ready jobs by priority, job class and insertion order
+  QMap<int, QMap<QString, QMap<quint64, QString>>> ReadyJobs;
+  QHash<QString, ReadyJobEntry> ReadyJobsEntries;
+  quint64 ReadyJobsSequence{0};
+  struct DispatchedJobEntry
+  {
+    QString ClassName;
+    QString Lane;
+  };
+  /// Jobs with a worker, by job UID
+  QHash<QString, DispatchedJobEntry> DispatchedJobs;
+  /// Numbers of ready and dispatched jobs by lane
+  QHash<QString, int> ReadyJobsByLane;
+  QHash<QString, int> DispatchedJobsByLane;
+
+  /// Pending jobs, with their persistent flag, guarded by the CompletionMutex
+  QHash<QString, bool> PendingJobs;
+  int NumberOfPendingPersistentJobs{0};
+  QMutex CompletionMutex;
+  QWaitCondition CompletionCondition;
+  quint64 CompletionCount{0};
+
+  QSharedPointer<ctkJobJournal> Journal;
+  QMap<QString, ctkJobScheduler::JobFactory> JobFactories;
+
+  struct JobEventsSubscription
+  {
+    bool accepts(ctkJobEvent::EventType type, const QString& jobClass, const QString& jobUID) const
+    {
+      return this->EventTypes.testFlag(type) &&
+        (this->JobClasses.isEmpty() || this->JobClasses.contains(jobClass)) &&
+        (this->JobUIDs.isEmpty() || this->JobUIDs.contains(jobUID));
+    }
+
+    QPointer<QObject> Context;
+    QMetaObject::Connection ContextConnection;
+    ctkJobScheduler::JobEventsCallback Callback;
+    ctkJobEvent::EventTypes EventTypes;
+    QSet<QString> JobClasses;
+    QSet<QString> JobUIDs;
+  };
+  QMap<int, JobEventsSubscription> JobEventsSubscriptions;
+  int LastJobEventsSubscriptionID{0};
+  QList<ctkJobEventPointer> BatchedJobEvents;
+
   QList<QVariant> BatchedJobsStarted;
   QList<QVariant> BatchedJobsUserStopped;
   QList<QVariant> BatchedJobsFinished;
@@ -0,0 +1,171 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QScopedPointer>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QTemporaryDir>
+
+// ctkCore includes
+#include <ctkCoreTestingMacros.h>
+
+// ctkDICOMCore includes
+#include "ctkDICOMAssociationPool.h"
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMQuery.h"
+#include "ctkDICOMRetrieve.h"
+#include "ctkDICOMServer.h"
+#include "ctkDICOMTester.h"
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+namespace
+{
+
+const int NumberOfQueries = 20;
+
+//------------------------------------------------------------------------------
+void setupQuery(ctkDICOMQuery& query, int port)
+{
+  query.setCallingAETitle("CTK_AE");
+  query.setCalledAETitle("CTK_AE");
+  query.setHost("localhost");
+  query.setPort(port);
+}
+
+//------------------------------------------------------------------------------
+// Send patient C-FINDs, each from a new query object (same as the query jobs).
+// Returns the elapsed time in milliseconds, -1 if a query failed.
+qint64 runQueries(int port, QSharedPointer<ctkDICOMAssociationPool> associationPool)
+{
+  QElapsedTimer timer;
+  timer.start();
+  for (int index = 0; index < NumberOfQueries; ++index)
+  {
+    ctkDICOMQuery query;
+    setupQuery(query, port);
+    query.setAssociationPool(associationPool);
+    if (!query.queryPatients() || query.jobResponseSets().isEmpty())
+    {
+      return -1;
+    }
+  }
+  return timer.elapsed();
+}
+
+} // end of anonymous namespace
+
+// Reuse of associations between queries and retrieves sent to a local dcmqrscp
+int ctkDICOMAssociationPoolTest1( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  QStringList arguments = app.arguments();
+  QString testName = arguments.takeFirst();
+
+  if (!arguments.count())
+  {
+    std::cerr << "Usage: " << qPrintable(testName)
+              << " <path-to-image> [...]" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Server clones share the pool
+  ctkDICOMServer server;
+  QScopedPointer<ctkDICOMServer> clonedServer(server.clone());
+  CHECK_POINTER(clonedServer->associationPool(), server.associationPool());
+  CHECK_INT(server.associationPool()->maximumAssociations(), 8);
+
+  // Concurrency bound
+  ctkDICOMAssociationPool boundedPool;
+  boundedPool.setMaximumAssociations(1);
+  CHECK_BOOL(boundedPool.acquire(0), true);
+  CHECK_BOOL(boundedPool.acquire(50), false);
+  CHECK_INT(boundedPool.activeAssociationCount(), 1);
+  boundedPool.release();
+  CHECK_INT(boundedPool.activeAssociationCount(), 0);
+  CHECK_BOOL(boundedPool.acquire(0), true);
+  boundedPool.release();
+
+  ctkDICOMTester tester;
+  tester.startDCMQRSCP();
+  tester.storeData(arguments);
+  int port = tester.dcmqrscpPort();
+
+  // Benchmark: one association per query vs. pooled associations
+  qint64 unpooledTime = runQueries(port, QSharedPointer<ctkDICOMAssociationPool>());
+  CHECK_BOOL(unpooledTime >= 0, true);
+
+  QSharedPointer<ctkDICOMAssociationPool> pool(new ctkDICOMAssociationPool);
+  qint64 pooledTime = runQueries(port, pool);
+  CHECK_BOOL(pooledTime >= 0, true);
+  std::cout << NumberOfQueries << " queries without pool: " << unpooledTime << "ms,"
+            << " with pool: " << pooledTime << "ms" << std::endl;
+  CHECK_INT(pool->reusedAssociationCount(), NumberOfQueries - 1);
+  CHECK_INT(pool->idleAssociationCount(), 1);
+  CHECK_INT(pool->activeAssociationCount(), 0);
+
+  // Idle associations are checked with a C-ECHO before being reused
+  pool->setHealthCheckInterval(0);
+  CHECK_BOOL(runQueries(port, pool) >= 0, true);
+  CHECK_INT(pool->reusedAssociationCount(), 2 * NumberOfQueries - 1);
+
+  // Retrieve associations are not exchanged with query associations
+  QTemporaryDir tempDirectory;
+  CHECK_BOOL(tempDirectory.isValid(), true);
+  ctkDICOMDatabase database;
+  CHECK_BOOL(database.openDatabase(tempDirectory.path() + "/ctkDICOM.sql"), true);
+
+  ctkDICOMQuery query;
+  setupQuery(query, port);
+  CHECK_BOOL(query.query(database), true);
+  CHECK_BOOL(query.studyAndSeriesInstanceUIDQueried().isEmpty(), false);
+  QString studyInstanceUID = query.studyAndSeriesInstanceUIDQueried()[0].first;
+
+  int reusedAssociationCount = pool->reusedAssociationCount();
+  for (int index = 0; index < 2; ++index)
+  {
+    ctkDICOMRetrieve retrieve;
+    retrieve.setCallingAETitle("CTK_AE");
+    retrieve.setCalledAETitle("CTK_AE");
+    retrieve.setHost("localhost");
+    retrieve.setPort(port);
+    retrieve.setDatabase(database);
+    retrieve.setAssociationPool(pool);
+    CHECK_BOOL(retrieve.getStudy(studyInstanceUID), true);
+  }
+  CHECK_INT(pool->reusedAssociationCount(), reusedAssociationCount + 1);
+  CHECK_INT(pool->idleAssociationCount(), 2);
+
+  // Idle timeout
+  pool->setIdleTimeout(0);
+  CHECK_INT(pool->idleAssociationCount(), 0);
+  pool->setIdleTimeout(30000);
+
+  pool->clear();
+  CHECK_INT(pool->idleAssociationCount(), 0);
+
+  return EXIT_SUCCESS;
+}
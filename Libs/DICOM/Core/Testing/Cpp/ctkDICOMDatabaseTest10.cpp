@@ -0,0 +1,167 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDate>
+
+// ctkCore includes
+#include <ctkCoreTestingMacros.h>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMDatabaseTestHelper.h"
+#include "ctkDICOMItem.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdeftag.h>
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+namespace
+{
+
+const int NumberOfPatients = 3;
+const int NumberOfSeriesPerStudy = 2;
+
+//------------------------------------------------------------------------------
+QString studyUID(int patientIndex)
+{
+  return QString("1.2.826.0.1.3680043.2.1125.10.%1").arg(patientIndex);
+}
+
+//------------------------------------------------------------------------------
+QString seriesUID(int patientIndex, int seriesIndex)
+{
+  return QString("%1.%2").arg(studyUID(patientIndex)).arg(seriesIndex);
+}
+
+//------------------------------------------------------------------------------
+// One study per patient, with an MR and a CT series
+QList<ctkDICOMDatabase::IndexingResult> createIndexingResults(ctkDICOMItem& templateDataset)
+{
+  const char* patientsNames[NumberOfPatients] = { "DOE^JOHN", "Doe^Jane", "SMITH^ANN" };
+  QDate today = QDate::currentDate();
+  QString studyDates[NumberOfPatients] = {
+    today.toString("yyyyMMdd"), today.addDays(-10).toString("yyyyMMdd"), "20000101" };
+  const char* modalities[NumberOfSeriesPerStudy] = { "MR", "CT" };
+
+  QList<ctkDICOMDatabase::IndexingResult> indexingResults;
+  for (int patientIndex = 0; patientIndex < NumberOfPatients; ++patientIndex)
+  {
+    for (int seriesIndex = 0; seriesIndex < NumberOfSeriesPerStudy; ++seriesIndex)
+    {
+      QMap<DcmTagKey, QString> attributes;
+      attributes[DCM_PatientName] = patientsNames[patientIndex];
+      attributes[DCM_PatientID] = QString("P%1").arg(patientIndex);
+      attributes[DCM_StudyDate] = studyDates[patientIndex];
+      attributes[DCM_Modality] = modalities[seriesIndex];
+      // Only the first CT series description contains "50%"
+      attributes[DCM_SeriesDescription] = seriesIndex == 0 ? QString("Axial T1") :
+        (patientIndex == 0 ? QString("Scout 50%") : QString("Scout 500"));
+      indexingResults << ctkDICOMDatabaseTestHelper::createIndexingResult(templateDataset,
+        studyUID(patientIndex), seriesUID(patientIndex, seriesIndex),
+        QString("%1.1").arg(seriesUID(patientIndex, seriesIndex)), attributes);
+    }
+  }
+  return indexingResults;
+}
+
+} // end of anonymous namespace
+
+// Checks the filtered patient/study/series accessors used by the visual browser.
+int ctkDICOMDatabaseTest10( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc < 2)
+  {
+    std::cerr << "ctkDICOMDatabaseTest10: missing dicom filePath argument";
+    std::cerr << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ctkDICOMItem templateDataset;
+  CHECK_BOOL(ctkDICOMDatabaseTestHelper::loadTemplateDataset(argv[1], templateDataset), true);
+
+  ctkDICOMDatabase database;
+  database.openDatabase(":memory:");
+  database.insert(createIndexingResults(templateDataset));
+  CHECK_INT(database.patients().count(), NumberOfPatients);
+
+  // No filter
+  QMap<QString, QVariant> filters;
+  CHECK_INT(database.filteredPatients(filters).count(), NumberOfPatients);
+  CHECK_INT(database.filteredStudies(filters).count(), NumberOfPatients);
+  CHECK_INT(database.filteredSeries(filters).count(), NumberOfPatients * NumberOfSeriesPerStudy);
+
+  // Empty strings and negative day windows do not filter
+  filters.insert("PatientsName", QString());
+  filters.insert("StudyDate", -1);
+  CHECK_INT(database.filteredSeries(filters).count(), NumberOfPatients * NumberOfSeriesPerStudy);
+
+  // Case insensitive substring, applied to the children
+  filters.insert("PatientsName", QString("doe"));
+  QStringList patients = database.filteredPatients(filters);
+  CHECK_INT(patients.count(), 2);
+  CHECK_BOOL(patients.contains(database.patientForStudy(studyUID(0))), true);
+  CHECK_BOOL(patients.contains(database.patientForStudy(studyUID(1))), true);
+  CHECK_INT(database.filteredStudies(filters).count(), 2);
+  CHECK_INT(database.filteredSeries(filters).count(), 2 * NumberOfSeriesPerStudy);
+
+  // Day window
+  filters.insert("StudyDate", 30);
+  CHECK_INT(database.filteredStudies(filters).count(), 2);
+  filters.insert("StudyDate", 5);
+  QStringList studies = database.filteredStudies(filters);
+  CHECK_INT(studies.count(), 1);
+  CHECK_QSTRING(studies[0], studyUID(0));
+  // Filters of the children do not restrict the parents
+  CHECK_INT(database.filteredPatients(filters).count(), 2);
+
+  // Modality list
+  filters.insert("Modality", QStringList() << "CT");
+  QStringList series = database.filteredSeries(filters);
+  CHECK_INT(series.count(), 1);
+  CHECK_QSTRING(series[0], seriesUID(0, 1));
+  CHECK_INT(database.filteredStudies(filters).count(), 1);
+  filters.insert("Modality", QStringList() << "CT" << "MR");
+  CHECK_INT(database.filteredSeries(filters).count(), 2);
+  filters.insert("Modality", QStringList());
+  CHECK_INT(database.filteredSeries(filters).count(), 0);
+
+  // LIKE wildcards in the value are matched literally
+  filters.clear();
+  filters.insert("SeriesDescription", QString("50%"));
+  series = database.filteredSeries(filters);
+  CHECK_INT(series.count(), 1);
+  CHECK_QSTRING(series[0], seriesUID(0, 1));
+  filters.insert("SeriesDescription", QString("SCOUT"));
+  CHECK_INT(database.filteredSeries(filters).count(), NumberOfPatients);
+
+  // Unknown fields
+  filters.insert("NoSuchField", QString("value"));
+  CHECK_INT(database.filteredSeries(filters).count(), 0);
+
+  database.closeDatabase();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,190 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+
+// ctkCore includes
+#include <ctkCoreTestingMacros.h>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMDatabaseTestHelper.h"
+#include "ctkDICOMItem.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdeftag.h>
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+namespace
+{
+
+const int NumberOfPatients = 1000;
+
+//------------------------------------------------------------------------------
+QString studyUID(int patientIndex)
+{
+  return QString("1.2.826.0.1.3680043.2.1125.11.%1").arg(patientIndex);
+}
+
+//------------------------------------------------------------------------------
+QString seriesUID(int patientIndex, int seriesIndex)
+{
+  return QString("%1.%2").arg(studyUID(patientIndex)).arg(seriesIndex);
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMDatabase::IndexingResult createIndexingResult(ctkDICOMItem& templateDataset,
+  int patientIndex, int seriesIndex, const QString& patientsName, const QString& seriesDescription)
+{
+  QMap<DcmTagKey, QString> attributes;
+  attributes[DCM_PatientName] = patientsName;
+  attributes[DCM_PatientID] = QString("ID%1").arg(patientIndex);
+  attributes[DCM_StudyDescription] = QString("Brain study %1").arg(patientIndex);
+  attributes[DCM_SeriesDescription] = seriesDescription;
+  return ctkDICOMDatabaseTestHelper::createIndexingResult(templateDataset,
+    studyUID(patientIndex), seriesUID(patientIndex, seriesIndex),
+    QString("%1.1").arg(seriesUID(patientIndex, seriesIndex)), attributes);
+}
+
+//------------------------------------------------------------------------------
+// Patients "PATIENT^00000" to "PATIENT^00999", each with an axial and a sagittal series.
+// The name of the first patient contains a quote.
+QList<ctkDICOMDatabase::IndexingResult> createIndexingResults(ctkDICOMItem& templateDataset)
+{
+  QList<ctkDICOMDatabase::IndexingResult> indexingResults;
+  for (int patientIndex = 0; patientIndex < NumberOfPatients; ++patientIndex)
+  {
+    QString patientsName = patientIndex == 0 ? QString("O\"BRIEN^ANNA") :
+      QString("PATIENT^%1").arg(patientIndex, 5, 10, QChar('0'));
+    indexingResults << createIndexingResult(templateDataset, patientIndex, 0, patientsName,
+      QString("Axial %1").arg(patientIndex));
+    indexingResults << createIndexingResult(templateDataset, patientIndex, 1, patientsName,
+      QString("Sagittal 50%"));
+  }
+  return indexingResults;
+}
+
+} // end of anonymous namespace
+
+// Checks the full-text search of patients, studies and series and measures its latency.
+int ctkDICOMDatabaseTest11( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc < 2)
+  {
+    std::cerr << "ctkDICOMDatabaseTest11: missing dicom filePath argument";
+    std::cerr << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ctkDICOMItem templateDataset;
+  CHECK_BOOL(ctkDICOMDatabaseTestHelper::loadTemplateDataset(argv[1], templateDataset), true);
+
+  CHECK_QSTRING(ctkDICOMDatabase::fullTextSearchExpression("ab"), QString());
+  CHECK_QSTRING(ctkDICOMDatabase::fullTextSearchExpression("a\"b"), QString("\"a\"\"b\""));
+
+  QTemporaryDir temporaryDirectory;
+  CHECK_BOOL(temporaryDirectory.isValid(), true);
+  QString databaseFile = temporaryDirectory.path() + "/ctkDICOM.sql";
+
+  ctkDICOMDatabase database;
+  CHECK_BOOL(database.openDatabase(databaseFile), true);
+  std::cout << "Full-text search index available: " << database.isFullTextSearchAvailable() << std::endl;
+  database.insert(createIndexingResults(templateDataset));
+
+  // Search of each level, with the index (at least 3 characters) or scanning the table
+  CHECK_INT(database.searchPatients("patient^00042").count(), 1);
+  CHECK_QSTRING(database.searchPatients("patient^00042")[0], database.patientForStudy(studyUID(42)));
+  CHECK_INT(database.searchPatients("PATIENT^").count(), NumberOfPatients - 1);
+  CHECK_INT(database.searchPatients("PATIENT^", 10).count(), 10);
+  CHECK_INT(database.searchPatients("o\"b").count(), 1);
+  CHECK_INT(database.searchPatients("ID1").count(), 111);
+  CHECK_INT(database.searchPatients("").count(), NumberOfPatients);
+  CHECK_INT(database.searchPatients("no such patient").count(), 0);
+  CHECK_INT(database.searchStudies("study 999").count(), 1);
+  CHECK_INT(database.searchStudies("BRAIN").count(), NumberOfPatients);
+  CHECK_INT(database.searchSeries("Ax").count(), NumberOfPatients);
+  CHECK_INT(database.searchSeries("50%").count(), NumberOfPatients);
+  CHECK_INT(database.searchSeries("l 5").count(), 111 + NumberOfPatients);
+
+  // The visual browser filters give the same results
+  QMap<QString, QVariant> filters;
+  filters.insert("PatientsName", QString("patient^0004"));
+  CHECK_INT(database.filteredPatients(filters).count(), 10);
+  filters.insert("SeriesDescription", QString("sagittal"));
+  CHECK_INT(database.filteredSeries(filters).count(), 10);
+
+  // Type-ahead latency
+  QString typedText = "patient^00123";
+  qint64 maximumLatency = 0;
+  for (int length = 1; length <= typedText.length(); ++length)
+  {
+    QElapsedTimer timer;
+    timer.start();
+    QStringList patients = database.searchPatients(typedText.left(length), 50);
+    maximumLatency = qMax(maximumLatency, timer.nsecsElapsed());
+    CHECK_BOOL(patients.isEmpty(), false);
+  }
+  std::cout << "Type-ahead search of " << NumberOfPatients << " patients: max="
+            << maximumLatency / 1000 << "us" << std::endl;
+
+  // New and removed items
+  QList<ctkDICOMDatabase::IndexingResult> newIndexingResults;
+  newIndexingResults << createIndexingResult(templateDataset, NumberOfPatients, 0, "NEWCOMER^JOE", "Coronal");
+  database.insert(newIndexingResults);
+  CHECK_INT(database.searchPatients("newcomer").count(), 1);
+  CHECK_INT(database.searchSeries("coronal").count(), 1);
+  CHECK_BOOL(database.removeSeries(seriesUID(7, 0)), true);
+  CHECK_INT(database.searchSeries("Axial 7").count(), 110);
+  if (database.isFullTextSearchAvailable())
+  {
+    // Entries of the removed rows are removed from the index
+    QSqlQuery indexEntriesQuery(database.database());
+    CHECK_BOOL(indexEntriesQuery.exec("SELECT COUNT(*) FROM SeriesSearchIndex"), true);
+    CHECK_BOOL(indexEntriesQuery.next(), true);
+    CHECK_INT(indexEntriesQuery.value(0).toInt(), 2 * NumberOfPatients);
+  }
+  CHECK_BOOL(database.cleanup(true), true);
+  CHECK_INT(database.searchSeries("Axial 7").count(), 110);
+  CHECK_INT(database.searchSeries("coronal").count(), 1);
+  CHECK_INT(database.searchPatients("newcomer").count(), 1);
+
+  // The index is created for existing databases
+  if (database.isFullTextSearchAvailable())
+  {
+    QSqlQuery dropIndexQuery(database.database());
+    CHECK_BOOL(dropIndexQuery.exec("DROP TABLE PatientsSearchIndex"), true);
+  }
+  database.closeDatabase();
+  CHECK_BOOL(database.openDatabase(databaseFile), true);
+  CHECK_INT(database.searchPatients("newcomer").count(), 1);
+  CHECK_INT(database.searchPatients("PATIENT^").count(), NumberOfPatients - 1);
+
+  database.closeDatabase();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,172 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QTemporaryDir>
+
+// ctkCore includes
+#include <ctkCoreTestingMacros.h>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMDatabaseTestHelper.h"
+#include "ctkDICOMItem.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdeftag.h>
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+namespace
+{
+
+// More series and instances than the number of UIDs bound to a single query
+const int NumberOfPatients = 300;
+const int NumberOfSeriesPerStudy = 2;
+const int NumberOfInstancesPerSeries = 2;
+
+//------------------------------------------------------------------------------
+QString studyUID(int patientIndex)
+{
+  return QString("1.2.826.0.1.3680043.2.1125.19.%1").arg(patientIndex);
+}
+
+//------------------------------------------------------------------------------
+QString seriesUID(int patientIndex, int seriesIndex)
+{
+  return QString("%1.%2").arg(studyUID(patientIndex)).arg(seriesIndex);
+}
+
+//------------------------------------------------------------------------------
+QList<ctkDICOMDatabase::IndexingResult> createIndexingResults(ctkDICOMItem& templateDataset)
+{
+  QList<ctkDICOMDatabase::IndexingResult> indexingResults;
+  for (int patientIndex = 0; patientIndex < NumberOfPatients; ++patientIndex)
+  {
+    for (int seriesIndex = 0; seriesIndex < NumberOfSeriesPerStudy; ++seriesIndex)
+    {
+      for (int instanceIndex = 0; instanceIndex < NumberOfInstancesPerSeries; ++instanceIndex)
+      {
+        QMap<DcmTagKey, QString> attributes;
+        attributes[DCM_PatientName] = QString("PATIENT^%1").arg(patientIndex);
+        attributes[DCM_PatientID] = QString("ID%1").arg(patientIndex);
+        indexingResults << ctkDICOMDatabaseTestHelper::createIndexingResult(templateDataset,
+          studyUID(patientIndex), seriesUID(patientIndex, seriesIndex),
+          QString("%1.%2").arg(seriesUID(patientIndex, seriesIndex)).arg(instanceIndex), attributes);
+      }
+    }
+  }
+  return indexingResults;
+}
+
+//------------------------------------------------------------------------------
+// Compare the bulk lookups with the lookups of each UID
+int checkBulkLookups(ctkDICOMDatabase& database)
+{
+  QStringList patientUIDs = database.patients();
+  CHECK_INT(patientUIDs.count(), NumberOfPatients);
+  QMap<QString, QStringList> studiesForPatients =
+    database.studiesForPatients(QStringList(patientUIDs) << patientUIDs.first() << "no such patient");
+  CHECK_INT(studiesForPatients.count(), NumberOfPatients);
+  CHECK_BOOL(studiesForPatients.contains("no such patient"), false);
+
+  QStringList studyUIDs;
+  foreach (const QString& patientUID, patientUIDs)
+  {
+    CHECK_QSTRINGLIST(studiesForPatients.value(patientUID), database.studiesForPatient(patientUID));
+    studyUIDs << studiesForPatients.value(patientUID);
+  }
+  CHECK_INT(studyUIDs.count(), NumberOfPatients);
+
+  QMap<QString, QStringList> seriesForStudies = database.seriesForStudies(studyUIDs);
+  CHECK_INT(seriesForStudies.count(), NumberOfPatients);
+  QStringList seriesUIDs;
+  foreach (const QString& studyUID, studyUIDs)
+  {
+    CHECK_QSTRINGLIST(seriesForStudies.value(studyUID), database.seriesForStudy(studyUID));
+    seriesUIDs << seriesForStudies.value(studyUID);
+  }
+  CHECK_INT(seriesUIDs.count(), NumberOfPatients * NumberOfSeriesPerStudy);
+
+  QMap<QString, QStringList> instancesForSeries = database.instancesForMultipleSeries(seriesUIDs);
+  QMap<QString, QStringList> filesForSeries = database.filesForMultipleSeries(seriesUIDs);
+  CHECK_INT(instancesForSeries.count(), seriesUIDs.count());
+  CHECK_INT(filesForSeries.count(), seriesUIDs.count());
+  QStringList sopInstanceUIDs;
+  foreach (const QString& seriesUID, seriesUIDs)
+  {
+    CHECK_QSTRINGLIST(instancesForSeries.value(seriesUID), database.instancesForSeries(seriesUID));
+    CHECK_QSTRINGLIST(filesForSeries.value(seriesUID), database.filesForSeries(seriesUID));
+    sopInstanceUIDs << instancesForSeries.value(seriesUID);
+  }
+  CHECK_INT(sopInstanceUIDs.count(), NumberOfPatients * NumberOfSeriesPerStudy * NumberOfInstancesPerSeries);
+
+  QMap<QString, QString> filesForInstances = database.filesForInstances(sopInstanceUIDs);
+  CHECK_INT(filesForInstances.count(), sopInstanceUIDs.count());
+  foreach (const QString& sopInstanceUID, sopInstanceUIDs)
+  {
+    CHECK_QSTRING(filesForInstances.value(sopInstanceUID), database.fileForInstance(sopInstanceUID));
+  }
+
+  // Empty lookups
+  CHECK_INT(database.seriesForStudies(QStringList()).count(), 0);
+  CHECK_INT(database.filesForMultipleSeries(QStringList() << "no such series").count(), 0);
+  CHECK_INT(database.filesForInstances(QStringList() << QString()).count(), 0);
+  return EXIT_SUCCESS;
+}
+
+} // end of anonymous namespace
+
+// Checks that the bulk lookups of the hierarchy return the same results as the lookups of each UID.
+int ctkDICOMDatabaseTest12( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc < 2)
+  {
+    std::cerr << "ctkDICOMDatabaseTest12: missing dicom filePath argument";
+    std::cerr << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ctkDICOMItem templateDataset;
+  CHECK_BOOL(ctkDICOMDatabaseTestHelper::loadTemplateDataset(argv[1], templateDataset), true);
+
+  QTemporaryDir temporaryDirectory;
+  CHECK_BOOL(temporaryDirectory.isValid(), true);
+
+  ctkDICOMDatabase database;
+  CHECK_BOOL(database.openDatabase(temporaryDirectory.path() + "/ctkDICOM.sql"), true);
+  database.insert(createIndexingResults(templateDataset));
+
+  // Lookups in the tables
+  CHECK_INT(checkBulkLookups(database), EXIT_SUCCESS);
+
+  // Studies and series lookups in the hierarchy snapshot
+  database.setHierarchySnapshotEnabled(true);
+  CHECK_NOT_NULL(database.hierarchySnapshot());
+  CHECK_INT(checkBulkLookups(database), EXIT_SUCCESS);
+
+  database.closeDatabase();
+  return EXIT_SUCCESS;
+}
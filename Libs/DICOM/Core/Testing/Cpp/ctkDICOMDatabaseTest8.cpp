@@ -0,0 +1,214 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+
+// ctkCore includes
+#include <ctkCoreTestingMacros.h>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMDatabaseTestHelper.h"
+#include "ctkDICOMItem.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdeftag.h>
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+namespace
+{
+
+const int NumberOfStudies = 4;
+const int NumberOfSeriesPerStudy = 5;
+const int NumberOfImagesPerSeries = 100;
+
+//------------------------------------------------------------------------------
+QString studyUID(int studyIndex)
+{
+  return QString("1.2.826.0.1.3680043.2.1125.8.%1").arg(studyIndex);
+}
+
+//------------------------------------------------------------------------------
+QString seriesUID(int studyIndex, int seriesIndex)
+{
+  return QString("%1.%2").arg(studyUID(studyIndex)).arg(seriesIndex);
+}
+
+//------------------------------------------------------------------------------
+// Create indexing results for synthetic images of a study (all studies belong to the same patient)
+QList<ctkDICOMDatabase::IndexingResult> createIndexingResults(ctkDICOMItem& templateDataset,
+  int studyIndex, int seriesIndexFilter = -1, int firstImageIndex = 0, int imageCount = NumberOfImagesPerSeries)
+{
+  QList<ctkDICOMDatabase::IndexingResult> indexingResults;
+  for (int seriesIndex = 0; seriesIndex < NumberOfSeriesPerStudy; ++seriesIndex)
+  {
+    if (seriesIndexFilter >= 0 && seriesIndex != seriesIndexFilter)
+    {
+      continue;
+    }
+    for (int imageIndex = firstImageIndex; imageIndex < firstImageIndex + imageCount; ++imageIndex)
+    {
+      QString sopInstanceUID = QString("%1.%2").arg(seriesUID(studyIndex, seriesIndex)).arg(imageIndex);
+      indexingResults << ctkDICOMDatabaseTestHelper::createIndexingResult(templateDataset,
+        studyUID(studyIndex), seriesUID(studyIndex, seriesIndex), sopInstanceUID);
+    }
+  }
+  return indexingResults;
+}
+
+} // end of anonymous namespace
+
+// Compares the insertion throughput of the database (including tag precaching) when
+// images are inserted one by one and in a single batch, and checks that
+// patient/study/series records are re-created after they are removed.
+int ctkDICOMDatabaseTest8( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc < 2)
+  {
+    std::cerr << "ctkDICOMDatabaseTest8: missing dicom filePath argument";
+    std::cerr << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ctkDICOMItem templateDataset;
+  CHECK_BOOL(ctkDICOMDatabaseTestHelper::loadTemplateDataset(argv[1], templateDataset), true);
+
+  QList<ctkDICOMDatabase::IndexingResult> indexingResults;
+  for (int studyIndex = 0; studyIndex < NumberOfStudies; ++studyIndex)
+  {
+    indexingResults << createIndexingResults(templateDataset, studyIndex);
+  }
+
+  QTemporaryDir temporaryDirectory;
+  CHECK_BOOL(temporaryDirectory.isValid(), true);
+
+  ctkDICOMDatabase database;
+  CHECK_BOOL(database.openDatabase(temporaryDirectory.path() + "/ctkDICOMDatabaseTest8.sql"), true);
+  QStringList tagsToPrecache = database.tagsToPrecache();
+  tagsToPrecache << "0008,0060" // Modality
+    << "0008,103E" // SeriesDescription
+    << "0018,0050" // SliceThickness
+    << "0020,0013" // InstanceNumber
+    << "0020,0032" // ImagePositionPatient
+    << "0020,0037" // ImageOrientationPatient
+    << "0028,0010" // Rows
+    << "0028,0011" // Columns
+    << "0028,0030" // PixelSpacing
+    << "0008,1030"; // StudyDescription
+  database.setTagsToPrecache(tagsToPrecache);
+
+  // Insert the images one by one, each in its own transaction
+  ctkDICOMDatabase perRowDatabase;
+  CHECK_BOOL(perRowDatabase.openDatabase(temporaryDirectory.path() + "/ctkDICOMDatabaseTest8PerRow.sql"), true);
+  perRowDatabase.setTagsToPrecache(tagsToPrecache);
+  QElapsedTimer timer;
+  timer.start();
+  foreach (const ctkDICOMDatabase::IndexingResult& indexingResult, indexingResults)
+  {
+    perRowDatabase.insert(QList<ctkDICOMDatabase::IndexingResult>() << indexingResult);
+  }
+  qint64 perRowElapsedTime = qMax(qint64(1), timer.elapsed());
+  CHECK_INT(perRowDatabase.imagesCount(), indexingResults.size());
+  perRowDatabase.closeDatabase();
+
+  // Insert all the images in a single batch
+  timer.start();
+  database.insert(indexingResults);
+  qint64 batchedElapsedTime = qMax(qint64(1), timer.elapsed());
+
+  std::cout << "Inserted " << indexingResults.size() << " images"
+            << " one by one in " << perRowElapsedTime / 1000.0 << "s"
+            << " (" << indexingResults.size() * 1000.0 / perRowElapsedTime << " rows/s),"
+            << " in a batch in " << batchedElapsedTime / 1000.0 << "s"
+            << " (" << indexingResults.size() * 1000.0 / batchedElapsedTime << " rows/s)" << std::endl;
+  // Allow some timing noise
+  CHECK_BOOL(batchedElapsedTime <= perRowElapsedTime + perRowElapsedTime / 10 + 50, true);
+
+  CHECK_INT(database.patientsCount(), 1);
+  CHECK_INT(database.studiesCount(), NumberOfStudies);
+  CHECK_INT(database.seriesCount(), NumberOfStudies * NumberOfSeriesPerStudy);
+  CHECK_INT(database.imagesCount(), indexingResults.size());
+
+  // Precached tags are written into the tag cache
+  QString lastSOPInstanceUID = indexingResults.last().dataset->GetElementAsString(DCM_SOPInstanceUID);
+  CHECK_QSTRING(database.cachedTag(lastSOPInstanceUID, "0008,0060"), templateDataset.GetElementAsString(DCM_Modality));
+
+  // Displayed image count is updated incrementally
+  timer.start();
+  database.updateDisplayedFields();
+  double elapsedTimeInSeconds = qMax(qint64(1), timer.elapsed()) / 1000.0;
+  std::cout << "Updated displayed fields of " << indexingResults.size() << " images in " << elapsedTimeInSeconds << "s" << std::endl;
+  CHECK_QSTRING(database.fieldForSeries("DisplayedCount", seriesUID(0, 1)), QString::number(NumberOfImagesPerSeries));
+  database.insert(createIndexingResults(templateDataset, 0, 1, NumberOfImagesPerSeries, 10));
+  database.updateDisplayedFields();
+  CHECK_QSTRING(database.fieldForSeries("DisplayedCount", seriesUID(0, 1)), QString::number(NumberOfImagesPerSeries + 10));
+  // Replaced images must not be counted twice
+  QList<ctkDICOMDatabase::IndexingResult> replacedIndexingResults = createIndexingResults(templateDataset, 0, 2);
+  for (int index = 0; index < replacedIndexingResults.size(); ++index)
+  {
+    replacedIndexingResults[index].overwriteExistingDataset = true;
+  }
+  database.insert(replacedIndexingResults);
+  database.updateDisplayedFields();
+  CHECK_QSTRING(database.fieldForSeries("DisplayedCount", seriesUID(0, 2)), QString::number(NumberOfImagesPerSeries));
+
+  // Removed series must be inserted again
+  CHECK_BOOL(database.removeSeries(seriesUID(0, 0)), true);
+  CHECK_INT(database.seriesCount(), NumberOfStudies * NumberOfSeriesPerStudy - 1);
+  database.insert(createIndexingResults(templateDataset, 0, 0));
+  CHECK_INT(database.seriesCount(), NumberOfStudies * NumberOfSeriesPerStudy);
+  CHECK_INT(database.instancesForSeries(seriesUID(0, 0)).size(), NumberOfImagesPerSeries);
+  database.updateDisplayedFields();
+  CHECK_QSTRING(database.fieldForSeries("DisplayedCount", seriesUID(0, 0)), QString::number(NumberOfImagesPerSeries));
+
+  // Removed study must be inserted again
+  CHECK_BOOL(database.removeStudy(studyUID(1)), true);
+  CHECK_INT(database.studiesCount(), NumberOfStudies - 1);
+  database.insert(createIndexingResults(templateDataset, 1));
+  CHECK_INT(database.studiesCount(), NumberOfStudies);
+  CHECK_INT(database.seriesForStudy(studyUID(1)).size(), NumberOfSeriesPerStudy);
+
+  // Removed patient must be inserted again
+  QStringList patients = database.patients();
+  CHECK_INT(patients.size(), 1);
+  CHECK_BOOL(database.removePatient(patients[0]), true);
+  CHECK_INT(database.patientsCount(), 0);
+  database.insert(createIndexingResults(templateDataset, 2));
+  CHECK_INT(database.patientsCount(), 1);
+  CHECK_INT(database.studiesCount(), 1);
+  CHECK_INT(database.imagesCount(), NumberOfSeriesPerStudy * NumberOfImagesPerSeries);
+
+  // Prepared statements must not be reused after the database is reopened
+  database.closeDatabase();
+  database.openDatabase(":memory:");
+  database.insert(createIndexingResults(templateDataset, 3));
+  CHECK_INT(database.seriesCount(), NumberOfSeriesPerStudy);
+  CHECK_INT(database.imagesCount(), NumberOfSeriesPerStudy * NumberOfImagesPerSeries);
+
+  return EXIT_SUCCESS;
+}
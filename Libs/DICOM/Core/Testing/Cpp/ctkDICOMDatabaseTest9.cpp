@@ -0,0 +1,276 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QSemaphore>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QThread>
+
+// ctkCore includes
+#include <ctkCoreTestingMacros.h>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMDatabaseTestHelper.h"
+#include "ctkDICOMItem.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdeftag.h>
+
+// STD includes
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+
+const int NumberOfStudies = 4;
+const int NumberOfSeriesPerStudy = 5;
+const int NumberOfImagesPerSeries = 200;
+
+//------------------------------------------------------------------------------
+QString studyUID(int studyIndex)
+{
+  return QString("1.2.826.0.1.3680043.2.1125.9.%1").arg(studyIndex);
+}
+
+//------------------------------------------------------------------------------
+QString seriesUID(int studyIndex, int seriesIndex)
+{
+  return QString("%1.%2").arg(studyUID(studyIndex)).arg(seriesIndex);
+}
+
+//------------------------------------------------------------------------------
+QList<ctkDICOMDatabase::IndexingResult> createIndexingResults(ctkDICOMItem& templateDataset,
+  int studyIndex, int seriesIndex)
+{
+  QList<ctkDICOMDatabase::IndexingResult> indexingResults;
+  for (int imageIndex = 0; imageIndex < NumberOfImagesPerSeries; ++imageIndex)
+  {
+    QString sopInstanceUID = QString("%1.%2").arg(seriesUID(studyIndex, seriesIndex)).arg(imageIndex);
+    indexingResults << ctkDICOMDatabaseTestHelper::createIndexingResult(templateDataset,
+      studyUID(studyIndex), seriesUID(studyIndex, seriesIndex), sopInstanceUID);
+  }
+  return indexingResults;
+}
+
+//------------------------------------------------------------------------------
+// Imports all the series, one transaction per series, using its own database connection
+// (same as the indexer does).
+class ImportThread : public QThread
+{
+public:
+  ImportThread(ctkDICOMItem& templateDataset, const QString& databaseFile)
+    : TemplateDataset(templateDataset)
+    , DatabaseFile(databaseFile)
+  {
+  }
+
+  QAtomicInt ImportedSeriesCount;
+
+protected:
+  void run() override
+  {
+    ctkDICOMDatabase database;
+    database.openDatabase(this->DatabaseFile, "ctkDICOMDatabaseTest9Import");
+    for (int studyIndex = 0; studyIndex < NumberOfStudies; ++studyIndex)
+    {
+      for (int seriesIndex = 0; seriesIndex < NumberOfSeriesPerStudy; ++seriesIndex)
+      {
+        database.insert(createIndexingResults(this->TemplateDataset, studyIndex, seriesIndex));
+        this->ImportedSeriesCount.ref();
+      }
+    }
+    database.closeDatabase();
+  }
+
+  ctkDICOMItem& TemplateDataset;
+  QString DatabaseFile;
+};
+
+//------------------------------------------------------------------------------
+// Queries the database from its own read-only connection, then waits until released
+class ReaderThread : public QThread
+{
+public:
+  ReaderThread(ctkDICOMDatabase& database)
+    : Database(database)
+  {
+  }
+
+  QString ConnectionName;
+  int SeriesCount{0};
+  QSemaphore Queried;
+  QSemaphore Released;
+
+protected:
+  void run() override
+  {
+    this->ConnectionName = this->Database.readOnlyDatabase().connectionName();
+    this->SeriesCount = this->Database.seriesForStudy(studyUID(0)).size();
+    this->Queried.release();
+    this->Released.acquire();
+  }
+
+  ctkDICOMDatabase& Database;
+};
+
+//------------------------------------------------------------------------------
+// Run browsing queries and record their duration (in nanoseconds).
+// Returns false if a query does not return the expected results.
+bool browse(ctkDICOMDatabase& database, std::vector<qint64>& latencies)
+{
+  QElapsedTimer timer;
+
+  timer.start();
+  QStringList patients = database.patients();
+  latencies.push_back(timer.nsecsElapsed());
+
+  timer.start();
+  QStringList series = database.seriesForStudy(studyUID(0));
+  latencies.push_back(timer.nsecsElapsed());
+
+  timer.start();
+  QStringList files = database.filesForSeries(seriesUID(0, 0));
+  latencies.push_back(timer.nsecsElapsed());
+
+  return patients.size() == 1 && !series.isEmpty() && files.size() == NumberOfImagesPerSeries;
+}
+
+//------------------------------------------------------------------------------
+void printLatencies(const char* title, std::vector<qint64> latencies)
+{
+  std::sort(latencies.begin(), latencies.end());
+  size_t count = latencies.size();
+  std::cout << title << ": " << count << " queries,"
+            << " p50=" << latencies[count * 50 / 100] / 1000 << "us"
+            << " p95=" << latencies[count * 95 / 100] / 1000 << "us"
+            << " p99=" << latencies[count * 99 / 100] / 1000 << "us"
+            << " max=" << latencies.back() / 1000 << "us" << std::endl;
+}
+
+} // end of anonymous namespace
+
+// Measures the latency of browsing queries while another connection is importing
+// and checks that the queries are not blocked by the insert transactions.
+int ctkDICOMDatabaseTest9( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc < 2)
+  {
+    std::cerr << "ctkDICOMDatabaseTest9: missing dicom filePath argument";
+    std::cerr << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ctkDICOMItem templateDataset;
+  CHECK_BOOL(ctkDICOMDatabaseTestHelper::loadTemplateDataset(argv[1], templateDataset), true);
+
+  // In-memory databases have a single connection
+  ctkDICOMDatabase memoryDatabase;
+  memoryDatabase.openDatabase(":memory:");
+  CHECK_QSTRING(memoryDatabase.readOnlyDatabase().connectionName(), memoryDatabase.database().connectionName());
+  memoryDatabase.closeDatabase();
+
+  QTemporaryDir temporaryDirectory;
+  CHECK_BOOL(temporaryDirectory.isValid(), true);
+  QString databaseFile = temporaryDirectory.path() + "/ctkDICOM.sql";
+
+  ctkDICOMDatabase database;
+  CHECK_QSTRING(database.journalMode(), QString("WAL"));
+  CHECK_BOOL(database.openDatabase(databaseFile, "ctkDICOMDatabaseTest9Browse"), true);
+  QSqlQuery journalModeQuery(database.database());
+  CHECK_BOOL(journalModeQuery.exec("PRAGMA journal_mode"), true);
+  CHECK_BOOL(journalModeQuery.next(), true);
+  CHECK_QSTRING(journalModeQuery.value(0).toString().toUpper(), QString("WAL"));
+  journalModeQuery.finish();
+
+  // Browsing queries use a separate read-only connection
+  {
+    QSqlDatabase readOnlyDatabase = database.readOnlyDatabase();
+    CHECK_BOOL(readOnlyDatabase.connectionName() != database.database().connectionName(), true);
+    CHECK_QSTRING(database.readOnlyDatabase().connectionName(), readOnlyDatabase.connectionName());
+    QSqlQuery writeQuery(readOnlyDatabase);
+    CHECK_BOOL(writeQuery.exec("DELETE FROM Patients"), false);
+  }
+
+  ctkDICOMDatabase baselineDatabase;
+  baselineDatabase.openDatabase(databaseFile, "ctkDICOMDatabaseTest9Baseline");
+  baselineDatabase.insert(createIndexingResults(templateDataset, 0, 0));
+  baselineDatabase.closeDatabase();
+
+  // Latency without concurrent import
+  std::vector<qint64> idleLatencies;
+  for (int iteration = 0; iteration < 100; ++iteration)
+  {
+    CHECK_BOOL(browse(database, idleLatencies), true);
+  }
+  printLatencies("Idle", idleLatencies);
+
+  // Latency while importing
+  ImportThread importThread(templateDataset, databaseFile);
+  QElapsedTimer importTimer;
+  importTimer.start();
+  importThread.start();
+  std::vector<qint64> importLatencies;
+  while (!importThread.isFinished())
+  {
+    CHECK_BOOL(browse(database, importLatencies), true);
+  }
+  importThread.wait();
+  std::cout << "Imported " << NumberOfStudies * NumberOfSeriesPerStudy * NumberOfImagesPerSeries
+            << " images in " << importTimer.elapsed() << "ms" << std::endl;
+  CHECK_INT(importThread.ImportedSeriesCount.loadAcquire(), NumberOfStudies * NumberOfSeriesPerStudy);
+  CHECK_BOOL(importLatencies.empty(), false);
+  printLatencies("During import", importLatencies);
+
+  // Readers must never wait for the busy timeout of the writer's lock
+  std::sort(importLatencies.begin(), importLatencies.end());
+  CHECK_BOOL(importLatencies.back() < qint64(2000) * 1000 * 1000, true);
+
+  // Imported data is visible to the read-only connection
+  CHECK_INT(database.seriesForStudy(studyUID(NumberOfStudies - 1)).size(), NumberOfSeriesPerStudy);
+
+  // Disabling the pool falls back to the main connection
+  database.setMaximumReadConnections(0);
+  CHECK_QSTRING(database.readOnlyDatabase().connectionName(), database.database().connectionName());
+  CHECK_INT(database.seriesForStudy(studyUID(0)).size(), NumberOfSeriesPerStudy);
+
+  // Closing the database closes the read-only connections of the other threads
+  database.setMaximumReadConnections(8);
+  ReaderThread readerThread(database);
+  readerThread.start();
+  readerThread.Queried.acquire();
+  CHECK_INT(readerThread.SeriesCount, NumberOfSeriesPerStudy);
+  CHECK_BOOL(readerThread.ConnectionName != database.database().connectionName(), true);
+  CHECK_BOOL(QSqlDatabase::contains(readerThread.ConnectionName), true);
+  database.closeDatabase();
+  CHECK_BOOL(QSqlDatabase::contains(readerThread.ConnectionName), false);
+  readerThread.Released.release();
+  CHECK_BOOL(readerThread.wait(10000), true);
+  return EXIT_SUCCESS;
+}
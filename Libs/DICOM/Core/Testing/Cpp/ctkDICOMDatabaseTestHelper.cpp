@@ -0,0 +1,57 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabaseTestHelper.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdeftag.h>
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabaseTestHelper::loadTemplateDataset(const QString& filePath, ctkDICOMItem& templateDataset)
+{
+  templateDataset.InitializeFromFile(filePath);
+  if (!templateDataset.IsInitialized())
+  {
+    return false;
+  }
+  templateDataset.GetDcmItem().findAndDeleteElement(DCM_PixelData);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMDatabase::IndexingResult ctkDICOMDatabaseTestHelper::createIndexingResult(ctkDICOMItem& templateDataset,
+  const QString& studyInstanceUID, const QString& seriesInstanceUID, const QString& sopInstanceUID,
+  const QMap<DcmTagKey, QString>& attributes)
+{
+  QSharedPointer<ctkDICOMItem> dataset(templateDataset.Clone());
+  for (QMap<DcmTagKey, QString>::const_iterator it = attributes.constBegin(); it != attributes.constEnd(); ++it)
+  {
+    dataset->SetElementAsString(it.key(), it.value());
+  }
+  dataset->SetElementAsString(DCM_StudyInstanceUID, studyInstanceUID);
+  dataset->SetElementAsString(DCM_SeriesInstanceUID, seriesInstanceUID);
+  dataset->SetElementAsString(DCM_SOPInstanceUID, sopInstanceUID);
+
+  ctkDICOMDatabase::IndexingResult indexingResult;
+  indexingResult.filePath = "/ctkDICOMDatabaseTestHelper/" + sopInstanceUID + ".dcm";
+  indexingResult.dataset = dataset;
+  return indexingResult;
+}
@@ -0,0 +1,54 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+#ifndef __ctkDICOMDatabaseTestHelper_h
+#define __ctkDICOMDatabaseTestHelper_h
+
+// Qt includes
+#include <QMap>
+#include <QString>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMItem.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dctagkey.h>
+
+/// Synthetic instances shared by the database tests: many datasets are made from a
+/// single template dataset, changing only their UIDs and a few attributes.
+namespace ctkDICOMDatabaseTestHelper
+{
+
+/// Load the dataset of \a filePath without its pixel data, so that it can be
+/// cloned into many instances cheaply.
+/// Return false if the file cannot be read.
+bool loadTemplateDataset(const QString& filePath, ctkDICOMItem& templateDataset);
+
+/// Indexing result of a copy of \a templateDataset with the given UIDs and
+/// \a attributes. Its file path is made up from the SOP instance UID and does not
+/// exist, therefore the file is neither copied nor read.
+ctkDICOMDatabase::IndexingResult createIndexingResult(ctkDICOMItem& templateDataset,
+  const QString& studyInstanceUID, const QString& seriesInstanceUID, const QString& sopInstanceUID,
+  const QMap<DcmTagKey, QString>& attributes = QMap<DcmTagKey, QString>());
+
+}
+
+#endif
@@ -0,0 +1,239 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+
+// ctkCore includes
+#include <ctkCoreTestingMacros.h>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMDatabaseTestHelper.h"
+#include "ctkDICOMHierarchySnapshot.h"
+#include "ctkDICOMItem.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdeftag.h>
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+namespace
+{
+
+const int NumberOfPatients = 500;
+
+//------------------------------------------------------------------------------
+QString patientsName(int patientIndex)
+{
+  return QString("PATIENT^%1").arg(patientIndex, 5, 10, QChar('0'));
+}
+
+//------------------------------------------------------------------------------
+QString studyUID(int patientIndex)
+{
+  return QString("1.2.826.0.1.3680043.2.1125.18.%1").arg(patientIndex);
+}
+
+//------------------------------------------------------------------------------
+QString seriesUID(int patientIndex, int seriesIndex)
+{
+  return QString("%1.%2").arg(studyUID(patientIndex)).arg(seriesIndex);
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMDatabase::IndexingResult createIndexingResult(ctkDICOMItem& templateDataset,
+  int patientIndex, int seriesIndex, const QString& seriesDescription)
+{
+  QMap<DcmTagKey, QString> attributes;
+  attributes[DCM_PatientName] = patientsName(patientIndex);
+  attributes[DCM_PatientID] = QString("ID%1").arg(patientIndex);
+  attributes[DCM_StudyDescription] = QString("Brain study %1").arg(patientIndex);
+  attributes[DCM_SeriesDescription] = seriesDescription;
+  return ctkDICOMDatabaseTestHelper::createIndexingResult(templateDataset,
+    studyUID(patientIndex), seriesUID(patientIndex, seriesIndex),
+    QString("%1.1").arg(seriesUID(patientIndex, seriesIndex)), attributes);
+}
+
+//------------------------------------------------------------------------------
+// Each patient has a study with an axial and a sagittal series
+QList<ctkDICOMDatabase::IndexingResult> createIndexingResults(ctkDICOMItem& templateDataset,
+  int firstPatient, int count)
+{
+  QList<ctkDICOMDatabase::IndexingResult> indexingResults;
+  for (int patientIndex = firstPatient; patientIndex < firstPatient + count; ++patientIndex)
+  {
+    indexingResults << createIndexingResult(templateDataset, patientIndex, 0, QString("Axial %1").arg(patientIndex));
+    indexingResults << createIndexingResult(templateDataset, patientIndex, 1, QString("Sagittal %1").arg(patientIndex));
+  }
+  return indexingResults;
+}
+
+} // end of anonymous namespace
+
+// Checks that the hierarchy snapshot answers the queries of the database and follows its changes.
+int ctkDICOMHierarchySnapshotTest1( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc < 2)
+  {
+    std::cerr << "ctkDICOMHierarchySnapshotTest1: missing dicom filePath argument";
+    std::cerr << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ctkDICOMItem templateDataset;
+  CHECK_BOOL(ctkDICOMDatabaseTestHelper::loadTemplateDataset(argv[1], templateDataset), true);
+
+  QTemporaryDir temporaryDirectory;
+  CHECK_BOOL(temporaryDirectory.isValid(), true);
+  QString databaseFile = temporaryDirectory.path() + "/ctkDICOM.sql";
+
+  ctkDICOMDatabase database;
+  CHECK_BOOL(database.openDatabase(databaseFile), true);
+  database.insert(createIndexingResults(templateDataset, 0, NumberOfPatients));
+
+  // Disabled by default
+  CHECK_BOOL(database.isHierarchySnapshotEnabled(), false);
+  CHECK_NULL(database.hierarchySnapshot());
+  QStringList patients = database.patients();
+  CHECK_INT(patients.count(), NumberOfPatients);
+
+  // Built from the database when first needed
+  database.setHierarchySnapshotEnabled(true);
+  ctkDICOMHierarchySnapshot* snapshot = database.hierarchySnapshot();
+  CHECK_NOT_NULL(snapshot);
+  CHECK_BOOL(QFileInfo(snapshot->filePath()).exists(), true);
+  CHECK_INT(snapshot->rebuildCount(), 1);
+  CHECK_INT(snapshot->count(ctkDICOMHierarchySnapshot::PatientLevel), NumberOfPatients);
+  CHECK_INT(snapshot->count(ctkDICOMHierarchySnapshot::StudyLevel), NumberOfPatients);
+  CHECK_INT(snapshot->count(ctkDICOMHierarchySnapshot::SeriesLevel), 2 * NumberOfPatients);
+  CHECK_QSTRINGLIST(database.patients(), patients);
+
+  // Queries answered from the snapshot
+  QString patientUID = database.patientForStudy(studyUID(42));
+  CHECK_QSTRINGLIST(database.studiesForPatient(patientUID), QStringList() << studyUID(42));
+  CHECK_QSTRINGLIST(database.seriesForStudy(studyUID(42)), QStringList() << seriesUID(42, 0) << seriesUID(42, 1));
+  CHECK_QSTRING(database.fieldForPatient("PatientsName", patientUID), patientsName(42));
+  CHECK_QSTRING(database.fieldForStudy("StudyDescription", studyUID(42)), QString("Brain study 42"));
+  CHECK_QSTRING(database.fieldForSeries("SeriesDescription", seriesUID(42, 1)), QString("Sagittal 42"));
+  CHECK_BOOL(database.insertDateTimeForPatient(patientUID).isValid(), true);
+  int seriesRow = snapshot->row(ctkDICOMHierarchySnapshot::SeriesLevel, seriesUID(42, 1));
+  CHECK_BOOL(seriesRow >= 0, true);
+  int studyRow = snapshot->parentRow(ctkDICOMHierarchySnapshot::SeriesLevel, seriesRow);
+  CHECK_QSTRING(snapshot->uid(ctkDICOMHierarchySnapshot::StudyLevel, studyRow), studyUID(42));
+  CHECK_INT(snapshot->row(ctkDICOMHierarchySnapshot::PatientLevel, "no such patient"), -1);
+  CHECK_QSTRING(database.fieldForSeries("SeriesDescription", "no such series"), QString());
+  CHECK_INT(snapshot->rebuildCount(), 1);
+  CHECK_INT(snapshot->incrementalUpdateCount(), 0);
+
+  // Inserted rows are added incrementally
+  QList<ctkDICOMDatabase::IndexingResult> newIndexingResults = createIndexingResults(templateDataset, NumberOfPatients, 1);
+  newIndexingResults << createIndexingResult(templateDataset, 7, 2, "Coronal 7");
+  database.insert(newIndexingResults);
+  CHECK_POINTER(database.hierarchySnapshot(), snapshot);
+  CHECK_INT(snapshot->rebuildCount(), 1);
+  CHECK_INT(snapshot->incrementalUpdateCount(), 1);
+  CHECK_INT(snapshot->count(ctkDICOMHierarchySnapshot::PatientLevel), NumberOfPatients + 1);
+  CHECK_QSTRING(database.fieldForPatient("PatientsName", database.patients().last()), patientsName(NumberOfPatients));
+  CHECK_INT(database.seriesForStudy(studyUID(7)).count(), 3);
+  CHECK_QSTRING(database.fieldForSeries("SeriesDescription", seriesUID(7, 2)), QString("Coronal 7"));
+
+  // Displayed fields are updated
+  database.updateDisplayedFields();
+  QSqlQuery displayedFieldsQuery(database.database());
+  CHECK_BOOL(displayedFieldsQuery.exec(QString(
+    "SELECT DisplayedPatientsName, DisplayedNumberOfStudies FROM Patients WHERE UID = %1").arg(patientUID)), true);
+  CHECK_BOOL(displayedFieldsQuery.next(), true);
+  CHECK_QSTRING(database.fieldForPatient("DisplayedPatientsName", patientUID), displayedFieldsQuery.value(0).toString());
+  CHECK_QSTRING(database.fieldForPatient("DisplayedNumberOfStudies", patientUID), displayedFieldsQuery.value(1).toString());
+  CHECK_INT(snapshot->rebuildCount(), 1);
+
+  // Image counts recomputed when files are removed are updated incrementally
+  int incrementalUpdateCount = snapshot->incrementalUpdateCount();
+  CHECK_BOOL(database.removeFiles(database.filesForSeries(seriesUID(5, 0)), false), true);
+  CHECK_QSTRING(database.fieldForSeries("DisplayedCount", seriesUID(5, 0)), QString("0"));
+  CHECK_INT(snapshot->rebuildCount(), 1);
+  CHECK_INT(snapshot->incrementalUpdateCount(), incrementalUpdateCount + 1);
+
+  // Removed rows rebuild the snapshot
+  CHECK_BOOL(database.removeSeries(seriesUID(7, 2)), true);
+  CHECK_NOT_NULL(database.hierarchySnapshot());
+  CHECK_INT(snapshot->rebuildCount(), 2);
+  CHECK_INT(database.seriesForStudy(studyUID(7)).count(), 2);
+
+  // Rows removed by another connection are detected, even if as many rows are inserted
+  {
+    ctkDICOMDatabase otherDatabase;
+    CHECK_BOOL(otherDatabase.openDatabase(databaseFile), true);
+    CHECK_BOOL(otherDatabase.removePatient(patientUID), true);
+    otherDatabase.insert(createIndexingResults(templateDataset, NumberOfPatients + 1, 1));
+    otherDatabase.closeDatabase();
+  }
+  CHECK_NOT_NULL(database.hierarchySnapshot());
+  CHECK_INT(snapshot->rebuildCount(), 3);
+  CHECK_INT(snapshot->count(ctkDICOMHierarchySnapshot::PatientLevel), NumberOfPatients + 1);
+  CHECK_INT(database.studiesForPatient(patientUID).count(), 0);
+  CHECK_INT(database.seriesForStudy(studyUID(NumberOfPatients + 1)).count(), 2);
+
+  // The snapshot file can be used after the database is closed, without querying it
+  QString snapshotFile = snapshot->filePath();
+  incrementalUpdateCount = snapshot->incrementalUpdateCount();
+  database.closeDatabase();
+  ctkDICOMHierarchySnapshot closedDatabaseSnapshot;
+  closedDatabaseSnapshot.setFilePath(snapshotFile);
+  QElapsedTimer timer;
+  timer.start();
+  CHECK_BOOL(closedDatabaseSnapshot.load(), true);
+  QStringList snapshotPatients = closedDatabaseSnapshot.uids(ctkDICOMHierarchySnapshot::PatientLevel);
+  qint64 loadTime = timer.nsecsElapsed();
+  CHECK_INT(snapshotPatients.count(), NumberOfPatients + 1);
+  CHECK_QSTRING(closedDatabaseSnapshot.valueForUID(ctkDICOMHierarchySnapshot::SeriesLevel, seriesUID(3, 0),
+    "SeriesDescription"), QString("Axial 3"));
+  CHECK_QSTRINGLIST(closedDatabaseSnapshot.childUIDs(ctkDICOMHierarchySnapshot::StudyLevel, studyUID(3)),
+    QStringList() << seriesUID(3, 0) << seriesUID(3, 1));
+  std::cout << "Load of the snapshot of " << NumberOfPatients << " patients: "
+            << loadTime / 1000 << "us" << std::endl;
+  closedDatabaseSnapshot.close();
+
+  // Reopened database uses the existing snapshot
+  CHECK_BOOL(database.openDatabase(databaseFile), true);
+  CHECK_NOT_NULL(database.hierarchySnapshot());
+  CHECK_BOOL(snapshot->isUpToDate(database.database()), true);
+  CHECK_INT(snapshot->rebuildCount(), 3);
+  CHECK_INT(snapshot->incrementalUpdateCount(), incrementalUpdateCount);
+  CHECK_INT(database.patients().count(), NumberOfPatients + 1);
+
+  // Disabled snapshot is not used anymore
+  database.setHierarchySnapshotEnabled(false);
+  CHECK_NULL(database.hierarchySnapshot());
+  CHECK_BOOL(snapshot->isLoaded(), false);
+  CHECK_INT(database.patients().count(), NumberOfPatients + 1);
+
+  database.closeDatabase();
+  return EXIT_SUCCESS;
+}
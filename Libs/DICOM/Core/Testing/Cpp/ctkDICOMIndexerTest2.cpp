@@ -0,0 +1,149 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QThread>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMIndexer.h"
+
+// STD includes
+#include <iostream>
+
+// Indexes the same directory with increasing number of parsing threads,
+// with and without header-only parsing, and reports the indexing throughput.
+// Every configuration must index the same files with consistent pipeline statistics.
+// Timings are only reported: they depend on the load of the machine.
+int ctkDICOMIndexerTest2( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc < 2)
+  {
+    std::cerr << "Usage: ctkDICOMIndexerTest2 <dicom directory>" << std::endl;
+    return EXIT_FAILURE;
+  }
+  QString dicomDir = argv[1];
+  if (!QDir(dicomDir).exists())
+  {
+    std::cerr << "Directory does not exist: " << qPrintable(dicomDir) << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // The indexer writes through its own connection to the database file, which
+  // would be a different, empty database for ":memory:".
+  QTemporaryDir temporaryDirectory;
+  if (!temporaryDirectory.isValid())
+  {
+    std::cerr << "Failed to create temporary directory" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  int maximumThreadCount = qMax(1, QThread::idealThreadCount());
+  QStringList expectedFiles;
+  for (int headerOnly = 0; headerOnly <= 1; ++headerOnly)
+  {
+    qint64 singleThreadElapsedTime = 0;
+    for (int threadCount = 1; ; threadCount = qMin(threadCount * 2, maximumThreadCount))
+    {
+      ctkDICOMDatabase database;
+      QString databaseFile = QString("%1/ctkDICOMIndexerTest2-%2-%3.sql")
+        .arg(temporaryDirectory.path()).arg(headerOnly).arg(threadCount);
+      if (!database.openDatabase(databaseFile))
+      {
+        std::cerr << "Failed to open database " << qPrintable(databaseFile) << std::endl;
+        return EXIT_FAILURE;
+      }
+      ctkDICOMIndexer indexer;
+      indexer.setParsingThreadCount(threadCount);
+      if (indexer.parsingThreadCount() != threadCount)
+      {
+        std::cerr << "ctkDICOMIndexer::setParsingThreadCount failed: "
+                  << indexer.parsingThreadCount() << " != " << threadCount << std::endl;
+        return EXIT_FAILURE;
+      }
+      indexer.setHeaderOnlyParsing(headerOnly);
+
+      QElapsedTimer timer;
+      timer.start();
+      indexer.addDirectory(&database, dicomDir);
+      indexer.waitForImportFinished();
+      qint64 elapsedTime = qMax(qint64(1), timer.elapsed());
+      double elapsedTimeInSeconds = elapsedTime / 1000.0;
+
+      int imagesCount = database.imagesCount();
+      QStringList files = database.allFiles();
+      files.sort();
+      if (expectedFiles.isEmpty())
+      {
+        expectedFiles = files;
+      }
+      if (imagesCount == 0 || imagesCount != files.count() || files != expectedFiles)
+      {
+        std::cerr << "Unexpected indexed images with " << threadCount << " threads: "
+                  << imagesCount << " images, " << files.count() << " files"
+                  << " (expected " << expectedFiles.count() << ")" << std::endl;
+        return EXIT_FAILURE;
+      }
+
+      ctkDICOMIndexer::PipelineStatistics statistics = indexer.pipelineStatistics();
+      if (statistics.ParsedFileCount < imagesCount
+        || statistics.MaximumQueueDepth > statistics.QueueCapacity
+        || statistics.AverageQueueDepth > statistics.MaximumQueueDepth)
+      {
+        std::cerr << "Unexpected pipeline statistics with " << threadCount << " threads: "
+                  << statistics.ParsedFileCount << " files, queue depth max " << statistics.MaximumQueueDepth
+                  << " average " << statistics.AverageQueueDepth
+                  << " capacity " << statistics.QueueCapacity << std::endl;
+        return EXIT_FAILURE;
+      }
+
+      std::cout << "Header only: " << (headerOnly ? "yes" : "no")
+                << "  parsing threads: " << threadCount
+                << "  files: " << imagesCount
+                << "  time: " << elapsedTimeInSeconds << "s"
+                << "  throughput: " << imagesCount / elapsedTimeInSeconds << " files/s"
+                << "  queue depth: max " << statistics.MaximumQueueDepth
+                << " average " << statistics.AverageQueueDepth << "/" << statistics.QueueCapacity
+                << "  parsers blocked: " << statistics.ProducerBlockedTime << "ms"
+                << "  writer idle: " << statistics.WriterIdleTime << "ms" << std::endl;
+
+      if (threadCount == 1)
+      {
+        singleThreadElapsedTime = elapsedTime;
+      }
+      std::cout << "  speedup over 1 thread: "
+                << static_cast<double>(singleThreadElapsedTime) / elapsedTime << std::endl;
+
+      database.closeDatabase();
+      if (threadCount == maximumThreadCount)
+      {
+        break;
+      }
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
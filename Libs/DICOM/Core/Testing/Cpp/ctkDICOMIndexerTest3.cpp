@@ -0,0 +1,162 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QThread>
+
+// ctkCore includes
+#include <ctkCoreTestingMacros.h>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMIndexer.h"
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+// Copied files are dated one hour back so that they are never deferred as still being written
+bool copyFiles(const QStringList& sourceFiles, const QString& destinationDirectory)
+{
+  if (!QDir().mkpath(destinationDirectory))
+  {
+    return false;
+  }
+  QDateTime modifiedTime = QDateTime::currentDateTime().addSecs(-3600);
+  foreach (const QString& sourceFile, sourceFiles)
+  {
+    QFile destinationFile(destinationDirectory + "/" + QFileInfo(sourceFile).fileName());
+    if (!QFile::copy(sourceFile, destinationFile.fileName())
+      || !destinationFile.open(QIODevice::ReadWrite)
+      || !destinationFile.setFileTime(modifiedTime, QFileDevice::FileModificationTime))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// Process events until the indexer is idle and the database has the expected number of images
+bool waitForImagesCount(ctkDICOMIndexer& indexer, ctkDICOMDatabase& database, int expectedImagesCount)
+{
+  QElapsedTimer timer;
+  timer.start();
+  while (timer.elapsed() < 30000)
+  {
+    QCoreApplication::processEvents();
+    if (!indexer.isImporting() && database.imagesCount() == expectedImagesCount)
+    {
+      return true;
+    }
+    QThread::msleep(50);
+  }
+  std::cerr << "Timeout: " << database.imagesCount() << " images instead of " << expectedImagesCount << std::endl;
+  return false;
+}
+
+} // end of anonymous namespace
+
+// Keeps a directory in sync with the database, across restarts.
+int ctkDICOMIndexerTest3( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc < 2)
+  {
+    std::cerr << "Usage: ctkDICOMIndexerTest3 <dicom directory>" << std::endl;
+    return EXIT_FAILURE;
+  }
+  QStringList sourceFiles;
+  foreach (const QFileInfo& fileInfo, QDir(argv[1]).entryInfoList(QDir::Files, QDir::Name))
+  {
+    sourceFiles << fileInfo.absoluteFilePath();
+  }
+  CHECK_BOOL(sourceFiles.size() >= 10, true);
+
+  QTemporaryDir temporaryDirectory;
+  CHECK_BOOL(temporaryDirectory.isValid(), true);
+  QString databaseFile = temporaryDirectory.path() + "/ctkDICOM.sql";
+  QString watchedDirectoryPath = temporaryDirectory.path() + "/watched";
+  QString stagingDirectoryPath = temporaryDirectory.path() + "/staging";
+  CHECK_BOOL(copyFiles(sourceFiles.mid(0, 5), watchedDirectoryPath + "/series1"), true);
+
+  {
+    ctkDICOMDatabase database;
+    CHECK_BOOL(database.openDatabase(databaseFile), true);
+    ctkDICOMIndexer indexer;
+    indexer.setDatabase(&database);
+    // The default settle time is kept: the scan cursor stays behind the modification time
+    // of the directories changed after the last synchronization, even on file systems
+    // with a coarse time resolution.
+    CHECK_INT(indexer.watchedDirectorySettleTime(), 2000);
+
+    // Initial synchronization
+    indexer.addWatchedDirectory(watchedDirectoryPath);
+    CHECK_INT(database.imagesCount(), 5);
+    CHECK_INT(indexer.watchedDirectories().size(), 1);
+    CHECK_INT(database.watchedDirectories().size(), 1);
+    CHECK_BOOL(database.watchedDirectories()[0].scanCursor.isValid(), true);
+
+    // Created and deleted files are found from change notifications.
+    // The new series is moved in at once so that no file is written between the listing
+    // of its directory and the start of its watch.
+    CHECK_BOOL(copyFiles(sourceFiles.mid(5, 3), stagingDirectoryPath + "/series2"), true);
+    CHECK_BOOL(QDir().rename(stagingDirectoryPath + "/series2", watchedDirectoryPath + "/series2"), true);
+    CHECK_BOOL(QFile::remove(watchedDirectoryPath + "/series1/" + QFileInfo(sourceFiles[0]).fileName()), true);
+    CHECK_BOOL(waitForImagesCount(indexer, database, 7), true);
+  }
+
+  // Changes made while the application is not running are found after restart
+  CHECK_BOOL(copyFiles(sourceFiles.mid(8, 2), watchedDirectoryPath + "/series1"), true);
+  {
+    ctkDICOMDatabase database;
+    CHECK_BOOL(database.openDatabase(databaseFile), true);
+    ctkDICOMIndexer indexer;
+    indexer.setDatabase(&database);
+    CHECK_INT(indexer.watchedDirectories().size(), 0);
+    indexer.restoreWatchedDirectories();
+    CHECK_INT(indexer.watchedDirectories().size(), 1);
+    CHECK_INT(database.imagesCount(), 9);
+
+    // Deleted directories are removed from the database
+    CHECK_BOOL(QDir(watchedDirectoryPath + "/series2").removeRecursively(), true);
+    CHECK_BOOL(waitForImagesCount(indexer, database, 6), true);
+
+    // Stop watching
+    indexer.removeWatchedDirectory(watchedDirectoryPath, true);
+    CHECK_INT(indexer.watchedDirectories().size(), 0);
+    CHECK_INT(database.watchedDirectories().size(), 0);
+    CHECK_INT(database.imagesCount(), 0);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,148 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+
+// ctkCore includes
+#include <ctkCoreTestingMacros.h>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMInsertService.h"
+#include "ctkDICOMJobResponseSet.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdeftag.h>
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+namespace
+{
+
+const char* SeriesInstanceUID = "1.2.826.0.1.3680043.2.1125.17.1.1";
+
+//------------------------------------------------------------------------------
+// Response sets of a query of instances, each one with an instance of the same series
+QList<QSharedPointer<ctkDICOMJobResponseSet>> createJobResponseSets(int firstInstance, int count)
+{
+  QList<QSharedPointer<ctkDICOMJobResponseSet>> jobResponseSets;
+  for (int instance = firstInstance; instance < firstInstance + count; ++instance)
+  {
+    QString sopInstanceUID = QString("%1.%2").arg(SeriesInstanceUID).arg(instance);
+    DcmDataset* dataset = new DcmDataset;
+    dataset->putAndInsertString(DCM_PatientName, "INSERT^SERVICE");
+    dataset->putAndInsertString(DCM_PatientID, "P17");
+    dataset->putAndInsertString(DCM_StudyInstanceUID, "1.2.826.0.1.3680043.2.1125.17.1");
+    dataset->putAndInsertString(DCM_SeriesInstanceUID, SeriesInstanceUID);
+    dataset->putAndInsertString(DCM_SOPInstanceUID, sopInstanceUID.toStdString().c_str());
+    dataset->putAndInsertString(DCM_Modality, "MR");
+
+    QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet(new ctkDICOMJobResponseSet);
+    jobResponseSet->setJobType(ctkDICOMJobResponseSet::JobType::QueryInstances);
+    jobResponseSet->setConnectionName("ctkDICOMInsertServiceTest1");
+    jobResponseSet->setSeriesInstanceUID(SeriesInstanceUID);
+    jobResponseSet->setSOPInstanceUID(sopInstanceUID);
+    jobResponseSet->setDataset(dataset);
+    jobResponseSets << jobResponseSet;
+  }
+  return jobResponseSets;
+}
+
+} // end of anonymous namespace
+
+// Checks that the requests of several jobs are coalesced into bounded transactions.
+int ctkDICOMInsertServiceTest1( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  QTemporaryDir temporaryDirectory;
+  CHECK_BOOL(temporaryDirectory.isValid(), true);
+  QString databaseFile = temporaryDirectory.path() + "/ctkDICOM.sql";
+
+  ctkDICOMDatabase database;
+  CHECK_BOOL(database.openDatabase(databaseFile), true);
+
+  ctkDICOMInsertService insertService;
+  CHECK_INT(insertService.maximumBatchSize(), 100);
+  CHECK_INT(insertService.maximumDelay(), 100);
+  // A transaction is written as soon as maximumBatchSize response sets are queued,
+  // the delay is only reached if the test hangs
+  insertService.setMaximumDelay(600000);
+  insertService.setMaximumBatchSize(6);
+
+  // Requests submitted together are written in one transaction
+  insertService.submit("job1", createJobResponseSets(0, 2), databaseFile);
+  insertService.submit("job2", createJobResponseSets(2, 2), databaseFile);
+  CHECK_BOOL(insertService.waitForInserted("job1", 100), false);
+  CHECK_BOOL(insertService.isSubmitted("job1"), true);
+  insertService.submit("job3", createJobResponseSets(4, 2), databaseFile);
+  CHECK_BOOL(insertService.isSubmitted("job2"), true);
+  CHECK_BOOL(insertService.waitForInserted("job3"), true);
+  CHECK_BOOL(insertService.waitForInserted("job1"), true);
+  CHECK_BOOL(insertService.waitForInserted("job2"), true);
+  CHECK_BOOL(insertService.isSubmitted("job2"), false);
+  CHECK_BOOL(insertService.waitForInserted("job2"), false);
+  CHECK_INT(insertService.flushCount(), 1);
+  CHECK_INT(insertService.insertedJobResponseSetsCount(), 6);
+  CHECK_INT(database.instancesForSeries(SeriesInstanceUID).count(), 6);
+
+  // Displayed fields are updated by the transaction
+  QSqlQuery notDisplayedQuery(database.database());
+  CHECK_BOOL(notDisplayedQuery.exec(
+    "SELECT COUNT(*) FROM Images WHERE DisplayedFieldsUpdatedTimestamp IS NULL"), true);
+  CHECK_BOOL(notDisplayedQuery.next(), true);
+  CHECK_INT(notDisplayedQuery.value(0).toInt(), 0);
+
+  // Transactions are bounded by the batch size, requests are not split
+  insertService.setMaximumBatchSize(3);
+  insertService.submit("job4", createJobResponseSets(6, 2), databaseFile);
+  insertService.submit("job5", createJobResponseSets(8, 2), databaseFile);
+  insertService.submit("job6", createJobResponseSets(10, 4), databaseFile);
+  CHECK_BOOL(insertService.waitForInserted("job6"), true);
+  CHECK_BOOL(insertService.waitForInserted("job4"), true);
+  CHECK_BOOL(insertService.waitForInserted("job5"), true);
+  CHECK_INT(insertService.flushCount(), 4);
+  CHECK_INT(database.instancesForSeries(SeriesInstanceUID).count(), 14);
+
+  // Canceled requests are not written and not waited
+  insertService.submit("job7", createJobResponseSets(14, 1), databaseFile);
+  insertService.cancel("job7");
+  CHECK_BOOL(insertService.isSubmitted("job7"), false);
+  CHECK_BOOL(insertService.waitForInserted("job7"), false);
+
+  // The service restarts after being stopped
+  insertService.stop();
+  CHECK_INT(insertService.flushCount(), 4);
+  CHECK_INT(database.instancesForSeries(SeriesInstanceUID).count(), 14);
+  insertService.setMaximumDelay(0);
+  insertService.submit("job8", createJobResponseSets(15, 1), databaseFile);
+  CHECK_BOOL(insertService.waitForInserted("job8"), true);
+  CHECK_INT(insertService.flushCount(), 5);
+  CHECK_INT(database.instancesForSeries(SeriesInstanceUID).count(), 15);
+
+  insertService.stop();
+  database.closeDatabase();
+  return EXIT_SUCCESS;
+}
@@ -30,6 +30,7 @@
 
 // ctkDICOMCore includes
 #include "ctkDICOMDatabase.h"
+#include "ctkDICOMJobResponseSet.h"
 #include "ctkDICOMQuery.h"
 #include "ctkDICOMTester.h"
 
@@ -84,5 +85,23 @@ int ctkDICOMQueryTest2( int argc, char * argv [] )
               << "No study instance retrieved" << std::endl;
     return EXIT_FAILURE;
   }
+  CHECK_INT(query.maximumParallelQueries(), 1);
+  CHECK_BOOL(query.jobResponseSets().isEmpty(), false);
+
+  // Series queries sent in parallel give the same results, in the same order
+  ctkDICOMQuery parallelQuery;
+  parallelQuery.setCallingAETitle("CTK_AE");
+  parallelQuery.setCalledAETitle("CTK_AE");
+  parallelQuery.setHost("localhost");
+  parallelQuery.setPort(tester.dcmqrscpPort());
+  parallelQuery.setMaximumParallelQueries(4);
+  CHECK_BOOL(parallelQuery.query(database), true);
+  CHECK_BOOL(parallelQuery.studyAndSeriesInstanceUIDQueried() == query.studyAndSeriesInstanceUIDQueried(), true);
+  CHECK_INT(parallelQuery.jobResponseSets().count(), query.jobResponseSets().count());
+  for (int index = 0; index < query.jobResponseSets().count(); ++index)
+  {
+    CHECK_QSTRING(parallelQuery.jobResponseSets()[index]->studyInstanceUID(),
+                  query.jobResponseSets()[index]->studyInstanceUID());
+  }
   return EXIT_SUCCESS;
 }
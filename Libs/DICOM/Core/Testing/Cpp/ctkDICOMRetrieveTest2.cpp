@@ -21,6 +21,7 @@
 // Qt includes
 #include <QCoreApplication>
 #include <QDebug>
+#include <QFile>
 #include <QPair>
 #include <QString>
 #include <QStringList>
@@ -32,10 +33,14 @@
 
 // ctkDICOMCore includes
 #include "ctkDICOMDatabase.h"
+#include "ctkDICOMJobResponseSet.h"
 #include "ctkDICOMQuery.h"
 #include "ctkDICOMRetrieve.h"
 #include "ctkDICOMTester.h"
 
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdeftag.h>
+
 // STD includes
 #include <iostream>
 
@@ -118,6 +123,86 @@ int ctkDICOMRetrieveTest2( int argc, char * argv [] )
     }
   }
 
+  // Streaming C-GET: instances are written to the database folder as they arrive
+  // and only their header is kept in memory
+  std::cerr << "ctkDICOMRetrieveTest2: Streaming retrieve\n";
+  retrieve.setJobUID("ctkDICOMRetrieveTest2");
+  retrieve.setStreamToStorage(true);
+  retrieve.setStreamingBatchSize(1);
+  CHECK_INT(retrieve.streamingBatchSize(), 1);
+  QList<QSharedPointer<ctkDICOMJobResponseSet>> streamedJobResponseSets;
+  int batchCount = 0;
+  QObject::connect(&retrieve, &ctkDICOMRetrieve::jobResponseSetsReady, [&]()
+  {
+    streamedJobResponseSets << retrieve.takeJobResponseSets(retrieve.streamingBatchSize());
+    ++batchCount;
+  });
+  QString studyInstanceUID = query.studyAndSeriesInstanceUIDQueried().first().first;
+  CHECK_BOOL(retrieve.getStudy(studyInstanceUID), true);
+  streamedJobResponseSets << retrieve.takeJobResponseSets();
+  CHECK_BOOL(streamedJobResponseSets.count() > 0, true);
+  CHECK_INT(batchCount, streamedJobResponseSets.count() - 1);
+
+  QList<ctkDICOMJobResponseSet*> jobResponseSets;
+  foreach (QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet, streamedJobResponseSets)
+  {
+    CHECK_BOOL(jobResponseSet->filePath().startsWith(database.databaseDirectory() + "/dicom/"), true);
+    CHECK_BOOL(jobResponseSet->filePath().endsWith(".part"), true);
+    CHECK_BOOL(QFileInfo::exists(jobResponseSet->filePath()), true);
+    CHECK_BOOL(jobResponseSet->dataset()->GetElementAsString(DCM_SOPInstanceUID).isEmpty(), false);
+    CHECK_BOOL(jobResponseSet->dataset()->GetElementAsString(DCM_Rows).isEmpty(), false);
+    CHECK_BOOL(jobResponseSet->dataset()->TagExists(DCM_PixelData), false);
+    jobResponseSets << jobResponseSet.data();
+  }
+
+  // The staged files are moved to their storage path when inserted
+  database.insert(jobResponseSets);
+  QStringList indexedFiles;
+  foreach (QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet, streamedJobResponseSets)
+  {
+    QString storedFilePath = jobResponseSet->filePath();
+    storedFilePath.chop(QString(".part").size());
+    CHECK_QSTRING(database.fileForInstance(jobResponseSet->sopInstanceUID()), storedFilePath);
+    CHECK_BOOL(QFileInfo::exists(storedFilePath), true);
+    CHECK_BOOL(QFileInfo::exists(jobResponseSet->filePath()), false);
+    indexedFiles << storedFilePath;
+  }
+
+  // Canceling the retrieve of an already indexed study keeps the indexed files
+  std::cerr << "ctkDICOMRetrieveTest2: Canceled streaming retrieve\n";
+  ctkDICOMRetrieve canceledRetrieve;
+  canceledRetrieve.setCallingAETitle("CTK_AE");
+  canceledRetrieve.setCalledAETitle("CTK_AE");
+  canceledRetrieve.setPort(tester.dcmqrscpPort());
+  canceledRetrieve.setHost("localhost");
+  canceledRetrieve.setDatabase(database);
+  canceledRetrieve.setJobUID("ctkDICOMRetrieveTest2Canceled");
+  canceledRetrieve.setStreamToStorage(true);
+  canceledRetrieve.setStreamingBatchSize(1);
+  QObject::connect(&canceledRetrieve, &ctkDICOMRetrieve::jobResponseSetsReady, [&]()
+  {
+    canceledRetrieve.cancel();
+  });
+  canceledRetrieve.getStudy(studyInstanceUID);
+  CHECK_BOOL(canceledRetrieve.wasCanceled(), true);
+  // Remove the staged files that were not inserted, as ctkDICOMRetrieveWorker does
+  QList<QSharedPointer<ctkDICOMJobResponseSet>> canceledJobResponseSets = canceledRetrieve.takeJobResponseSets();
+  CHECK_BOOL(canceledJobResponseSets.count() > 0, true);
+  foreach (QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet, canceledJobResponseSets)
+  {
+    CHECK_BOOL(jobResponseSet->filePath().endsWith(".part"), true);
+    CHECK_BOOL(indexedFiles.contains(jobResponseSet->filePath()), false);
+    QFile::remove(jobResponseSet->filePath());
+  }
+  foreach (const QString& indexedFile, indexedFiles)
+  {
+    CHECK_BOOL(QFileInfo::exists(indexedFile), true);
+  }
+  foreach (QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet, streamedJobResponseSets)
+  {
+    CHECK_BOOL(indexedFiles.contains(database.fileForInstance(jobResponseSet->sopInstanceUID())), true);
+  }
+
   std::cerr << "ctkDICOMRetrieveTest2: Exit success\n";
 
   return EXIT_SUCCESS;
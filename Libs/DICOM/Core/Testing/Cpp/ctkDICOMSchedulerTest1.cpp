@@ -25,6 +25,7 @@
 // Qt includes
 #include <QCoreApplication>
 #include <QTemporaryDir>
+#include <QThreadPool>
 
 // ctkCore includes
 #include <ctkCoreTestingMacros.h>
@@ -70,8 +71,12 @@ int ctkDICOMSchedulerTest1(int argc, char* argv[])
   CHECK_INT(scheduler.maximumPatientsQuery(), 25);
 
   // Test setting and getting
+  CHECK_INT(scheduler.laneThreadPool("Network")->maxThreadCount(), 20);
   scheduler.setMaximumThreadCount(19);
   CHECK_INT(scheduler.maximumThreadCount(), 19);
+  CHECK_INT(scheduler.laneThreadPool("Network")->maxThreadCount(), 19);
+  CHECK_BOOL(scheduler.laneThreadPool("CPU")->maxThreadCount() <= 19, true);
+  CHECK_INT(scheduler.laneThreadPool("DatabaseWriter")->maxThreadCount(), 1);
   scheduler.setMaximumNumberOfRetry(5);
   CHECK_INT(scheduler.maximumNumberOfRetry(), 5);
   scheduler.setRetryDelay(300);
@@ -0,0 +1,336 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QSemaphore>
+#include <QTemporaryDir>
+#include <QThread>
+
+// ctkCore includes
+#include <ctkCoreTestingMacros.h>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMJobResponseSet.h"
+#include "ctkDICOMScheduler.h"
+#include "ctkDICOMStorageListener.h"
+
+// DCMTK includes
+#include <dcmtk/config/osconfig.h>
+#include <dcmtk/dcmnet/dstorscu.h>
+
+// STD includes
+#include <iostream>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+// Sends files on its own association. The association is negotiated first, then
+// the files are sent and the association is released when the test allows it,
+// so that the associations of several senders are open at the same time.
+class SenderThread : public QThread
+{
+public:
+  SenderThread(const QString& AETitle, const QStringList& files, int port)
+    : AETitle(AETitle)
+    , Files(files)
+    , Port(port)
+  {
+  }
+
+  QString AETitle;
+  bool Negotiated{false};
+  bool AllSent{false};
+  QSemaphore Connected;
+  QSemaphore Send;
+  QSemaphore Sent;
+  QSemaphore Release;
+
+protected:
+  void run() override
+  {
+    DcmStorageSCU scu;
+    scu.setAETitle(OFString(this->AETitle.toStdString().c_str()));
+    scu.setPeerAETitle("CTKSTORE");
+    scu.setPeerHostName("localhost");
+    scu.setPeerPort(this->Port);
+    foreach (const QString& file, this->Files)
+    {
+      scu.addDicomFile(OFFilename(file.toStdString().c_str()));
+    }
+    if (scu.addPresentationContexts().good() && scu.initNetwork().good())
+    {
+      // The listener may not be listening yet
+      for (int attempt = 0; attempt < 50 && !this->Negotiated; ++attempt)
+      {
+        this->Negotiated = scu.negotiateAssociation().good();
+        if (!this->Negotiated)
+        {
+          QThread::msleep(100);
+        }
+      }
+    }
+    this->Connected.release();
+    if (!this->Negotiated)
+    {
+      return;
+    }
+
+    this->Send.acquire();
+    this->AllSent = scu.sendSOPInstances().good();
+    this->Sent.release();
+
+    this->Release.acquire();
+    scu.releaseAssociation();
+  }
+
+  QStringList Files;
+  int Port;
+};
+
+//------------------------------------------------------------------------------
+class ListenerThread : public QThread
+{
+public:
+  ListenerThread(ctkDICOMStorageListener& listener)
+    : Listener(listener)
+  {
+  }
+
+protected:
+  void run() override
+  {
+    this->Listener.listen();
+  }
+
+  ctkDICOMStorageListener& Listener;
+};
+
+//------------------------------------------------------------------------------
+// Open the associations of the senders and send their files while all are open.
+// Returns false if a sender fails.
+bool sendConcurrently(const QList<SenderThread*>& senders)
+{
+  foreach (SenderThread* sender, senders)
+  {
+    sender->start();
+  }
+  bool negotiated = true;
+  foreach (SenderThread* sender, senders)
+  {
+    negotiated = sender->Connected.tryAcquire(1, 30000) && sender->Negotiated && negotiated;
+  }
+  if (!negotiated)
+  {
+    return false;
+  }
+  foreach (SenderThread* sender, senders)
+  {
+    sender->Send.release();
+  }
+  bool allSent = true;
+  foreach (SenderThread* sender, senders)
+  {
+    allSent = sender->Sent.tryAcquire(1, 30000) && sender->AllSent && allSent;
+  }
+  return allSent;
+}
+
+//------------------------------------------------------------------------------
+void releaseAssociations(const QList<SenderThread*>& senders)
+{
+  foreach (SenderThread* sender, senders)
+  {
+    sender->Release.release();
+  }
+  foreach (SenderThread* sender, senders)
+  {
+    sender->wait(30000);
+  }
+}
+
+//------------------------------------------------------------------------------
+int totalQueueDepth(const QMap<QString, QVariant>& associationQueueDepths)
+{
+  int total = 0;
+  foreach (const QVariant& queueDepth, associationQueueDepths)
+  {
+    total += queueDepth.toInt();
+  }
+  return total;
+}
+
+//------------------------------------------------------------------------------
+int queueDepthOfSender(const QMap<QString, QVariant>& associationQueueDepths, const QString& AETitle)
+{
+  for (QMap<QString, QVariant>::const_iterator it = associationQueueDepths.constBegin();
+       it != associationQueueDepths.constEnd(); ++it)
+  {
+    if (it.key().startsWith(AETitle + "@"))
+    {
+      return it.value().toInt();
+    }
+  }
+  return -1;
+}
+
+} // end of anonymous namespace
+
+// Receives instances on two simultaneous associations, with the listener alone
+// and with the listener job of the scheduler that inserts the received batches.
+int ctkDICOMStorageListenerTest1(int argc, char* argv[])
+{
+  QCoreApplication app(argc, argv);
+
+  QStringList arguments = app.arguments();
+  QString testName = arguments.takeFirst();
+
+  if (arguments.count() < 2)
+  {
+    std::cerr << "Usage: " << qPrintable(testName)
+              << " <path-to-image> <path-to-image> [...]" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+#ifndef WITH_THREADS
+  std::cout << qPrintable(testName) << ": DCMTK is built without thread support,"
+            << " associations are received one at a time" << std::endl;
+  return EXIT_SUCCESS;
+#endif
+
+  int numberOfImages = arguments.count();
+  QStringList firstFiles = arguments.mid(0, numberOfImages / 2);
+  QStringList secondFiles = arguments.mid(numberOfImages / 2);
+
+  QTemporaryDir tempDirectory;
+  CHECK_BOOL(tempDirectory.isValid(), true);
+
+  // Listener alone: statistics of the received instances
+  std::cout << qPrintable(testName) << ": Receiving with the listener" << std::endl;
+  ctkDICOMStorageListener listener;
+  CHECK_INT(listener.maximumAssociations(), 1);
+  listener.setMaximumAssociations(4);
+  CHECK_INT(listener.maximumAssociations(), 4);
+  listener.setPort(11120);
+  listener.setJobUID("ctkDICOMStorageListenerTest1");
+  // Batches are taken by the test
+  listener.setInsertBatchSize(numberOfImages + 1);
+  CHECK_INT(listener.receivedObjectsCount(), 0);
+  CHECK_INT(listener.queueDepth(), 0);
+  CHECK_BOOL(listener.wasCanceled(), false);
+
+  ListenerThread listenerThread(listener);
+  listenerThread.start();
+
+  SenderThread firstSender("SENDER1", firstFiles, listener.port());
+  SenderThread secondSender("SENDER2", secondFiles, listener.port());
+  QList<SenderThread*> senders;
+  senders << &firstSender << &secondSender;
+  CHECK_BOOL(sendConcurrently(senders), true);
+
+  // The instances are pending, each association has its own queue
+  CHECK_INT(listener.receivedObjectsCount(), numberOfImages);
+  CHECK_INT(listener.queueDepth(), numberOfImages);
+  CHECK_BOOL(listener.objectsPerSecond() > 0., true);
+  QMap<QString, QVariant> associationQueueDepths = listener.associationQueueDepths();
+  CHECK_INT(associationQueueDepths.count(), 2);
+  CHECK_INT(queueDepthOfSender(associationQueueDepths, "SENDER1"), firstFiles.count());
+  CHECK_INT(queueDepthOfSender(associationQueueDepths, "SENDER2"), secondFiles.count());
+
+  releaseAssociations(senders);
+
+  // Terminated associations are listed while they have pending instances
+  QList<QSharedPointer<ctkDICOMJobResponseSet>> jobResponseSets = listener.takeJobResponseSets(1);
+  CHECK_INT(jobResponseSets.count(), 1);
+  CHECK_INT(listener.queueDepth(), numberOfImages - 1);
+  CHECK_INT(totalQueueDepth(listener.associationQueueDepths()), numberOfImages - 1);
+  jobResponseSets << listener.takeJobResponseSets();
+  CHECK_INT(jobResponseSets.count(), numberOfImages);
+  CHECK_INT(listener.queueDepth(), 0);
+  QElapsedTimer timer;
+  timer.start();
+  while (!listener.associationQueueDepths().isEmpty() && timer.elapsed() < 5000)
+  {
+    QThread::msleep(10);
+  }
+  CHECK_INT(listener.associationQueueDepths().count(), 0);
+  CHECK_INT(listener.receivedObjectsCount(), numberOfImages);
+
+  listener.cancel();
+  CHECK_BOOL(listener.wasCanceled(), true);
+  CHECK_BOOL(listenerThread.wait(30000), true);
+
+  ctkDICOMDatabase listenerDatabase;
+  QString listenerDatabaseFile = tempDirectory.path() + "/ctkDICOMStorageListenerTest1-listener.sql";
+  CHECK_BOOL(listenerDatabase.openDatabase(listenerDatabaseFile), true);
+  QList<ctkDICOMJobResponseSet*> jobResponseSetsToInsert;
+  foreach (QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet, jobResponseSets)
+  {
+    CHECK_BOOL(jobResponseSet->jobType() == ctkDICOMJobResponseSet::JobType::StoreSOPInstance, true);
+    jobResponseSetsToInsert.append(jobResponseSet.data());
+  }
+  listenerDatabase.insert(jobResponseSetsToInsert);
+  CHECK_INT(listenerDatabase.imagesCount(), numberOfImages);
+  listenerDatabase.closeDatabase();
+
+  // Listener job of the scheduler: the received batches are inserted in the database
+  std::cout << qPrintable(testName) << ": Receiving with the scheduler" << std::endl;
+  ctkDICOMDatabase database;
+  QString databaseFile = tempDirectory.path() + "/ctkDICOMStorageListenerTest1-scheduler.sql";
+  CHECK_BOOL(database.openDatabase(databaseFile), true);
+  ctkDICOMScheduler scheduler;
+  scheduler.setDicomDatabase(database);
+  scheduler.startListener(11121, "CTKSTORE", QThread::LowPriority, 2);
+  timer.restart();
+  while (!scheduler.isStorageListenerActive() && timer.elapsed() < 30000)
+  {
+    QCoreApplication::processEvents();
+    QThread::msleep(10);
+  }
+  CHECK_BOOL(scheduler.isStorageListenerActive(), true);
+
+  SenderThread firstSchedulerSender("SENDER1", firstFiles, 11121);
+  SenderThread secondSchedulerSender("SENDER2", secondFiles, 11121);
+  QList<SenderThread*> schedulerSenders;
+  schedulerSenders << &firstSchedulerSender << &secondSchedulerSender;
+  CHECK_BOOL(sendConcurrently(schedulerSenders), true);
+  releaseAssociations(schedulerSenders);
+
+  // The batches are queued to the thread of the scheduler, and the incomplete
+  // batches are inserted by the timer of the listener worker
+  timer.restart();
+  while (database.imagesCount() < numberOfImages && timer.elapsed() < 30000)
+  {
+    QCoreApplication::processEvents();
+    QThread::msleep(10);
+  }
+  CHECK_INT(database.imagesCount(), numberOfImages);
+  CHECK_BOOL(scheduler.isStorageListenerActive(), true);
+
+  scheduler.stopAllJobs(true);
+  scheduler.waitForFinish(true, true);
+  CHECK_INT(database.imagesCount(), numberOfImages);
+  database.closeDatabase();
+
+  return EXIT_SUCCESS;
+}
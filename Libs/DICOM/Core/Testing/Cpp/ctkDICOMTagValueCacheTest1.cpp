@@ -0,0 +1,229 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QTemporaryDir>
+#include <QThread>
+
+// ctkCore includes
+#include <ctkCoreTestingMacros.h>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMDatabaseTestHelper.h"
+#include "ctkDICOMItem.h"
+#include "ctkDICOMTagValueCache.h"
+
+// DCMTK includes
+#include <dcmtk/dcmdata/dcdeftag.h>
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+namespace
+{
+
+const int NumberOfInstances = 20;
+const char* SeriesInstanceUID = "1.2.826.0.1.3680043.2.1125.20.1.1";
+
+//------------------------------------------------------------------------------
+QString sopInstanceUID(int instanceIndex)
+{
+  return QString("%1.%2").arg(SeriesInstanceUID).arg(instanceIndex);
+}
+
+//------------------------------------------------------------------------------
+QList<ctkDICOMDatabase::IndexingResult> createIndexingResults(ctkDICOMItem& templateDataset)
+{
+  QList<ctkDICOMDatabase::IndexingResult> indexingResults;
+  for (int instanceIndex = 0; instanceIndex < NumberOfInstances; ++instanceIndex)
+  {
+    QMap<DcmTagKey, QString> attributes;
+    attributes[DCM_InstanceNumber] = QString::number(instanceIndex + 1);
+    indexingResults << ctkDICOMDatabaseTestHelper::createIndexingResult(templateDataset,
+      "1.2.826.0.1.3680043.2.1125.20.1", SeriesInstanceUID, sopInstanceUID(instanceIndex), attributes);
+  }
+  return indexingResults;
+}
+
+//------------------------------------------------------------------------------
+int testTagValueCache()
+{
+  ctkDICOMTagValueCache cache(64);
+  CHECK_INT(cache.capacity(), 64);
+
+  QString value;
+  CHECK_BOOL(cache.value("1", "0010,0010", value), false);
+  CHECK_INT(cache.missCount(), 1);
+  cache.insert("1", "0010,0010", "NAME");
+  CHECK_BOOL(cache.value("1", "0010,0010", value), true);
+  CHECK_QSTRING(value, QString("NAME"));
+  CHECK_INT(cache.hitCount(), 1);
+
+  // All values of an instance are only returned if they have been inserted as complete
+  QMap<QString, QString> values;
+  CHECK_BOOL(cache.values("1", values), false);
+  QMap<QString, QString> allValues;
+  allValues.insert("0010,0010", "NAME");
+  allValues.insert("0010,0020", "ID");
+  cache.insert("1", allValues, true);
+  CHECK_BOOL(cache.values("1", values), true);
+  CHECK_INT(values.count(), 2);
+  CHECK_QSTRING(values["0010,0020"], QString("ID"));
+  CHECK_INT(cache.count(), 2);
+
+  // Updates only apply to instances in memory
+  cache.update("1", "0010,0020", "NEW ID");
+  cache.update("2", "0010,0020", "ID2");
+  CHECK_BOOL(cache.value("1", "0010,0020", value), true);
+  CHECK_QSTRING(value, QString("NEW ID"));
+  CHECK_BOOL(cache.contains("2"), false);
+
+  // Least recently used instances are evicted, recently used ones are kept
+  for (int instanceIndex = 100; instanceIndex < 1100; ++instanceIndex)
+  {
+    CHECK_BOOL(cache.value("1", "0010,0010", value), true);
+    cache.insert(QString::number(instanceIndex), "0020,0013", QString::number(instanceIndex));
+  }
+  CHECK_BOOL(cache.count() <= cache.capacity(), true);
+  CHECK_BOOL(cache.contains("1"), true);
+  CHECK_BOOL(cache.contains("1099"), true);
+  CHECK_BOOL(cache.contains("100"), false);
+
+  cache.remove("1");
+  CHECK_BOOL(cache.contains("1"), false);
+  cache.clear();
+  CHECK_INT(cache.count(), 0);
+  cache.resetStatistics();
+  CHECK_INT(cache.hitCount(), 0);
+  CHECK_INT(cache.missCount(), 0);
+
+  // Zero capacity disables the cache
+  cache.setCapacity(0);
+  cache.insert("1", "0010,0010", "NAME");
+  CHECK_BOOL(cache.value("1", "0010,0010", value), false);
+  return EXIT_SUCCESS;
+}
+
+} // end of anonymous namespace
+
+// Checks the in-memory cache of tag values and its use by the database.
+int ctkDICOMTagValueCacheTest1( int argc, char * argv [] )
+{
+  QCoreApplication app(argc, argv);
+
+  CHECK_INT(testTagValueCache(), EXIT_SUCCESS);
+
+  if (argc < 2)
+  {
+    std::cerr << "ctkDICOMTagValueCacheTest1: missing dicom filePath argument";
+    std::cerr << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ctkDICOMItem templateDataset;
+  CHECK_BOOL(ctkDICOMDatabaseTestHelper::loadTemplateDataset(argv[1], templateDataset), true);
+
+  QTemporaryDir temporaryDirectory;
+  CHECK_BOOL(temporaryDirectory.isValid(), true);
+
+  ctkDICOMDatabase database;
+  CHECK_BOOL(database.openDatabase(temporaryDirectory.path() + "/ctkDICOM.sql"), true);
+  database.setTagsToPrecache(QStringList() << "0008,0060" << "0020,0013");
+  database.insert(createIndexingResults(templateDataset));
+  ctkDICOMTagValueCache* cache = database.tagValueCache();
+  CHECK_NOT_NULL(cache);
+  cache->clear();
+  cache->resetStatistics();
+
+  // Instance numbers of the whole series are loaded at once
+  CHECK_BOOL(database.prefetchTags(SeriesInstanceUID, QStringList() << "0020,0013" << "0028,0010"), true);
+  for (int instanceIndex = 0; instanceIndex < NumberOfInstances; ++instanceIndex)
+  {
+    CHECK_QSTRING(database.instanceValue(sopInstanceUID(instanceIndex), "0020,0013"), QString::number(instanceIndex + 1));
+  }
+  // Tags that are not in the tag cache are known to be missing
+  CHECK_QSTRING(database.cachedTag(sopInstanceUID(0), "0028,0010"), QString());
+  CHECK_INT(database.tagCacheHitCount(), NumberOfInstances + 1);
+  CHECK_INT(database.tagCacheMissCount(), 0);
+
+  // Tags that have not been prefetched are read from the tag cache table once
+  QString modality = templateDataset.GetElementAsString(DCM_Modality);
+  CHECK_QSTRING(database.cachedTag(sopInstanceUID(1), "0008,0060"), modality);
+  CHECK_QSTRING(database.cachedTag(sopInstanceUID(1), "0008,0060"), modality);
+  CHECK_INT(database.tagCacheMissCount(), 1);
+
+  // All tags of an instance
+  QMap<QString, QString> cachedTags;
+  database.getCachedTags(sopInstanceUID(2), cachedTags);
+  CHECK_QSTRING(cachedTags["0008,0060"], modality);
+  CHECK_QSTRING(cachedTags["0020,0013"], QString("3"));
+  CHECK_BOOL(cachedTags.contains("0028,0010"), false);
+  CHECK_INT(database.tagCacheMissCount(), 2);
+  database.getCachedTags(sopInstanceUID(2), cachedTags);
+  CHECK_INT(cachedTags.count(), 2);
+  CHECK_INT(database.tagCacheMissCount(), 2);
+
+  // Written and removed values are reflected in memory
+  CHECK_BOOL(database.cacheTag(sopInstanceUID(2), "0008,0060", "CT"), true);
+  CHECK_QSTRING(database.cachedTag(sopInstanceUID(2), "0008,0060"), QString("CT"));
+  database.removeCachedTags(sopInstanceUID(2));
+  CHECK_QSTRING(database.cachedTag(sopInstanceUID(2), "0008,0060"), QString());
+  CHECK_QSTRING(database.cachedTag(sopInstanceUID(3), "0008,0060"), modality);
+
+  // Prefetching all tags of the series
+  cache->clear();
+  cache->resetStatistics();
+  CHECK_BOOL(database.prefetchTags(SeriesInstanceUID), true);
+  database.getCachedTags(sopInstanceUID(4), cachedTags);
+  CHECK_INT(cachedTags.count(), 2);
+  CHECK_INT(database.tagCacheHitCount(), 1);
+  CHECK_INT(database.tagCacheMissCount(), 0);
+
+  // Values modified by another connection are read again from the tag cache table
+  // when the tags are prefetched
+  {
+    ctkDICOMDatabase otherDatabase;
+    CHECK_BOOL(otherDatabase.openDatabase(temporaryDirectory.path() + "/ctkDICOM.sql"), true);
+    CHECK_BOOL(otherDatabase.cacheTag(sopInstanceUID(4), "0008,0060", "MR"), true);
+    otherDatabase.closeDatabase();
+  }
+  CHECK_BOOL(database.prefetchTags(SeriesInstanceUID), true);
+  CHECK_QSTRING(database.cachedTag(sopInstanceUID(4), "0008,0060"), QString("MR"));
+  CHECK_INT(database.tagCacheHitCount(), 2);
+  CHECK_INT(database.tagCacheMissCount(), 0);
+
+  // or when they are read, at most once per check interval
+  {
+    ctkDICOMDatabase otherDatabase;
+    CHECK_BOOL(otherDatabase.openDatabase(temporaryDirectory.path() + "/ctkDICOM.sql"), true);
+    CHECK_BOOL(otherDatabase.cacheTag(sopInstanceUID(4), "0008,0060", "PT"), true);
+    otherDatabase.closeDatabase();
+  }
+  QThread::msleep(1100);
+  CHECK_QSTRING(database.cachedTag(sopInstanceUID(4), "0008,0060"), QString("PT"));
+  CHECK_INT(database.tagCacheMissCount(), 1);
+
+  database.closeDatabase();
+  CHECK_INT(cache->count(), 0);
+  return EXIT_SUCCESS;
+}
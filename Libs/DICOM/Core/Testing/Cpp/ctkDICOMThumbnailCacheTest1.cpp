@@ -0,0 +1,201 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QTemporaryDir>
+
+// ctkCore includes
+#include <ctkCoreTestingMacros.h>
+
+// ctkDICOMCore includes
+#include "ctkDICOMThumbnailCache.h"
+#include "ctkDICOMThumbnailGenerator.h"
+
+// STD includes
+#include <iostream>
+#include <cstdlib>
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+QImage createImage(int seed, QImage::Format format = QImage::Format_RGB888)
+{
+  QImage image(100, 75, format);
+  for (int y = 0; y < image.height(); ++y)
+  {
+    for (int x = 0; x < image.width(); ++x)
+    {
+      image.setPixelColor(x, y, QColor((x + seed) % 256, (y * seed) % 256, (x * y) % 256));
+    }
+  }
+  return image;
+}
+
+} // end of anonymous namespace
+
+int ctkDICOMThumbnailCacheTest1(int argc, char* argv[])
+{
+  QCoreApplication app(argc, argv);
+
+  if (argc < 2)
+  {
+    std::cerr << "ctkDICOMThumbnailCacheTest1: missing dicom filePath argument";
+    std::cerr << std::endl;
+    return EXIT_FAILURE;
+  }
+  QString dicomFilePath(argv[1]);
+
+  QTemporaryDir temporaryDirectory;
+  CHECK_BOOL(temporaryDirectory.isValid(), true);
+
+  const QString studyInstanceUID("1.2.3");
+  ctkDICOMThumbnailCache cache;
+  QImage thumbnail;
+
+  // Disabled when no directory is set
+  CHECK_BOOL(cache.storeThumbnail(studyInstanceUID, "1.2.3.4.1", createImage(1)), false);
+
+  cache.setDirectory(temporaryDirectory.path());
+  CHECK_BOOL(cache.thumbnail(studyInstanceUID, "1.2.3.4.1", thumbnail), false);
+  CHECK_BOOL(QFileInfo::exists(cache.containerPathForStudy(studyInstanceUID)), false);
+
+  // Store and read back
+  QImage image1 = createImage(1);
+  QImage image2 = createImage(2, QImage::Format_Grayscale8);
+  QDateTime sourceLastModified = QDateTime::currentDateTime();
+  CHECK_BOOL(cache.storeThumbnail(studyInstanceUID, "1.2.3.4.1", image1, sourceLastModified), true);
+  CHECK_BOOL(cache.storeThumbnail(studyInstanceUID, "1.2.3.4.2", image2, sourceLastModified), true);
+  CHECK_BOOL(cache.thumbnail(studyInstanceUID, "1.2.3.4.1", thumbnail), true);
+  CHECK_BOOL(thumbnail == image1, true);
+  CHECK_BOOL(cache.thumbnail(studyInstanceUID, "1.2.3.4.2", thumbnail), true);
+  CHECK_BOOL(thumbnail == image2, true);
+
+  // Up-to-date check
+  CHECK_BOOL(cache.contains(studyInstanceUID, "1.2.3.4.1"), true);
+  CHECK_BOOL(cache.contains(studyInstanceUID, "1.2.3.4.1", sourceLastModified), true);
+  CHECK_BOOL(cache.contains(studyInstanceUID, "1.2.3.4.1", sourceLastModified.addSecs(10)), false);
+
+  // Identical images are stored only once
+  qint64 containerSize = QFileInfo(cache.containerPathForStudy(studyInstanceUID)).size();
+  CHECK_BOOL(cache.storeThumbnail(studyInstanceUID, "1.2.3.4.3", image1, sourceLastModified), true);
+  qint64 indexRecordSize = QFileInfo(cache.containerPathForStudy(studyInstanceUID)).size() - containerSize;
+  CHECK_BOOL(indexRecordSize > 0 && indexRecordSize < 100, true);
+  CHECK_BOOL(cache.thumbnail(studyInstanceUID, "1.2.3.4.3", thumbnail), true);
+  CHECK_BOOL(thumbnail == image1, true);
+
+  // Other instances sharing the same directory see the new thumbnails
+  ctkDICOMThumbnailCache otherCache;
+  otherCache.setDirectory(temporaryDirectory.path());
+  otherCache.setCodec(ctkDICOMThumbnailCache::PNGCodec);
+  CHECK_BOOL(otherCache.thumbnail(studyInstanceUID, "1.2.3.4.2", thumbnail), true);
+  CHECK_BOOL(thumbnail == image2, true);
+  QImage image4 = createImage(4);
+  CHECK_BOOL(otherCache.storeThumbnail(studyInstanceUID, "1.2.3.4.4", image4), true);
+  CHECK_BOOL(cache.thumbnail(studyInstanceUID, "1.2.3.4.4", thumbnail), true);
+  CHECK_BOOL(thumbnail.convertToFormat(image4.format()) == image4, true);
+
+  // Replace a thumbnail
+  CHECK_BOOL(cache.storeThumbnail(studyInstanceUID, "1.2.3.4.2", image4), true);
+  CHECK_BOOL(cache.thumbnail(studyInstanceUID, "1.2.3.4.2", thumbnail), true);
+  CHECK_BOOL(thumbnail == image4, true);
+
+  // Remove thumbnails
+  CHECK_BOOL(cache.removeThumbnails(studyInstanceUID, QStringList() << "1.2.3.4.1"), true);
+  CHECK_BOOL(cache.thumbnail(studyInstanceUID, "1.2.3.4.1", thumbnail), false);
+  CHECK_BOOL(otherCache.thumbnail(studyInstanceUID, "1.2.3.4.1", thumbnail), false);
+  CHECK_BOOL(cache.thumbnail(studyInstanceUID, "1.2.3.4.3", thumbnail), true);
+
+  // Compaction keeps the remaining thumbnails
+  containerSize = QFileInfo(cache.containerPathForStudy(studyInstanceUID)).size();
+  CHECK_BOOL(cache.compact(studyInstanceUID), true);
+  CHECK_BOOL(QFileInfo(cache.containerPathForStudy(studyInstanceUID)).size() < containerSize, true);
+  CHECK_BOOL(cache.thumbnail(studyInstanceUID, "1.2.3.4.3", thumbnail), true);
+  CHECK_BOOL(thumbnail == image1, true);
+  // the other instance must reopen the compacted container
+  CHECK_BOOL(otherCache.thumbnail(studyInstanceUID, "1.2.3.4.2", thumbnail), true);
+  CHECK_BOOL(thumbnail == image4, true);
+
+  // An incomplete record left by an interrupted write is dropped by replacing
+  // the container, which the other instance still has mapped
+  {
+    QFile containerFile(cache.containerPathForStudy(studyInstanceUID));
+    CHECK_BOOL(containerFile.open(QIODevice::WriteOnly | QIODevice::Append), true);
+    // header of an index record of 256 bytes
+    containerFile.write(QByteArray("\x02\x00\x00\x01\x00", 5));
+  }
+  CHECK_BOOL(cache.storeThumbnail(studyInstanceUID, "1.2.3.4.5", image2), true);
+  CHECK_BOOL(cache.thumbnail(studyInstanceUID, "1.2.3.4.5", thumbnail), true);
+  CHECK_BOOL(thumbnail == image2, true);
+  CHECK_BOOL(otherCache.thumbnail(studyInstanceUID, "1.2.3.4.5", thumbnail), true);
+  CHECK_BOOL(thumbnail == image2, true);
+  CHECK_BOOL(cache.removeThumbnails(studyInstanceUID, QStringList() << "1.2.3.4.5"), true);
+
+  // Removing all the thumbnails removes the container
+  CHECK_BOOL(cache.removeThumbnails(studyInstanceUID, QStringList() << "1.2.3.4.2" << "1.2.3.4.3" << "1.2.3.4.4"), true);
+  CHECK_BOOL(QFileInfo::exists(cache.containerPathForStudy(studyInstanceUID)), false);
+  CHECK_BOOL(otherCache.thumbnail(studyInstanceUID, "1.2.3.4.2", thumbnail), false);
+
+  // Batch generation from DICOM files, the same file is decoded once
+  ctkDICOMThumbnailGenerator generator;
+  generator.setWidth(128);
+  generator.setHeight(128);
+  QList<ctkDICOMThumbnailCache::ThumbnailRequest> requests;
+  for (int index = 0; index < 10; ++index)
+  {
+    ctkDICOMThumbnailCache::ThumbnailRequest request;
+    request.SOPInstanceUID = QString("1.2.3.5.%1").arg(index);
+    request.FilePath = dicomFilePath;
+    request.Modality = "MR";
+    requests << request;
+  }
+  QElapsedTimer timer;
+  timer.start();
+  CHECK_INT(cache.generateThumbnails(studyInstanceUID, requests, &generator), requests.count());
+  std::cout << "Generated " << requests.count() << " thumbnails in " << timer.elapsed() << "ms" << std::endl;
+  CHECK_BOOL(cache.thumbnail(studyInstanceUID, "1.2.3.5.9", thumbnail), true);
+  CHECK_BOOL(thumbnail.width() <= 128 && thumbnail.height() <= 128, true);
+  CHECK_BOOL(thumbnail.width() == 128 || thumbnail.height() == 128, true);
+  // up-to-date thumbnails are not generated again
+  containerSize = QFileInfo(cache.containerPathForStudy(studyInstanceUID)).size();
+  CHECK_INT(cache.generateThumbnails(studyInstanceUID, requests, &generator), requests.count());
+  CHECK_INT(QFileInfo(cache.containerPathForStudy(studyInstanceUID)).size(), containerSize);
+
+  // Images smaller than the thumbnail are scaled up
+  ctkDICOMThumbnailGenerator largeThumbnailGenerator;
+  largeThumbnailGenerator.setWidth(1024);
+  largeThumbnailGenerator.setHeight(1024);
+  QImage largeThumbnail;
+  CHECK_BOOL(largeThumbnailGenerator.generateThumbnail(dicomFilePath, largeThumbnail), true);
+  CHECK_BOOL(largeThumbnail.width() == 1024 || largeThumbnail.height() == 1024, true);
+
+  // Remove study
+  CHECK_BOOL(cache.removeStudy(studyInstanceUID), true);
+  CHECK_BOOL(QFileInfo::exists(cache.containerPathForStudy(studyInstanceUID)), false);
+  CHECK_BOOL(cache.thumbnail(studyInstanceUID, "1.2.3.5.9", thumbnail), false);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,393 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+
+// ctkCore includes
+#include <ctkLogger.h>
+
+// ctkDICOMCore includes
+#include "ctkDICOMAssociationPool.h"
+
+// DCMTK includes
+#include <dcmtk/dcmnet/scu.h>
+
+// STD includes
+#include <climits>
+
+static ctkLogger logger("org.commontk.dicom.DICOMAssociationPool");
+
+//------------------------------------------------------------------------------
+class ctkDICOMAssociationPoolPrivate
+{
+public:
+  ctkDICOMAssociationPoolPrivate();
+
+  struct IdleAssociation
+  {
+    QString Key;
+    DcmSCU* Association;
+    QElapsedTimer IdleTimer;
+  };
+
+  /// Remove from the idle list the associations idle for longer than IdleTimeout.
+  /// Must be called with Mutex locked, the returned associations must be
+  /// deleted (with deleteAssociations()) after unlocking it.
+  QList<DcmSCU*> takeExpiredAssociations();
+
+  /// Release (or abort) and delete associations
+  static void deleteAssociations(const QList<DcmSCU*>& associations, bool abort = false);
+
+  mutable QMutex Mutex;
+  QWaitCondition SlotReleased;
+  int MaximumAssociations;
+  int IdleTimeout;
+  int HealthCheckInterval;
+  int ActiveAssociationCount;
+  int ReusedAssociationCount;
+  /// Least recently returned first
+  QList<IdleAssociation> IdleAssociations;
+};
+
+//------------------------------------------------------------------------------
+// ctkDICOMAssociationPoolPrivate methods
+
+//------------------------------------------------------------------------------
+ctkDICOMAssociationPoolPrivate::ctkDICOMAssociationPoolPrivate()
+{
+  this->MaximumAssociations = 8;
+  this->IdleTimeout = 30000;
+  this->HealthCheckInterval = 5000;
+  this->ActiveAssociationCount = 0;
+  this->ReusedAssociationCount = 0;
+}
+
+//------------------------------------------------------------------------------
+QList<DcmSCU*> ctkDICOMAssociationPoolPrivate::takeExpiredAssociations()
+{
+  QList<DcmSCU*> expiredAssociations;
+  for (int index = this->IdleAssociations.size() - 1; index >= 0; --index)
+  {
+    if (this->IdleAssociations[index].IdleTimer.elapsed() >= this->IdleTimeout)
+    {
+      expiredAssociations << this->IdleAssociations.takeAt(index).Association;
+    }
+  }
+  return expiredAssociations;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMAssociationPoolPrivate::deleteAssociations(const QList<DcmSCU*>& associations, bool abort)
+{
+  foreach (DcmSCU* association, associations)
+  {
+    if (association->isConnected())
+    {
+      if (abort)
+      {
+        association->abortAssociation();
+      }
+      else
+      {
+        association->releaseAssociation();
+      }
+    }
+    delete association;
+  }
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMAssociationPool methods
+
+//------------------------------------------------------------------------------
+ctkDICOMAssociationPool::ctkDICOMAssociationPool(QObject* parent)
+  : QObject(parent)
+  , d_ptr(new ctkDICOMAssociationPoolPrivate)
+{
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMAssociationPool::~ctkDICOMAssociationPool()
+{
+  this->clear();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMAssociationPool::setMaximumAssociations(int maximumAssociations)
+{
+  Q_D(ctkDICOMAssociationPool);
+  QList<DcmSCU*> removedAssociations;
+  {
+    QMutexLocker locker(&d->Mutex);
+    d->MaximumAssociations = qMax(1, maximumAssociations);
+    while (d->IdleAssociations.size() > d->MaximumAssociations)
+    {
+      removedAssociations << d->IdleAssociations.takeFirst().Association;
+    }
+    d->SlotReleased.wakeAll();
+  }
+  ctkDICOMAssociationPoolPrivate::deleteAssociations(removedAssociations);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMAssociationPool::maximumAssociations() const
+{
+  Q_D(const ctkDICOMAssociationPool);
+  QMutexLocker locker(&d->Mutex);
+  return d->MaximumAssociations;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMAssociationPool::setIdleTimeout(int msecs)
+{
+  Q_D(ctkDICOMAssociationPool);
+  {
+    QMutexLocker locker(&d->Mutex);
+    d->IdleTimeout = qMax(0, msecs);
+  }
+  this->purgeIdleAssociations();
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMAssociationPool::idleTimeout() const
+{
+  Q_D(const ctkDICOMAssociationPool);
+  QMutexLocker locker(&d->Mutex);
+  return d->IdleTimeout;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMAssociationPool::setHealthCheckInterval(int msecs)
+{
+  Q_D(ctkDICOMAssociationPool);
+  QMutexLocker locker(&d->Mutex);
+  d->HealthCheckInterval = msecs;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMAssociationPool::healthCheckInterval() const
+{
+  Q_D(const ctkDICOMAssociationPool);
+  QMutexLocker locker(&d->Mutex);
+  return d->HealthCheckInterval;
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMAssociationPool::associationKey(const QString& type,
+                                                const QString& callingAETitle,
+                                                const QString& calledAETitle,
+                                                const QString& host,
+                                                int port)
+{
+  return QString("%1|%2|%3|%4|%5").arg(type).arg(callingAETitle).arg(calledAETitle).arg(host).arg(port);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMAssociationPool::acquire(int msecs)
+{
+  Q_D(ctkDICOMAssociationPool);
+  QList<DcmSCU*> expiredAssociations;
+  bool acquired = false;
+  {
+    QMutexLocker locker(&d->Mutex);
+    expiredAssociations = d->takeExpiredAssociations();
+
+    QElapsedTimer timer;
+    timer.start();
+    while (d->ActiveAssociationCount >= d->MaximumAssociations)
+    {
+      unsigned long remainingTime = ULONG_MAX;
+      if (msecs >= 0)
+      {
+        qint64 remaining = msecs - timer.elapsed();
+        if (remaining <= 0)
+        {
+          break;
+        }
+        remainingTime = static_cast<unsigned long>(remaining);
+      }
+      d->SlotReleased.wait(&d->Mutex, remainingTime);
+    }
+
+    if (d->ActiveAssociationCount < d->MaximumAssociations)
+    {
+      d->ActiveAssociationCount++;
+      acquired = true;
+    }
+  }
+  ctkDICOMAssociationPoolPrivate::deleteAssociations(expiredAssociations);
+  return acquired;
+}
+
+//------------------------------------------------------------------------------
+DcmSCU* ctkDICOMAssociationPool::takeIdleAssociation(const QString& key)
+{
+  Q_D(ctkDICOMAssociationPool);
+  forever
+  {
+    DcmSCU* association = nullptr;
+    qint64 idleTime = 0;
+    int healthCheckInterval = -1;
+    QList<DcmSCU*> expiredAssociations;
+    {
+      QMutexLocker locker(&d->Mutex);
+      expiredAssociations = d->takeExpiredAssociations();
+      // Most recently returned first, it is the most likely to be still alive
+      for (int index = d->IdleAssociations.size() - 1; index >= 0; --index)
+      {
+        if (d->IdleAssociations[index].Key == key)
+        {
+          ctkDICOMAssociationPoolPrivate::IdleAssociation idleAssociation = d->IdleAssociations.takeAt(index);
+          association = idleAssociation.Association;
+          idleTime = idleAssociation.IdleTimer.elapsed();
+          break;
+        }
+      }
+      healthCheckInterval = d->HealthCheckInterval;
+    }
+    ctkDICOMAssociationPoolPrivate::deleteAssociations(expiredAssociations);
+
+    if (!association)
+    {
+      return nullptr;
+    }
+
+    if (!association->isConnected())
+    {
+      delete association;
+      continue;
+    }
+
+    // Associations without an accepted Verification presentation context
+    // can only be checked for a closed connection
+    if (healthCheckInterval >= 0 && idleTime >= healthCheckInterval
+        && association->findAnyPresentationContextID(UID_VerificationSOPClass, UID_LittleEndianImplicitTransferSyntax) != 0)
+    {
+      OFCondition status = association->sendECHORequest(0 /* any Verification presentation context */);
+      if (status.bad())
+      {
+        logger.debug(QString("Idle association failed the health check: %1").arg(status.text()));
+        ctkDICOMAssociationPoolPrivate::deleteAssociations(QList<DcmSCU*>() << association, true);
+        continue;
+      }
+    }
+
+    QMutexLocker locker(&d->Mutex);
+    d->ReusedAssociationCount++;
+    return association;
+  }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMAssociationPool::release(const QString& key, DcmSCU* association)
+{
+  Q_D(ctkDICOMAssociationPool);
+  QList<DcmSCU*> removedAssociations;
+  {
+    QMutexLocker locker(&d->Mutex);
+    if (d->ActiveAssociationCount > 0)
+    {
+      d->ActiveAssociationCount--;
+    }
+    else
+    {
+      logger.warn("release() called without a matching acquire()");
+    }
+
+    if (association)
+    {
+      if (association->isConnected() && d->IdleTimeout > 0 && !key.isEmpty())
+      {
+        ctkDICOMAssociationPoolPrivate::IdleAssociation idleAssociation;
+        idleAssociation.Key = key;
+        idleAssociation.Association = association;
+        idleAssociation.IdleTimer.start();
+        d->IdleAssociations.append(idleAssociation);
+        while (d->IdleAssociations.size() > d->MaximumAssociations)
+        {
+          removedAssociations << d->IdleAssociations.takeFirst().Association;
+        }
+      }
+      else
+      {
+        removedAssociations << association;
+      }
+    }
+    removedAssociations << d->takeExpiredAssociations();
+    d->SlotReleased.wakeOne();
+  }
+  ctkDICOMAssociationPoolPrivate::deleteAssociations(removedAssociations);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMAssociationPool::activeAssociationCount() const
+{
+  Q_D(const ctkDICOMAssociationPool);
+  QMutexLocker locker(&d->Mutex);
+  return d->ActiveAssociationCount;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMAssociationPool::idleAssociationCount() const
+{
+  Q_D(const ctkDICOMAssociationPool);
+  QMutexLocker locker(&d->Mutex);
+  return d->IdleAssociations.size();
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMAssociationPool::reusedAssociationCount() const
+{
+  Q_D(const ctkDICOMAssociationPool);
+  QMutexLocker locker(&d->Mutex);
+  return d->ReusedAssociationCount;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMAssociationPool::purgeIdleAssociations()
+{
+  Q_D(ctkDICOMAssociationPool);
+  QList<DcmSCU*> expiredAssociations;
+  {
+    QMutexLocker locker(&d->Mutex);
+    expiredAssociations = d->takeExpiredAssociations();
+  }
+  ctkDICOMAssociationPoolPrivate::deleteAssociations(expiredAssociations);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMAssociationPool::clear()
+{
+  Q_D(ctkDICOMAssociationPool);
+  QList<DcmSCU*> idleAssociations;
+  {
+    QMutexLocker locker(&d->Mutex);
+    foreach (const ctkDICOMAssociationPoolPrivate::IdleAssociation& idleAssociation, d->IdleAssociations)
+    {
+      idleAssociations << idleAssociation.Association;
+    }
+    d->IdleAssociations.clear();
+  }
+  ctkDICOMAssociationPoolPrivate::deleteAssociations(idleAssociations);
+}
@@ -0,0 +1,137 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+#ifndef __ctkDICOMAssociationPool_h
+#define __ctkDICOMAssociationPool_h
+
+// Qt includes
+#include <QObject>
+#include <QString>
+
+// ctkDICOMCore includes
+#include "ctkDICOMCoreExport.h"
+class ctkDICOMAssociationPoolPrivate;
+
+// DCMTK includes
+class DcmSCU;
+
+/// \ingroup DICOM_Core
+///
+/// \brief Negotiated DICOM associations shared by the query and retrieve
+/// operations sent to the same server.
+///
+/// Negotiating an association costs at least one network round-trip (plus the
+/// TCP connection setup), which dominates the latency of small C-FIND requests.
+/// Instead of releasing the association at the end of a request, ctkDICOMQuery
+/// and ctkDICOMRetrieve give it back to the pool and the next request to the same
+/// peer with the same kind of presentation contexts reuses it.
+///
+/// The pool also bounds the number of associations used at the same time
+/// (maximumAssociations): acquire() blocks until a slot is available.
+///
+/// Idle associations are released after idleTimeout. Associations that have been
+/// idle for more than healthCheckInterval are verified with a C-ECHO before being
+/// reused, so that associations aborted by the peer are not handed out.
+/// Expired associations are released when the pool is used (acquire() and
+/// release()) or when purgeIdleAssociations() is called.
+///
+/// A pool is shared by a ctkDICOMServer and all its clones (e.g. the copies
+/// owned by the jobs), \sa ctkDICOMServer::associationPool().
+///
+/// All methods are thread safe.
+class CTK_DICOM_CORE_EXPORT ctkDICOMAssociationPool : public QObject
+{
+  Q_OBJECT
+  Q_PROPERTY(int maximumAssociations READ maximumAssociations WRITE setMaximumAssociations);
+  Q_PROPERTY(int idleTimeout READ idleTimeout WRITE setIdleTimeout);
+  Q_PROPERTY(int healthCheckInterval READ healthCheckInterval WRITE setHealthCheckInterval);
+
+public:
+  explicit ctkDICOMAssociationPool(QObject* parent = nullptr);
+  virtual ~ctkDICOMAssociationPool();
+
+  ///@{
+  /// Maximum number of associations acquired at the same time (8 by default).
+  /// It also bounds the number of idle associations kept open.
+  void setMaximumAssociations(int maximumAssociations);
+  int maximumAssociations() const;
+  ///@}
+
+  ///@{
+  /// Time in milliseconds after which an idle association is released (30 s by default).
+  /// 0 disables the reuse of associations, but still bounds their number.
+  void setIdleTimeout(int msecs);
+  int idleTimeout() const;
+  ///@}
+
+  ///@{
+  /// Time in milliseconds after which an idle association is verified with a C-ECHO
+  /// before being reused (5 s by default). -1 disables the health check.
+  void setHealthCheckInterval(int msecs);
+  int healthCheckInterval() const;
+  ///@}
+
+  /// Identifier of the associations that can be exchanged.
+  /// \a type identifies the DcmSCU subclass and its presentation contexts.
+  static QString associationKey(const QString& type,
+                                const QString& callingAETitle,
+                                const QString& calledAETitle,
+                                const QString& host,
+                                int port);
+
+  /// Reserve one of the maximumAssociations slots, waiting up to \a msecs
+  /// milliseconds (forever if negative). Returns false on timeout.
+  /// Every successful call must be followed by a call to release().
+  bool acquire(int msecs = -1);
+
+  /// Take an idle association matching \a key, or nullptr if there is none.
+  /// Must be called by a caller that has acquired a slot.
+  /// The ownership of the association is transferred to the caller.
+  DcmSCU* takeIdleAssociation(const QString& key);
+
+  /// Give back the slot reserved by acquire().
+  /// If \a association is connected, the pool takes its ownership and keeps it
+  /// idle for later reuse, otherwise it is deleted.
+  void release(const QString& key = QString(), DcmSCU* association = nullptr);
+
+  /// Number of slots currently acquired
+  int activeAssociationCount() const;
+
+  /// Number of associations kept open for reuse
+  int idleAssociationCount() const;
+
+  /// Number of associations handed out by takeIdleAssociation()
+  int reusedAssociationCount() const;
+
+  /// Release the associations that have been idle for longer than idleTimeout
+  Q_INVOKABLE void purgeIdleAssociations();
+
+  /// Release all idle associations
+  Q_INVOKABLE void clear();
+
+protected:
+  QScopedPointer<ctkDICOMAssociationPoolPrivate> d_ptr;
+
+private:
+  Q_DECLARE_PRIVATE(ctkDICOMAssociationPool);
+  Q_DISABLE_COPY(ctkDICOMAssociationPool);
+};
+
+#endif
@@ -21,14 +21,17 @@
 // Qt includes
 #include <QDate>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
 #include <QFileSystemWatcher>
+#include <QImage>
 #include <QSet>
 #include <QSqlError>
 #include <QSqlQuery>
 #include <QSqlRecord>
 #include <QStringList>
+#include <QThread>
 #include <QUuid>
 #include <QVariant>
 
@@ -37,6 +40,7 @@
 #include "ctkDICOMAbstractThumbnailGenerator.h"
 #include "ctkDICOMItem.h"
 #include "ctkDICOMJobResponseSet.h"
+#include "ctkDICOMThumbnailGenerator.h"
 
 #include "ctkLogger.h"
 #include "ctkUtils.h"
@@ -69,6 +73,41 @@ static QString ValueIsEmptyString("__VALUE_IS_EMPTY_STRING__");
 static QString ValueIsNotStored("__VALUE_IS_NOT_STORED__");
 /// Separator character for table and field names to be used in display rules manager
 static QString TableFieldSeparator(":");
+/// Minimum time between two checks of the tag cache data version when reading cached tags (in ms)
+static const int TagCacheDataVersionCheckInterval = 1000;
+/// Time during which the hierarchy snapshot is used by the queries without checking that
+/// the database was not changed by another connection (in ms)
+static const int HierarchySnapshotCheckInterval = 1000;
+
+/// Tables of the patient/study/series hierarchy, from the top
+struct ctkDICOMDatabaseHierarchyLevel
+{
+  const char* Table;
+  const char* UIDColumn;
+  /// Join to the parent table
+  const char* ParentJoin;
+  /// Text columns indexed by the full-text search index of the table
+  const char* SearchableColumns;
+};
+static const ctkDICOMDatabaseHierarchyLevel HierarchyLevels[] = {
+  { "Patients", "UID", "",
+    "PatientsName, PatientID, DisplayedPatientsName" },
+  { "Studies", "StudyInstanceUID", "JOIN Patients ON Studies.PatientsUID = Patients.UID",
+    "StudyDescription, StudyID, AccessionNumber, ModalitiesInStudy, InstitutionName, ReferringPhysician" },
+  { "Series", "SeriesInstanceUID", "JOIN Studies ON Series.StudyInstanceUID = Studies.StudyInstanceUID",
+    "SeriesDescription, Modality, BodyPartExamined" } };
+static const int NumberOfHierarchyLevels = 3;
+
+//------------------------------------------------------------------------------
+/// Close and remove a read-only connection.
+/// The connection must not be in use by another thread.
+static void removeReadConnection(QSqlDatabase& connection)
+{
+  QString connectionName = connection.connectionName();
+  connection.close();
+  connection = QSqlDatabase();
+  QSqlDatabase::removeDatabase(connectionName);
+}
 
 //------------------------------------------------------------------------------
 // ctkDICOMDatabasePrivate methods
@@ -76,14 +115,23 @@ static QString TableFieldSeparator(":");
 //------------------------------------------------------------------------------
 ctkDICOMDatabasePrivate::ctkDICOMDatabasePrivate(ctkDICOMDatabase& o)
   : q_ptr(&o)
+  , JournalMode("WAL")
+  , MaximumReadConnections(8)
+  , ReadConnectionsCounter(0)
+  , WriteTransactionThread(nullptr)
   , DisplayedFieldsTableAvailable(false)
+  , FullTextSearchAvailable(false)
   , UseShortStoragePath(true)
   , ThumbnailGenerator(nullptr)
+  , HierarchySnapshotEnabled(false)
   , TagCacheVerified(false)
+  , TagCacheDataVersion(-1)
   , SchemaVersion("0.8.1")
 {
   this->resetLastInsertedValues();
   this->DisplayedFieldGenerator = new ctkDICOMDisplayedFieldGenerator(q_ptr);
+  this->ThumbnailCache = new ctkDICOMThumbnailCache(q_ptr);
+  this->HierarchySnapshot = new ctkDICOMHierarchySnapshot(q_ptr);
 }
 
 //------------------------------------------------------------------------------
@@ -93,6 +141,236 @@ void ctkDICOMDatabasePrivate::resetLastInsertedValues()
   this->InsertedConnectionsIDCache.clear();
   this->InsertedStudyUIDsCache.clear();
   this->InsertedSeriesUIDsCache.clear();
+  this->HierarchySnapshotCheckTimer.invalidate();
+}
+
+//------------------------------------------------------------------------------
+QSqlQuery& ctkDICOMDatabasePrivate::insertSessionQuery(const QString& statement)
+{
+  QHash<QString, QSqlQuery>::iterator queryIt = this->InsertSessionQueries.find(statement);
+  if (queryIt == this->InsertSessionQueries.end())
+  {
+    QSqlQuery query(this->Database);
+    if (!query.prepare(statement))
+    {
+      logger.error("Error preparing statement: " + statement + " Error: " + query.lastError().text());
+    }
+    queryIt = this->InsertSessionQueries.insert(statement, query);
+  }
+  return queryIt.value();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::resetInsertSession()
+{
+  this->InsertSessionQueries.clear();
+  this->resetLastInsertedValues();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::applyJournalMode(QSqlDatabase& database)
+{
+  if (this->JournalMode.isEmpty() || !database.isOpen() || database.databaseName() == ":memory:")
+  {
+    return;
+  }
+  QSqlQuery pragmaJournalModeQuery(database);
+  if (!pragmaJournalModeQuery.exec("PRAGMA journal_mode = " + this->JournalMode)
+    || !pragmaJournalModeQuery.next())
+  {
+    logger.warn("Failed to set journal mode " + this->JournalMode + " on " + database.databaseName()
+      + ": " + pragmaJournalModeQuery.lastError().text());
+  }
+  else if (pragmaJournalModeQuery.value(0).toString().compare(this->JournalMode, Qt::CaseInsensitive) != 0)
+  {
+    // SQLite keeps the current mode if the requested one is not available (e.g. WAL on some file systems)
+    logger.warn("Journal mode " + this->JournalMode + " is not available for " + database.databaseName()
+      + ", using " + pragmaJournalModeQuery.value(0).toString());
+  }
+  pragmaJournalModeQuery.finish();
+}
+
+//------------------------------------------------------------------------------
+QSqlDatabase ctkDICOMDatabasePrivate::readDatabase()
+{
+  Q_Q(ctkDICOMDatabase);
+  Qt::HANDLE threadId = QThread::currentThreadId();
+  if (this->MaximumReadConnections <= 0
+    || !this->Database.isOpen()
+    || this->DatabaseFileName == ":memory:"
+    || this->WriteTransactionThread.loadAcquire() == threadId)
+  {
+    return this->Database;
+  }
+
+  QThread* thread = QThread::currentThread();
+  QMutexLocker locker(&this->ReadConnectionsMutex);
+  QHash<QThread*, QSqlDatabase>::iterator readConnectionIt = this->ReadConnections.find(thread);
+  if (readConnectionIt != this->ReadConnections.end())
+  {
+    return readConnectionIt.value();
+  }
+
+  // Connections of finished threads have been removed when they finished
+  if (this->ReadConnections.count() >= this->MaximumReadConnections)
+  {
+    return this->Database;
+  }
+
+  // Thread IDs and QThread addresses may be reused, a counter makes the name unique
+  QString readConnectionName = QString("%1_read_%2").arg(this->Database.connectionName())
+    .arg(++this->ReadConnectionsCounter);
+  QSqlDatabase readConnection = QSqlDatabase::addDatabase("QSQLITE", readConnectionName);
+  readConnection.setConnectOptions("QSQLITE_OPEN_READONLY");
+  readConnection.setDatabaseName(this->DatabaseFileName);
+  if (!readConnection.open())
+  {
+    logger.warn("Failed to open read-only connection to " + this->DatabaseFileName + ": "
+      + readConnection.lastError().text());
+    readConnection = QSqlDatabase();
+    QSqlDatabase::removeDatabase(readConnectionName);
+    return this->Database;
+  }
+  // QThread::finished is emitted by the thread itself, once it does not query the database anymore.
+  // The connection may have been removed already by closeReadDatabases().
+  QObject::connect(thread, &QThread::finished, q, [this, thread]()
+  {
+    this->closeReadDatabase(thread);
+  }, Qt::DirectConnection);
+  this->ReadConnections.insert(thread, readConnection);
+  return readConnection;
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMHierarchySnapshot* ctkDICOMDatabasePrivate::upToDateHierarchySnapshot(bool throttled/*=false*/)
+{
+  Q_Q(ctkDICOMDatabase);
+  // Uncommitted changes of the main connection would not be in the snapshot
+  if (!this->HierarchySnapshotEnabled
+    || !this->Database.isOpen()
+    || this->DatabaseDirectory.isEmpty()
+    || QThread::currentThread() != q->thread()
+    || this->WriteTransactionThread.loadAcquire() == QThread::currentThreadId())
+  {
+    return nullptr;
+  }
+  if (throttled && this->HierarchySnapshot->isLoaded() && this->HierarchySnapshotCheckTimer.isValid()
+    && this->HierarchySnapshotCheckTimer.elapsed() < HierarchySnapshotCheckInterval)
+  {
+    return this->HierarchySnapshot;
+  }
+  QSqlDatabase readDatabase = this->readDatabase();
+  if (!this->HierarchySnapshot->isUpToDate(readDatabase)
+    && !this->HierarchySnapshot->update(readDatabase))
+  {
+    this->HierarchySnapshotCheckTimer.invalidate();
+    return nullptr;
+  }
+  this->HierarchySnapshotCheckTimer.start();
+  return this->HierarchySnapshot;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::groupedLookup(const QString& queryPattern, const QStringList& keys,
+  QMap<QString, QStringList>& valuesForKey, bool absolutePaths/*=false*/)
+{
+  // Number of bound values per query is limited by SQLite
+  const int maximumKeysPerQuery = 500;
+  QStringList uniqueKeys = keys;
+  uniqueKeys.removeDuplicates();
+  uniqueKeys.removeAll(QString());
+
+  QSqlQuery query(this->readDatabase());
+  query.setForwardOnly(true);
+  int preparedKeyCount = 0;
+  for (int startIndex = 0; startIndex < uniqueKeys.count(); startIndex += maximumKeysPerQuery)
+  {
+    QStringList chunkKeys = uniqueKeys.mid(startIndex, maximumKeysPerQuery);
+    if (chunkKeys.count() != preparedKeyCount)
+    {
+      // Only the last chunk may need a different statement
+      QStringList placeholders;
+      for (int index = 0; index < chunkKeys.count(); ++index)
+      {
+        placeholders << "?";
+      }
+      QString statement = queryPattern.arg(placeholders.join(","));
+      if (!query.prepare(statement))
+      {
+        logger.error("Error preparing statement: " + statement + " Error: " + query.lastError().text());
+        return false;
+      }
+      preparedKeyCount = chunkKeys.count();
+    }
+    for (int index = 0; index < chunkKeys.count(); ++index)
+    {
+      query.bindValue(index, chunkKeys[index]);
+    }
+    if (!this->loggedExec(query))
+    {
+      return false;
+    }
+    while (query.next())
+    {
+      QString value = query.value(1).toString();
+      if (absolutePaths)
+      {
+        value = this->absolutePathFromInternal(value);
+      }
+      valuesForKey[query.value(0).toString()] << value;
+    }
+    query.finish();
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::closeReadDatabases()
+{
+  QMutexLocker locker(&this->ReadConnectionsMutex);
+  for (QHash<QThread*, QSqlDatabase>::iterator readConnectionIt = this->ReadConnections.begin();
+    readConnectionIt != this->ReadConnections.end(); ++readConnectionIt)
+  {
+    removeReadConnection(readConnectionIt.value());
+  }
+  this->ReadConnections.clear();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::closeReadDatabase(QThread* thread)
+{
+  QMutexLocker locker(&this->ReadConnectionsMutex);
+  QHash<QThread*, QSqlDatabase>::iterator readConnectionIt = this->ReadConnections.find(thread);
+  if (readConnectionIt != this->ReadConnections.end())
+  {
+    removeReadConnection(readConnectionIt.value());
+    this->ReadConnections.erase(readConnectionIt);
+  }
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::beginWriteTransaction()
+{
+  if (!this->Database.transaction())
+  {
+    return false;
+  }
+  this->WriteTransactionThread.storeRelease(QThread::currentThreadId());
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::commitWriteTransaction()
+{
+  this->WriteTransactionThread.storeRelease(nullptr);
+  return this->Database.commit();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::rollbackWriteTransaction()
+{
+  this->WriteTransactionThread.storeRelease(nullptr);
+  return this->Database.rollback();
 }
 
 //------------------------------------------------------------------------------
@@ -320,8 +598,8 @@ ctkDICOMDatabase::InsertResult ctkDICOMDatabasePrivate::insertPatient(
   }
   patientsBirthDate = dataset.GetElementAsString(DCM_PatientBirthDate);
 
-  QSqlQuery checkPatientExistsQuery(this->Database);
-  checkPatientExistsQuery.prepare("SELECT * FROM Patients WHERE PatientID = ? AND PatientsName = ?");
+  QSqlQuery& checkPatientExistsQuery = this->insertSessionQuery(
+    "SELECT UID FROM Patients WHERE PatientID = ? AND PatientsName = ?");
   checkPatientExistsQuery.bindValue(0, tempPatientID);
   checkPatientExistsQuery.bindValue(1, tempPatientsName);
   loggedExec(checkPatientExistsQuery);
@@ -329,9 +607,13 @@ ctkDICOMDatabase::InsertResult ctkDICOMDatabasePrivate::insertPatient(
   QString compositeID = ctkDICOMDatabase::compositePatientID(tempPatientID, tempPatientsName, patientsBirthDate);
   bool patientFound = checkPatientExistsQuery.next();
   if (patientFound)
+  {
+    dbPatientID = checkPatientExistsQuery.value(0).toInt();
+  }
+  checkPatientExistsQuery.finish();
+  if (patientFound)
   {
     // patient found
-    dbPatientID = checkPatientExistsQuery.value(checkPatientExistsQuery.record().indexOf("UID")).toInt();
     logger.debug("Found patient in the database as UID: " + QString::number(dbPatientID));
     logger.debug("New patient ID cache item: " + compositeID + "->" + dbPatientID);
   }
@@ -343,8 +625,7 @@ ctkDICOMDatabase::InsertResult ctkDICOMDatabasePrivate::insertPatient(
     QString patientsAge(dataset.GetElementAsString(DCM_PatientAge));
     QString patientComments(dataset.GetElementAsString(DCM_PatientComments));
 
-    QSqlQuery insertPatientStatement(this->Database);
-    insertPatientStatement.prepare("INSERT INTO Patients "
+    QSqlQuery& insertPatientStatement = this->insertSessionQuery("INSERT INTO Patients "
       "('UID', 'PatientsName', 'PatientID', 'PatientsBirthDate', 'PatientsBirthTime', 'PatientsSex', 'PatientsAge', 'PatientsComments', "
       "'InsertTimestamp', 'DisplayedPatientsName', 'DisplayedNumberOfStudies', 'DisplayedFieldsUpdatedTimestamp', 'Connections')"
       "VALUES ( NULL, ?, ?, ?, ?, ?, ?, ?, ?, NULL, NULL, NULL, NULL)");
@@ -363,6 +644,7 @@ ctkDICOMDatabase::InsertResult ctkDICOMDatabasePrivate::insertPatient(
       return ctkDICOMDatabase::InsertResult::Failed;
     }
     dbPatientID = insertPatientStatement.lastInsertId().toInt();
+    this->updateFullTextSearchIndex(0, dbPatientID);
 
     logger.debug("New patient inserted: database item ID = " + QString().setNum(dbPatientID));
   }
@@ -446,14 +728,15 @@ ctkDICOMDatabase::InsertResult ctkDICOMDatabasePrivate::insertStudy(
   const ctkDICOMItem& dataset, const int& dbPatientID)
 {
   QString studyInstanceUID(dataset.GetElementAsString(DCM_StudyInstanceUID) );
-  QSqlQuery checkStudyExistsQuery(this->Database);
-  checkStudyExistsQuery.prepare( "SELECT * FROM Studies WHERE StudyInstanceUID = ?" );
+  QSqlQuery& checkStudyExistsQuery = this->insertSessionQuery("SELECT 1 FROM Studies WHERE StudyInstanceUID = ?");
   checkStudyExistsQuery.bindValue( 0, studyInstanceUID );
   if (!loggedExec(checkStudyExistsQuery))
   {
     return ctkDICOMDatabase::InsertResult::Failed;
   }
-  if (!checkStudyExistsQuery.next())
+  bool studyFound = checkStudyExistsQuery.next();
+  checkStudyExistsQuery.finish();
+  if (!studyFound)
   {
     logger.debug("Need to insert new study: " + studyInstanceUID);
 
@@ -467,8 +750,7 @@ ctkDICOMDatabase::InsertResult ctkDICOMDatabasePrivate::insertStudy(
     QString referringPhysician(dataset.GetElementAsString(DCM_ReferringPhysicianName) );
     QString studyDescription(dataset.GetElementAsString(DCM_StudyDescription) );
 
-    QSqlQuery insertStudyStatement(this->Database);
-    insertStudyStatement.prepare("INSERT INTO Studies "
+    QSqlQuery& insertStudyStatement = this->insertSessionQuery("INSERT INTO Studies "
       "( 'StudyInstanceUID', 'PatientsUID', 'StudyID', 'StudyDate', 'StudyTime', 'AccessionNumber', 'ModalitiesInStudy', 'InstitutionName', 'ReferringPhysician', 'PerformingPhysiciansName', "
         "'StudyDescription', 'InsertTimestamp', 'DisplayedNumberOfSeries', 'DisplayedFieldsUpdatedTimestamp' ) "
       "VALUES ( ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, NULL, NULL)");
@@ -492,6 +774,7 @@ ctkDICOMDatabase::InsertResult ctkDICOMDatabasePrivate::insertStudy(
     else
     {
       this->InsertedStudyUIDsCache.insert(studyInstanceUID);
+      this->updateFullTextSearchIndex(1, studyInstanceUID);
     }
 
     return ctkDICOMDatabase::InsertResult::Inserted;
@@ -509,15 +792,15 @@ ctkDICOMDatabase::InsertResult ctkDICOMDatabasePrivate::insertSeries(
   const ctkDICOMItem& dataset, const QString& studyInstanceUID)
 {
   QString seriesInstanceUID(dataset.GetElementAsString(DCM_SeriesInstanceUID) );
-  QSqlQuery checkSeriesExistsQuery(this->Database);
-  checkSeriesExistsQuery.prepare( "SELECT * FROM Series WHERE SeriesInstanceUID = ?" );
+  QSqlQuery& checkSeriesExistsQuery = this->insertSessionQuery("SELECT 1 FROM Series WHERE SeriesInstanceUID = ?");
   checkSeriesExistsQuery.bindValue( 0, seriesInstanceUID );
-  logger.debug("Statement: " + checkSeriesExistsQuery.lastQuery() );
   if (!loggedExec(checkSeriesExistsQuery))
   {
     return ctkDICOMDatabase::InsertResult::Failed;
   }
-  if (!checkSeriesExistsQuery.next())
+  bool seriesFound = checkSeriesExistsQuery.next();
+  checkSeriesExistsQuery.finish();
+  if (!seriesFound)
   {
     logger.debug("Need to insert new series: " + seriesInstanceUID);
 
@@ -534,8 +817,7 @@ ctkDICOMDatabase::InsertResult ctkDICOMDatabasePrivate::insertSeries(
     long echoNumber(dataset.GetElementAsInteger(DCM_EchoNumbers) );
     long temporalPosition(dataset.GetElementAsInteger(DCM_TemporalPositionIdentifier) );
 
-    QSqlQuery insertSeriesStatement(this->Database);
-    insertSeriesStatement.prepare( "INSERT INTO Series "
+    QSqlQuery& insertSeriesStatement = this->insertSessionQuery("INSERT INTO Series "
       "( 'SeriesInstanceUID', 'StudyInstanceUID', 'SeriesNumber', 'SeriesDate', 'SeriesTime', 'SeriesDescription', 'Modality', 'BodyPartExamined', "
         "'FrameOfReferenceUID', 'AcquisitionNumber', 'ContrastAgent', 'ScanningSequence', 'EchoNumber', 'TemporalPosition', 'InsertTimestamp' ) "
       "VALUES ( ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ? )" );
@@ -564,6 +846,7 @@ ctkDICOMDatabase::InsertResult ctkDICOMDatabasePrivate::insertSeries(
     else
     {
       this->InsertedSeriesUIDsCache.insert(seriesInstanceUID);
+      this->updateFullTextSearchIndex(2, seriesInstanceUID);
     }
 
     return ctkDICOMDatabase::InsertResult::Inserted;
@@ -605,25 +888,49 @@ bool ctkDICOMDatabasePrivate::openTagCacheDatabase()
   pragmaSyncQuery.exec("PRAGMA synchronous = OFF");
   pragmaSyncQuery.finish();
 
+  this->applyJournalMode(this->TagCacheDatabase);
+  this->TagCacheDataVersion = -1;
+  this->TagCacheDataVersionTimer.invalidate();
+
   return true;
 }
 
 //------------------------------------------------------------------------------
-void ctkDICOMDatabasePrivate::precacheTags(const ctkDICOMItem& dataset, const QString sopInstanceUID)
+void ctkDICOMDatabasePrivate::updatePrecachedTags()
 {
   Q_Q(ctkDICOMDatabase);
-
-  QStringList sopInstanceUIDs, tags, values;
+  this->PrecachedTags.clear();
   foreach (const QString &tag, this->TagsToPrecache)
   {
-    QString upperTag = tag.toUpper();
+    PrecachedTag precachedTag;
+    precachedTag.Tag = tag.toUpper();
     unsigned short group, element;
-    q->tagToGroupElement(upperTag, group, element);
-    DcmTagKey tagKey(group, element);
+    if (!q->tagToGroupElement(precachedTag.Tag, group, element))
+    {
+      logger.warn("Invalid tag to precache: " + tag);
+      continue;
+    }
+    precachedTag.TagKey = DcmTagKey(group, element);
+    precachedTag.ExcludedFromStorage = this->TagsToExcludeFromStorage.contains(precachedTag.Tag);
+    this->PrecachedTags << precachedTag;
+  }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::precacheTags(const ctkDICOMItem& dataset, const QString& sopInstanceUID,
+  TagCacheBatch& batch, bool headerOnly/*=false*/)
+{
+  foreach (const PrecachedTag& precachedTag, this->PrecachedTags)
+  {
+    if (headerOnly && !(precachedTag.TagKey < DCM_PixelData))
+    {
+      // not read from the file, leave it to be cached on first access
+      continue;
+    }
     QString value;
-    if (this->TagsToExcludeFromStorage.contains(upperTag))
+    if (precachedTag.ExcludedFromStorage)
     {
-      if (dataset.TagExists(tagKey))
+      if (dataset.TagExists(precachedTag.TagKey))
       {
         value = ValueIsNotStored;
       }
@@ -634,20 +941,566 @@ void ctkDICOMDatabasePrivate::precacheTags(const ctkDICOMItem& dataset, const QS
     }
     else
     {
-      value = dataset.GetAllElementValuesAsString(tagKey);
+      value = dataset.GetAllElementValuesAsString(precachedTag.TagKey);
+    }
+
+    batch.SOPInstanceUIDs << sopInstanceUID;
+    batch.Tags << precachedTag.Tag;
+    // replace empty strings with special flag string
+    batch.Values << (value.isEmpty() ? TagNotInInstance : value);
+  }
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::writeTagCacheBatch(TagCacheBatch& batch)
+{
+  Q_Q(ctkDICOMDatabase);
+  int itemCount = batch.SOPInstanceUIDs.size();
+  if (itemCount == 0)
+  {
+    return true;
+  }
+  if (!q->tagCacheExists())
+  {
+    if (!q->initializeTagCache())
+    {
+      return false;
+    }
+  }
+
+  // Insert multiple rows per statement (3 bound values per row, which must remain
+  // below the SQLite limit of 999 variables per statement).
+  const int maximumRowsPerStatement = 300;
+  QSqlQuery insertTags(this->TagCacheDatabase);
+  int preparedRowCount = 0;
+  bool success = true;
+  for (int firstRow = 0; firstRow < itemCount; firstRow += maximumRowsPerStatement)
+  {
+    int rowCount = qMin(maximumRowsPerStatement, itemCount - firstRow);
+    if (rowCount != preparedRowCount)
+    {
+      QStringList rowPlaceholders;
+      for (int row = 0; row < rowCount; ++row)
+      {
+        rowPlaceholders << "(?,?,?)";
+      }
+      insertTags.prepare("INSERT OR REPLACE INTO TagCache VALUES " + rowPlaceholders.join(","));
+      preparedRowCount = rowCount;
+    }
+    for (int row = 0; row < rowCount; ++row)
+    {
+      insertTags.bindValue(row * 3, batch.SOPInstanceUIDs[firstRow + row]);
+      insertTags.bindValue(row * 3 + 1, batch.Tags[firstRow + row]);
+      insertTags.bindValue(row * 3 + 2, batch.Values[firstRow + row]);
+    }
+    if (!this->loggedExec(insertTags))
+    {
+      success = false;
+    }
+  }
+
+  // Keep the values of the instances that are in memory up to date
+  for (int row = 0; row < itemCount; ++row)
+  {
+    this->TagValueCache.update(batch.SOPInstanceUIDs[row].toString(),
+      batch.Tags[row].toString(), batch.Values[row].toString());
+  }
+
+  batch.SOPInstanceUIDs.clear();
+  batch.Tags.clear();
+  batch.Values.clear();
+  return success;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::checkTagCacheDataVersion(bool throttled/*=false*/)
+{
+  if (!this->TagCacheDatabase.isOpen())
+  {
+    return;
+  }
+  if (throttled && this->TagCacheDataVersionTimer.isValid()
+    && this->TagCacheDataVersionTimer.elapsed() < TagCacheDataVersionCheckInterval)
+  {
+    return;
+  }
+  this->TagCacheDataVersionTimer.start();
+  // data_version only changes when another connection commits a modification of the database file
+  QSqlQuery dataVersionQuery(this->TagCacheDatabase);
+  if (!dataVersionQuery.exec("PRAGMA data_version") || !dataVersionQuery.next())
+  {
+    this->TagValueCache.clear();
+    this->TagCacheDataVersion = -1;
+    return;
+  }
+  qint64 dataVersion = dataVersionQuery.value(0).toLongLong();
+  if (dataVersion != this->TagCacheDataVersion)
+  {
+    this->TagValueCache.clear();
+    this->TagCacheDataVersion = dataVersion;
+  }
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabasePrivate::loadCachedTags(const QStringList& sopInstanceUIDs, const QStringList& tags/*=QStringList()*/)
+{
+  Q_Q(ctkDICOMDatabase);
+  if (sopInstanceUIDs.isEmpty() || this->TagValueCache.capacity() <= 0)
+  {
+    return true;
+  }
+  if (!q->tagCacheExists())
+  {
+    return false;
+  }
+  this->checkTagCacheDataVersion();
+
+  QStringList upperTags;
+  foreach (const QString& tag, tags)
+  {
+    upperTags << tag.toUpper();
+  }
+  upperTags.removeDuplicates();
+  QString tagsCondition;
+  if (!upperTags.isEmpty())
+  {
+    QStringList tagPlaceholders;
+    for (int index = 0; index < upperTags.count(); ++index)
+    {
+      tagPlaceholders << "?";
     }
+    tagsCondition = QString(" AND Tag IN (%1)").arg(tagPlaceholders.join(","));
+  }
 
-    sopInstanceUIDs << sopInstanceUID;
-    tags << upperTag;
-    values << value;
+  // Number of bound values per query is limited by SQLite
+  const int maximumValuesPerQuery = 500;
+  int maximumInstancesPerQuery = qMax(1, maximumValuesPerQuery - upperTags.count());
+  QSqlQuery selectValues(this->TagCacheDatabase);
+  selectValues.setForwardOnly(true);
+  int preparedInstanceCount = 0;
+  for (int startIndex = 0; startIndex < sopInstanceUIDs.count(); startIndex += maximumInstancesPerQuery)
+  {
+    QStringList instances = sopInstanceUIDs.mid(startIndex, maximumInstancesPerQuery);
+    if (instances.count() != preparedInstanceCount)
+    {
+      QStringList placeholders;
+      for (int index = 0; index < instances.count(); ++index)
+      {
+        placeholders << "?";
+      }
+      selectValues.prepare(QString("SELECT SOPInstanceUID, Tag, Value FROM TagCache WHERE SOPInstanceUID IN (%1)")
+        .arg(placeholders.join(",")) + tagsCondition);
+      preparedInstanceCount = instances.count();
+    }
+    int bindIndex = 0;
+    foreach (const QString& sopInstanceUID, instances)
+    {
+      selectValues.bindValue(bindIndex++, sopInstanceUID);
+    }
+    foreach (const QString& tag, upperTags)
+    {
+      selectValues.bindValue(bindIndex++, tag);
+    }
+    if (!this->loggedExec(selectValues))
+    {
+      return false;
+    }
+
+    QHash<QString, QMap<QString, QString> > valuesForInstance;
+    if (!upperTags.isEmpty())
+    {
+      // requested tags that are not in the table are stored as missing (empty value)
+      QMap<QString, QString> missingValues;
+      foreach (const QString& tag, upperTags)
+      {
+        missingValues.insert(tag, QString(""));
+      }
+      foreach (const QString& sopInstanceUID, instances)
+      {
+        valuesForInstance.insert(sopInstanceUID, missingValues);
+      }
+    }
+    while (selectValues.next())
+    {
+      QString value = selectValues.value(2).toString();
+      valuesForInstance[selectValues.value(0).toString()].insert(
+        selectValues.value(1).toString().toUpper(), value.isEmpty() ? ValueIsEmptyString : value);
+    }
+    selectValues.finish();
+
+    for (QHash<QString, QMap<QString, QString> >::const_iterator instanceIt = valuesForInstance.constBegin();
+      instanceIt != valuesForInstance.constEnd(); ++instanceIt)
+    {
+      this->TagValueCache.insert(instanceIt.key(), instanceIt.value(), upperTags.isEmpty());
+    }
   }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::createDisplayedFieldsUpdateIndex()
+{
+  // Created here (and not in the schema) so that existing databases get it without requiring a schema update.
+  // Failure is not an error (e.g., the database is read-only), it just makes updateDisplayedFields slower.
+  QSqlQuery createIndexQuery(this->Database);
+  createIndexQuery.exec("CREATE INDEX IF NOT EXISTS 'ImagesDisplayedFieldsNotUpdatedIndex' ON 'Images' ('SOPInstanceUID', 'SeriesInstanceUID') "
+    "WHERE DisplayedFieldsUpdatedTimestamp IS NULL");
+  createIndexQuery.finish();
+}
 
-  q->cacheTags(sopInstanceUIDs, tags, values);
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::createWatchedDirectoriesTable()
+{
+  QSqlQuery createTableQuery(this->Database);
+  createTableQuery.exec("CREATE TABLE IF NOT EXISTS 'WatchedDirectories' ( "
+    "'Dirname' VARCHAR(1024) NOT NULL, 'IncludeHidden' INT NULL DEFAULT 1, "
+    "'ScanCursor' VARCHAR(20) NULL, PRIMARY KEY ('Dirname') )");
+  createTableQuery.finish();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::createHierarchyChangeCounters(bool tablesRecreated)
+{
+  // Failure is not an error (e.g., the database is read-only), the hierarchy snapshot is then not used.
+  QSqlQuery createCountersQuery(this->Database);
+  createCountersQuery.exec("CREATE TABLE IF NOT EXISTS 'HierarchyChanges' ( "
+    "'ChangeCount' INTEGER NOT NULL, 'RemovalCount' INTEGER NOT NULL )");
+  createCountersQuery.exec("INSERT INTO HierarchyChanges (ChangeCount, RemovalCount) "
+    "SELECT 0, 0 WHERE NOT EXISTS (SELECT 1 FROM HierarchyChanges)");
+  for (int level = 0; level < NumberOfHierarchyLevels; ++level)
+  {
+    QString table = HierarchyLevels[level].Table;
+    createCountersQuery.exec(QString("CREATE TRIGGER IF NOT EXISTS %1HierarchyInsert AFTER INSERT ON %1 "
+      "BEGIN UPDATE HierarchyChanges SET ChangeCount = ChangeCount + 1; END").arg(table));
+    createCountersQuery.exec(QString("CREATE TRIGGER IF NOT EXISTS %1HierarchyUpdate AFTER UPDATE ON %1 "
+      "BEGIN UPDATE HierarchyChanges SET ChangeCount = ChangeCount + 1; END").arg(table));
+    createCountersQuery.exec(QString("CREATE TRIGGER IF NOT EXISTS %1HierarchyDelete AFTER DELETE ON %1 "
+      "BEGIN UPDATE HierarchyChanges SET ChangeCount = ChangeCount + 1, RemovalCount = RemovalCount + 1; END").arg(table));
+  }
+  if (tablesRecreated)
+  {
+    createCountersQuery.exec("UPDATE HierarchyChanges SET ChangeCount = ChangeCount + 1, RemovalCount = RemovalCount + 1");
+  }
+  createCountersQuery.finish();
+}
+
+//------------------------------------------------------------------------------
+QStringList ctkDICOMDatabasePrivate::filteredUIDs(int level, const QMap<QString, QVariant>& filters)
+{
+  QStringList result;
+  if (level < 0 || level >= NumberOfHierarchyLevels)
+  {
+    return result;
+  }
+
+  QSqlDatabase database = this->readDatabase();
+  QList<QStringList> fieldNames;
+  for (int tableLevel = 0; tableLevel < NumberOfHierarchyLevels; ++tableLevel)
+  {
+    QStringList tableFieldNames;
+    QSqlQuery fieldNamesQuery(database);
+    fieldNamesQuery.prepare(QString("SELECT name FROM PRAGMA_TABLE_INFO('%1')").arg(HierarchyLevels[tableLevel].Table));
+    if (!this->loggedExec(fieldNamesQuery))
+    {
+      return result;
+    }
+    while (fieldNamesQuery.next())
+    {
+      tableFieldNames << fieldNamesQuery.value(0).toString();
+    }
+    fieldNames << tableFieldNames;
+  }
+
+  QStringList conditions;
+  QVariantList bindValues;
+  int topFilteredLevel = level;
+  for (QMap<QString, QVariant>::const_iterator filter = filters.constBegin(); filter != filters.constEnd(); ++filter)
+  {
+    const QString& field = filter.key();
+    const QVariant& value = filter.value();
+
+    // Look for the column in the table of the level first, then in its parents
+    int fieldLevel = level;
+    while (fieldLevel >= 0 && !fieldNames[fieldLevel].contains(field))
+    {
+      --fieldLevel;
+    }
+    if (fieldLevel < 0)
+    {
+      bool childField = false;
+      for (int childLevel = level + 1; childLevel < NumberOfHierarchyLevels; ++childLevel)
+      {
+        childField = childField || fieldNames[childLevel].contains(field);
+      }
+      if (!childField)
+      {
+        logger.error(QString("Unknown filter field: %1").arg(field));
+        return result;
+      }
+      // Filters on the children do not restrict this level
+      continue;
+    }
+
+    const char* table = HierarchyLevels[fieldLevel].Table;
+    QString column = QString("%1.%2").arg(table).arg(field);
+    if (value.userType() == QMetaType::QStringList)
+    {
+      QStringList values = value.toStringList();
+      if (values.isEmpty())
+      {
+        return result;
+      }
+      QStringList placeholders;
+      foreach (const QString& listValue, values)
+      {
+        placeholders << "?";
+        bindValues << listValue;
+      }
+      conditions << QString("%1 IN (%2)").arg(column).arg(placeholders.join(", "));
+    }
+    else if (value.userType() == QMetaType::Int)
+    {
+      int numberOfDays = value.toInt();
+      if (numberOfDays < 0)
+      {
+        continue;
+      }
+      // Dates are stored either as DICOM dates (yyyyMMdd) or ISO dates (yyyy-MM-dd)
+      QDate endDate = QDate::currentDate();
+      QDate startDate = endDate.addDays(-numberOfDays);
+      conditions << QString("REPLACE(%1, '-', '') BETWEEN ? AND ?").arg(column);
+      bindValues << startDate.toString("yyyyMMdd") << endDate.toString("yyyyMMdd");
+    }
+    else
+    {
+      QString text = value.toString();
+      if (text.isEmpty())
+      {
+        continue;
+      }
+      // The search index selects the candidates, LIKE keeps the same matching as without the index
+      QString searchExpression = ctkDICOMDatabase::fullTextSearchExpression(text);
+      if (this->FullTextSearchAvailable && !searchExpression.isEmpty()
+          && this->searchableColumns(fieldLevel).contains(field))
+      {
+        conditions << QString("%1.rowid IN (SELECT rowid FROM %1SearchIndex WHERE %1SearchIndex MATCH ?)").arg(table);
+        bindValues << QString("%1 : %2").arg(field).arg(searchExpression);
+      }
+      conditions << QString("%1 LIKE ? ESCAPE '\\'").arg(column);
+      bindValues << ctkDICOMDatabasePrivate::likePattern(text);
+    }
+    topFilteredLevel = qMin(topFilteredLevel, fieldLevel);
+  }
+
+  QString queryString = QString("SELECT %1.%2 FROM %1").arg(HierarchyLevels[level].Table).arg(HierarchyLevels[level].UIDColumn);
+  for (int joinedLevel = level; joinedLevel > topFilteredLevel; --joinedLevel)
+  {
+    queryString += QString(" %1").arg(HierarchyLevels[joinedLevel].ParentJoin);
+  }
+  if (!conditions.isEmpty())
+  {
+    queryString += " WHERE " + conditions.join(" AND ");
+  }
+
+  QSqlQuery query(database);
+  query.prepare(queryString);
+  foreach (const QVariant& bindValue, bindValues)
+  {
+    query.addBindValue(bindValue);
+  }
+  if (!this->loggedExec(query))
+  {
+    return result;
+  }
+  while (query.next())
+  {
+    result << query.value(0).toString();
+  }
+  return result;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::createFullTextSearchIndexes(bool rebuild)
+{
+  // Failure is not an error (e.g., the SQLite library has no trigram tokenizer or the database is read-only),
+  // searches then scan the tables.
+  this->FullTextSearchAvailable = false;
+  QStringList tables = this->Database.tables();
+  bool created = false;
+  for (int level = 0; level < NumberOfHierarchyLevels; ++level)
+  {
+    QString indexName = QString("%1SearchIndex").arg(HierarchyLevels[level].Table);
+    if (!tables.contains(indexName))
+    {
+      QSqlQuery createIndexQuery(this->Database);
+      if (!createIndexQuery.exec(QString("CREATE VIRTUAL TABLE IF NOT EXISTS %1 USING fts5(%2, tokenize='trigram')")
+        .arg(indexName).arg(HierarchyLevels[level].SearchableColumns)))
+      {
+        logger.debug("Full-text search is not available: " + createIndexQuery.lastError().text());
+        return;
+      }
+      created = true;
+    }
+    // The index may have been created by another application, with a SQLite library that supports it
+    QSqlQuery checkIndexQuery(this->Database);
+    if (!checkIndexQuery.exec(QString("SELECT rowid FROM %1 WHERE %1 MATCH '\"ctk\"' LIMIT 0").arg(indexName)))
+    {
+      logger.debug("Full-text search is not available: " + checkIndexQuery.lastError().text());
+      return;
+    }
+  }
+  this->FullTextSearchAvailable = true;
+
+  if (created || rebuild)
+  {
+    this->rebuildFullTextSearchIndexes();
+  }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::rebuildFullTextSearchIndexes()
+{
+  if (!this->FullTextSearchAvailable)
+  {
+    return;
+  }
+  for (int level = 0; level < NumberOfHierarchyLevels; ++level)
+  {
+    const ctkDICOMDatabaseHierarchyLevel& hierarchyLevel = HierarchyLevels[level];
+    QSqlQuery rebuildQuery(this->Database);
+    this->loggedExec(rebuildQuery, QString("DELETE FROM %1SearchIndex").arg(hierarchyLevel.Table));
+    this->loggedExec(rebuildQuery, QString("INSERT INTO %1SearchIndex (rowid, %2) SELECT rowid, %2 FROM %1")
+      .arg(hierarchyLevel.Table).arg(hierarchyLevel.SearchableColumns));
+  }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::removeOrphanedFullTextSearchEntries()
+{
+  if (!this->FullTextSearchAvailable)
+  {
+    return;
+  }
+  for (int level = 0; level < NumberOfHierarchyLevels; ++level)
+  {
+    QSqlQuery removeEntriesQuery(this->Database);
+    this->loggedExec(removeEntriesQuery, QString("DELETE FROM %1SearchIndex WHERE rowid NOT IN (SELECT rowid FROM %1)")
+      .arg(HierarchyLevels[level].Table));
+  }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabasePrivate::updateFullTextSearchIndex(int level, const QVariant& uid)
+{
+  if (!this->FullTextSearchAvailable)
+  {
+    return;
+  }
+  const ctkDICOMDatabaseHierarchyLevel& hierarchyLevel = HierarchyLevels[level];
+
+  // The entry may be outdated, or left by a removed row that had the same rowid
+  QSqlQuery& deleteEntryQuery = this->insertSessionQuery(
+    QString("DELETE FROM %1SearchIndex WHERE rowid = (SELECT rowid FROM %1 WHERE %2 = ?)")
+    .arg(hierarchyLevel.Table).arg(hierarchyLevel.UIDColumn));
+  deleteEntryQuery.bindValue(0, uid);
+  this->loggedExec(deleteEntryQuery);
+
+  QSqlQuery& insertEntryQuery = this->insertSessionQuery(
+    QString("INSERT INTO %1SearchIndex (rowid, %3) SELECT rowid, %3 FROM %1 WHERE %2 = ?")
+    .arg(hierarchyLevel.Table).arg(hierarchyLevel.UIDColumn).arg(hierarchyLevel.SearchableColumns));
+  insertEntryQuery.bindValue(0, uid);
+  this->loggedExec(insertEntryQuery);
+}
+
+//------------------------------------------------------------------------------
+QStringList ctkDICOMDatabasePrivate::searchableColumns(int level) const
+{
+  return ctkDICOMDatabase::fullTextSearchColumns(HierarchyLevels[level].Table);
+}
+
+//------------------------------------------------------------------------------
+QStringList ctkDICOMDatabasePrivate::search(int level, const QString& text, int limit)
+{
+  QStringList result;
+  if (level < 0 || level >= NumberOfHierarchyLevels)
+  {
+    return result;
+  }
+  const ctkDICOMDatabaseHierarchyLevel& hierarchyLevel = HierarchyLevels[level];
+
+  QSqlQuery query(this->readDatabase());
+  QString searchExpression = ctkDICOMDatabase::fullTextSearchExpression(text);
+  if (this->FullTextSearchAvailable && !searchExpression.isEmpty())
+  {
+    // Entries of removed rows are discarded by the join
+    query.prepare(QString("SELECT %1.%2 FROM %1SearchIndex JOIN %1 ON %1.rowid = %1SearchIndex.rowid "
+      "WHERE %1SearchIndex MATCH ? LIMIT ?").arg(hierarchyLevel.Table).arg(hierarchyLevel.UIDColumn));
+    query.addBindValue(searchExpression);
+  }
+  else if (text.isEmpty())
+  {
+    query.prepare(QString("SELECT %1 FROM %2 LIMIT ?").arg(hierarchyLevel.UIDColumn).arg(hierarchyLevel.Table));
+  }
+  else
+  {
+    // Texts shorter than a trigram cannot be searched with the index
+    QStringList conditions;
+    foreach (const QString& column, this->searchableColumns(level))
+    {
+      conditions << QString("%1 LIKE ? ESCAPE '\\'").arg(column);
+    }
+    query.prepare(QString("SELECT %1 FROM %2 WHERE %3 LIMIT ?")
+      .arg(hierarchyLevel.UIDColumn).arg(hierarchyLevel.Table).arg(conditions.join(" OR ")));
+    QString pattern = ctkDICOMDatabasePrivate::likePattern(text);
+    for (int index = 0; index < conditions.size(); ++index)
+    {
+      query.addBindValue(pattern);
+    }
+  }
+  query.addBindValue(limit < 0 ? -1 : limit);
+  if (!this->loggedExec(query))
+  {
+    return result;
+  }
+  while (query.next())
+  {
+    result << query.value(0).toString();
+  }
+  return result;
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMDatabasePrivate::likePattern(const QString& text)
+{
+  QString escapedText = text;
+  escapedText.replace("\\", "\\\\").replace("%", "\\%").replace("_", "\\_");
+  return QString("%" + escapedText + "%");
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMDatabasePrivate::internalDirectoryPrefix(const QString& directoryPath)
+{
+  QString prefix = this->internalPathFromAbsolute(QDir::cleanPath(directoryPath));
+  if (!prefix.endsWith('/'))
+  {
+    prefix += '/';
+  }
+  return prefix;
 }
 
 //------------------------------------------------------------------------------
 bool ctkDICOMDatabasePrivate::removeImage(const QString& sopInstanceUID)
 {
+  this->HierarchySnapshotCheckTimer.invalidate();
+  // Stored image count of the series is not valid anymore (it is updated incrementally).
+  // The timestamp is updated so that the hierarchy snapshot reads the series again.
+  QSqlQuery invalidateSeriesCount(Database);
+  invalidateSeriesCount.prepare("UPDATE Series SET DisplayedCount = NULL, "
+    "DisplayedFieldsUpdatedTimestamp = CURRENT_TIMESTAMP WHERE SeriesInstanceUID IN "
+    "(SELECT SeriesInstanceUID FROM Images WHERE SOPInstanceUID == :sopInstanceUID)");
+  invalidateSeriesCount.bindValue(":sopInstanceUID", sopInstanceUID);
+  this->loggedExec(invalidateSeriesCount);
+
   QSqlQuery deleteFile(Database);
   deleteFile.prepare("DELETE FROM Images WHERE SOPInstanceUID == :sopInstanceUID");
   deleteFile.bindValue(":sopInstanceUID", sopInstanceUID);
@@ -701,8 +1554,27 @@ bool ctkDICOMDatabasePrivate::storeDatasetFile(const ctkDICOMItem& dataset, cons
     return false;
   }
 
-  storedFilePath = q->databaseDirectory() + "/dicom/"
-    + this->internalStoragePath(studyInstanceUID, seriesInstanceUID, sopInstanceUID) + ".dcm";
+  if (!originalFilePath.isEmpty()
+    && QFileInfo(originalFilePath).absoluteFilePath().startsWith(q->databaseDirectory() + "/dicom/"))
+  {
+    // The file is already in the database folder (e.g., streamed there by ctkDICOMRetrieve)
+    storedFilePath = originalFilePath;
+    if (!originalFilePath.endsWith(".part"))
+    {
+      return true;
+    }
+    // Staged file: replace the file of the previously indexed instance
+    storedFilePath.chop(5);
+    QFile::remove(storedFilePath);
+    if (!QFile::rename(originalFilePath, storedFilePath))
+    {
+      logger.error("Error moving file from: " + originalFilePath + " to: " + storedFilePath);
+      return false;
+    }
+    return true;
+  }
+
+  storedFilePath = q->storagePathForInstance(studyInstanceUID, seriesInstanceUID, sopInstanceUID);
 
   QDir destinationDir(QFileInfo(storedFilePath).dir());
   if (!destinationDir.exists())
@@ -738,8 +1610,8 @@ bool ctkDICOMDatabasePrivate::indexingStatusForFile(const QString& filePath, con
   datasetUpToDate = false;
   databaseFilename.clear();
 
-  QSqlQuery fileExistsQuery(Database);
-  fileExistsQuery.prepare("SELECT InsertTimestamp,Filename FROM Images WHERE SOPInstanceUID == :sopInstanceUID");
+  QSqlQuery& fileExistsQuery = this->insertSessionQuery(
+    "SELECT InsertTimestamp,Filename FROM Images WHERE SOPInstanceUID == :sopInstanceUID");
   fileExistsQuery.bindValue(":sopInstanceUID", sopInstanceUID);
   bool success = fileExistsQuery.exec();
   if (!success)
@@ -751,6 +1623,7 @@ bool ctkDICOMDatabasePrivate::indexingStatusForFile(const QString& filePath, con
   if (!foundSOPInstanceUID)
   {
     // this data set is not in the database yet
+    fileExistsQuery.finish();
     return true;
   }
 
@@ -759,13 +1632,15 @@ bool ctkDICOMDatabasePrivate::indexingStatusForFile(const QString& filePath, con
   // The SOP instance UID exists in the database. In theory, new SOP instance UID must be generated if
   // a file is modified, but some software may not respect this, so check if the file was modified.
   databaseFilename = fileExistsQuery.value(1).toString();
+  QString databaseInsertTimestampString = fileExistsQuery.value(0).toString();
+  fileExistsQuery.finish();
   QFileInfo databaseFileInfo(databaseFilename);
   if (!databaseFileInfo.isRelative())
   {
     // database stores a link to an external file, if it is the same filename and the file has not changed
     // since insertion date then it means that the dataset is up-to-date
     QDateTime fileLastModified(databaseFileInfo.lastModified());
-    QDateTime databaseInsertTimestamp(QDateTime::fromString(fileExistsQuery.value(0).toString(), Qt::ISODate));
+    QDateTime databaseInsertTimestamp(QDateTime::fromString(databaseInsertTimestampString, Qt::ISODate));
     // Compare QFileInfo objects instead of path strings to ensure equivalent file names
     // (such as same file name in uppercase/lowercase on Windows) are considered as equal.
     if (databaseFileInfo == QFileInfo(filePath) && fileLastModified < databaseInsertTimestamp)
@@ -784,6 +1659,7 @@ ctkDICOMDatabase::InsertResult ctkDICOMDatabasePrivate::insertPatientStudySeries
 {
   Q_Q(ctkDICOMDatabase);
   bool databaseWasChanged = false;
+  this->HierarchySnapshotCheckTimer.invalidate();
 
   // Insert new patient if needed
   // Generate composite patient ID
@@ -982,14 +1858,14 @@ void ctkDICOMDatabasePrivate::insert(const ctkDICOMItem& dataset, const QString&
     if (!storeFile)
     {
       // file is linked, maybe it is already inserted
-      QSqlQuery checkImageExistsQuery(Database);
-      checkImageExistsQuery.prepare("SELECT * FROM Images WHERE SOPInstanceUID = ?");
-      checkImageExistsQuery.addBindValue(sopInstanceUID);
+      QSqlQuery& checkImageExistsQuery = this->insertSessionQuery("SELECT 1 FROM Images WHERE SOPInstanceUID = ?");
+      checkImageExistsQuery.bindValue(0, sopInstanceUID);
       if (!loggedExec(checkImageExistsQuery))
       {
         return;
       }
       alreadyInserted = checkImageExistsQuery.next();
+      checkImageExistsQuery.finish();
     }
     if (!alreadyInserted)
     {
@@ -1006,8 +1882,8 @@ void ctkDICOMDatabasePrivate::insert(const ctkDICOMItem& dataset, const QString&
         storedFilePathInDatabase = storedFilePath;
       }
 
-      QSqlQuery insertImageStatement(Database);
-      insertImageStatement.prepare("INSERT INTO Images ( 'SOPInstanceUID', 'Filename', 'URL', 'SeriesInstanceUID', 'InsertTimestamp' ) VALUES ( ?, ?, ?, ?, ? )");
+      QSqlQuery& insertImageStatement = this->insertSessionQuery(
+        "INSERT INTO Images ( 'SOPInstanceUID', 'Filename', 'URL', 'SeriesInstanceUID', 'InsertTimestamp' ) VALUES ( ?, ?, ?, ?, ? )");
       insertImageStatement.addBindValue(sopInstanceUID);
       insertImageStatement.addBindValue(storedFilePathInDatabase);
       insertImageStatement.addBindValue(QString(""));
@@ -1023,7 +1899,11 @@ void ctkDICOMDatabasePrivate::insert(const ctkDICOMItem& dataset, const QString&
       else
       {
         // insert was needed, so cache any application-requested tags
-        this->precacheTags(dataset, sopInstanceUID);
+        TagCacheBatch tagCacheBatch;
+        this->precacheTags(dataset, sopInstanceUID, tagCacheBatch);
+        this->TagCacheDatabase.transaction();
+        this->writeTagCacheBatch(tagCacheBatch);
+        this->TagCacheDatabase.commit();
       }
 
       // let users of this class track when things happen
@@ -1033,7 +1913,7 @@ void ctkDICOMDatabasePrivate::insert(const ctkDICOMItem& dataset, const QString&
     }
     if (generateThumbnail)
     {
-      q->storeThumbnailFile(storedFilePath, studyInstanceUID, seriesInstanceUID, sopInstanceUID);
+      q->storeThumbnail(storedFilePath, studyInstanceUID, seriesInstanceUID, sopInstanceUID);
     }
   }
   if (q->isInMemory() && insertOperationResult == ctkDICOMDatabase::InsertResult::Inserted)
@@ -1089,12 +1969,9 @@ QString ctkDICOMDatabasePrivate::getDisplayPatientFieldsKey(const QString& patie
 QString ctkDICOMDatabasePrivate::getDisplayStudyFieldsKey(QString studyInstanceUID, QMap<QString, QMap<QString, QString> > &displayedFieldsMapStudy)
 {
   // Look for the study in the displayed fields cache first
-  foreach (QString currentStudyInstanceUid, displayedFieldsMapStudy.keys())
+  if (displayedFieldsMapStudy.contains(studyInstanceUID))
   {
-    if ( !displayedFieldsMapStudy[currentStudyInstanceUid]["StudyInstanceUID"].compare(studyInstanceUID) )
-    {
-      return studyInstanceUID;
-    }
+    return studyInstanceUID;
   }
 
   // Look for the study in the display database
@@ -1130,12 +2007,9 @@ QString ctkDICOMDatabasePrivate::getDisplayStudyFieldsKey(QString studyInstanceU
 QString ctkDICOMDatabasePrivate::getDisplaySeriesFieldsKey(QString seriesInstanceUID, QMap<QString, QMap<QString, QString> > &displayedFieldsMapSeries)
 {
   // Look for the series in the displayed fields cache first
-  foreach (QString currentSeriesInstanceUid, displayedFieldsMapSeries.keys())
+  if (displayedFieldsMapSeries.contains(seriesInstanceUID))
   {
-    if ( !displayedFieldsMapSeries[currentSeriesInstanceUid]["SeriesInstanceUID"].compare(seriesInstanceUID) )
-    {
-      return seriesInstanceUID;
-    }
+    return seriesInstanceUID;
   }
 
   // Look for the series in the display database
@@ -1172,6 +2046,7 @@ bool ctkDICOMDatabasePrivate::applyDisplayedFieldsChanges( QMap<QString, QMap<QS
                                                            QMap<QString, QMap<QString, QString> > &displayedFieldsMapStudy,
                                                            QMap<QString, QMap<QString, QString> > &displayedFieldsMapPatient)
 {
+  this->HierarchySnapshotCheckTimer.invalidate();
   QMap<QString, int> patientCompositeIdToPatientUidMap;
 
   // Update patient fields
@@ -1229,6 +2104,7 @@ bool ctkDICOMDatabasePrivate::applyDisplayedFieldsChanges( QMap<QString, QMap<QS
       }
       updateDisplayPatientStatement.addBindValue(patientUID);
       this->loggedExec(updateDisplayPatientStatement);
+      this->updateFullTextSearchIndex(0, patientUID);
 
       QSqlQuery updateDisplayedFieldsUpdatedTimestampStatement(this->Database);
       updateDisplayedFieldsUpdatedTimestampStatement.prepare("UPDATE Patients SET DisplayedFieldsUpdatedTimestamp=CURRENT_TIMESTAMP WHERE UID = ? ;");
@@ -1288,6 +2164,7 @@ bool ctkDICOMDatabasePrivate::applyDisplayedFieldsChanges( QMap<QString, QMap<QS
       }
       updateDisplayStudyStatement.addBindValue(currentStudy["StudyInstanceUID"]);
       this->loggedExec(updateDisplayStudyStatement);
+      this->updateFullTextSearchIndex(1, currentStudy["StudyInstanceUID"]);
 
       QSqlQuery updateDisplayedFieldsUpdatedTimestampStatement(this->Database);
       updateDisplayedFieldsUpdatedTimestampStatement.prepare("UPDATE Studies SET DisplayedFieldsUpdatedTimestamp=CURRENT_TIMESTAMP WHERE StudyInstanceUID = ? ;");
@@ -1338,6 +2215,7 @@ bool ctkDICOMDatabasePrivate::applyDisplayedFieldsChanges( QMap<QString, QMap<QS
       }
       updateDisplaySeriesStatement.addBindValue(currentSeries["SeriesInstanceUID"]);
       this->loggedExec(updateDisplaySeriesStatement);
+      this->updateFullTextSearchIndex(2, currentSeries["SeriesInstanceUID"]);
 
       QSqlQuery updateDisplayedFieldsUpdatedTimestampStatement(this->Database);
       updateDisplayedFieldsUpdatedTimestampStatement.prepare("UPDATE Series SET DisplayedFieldsUpdatedTimestamp=CURRENT_TIMESTAMP WHERE SeriesInstanceUID = ? ;");
@@ -1463,6 +2341,9 @@ bool ctkDICOMDatabase::openDatabase(const QString& databaseFile,
     }
     d->DatabaseDirectory = QFileInfo(databaseFileAbsolute).absoluteDir().path();
   }
+  d->ThumbnailCache->setDirectory(d->DatabaseDirectory.isEmpty() ? QString() : d->DatabaseDirectory + "/thumbs");
+  d->HierarchySnapshot->close();
+  d->HierarchySnapshot->setFilePath(d->DatabaseDirectory.isEmpty() ? QString() : d->DatabaseDirectory + "/ctkDICOMHierarchy.snapshot");
 
   QString verifiedConnectionName = connectionName;
   if (verifiedConnectionName.isEmpty())
@@ -1470,6 +2351,10 @@ bool ctkDICOMDatabase::openDatabase(const QString& databaseFile,
     verifiedConnectionName = QUuid::createUuid().toString();
   }
 
+  // Prepared statements and read-only connections belong to the previous connection
+  d->resetInsertSession();
+  d->closeReadDatabases();
+
   if (QSqlDatabase::contains(verifiedConnectionName))
   {
     QSqlDatabase::removeDatabase(verifiedConnectionName);
@@ -1492,6 +2377,9 @@ bool ctkDICOMDatabase::openDatabase(const QString& databaseFile,
   pragmaSyncQuery.exec("PRAGMA synchronous = OFF");
   pragmaSyncQuery.finish();
 
+  // Let readers access the database while an insert transaction is in progress
+  d->applyJournalMode(d->Database);
+
   if ( d->Database.tables().empty() )
   {
     if (!this->initializeDatabase())
@@ -1506,6 +2394,11 @@ bool ctkDICOMDatabase::openDatabase(const QString& databaseFile,
   }
   d->resetLastInsertedValues();
 
+  d->createDisplayedFieldsUpdateIndex();
+  d->createWatchedDirectoriesTable();
+  d->createHierarchyChangeCounters();
+  d->createFullTextSearchIndexes();
+
   d->DisplayedFieldsTableAvailable = d->Database.tables().contains("ColumnDisplayProperties");
 
   if (!isInMemory())
@@ -1518,57 +2411,146 @@ bool ctkDICOMDatabase::openDatabase(const QString& databaseFile,
   QFileInfo fileInfo(d->DatabaseFileName);
   d->TagCacheDatabaseFilename = QString( fileInfo.dir().path() + "/ctkDICOMTagCache.sql" );
   d->TagCacheVerified = false;
+  d->TagValueCache.clear();
   if ( !this->tagCacheExists() )
   {
-    this->initializeTagCache();
+    this->initializeTagCache();
+  }
+
+  // Add displayed field generator's required tags to the pre-cached list to make
+  // displayed field updates fast.
+  QStringList tags = this->tagsToPrecache();
+  d->DisplayedFieldGenerator->setDatabase(this);
+  tags << d->DisplayedFieldGenerator->getRequiredTags();
+  tags.removeDuplicates();
+  this->setTagsToPrecache(tags);
+
+  emit opened();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+const QString ctkDICOMDatabase::lastError() const {
+  Q_D(const ctkDICOMDatabase);
+  return d->LastError;
+}
+
+//------------------------------------------------------------------------------
+const QString ctkDICOMDatabase::databaseFilename() const {
+  Q_D(const ctkDICOMDatabase);
+  return d->DatabaseFileName;
+}
+
+//------------------------------------------------------------------------------
+const QString ctkDICOMDatabase::databaseDirectory() const {
+  Q_D(const ctkDICOMDatabase);
+  return d->DatabaseDirectory;
+}
+
+//------------------------------------------------------------------------------
+const QSqlDatabase& ctkDICOMDatabase::database() const {
+  Q_D(const ctkDICOMDatabase);
+  return d->Database;
+}
+
+//------------------------------------------------------------------------------
+QSqlDatabase ctkDICOMDatabase::readOnlyDatabase()
+{
+  Q_D(ctkDICOMDatabase);
+  return d->readDatabase();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::setJournalMode(const QString& mode)
+{
+  Q_D(ctkDICOMDatabase);
+  static const QStringList journalModes = QStringList()
+    << "DELETE" << "TRUNCATE" << "PERSIST" << "MEMORY" << "WAL" << "OFF";
+  QString upperMode = mode.toUpper();
+  if (!journalModes.contains(upperMode))
+  {
+    logger.error("Invalid journal mode: " + mode);
+    return;
+  }
+  if (d->JournalMode == upperMode)
+  {
+    return;
   }
+  d->JournalMode = upperMode;
+  // Read-only connections cannot change the journal mode and would prevent the change
+  // (connections of other threads are closed when these threads use the database again)
+  d->closeReadDatabases();
+  d->applyJournalMode(d->Database);
+  d->applyJournalMode(d->TagCacheDatabase);
+}
 
-  // Add displayed field generator's required tags to the pre-cached list to make
-  // displayed field updates fast.
-  QStringList tags = this->tagsToPrecache();
-  d->DisplayedFieldGenerator->setDatabase(this);
-  tags << d->DisplayedFieldGenerator->getRequiredTags();
-  tags.removeDuplicates();
-  this->setTagsToPrecache(tags);
+//------------------------------------------------------------------------------
+QString ctkDICOMDatabase::journalMode() const
+{
+  Q_D(const ctkDICOMDatabase);
+  return d->JournalMode;
+}
 
-  emit opened();
-  return true;
+//------------------------------------------------------------------------------
+void ctkDICOMDatabase::setMaximumReadConnections(int maximum)
+{
+  Q_D(ctkDICOMDatabase);
+  d->MaximumReadConnections = maximum;
+  if (maximum <= 0)
+  {
+    d->closeReadDatabases();
+  }
 }
 
 //------------------------------------------------------------------------------
-const QString ctkDICOMDatabase::lastError() const {
+int ctkDICOMDatabase::maximumReadConnections() const
+{
   Q_D(const ctkDICOMDatabase);
-  return d->LastError;
+  return d->MaximumReadConnections;
 }
 
 //------------------------------------------------------------------------------
-const QString ctkDICOMDatabase::databaseFilename() const {
-  Q_D(const ctkDICOMDatabase);
-  return d->DatabaseFileName;
+void ctkDICOMDatabase::setThumbnailGenerator(ctkDICOMAbstractThumbnailGenerator *generator){
+  Q_D(ctkDICOMDatabase);
+  d->ThumbnailGenerator = generator;
 }
 
 //------------------------------------------------------------------------------
-const QString ctkDICOMDatabase::databaseDirectory() const {
+ctkDICOMAbstractThumbnailGenerator* ctkDICOMDatabase::thumbnailGenerator(){
   Q_D(const ctkDICOMDatabase);
-  return d->DatabaseDirectory;
+  return d->ThumbnailGenerator;
 }
 
 //------------------------------------------------------------------------------
-const QSqlDatabase& ctkDICOMDatabase::database() const {
+ctkDICOMThumbnailCache* ctkDICOMDatabase::thumbnailCache() const
+{
   Q_D(const ctkDICOMDatabase);
-  return d->Database;
+  return d->ThumbnailCache;
 }
 
 //------------------------------------------------------------------------------
-void ctkDICOMDatabase::setThumbnailGenerator(ctkDICOMAbstractThumbnailGenerator *generator){
+void ctkDICOMDatabase::setHierarchySnapshotEnabled(bool enabled)
+{
   Q_D(ctkDICOMDatabase);
-  d->ThumbnailGenerator = generator;
+  d->HierarchySnapshotEnabled = enabled;
+  if (!enabled)
+  {
+    d->HierarchySnapshot->close();
+  }
 }
 
 //------------------------------------------------------------------------------
-ctkDICOMAbstractThumbnailGenerator* ctkDICOMDatabase::thumbnailGenerator(){
+bool ctkDICOMDatabase::isHierarchySnapshotEnabled() const
+{
   Q_D(const ctkDICOMDatabase);
-  return d->ThumbnailGenerator;
+  return d->HierarchySnapshotEnabled;
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMHierarchySnapshot* ctkDICOMDatabase::hierarchySnapshot()
+{
+  Q_D(ctkDICOMDatabase);
+  return d->upToDateHierarchySnapshot();
 }
 
 //------------------------------------------------------------------------------
@@ -1583,6 +2565,10 @@ bool ctkDICOMDatabase::initializeDatabase(const char* sqlFileName/* = ":/dicom/d
   QSqlQuery dropSchemaInfo(d->Database);
   d->loggedExec( dropSchemaInfo, QString("DROP TABLE IF EXISTS 'SchemaInfo';") );
   const bool r = d->executeScript(sqlFileName);
+  d->createDisplayedFieldsUpdateIndex();
+  // The tables have been re-created
+  d->createFullTextSearchIndexes(true);
+  d->createHierarchyChangeCounters(true);
   emit databaseChanged();
   return r;
 }
@@ -1719,8 +2705,13 @@ void ctkDICOMDatabase::closeDatabase()
 {
   Q_D(ctkDICOMDatabase);
   bool wasOpen = this->isOpen();
+  d->resetInsertSession();
+  d->closeReadDatabases();
+  d->ThumbnailCache->close();
   d->Database.close();
   d->TagCacheDatabase.close();
+  d->TagValueCache.clear();
+  d->HierarchySnapshot->close();
   if (wasOpen)
   {
     emit closed();
@@ -1735,8 +2726,13 @@ void ctkDICOMDatabase::closeDatabase()
 QStringList ctkDICOMDatabase::patients()
 {
   Q_D(ctkDICOMDatabase);
+  ctkDICOMHierarchySnapshot* hierarchySnapshot = d->upToDateHierarchySnapshot(true);
+  if (hierarchySnapshot)
+  {
+    return hierarchySnapshot->uids(ctkDICOMHierarchySnapshot::PatientLevel);
+  }
   QStringList result;
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT UID FROM Patients" );
   if (!d->loggedExec(query))
   {
@@ -1753,8 +2749,13 @@ QStringList ctkDICOMDatabase::patients()
 QStringList ctkDICOMDatabase::studiesForPatient(QString dbPatientID)
 {
   Q_D(ctkDICOMDatabase);
+  ctkDICOMHierarchySnapshot* hierarchySnapshot = d->upToDateHierarchySnapshot(true);
+  if (hierarchySnapshot)
+  {
+    return hierarchySnapshot->childUIDs(ctkDICOMHierarchySnapshot::PatientLevel, dbPatientID);
+  }
   QStringList result;
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT StudyInstanceUID FROM Studies WHERE PatientsUID = ?" );
   query.addBindValue( dbPatientID );
   if (!d->loggedExec(query))
@@ -1773,7 +2774,7 @@ QString ctkDICOMDatabase::studyForSeries(QString seriesUID)
 {
   Q_D(ctkDICOMDatabase);
   QString result;
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT StudyInstanceUID FROM Series WHERE SeriesInstanceUID= ?" );
   query.addBindValue( seriesUID );
   if (!d->loggedExec(query))
@@ -1792,7 +2793,7 @@ QString ctkDICOMDatabase::patientForStudy(QString studyUID)
 {
   Q_D(ctkDICOMDatabase);
   QString result;
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT PatientsUID FROM Studies WHERE StudyInstanceUID= ?" );
   query.addBindValue( studyUID );
   if (!d->loggedExec(query))
@@ -1816,7 +2817,7 @@ QHash<QString,QString> ctkDICOMDatabase::descriptionsForFile(QString fileName)
   QString patientID(this->patientForStudy(studyUID));
 
   QHash<QString,QString> result;
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT SeriesDescription FROM Series WHERE SeriesInstanceUID= ?" );
   query.addBindValue( seriesUID );
   if (!d->loggedExec(query))
@@ -1856,7 +2857,7 @@ QString ctkDICOMDatabase::descriptionForSeries(const QString seriesUID)
   Q_D(ctkDICOMDatabase);
 
   QString result;
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT SeriesDescription FROM Series WHERE SeriesInstanceUID= ?" );
   query.addBindValue( seriesUID );
   if (!d->loggedExec(query))
@@ -1876,7 +2877,7 @@ QString ctkDICOMDatabase::descriptionForStudy(const QString studyUID)
   Q_D(ctkDICOMDatabase);
 
   QString result;
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT StudyDescription FROM Studies WHERE StudyInstanceUID= ?" );
   query.addBindValue( studyUID );
   if (!d->loggedExec(query))
@@ -1896,7 +2897,7 @@ QString ctkDICOMDatabase::nameForPatient(const QString patientUID)
   Q_D(ctkDICOMDatabase);
 
   QString result;
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT PatientsName FROM Patients WHERE UID= ?" );
   query.addBindValue( patientUID );
   if (!d->loggedExec(query))
@@ -1918,7 +2919,7 @@ QMap<QString, QStringList> ctkDICOMDatabase::connectionsInformationForPatient(co
   QString result;
   QMap<QString, QStringList> connectionsInformation;
 
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare("SELECT Connections FROM Patients WHERE UID= ?");
   query.addBindValue(patientUID);
   if (!d->loggedExec(query))
@@ -1958,7 +2959,7 @@ QString ctkDICOMDatabase::displayedNameForPatient(const QString patientUID)
 
   QString result;
 
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT DisplayedPatientsName FROM Patients WHERE UID= ?" );
   query.addBindValue( patientUID );
   if (!d->loggedExec(query))
@@ -1977,8 +2978,14 @@ QString ctkDICOMDatabase::displayedNameForPatient(const QString patientUID)
 QDateTime ctkDICOMDatabase::insertDateTimeForPatient(const QString patientUID)
 {
   Q_D(ctkDICOMDatabase);
+  ctkDICOMHierarchySnapshot* hierarchySnapshot = d->upToDateHierarchySnapshot(true);
+  if (hierarchySnapshot)
+  {
+    return QDateTime::fromString(hierarchySnapshot->valueForUID(
+      ctkDICOMHierarchySnapshot::PatientLevel, patientUID, "InsertTimestamp"), Qt::ISODate);
+  }
   QDateTime result;
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare("SELECT InsertTimestamp FROM Patients WHERE UID=?");
   query.addBindValue(patientUID);
   if (!d->loggedExec(query))
@@ -1996,8 +3003,14 @@ QDateTime ctkDICOMDatabase::insertDateTimeForPatient(const QString patientUID)
 QDateTime ctkDICOMDatabase::insertDateTimeForStudy(const QString studyInstanceUID)
 {
   Q_D(ctkDICOMDatabase);
+  ctkDICOMHierarchySnapshot* hierarchySnapshot = d->upToDateHierarchySnapshot(true);
+  if (hierarchySnapshot)
+  {
+    return QDateTime::fromString(hierarchySnapshot->valueForUID(
+      ctkDICOMHierarchySnapshot::StudyLevel, studyInstanceUID, "InsertTimestamp"), Qt::ISODate);
+  }
   QDateTime result;
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare("SELECT InsertTimestamp FROM Studies WHERE StudyInstanceUID=?");
   query.addBindValue(studyInstanceUID);
   if (!d->loggedExec(query))
@@ -2015,8 +3028,14 @@ QDateTime ctkDICOMDatabase::insertDateTimeForStudy(const QString studyInstanceUI
 QDateTime ctkDICOMDatabase::insertDateTimeForSeries(const QString seriesInstanceUID)
 {
   Q_D(ctkDICOMDatabase);
+  ctkDICOMHierarchySnapshot* hierarchySnapshot = d->upToDateHierarchySnapshot(true);
+  if (hierarchySnapshot)
+  {
+    return QDateTime::fromString(hierarchySnapshot->valueForUID(
+      ctkDICOMHierarchySnapshot::SeriesLevel, seriesInstanceUID, "InsertTimestamp"), Qt::ISODate);
+  }
   QDateTime result;
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare("SELECT InsertTimestamp FROM Series WHERE SeriesInstanceUID=?");
   query.addBindValue(seriesInstanceUID);
   if (!d->loggedExec(query))
@@ -2034,10 +3053,15 @@ QDateTime ctkDICOMDatabase::insertDateTimeForSeries(const QString seriesInstance
 QString ctkDICOMDatabase::fieldForPatient(const QString field, const QString patientUID)
 {
   Q_D(ctkDICOMDatabase);
+  ctkDICOMHierarchySnapshot* hierarchySnapshot = d->upToDateHierarchySnapshot(true);
+  if (hierarchySnapshot && ctkDICOMHierarchySnapshot::fields(ctkDICOMHierarchySnapshot::PatientLevel).contains(field))
+  {
+    return hierarchySnapshot->valueForUID(ctkDICOMHierarchySnapshot::PatientLevel, patientUID, field);
+  }
 
   QString result;
 
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   QString queryStr = QString("SELECT %1 FROM Patients WHERE UID= ?" ).arg(field);
   query.prepare(queryStr);
   query.addBindValue( patientUID );
@@ -2057,10 +3081,15 @@ QString ctkDICOMDatabase::fieldForPatient(const QString field, const QString pat
 QString ctkDICOMDatabase::fieldForStudy(const QString field, const QString studyInstanceUID)
 {
   Q_D(ctkDICOMDatabase);
+  ctkDICOMHierarchySnapshot* hierarchySnapshot = d->upToDateHierarchySnapshot(true);
+  if (hierarchySnapshot && ctkDICOMHierarchySnapshot::fields(ctkDICOMHierarchySnapshot::StudyLevel).contains(field))
+  {
+    return hierarchySnapshot->valueForUID(ctkDICOMHierarchySnapshot::StudyLevel, studyInstanceUID, field);
+  }
 
   QString result;
 
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   QString queryStr = QString("SELECT %1 FROM Studies WHERE StudyInstanceUID= ?" ).arg(field);
   query.prepare(queryStr);
   query.addBindValue( studyInstanceUID );
@@ -2080,10 +3109,15 @@ QString ctkDICOMDatabase::fieldForStudy(const QString field, const QString study
 QString ctkDICOMDatabase::fieldForSeries(const QString field, const QString seriesInstanceUID)
 {
   Q_D(ctkDICOMDatabase);
+  ctkDICOMHierarchySnapshot* hierarchySnapshot = d->upToDateHierarchySnapshot(true);
+  if (hierarchySnapshot && ctkDICOMHierarchySnapshot::fields(ctkDICOMHierarchySnapshot::SeriesLevel).contains(field))
+  {
+    return hierarchySnapshot->valueForUID(ctkDICOMHierarchySnapshot::SeriesLevel, seriesInstanceUID, field);
+  }
 
   QString result;
 
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   QString queryStr = QString("SELECT %1 FROM Series WHERE SeriesInstanceUID= ?" ).arg(field);
   query.prepare(queryStr);
   query.addBindValue( seriesInstanceUID );
@@ -2099,6 +3133,77 @@ QString ctkDICOMDatabase::fieldForSeries(const QString field, const QString seri
   return result;
 }
 
+//------------------------------------------------------------------------------
+QStringList ctkDICOMDatabase::filteredPatients(const QMap<QString, QVariant>& filters)
+{
+  Q_D(ctkDICOMDatabase);
+  return d->filteredUIDs(0, filters);
+}
+
+//------------------------------------------------------------------------------
+QStringList ctkDICOMDatabase::filteredStudies(const QMap<QString, QVariant>& filters)
+{
+  Q_D(ctkDICOMDatabase);
+  return d->filteredUIDs(1, filters);
+}
+
+//------------------------------------------------------------------------------
+QStringList ctkDICOMDatabase::filteredSeries(const QMap<QString, QVariant>& filters)
+{
+  Q_D(ctkDICOMDatabase);
+  return d->filteredUIDs(2, filters);
+}
+
+//------------------------------------------------------------------------------
+QStringList ctkDICOMDatabase::searchPatients(const QString& text, int limit)
+{
+  Q_D(ctkDICOMDatabase);
+  return d->search(0, text, limit);
+}
+
+//------------------------------------------------------------------------------
+QStringList ctkDICOMDatabase::searchStudies(const QString& text, int limit)
+{
+  Q_D(ctkDICOMDatabase);
+  return d->search(1, text, limit);
+}
+
+//------------------------------------------------------------------------------
+QStringList ctkDICOMDatabase::searchSeries(const QString& text, int limit)
+{
+  Q_D(ctkDICOMDatabase);
+  return d->search(2, text, limit);
+}
+
+//------------------------------------------------------------------------------
+CTK_GET_CPP(ctkDICOMDatabase, bool, isFullTextSearchAvailable, FullTextSearchAvailable);
+
+//------------------------------------------------------------------------------
+QString ctkDICOMDatabase::fullTextSearchExpression(const QString& text)
+{
+  // The trigram tokenizer only matches substrings of at least 3 characters
+  if (text.length() < 3)
+  {
+    return QString();
+  }
+  QString phrase = text;
+  phrase.replace("\"", "\"\"");
+  return QString("\"%1\"").arg(phrase);
+}
+
+//------------------------------------------------------------------------------
+QStringList ctkDICOMDatabase::fullTextSearchColumns(const QString& tableName)
+{
+  for (int level = 0; level < NumberOfHierarchyLevels; ++level)
+  {
+    if (tableName == HierarchyLevels[level].Table)
+    {
+      return QString(HierarchyLevels[level].SearchableColumns).split(", ");
+    }
+  }
+  return QStringList();
+}
+
 //------------------------------------------------------------------------------
 QStringList ctkDICOMDatabase::patientFieldNames() const
 {
@@ -2160,9 +3265,14 @@ QStringList ctkDICOMDatabase::seriesFieldNames() const
 QStringList ctkDICOMDatabase::seriesForStudy(QString studyUID)
 {
   Q_D(ctkDICOMDatabase);
+  ctkDICOMHierarchySnapshot* hierarchySnapshot = d->upToDateHierarchySnapshot(true);
+  if (hierarchySnapshot)
+  {
+    return hierarchySnapshot->childUIDs(ctkDICOMHierarchySnapshot::StudyLevel, studyUID);
+  }
 
   QStringList result;
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT SeriesInstanceUID FROM Series WHERE StudyInstanceUID=?");
   query.addBindValue( studyUID );
   if (!d->loggedExec(query))
@@ -2182,7 +3292,7 @@ QStringList ctkDICOMDatabase::instancesForSeries(const QString seriesUID, int hi
   Q_D(ctkDICOMDatabase);
 
   QStringList result;
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare("SELECT SOPInstanceUID FROM Images WHERE SeriesInstanceUID= ?");
   query.addBindValue(seriesUID);
   if (!d->loggedExec(query))
@@ -2207,7 +3317,7 @@ QStringList ctkDICOMDatabase::filesForSeries(QString seriesUID, int hits/*=-1*/)
   Q_D(ctkDICOMDatabase);
 
   QStringList allFileNames;
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare("SELECT Filename FROM Images WHERE SeriesInstanceUID=?");
   query.addBindValue(seriesUID);
   if (!d->loggedExec(query))
@@ -2234,7 +3344,7 @@ QStringList ctkDICOMDatabase::urlsForSeries(QString seriesUID, int hits/*=-1*/)
   Q_D(ctkDICOMDatabase);
 
   QStringList allURLs;
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare("SELECT URL FROM Images WHERE SeriesInstanceUID=?");
   query.addBindValue(seriesUID);
   if (!d->loggedExec(query))
@@ -2254,13 +3364,95 @@ QStringList ctkDICOMDatabase::urlsForSeries(QString seriesUID, int hits/*=-1*/)
   return allURLs;
 }
 
+//------------------------------------------------------------------------------
+QMap<QString, QStringList> ctkDICOMDatabase::studiesForPatients(const QStringList& patientUIDs)
+{
+  Q_D(ctkDICOMDatabase);
+  QMap<QString, QStringList> result;
+  ctkDICOMHierarchySnapshot* hierarchySnapshot = d->upToDateHierarchySnapshot(true);
+  if (hierarchySnapshot)
+  {
+    foreach (const QString& patientUID, patientUIDs)
+    {
+      QStringList studyUIDs = hierarchySnapshot->childUIDs(ctkDICOMHierarchySnapshot::PatientLevel, patientUID);
+      if (!studyUIDs.isEmpty())
+      {
+        result[patientUID] = studyUIDs;
+      }
+    }
+    return result;
+  }
+  d->groupedLookup("SELECT PatientsUID, StudyInstanceUID FROM Studies WHERE PatientsUID IN (%1)",
+    patientUIDs, result);
+  return result;
+}
+
+//------------------------------------------------------------------------------
+QMap<QString, QStringList> ctkDICOMDatabase::seriesForStudies(const QStringList& studyUIDs)
+{
+  Q_D(ctkDICOMDatabase);
+  QMap<QString, QStringList> result;
+  ctkDICOMHierarchySnapshot* hierarchySnapshot = d->upToDateHierarchySnapshot(true);
+  if (hierarchySnapshot)
+  {
+    foreach (const QString& studyUID, studyUIDs)
+    {
+      QStringList seriesUIDs = hierarchySnapshot->childUIDs(ctkDICOMHierarchySnapshot::StudyLevel, studyUID);
+      if (!seriesUIDs.isEmpty())
+      {
+        result[studyUID] = seriesUIDs;
+      }
+    }
+    return result;
+  }
+  d->groupedLookup("SELECT StudyInstanceUID, SeriesInstanceUID FROM Series WHERE StudyInstanceUID IN (%1)",
+    studyUIDs, result);
+  return result;
+}
+
+//------------------------------------------------------------------------------
+QMap<QString, QStringList> ctkDICOMDatabase::instancesForMultipleSeries(const QStringList& seriesUIDs)
+{
+  Q_D(ctkDICOMDatabase);
+  QMap<QString, QStringList> result;
+  d->groupedLookup("SELECT SeriesInstanceUID, SOPInstanceUID FROM Images WHERE SeriesInstanceUID IN (%1)",
+    seriesUIDs, result);
+  return result;
+}
+
+//------------------------------------------------------------------------------
+QMap<QString, QStringList> ctkDICOMDatabase::filesForMultipleSeries(const QStringList& seriesUIDs)
+{
+  Q_D(ctkDICOMDatabase);
+  QMap<QString, QStringList> result;
+  d->groupedLookup("SELECT SeriesInstanceUID, Filename FROM Images WHERE SeriesInstanceUID IN (%1)",
+    seriesUIDs, result, true);
+  return result;
+}
+
+//------------------------------------------------------------------------------
+QMap<QString, QString> ctkDICOMDatabase::filesForInstances(const QStringList& sopInstanceUIDs)
+{
+  Q_D(ctkDICOMDatabase);
+  QMap<QString, QStringList> filesForInstance;
+  d->groupedLookup("SELECT SOPInstanceUID, Filename FROM Images WHERE SOPInstanceUID IN (%1)",
+    sopInstanceUIDs, filesForInstance, true);
+  QMap<QString, QString> result;
+  for (QMap<QString, QStringList>::const_iterator it = filesForInstance.constBegin();
+    it != filesForInstance.constEnd(); ++it)
+  {
+    result[it.key()] = it.value().first();
+  }
+  return result;
+}
+
 //------------------------------------------------------------------------------
 QString ctkDICOMDatabase::fileForInstance(QString sopInstanceUID)
 {
   Q_D(ctkDICOMDatabase);
 
   QString result;
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare("SELECT Filename FROM Images WHERE SOPInstanceUID=?");
   query.addBindValue(sopInstanceUID);
   if (!d->loggedExec(query))
@@ -2280,7 +3472,7 @@ QString ctkDICOMDatabase::urlForInstance(QString sopInstanceUID)
   Q_D(ctkDICOMDatabase);
 
   QString result;
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare("SELECT URL FROM Images WHERE SOPInstanceUID=?");
   query.addBindValue(sopInstanceUID);
   if (!d->loggedExec(query))
@@ -2300,7 +3492,7 @@ QString ctkDICOMDatabase::seriesForFile(QString fileName)
   Q_D(ctkDICOMDatabase);
 
   QString result;
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT SeriesInstanceUID FROM Images WHERE Filename=?");
   query.addBindValue(d->internalPathFromAbsolute(fileName));
   if (!d->loggedExec(query))
@@ -2319,7 +3511,7 @@ QString ctkDICOMDatabase::instanceForFile(QString fileName)
 {
   Q_D(ctkDICOMDatabase);
   QString result;
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT SOPInstanceUID FROM Images WHERE Filename=?");
   query.addBindValue(d->internalPathFromAbsolute(fileName));
   if (!d->loggedExec(query))
@@ -2339,7 +3531,7 @@ QString ctkDICOMDatabase::instanceForURL(QString url)
   Q_D(ctkDICOMDatabase);
 
   QString result;
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare( "SELECT SOPInstanceUID FROM Images WHERE URL=?");
   query.addBindValue(url);
   if (!d->loggedExec(query))
@@ -2358,7 +3550,7 @@ QDateTime ctkDICOMDatabase::insertDateTimeForInstance(QString sopInstanceUID)
 {
   Q_D(ctkDICOMDatabase);
   QDateTime result;
-  QSqlQuery query(d->Database);
+  QSqlQuery query(d->readDatabase());
   query.prepare("SELECT InsertTimestamp FROM Images WHERE SOPInstanceUID=?");
   query.addBindValue(sopInstanceUID);
   if (!d->loggedExec(query))
@@ -2372,6 +3564,51 @@ QDateTime ctkDICOMDatabase::insertDateTimeForInstance(QString sopInstanceUID)
   return result;
 }
 
+//------------------------------------------------------------------------------
+QString ctkDICOMDatabase::storagePathForInstance(const QString& studyInstanceUID,
+                                                 const QString& seriesInstanceUID,
+                                                 const QString& sopInstanceUID)
+{
+  Q_D(ctkDICOMDatabase);
+  return this->databaseDirectory() + "/dicom/"
+    + d->internalStoragePath(studyInstanceUID, seriesInstanceUID, sopInstanceUID) + ".dcm";
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::storeInstanceFile(DcmDataset* dataset, const QString& studyInstanceUID,
+                                         const QString& seriesInstanceUID, const QString& sopInstanceUID,
+                                         QString& storedFilePath)
+{
+  if (!dataset || sopInstanceUID.isEmpty() || studyInstanceUID.isEmpty() || seriesInstanceUID.isEmpty())
+  {
+    logger.error("Cannot store instance: Study, Series or SOP Instance UID empty.");
+    return false;
+  }
+
+  // The instance may already be indexed: it is only moved to its storage path when inserted
+  storedFilePath = this->storagePathForInstance(studyInstanceUID, seriesInstanceUID, sopInstanceUID) + ".part";
+  QDir().mkpath(QFileInfo(storedFilePath).absolutePath());
+  ctkDICOMItem instance;
+  instance.InitializeFromItem(dataset, false);
+  if (!instance.SaveToFile(storedFilePath))
+  {
+    logger.error(QString("Cannot store instance %1 to %2").arg(sopInstanceUID).arg(storedFilePath));
+    QFile::remove(storedFilePath);
+    return false;
+  }
+
+  for (unsigned long elementIndex = dataset->card(); elementIndex > 0; --elementIndex)
+  {
+    DcmElement* element = dataset->getElement(elementIndex - 1);
+    if (!element || element->getTag() < DCM_PixelData)
+    {
+      break;
+    }
+    delete dataset->remove(elementIndex - 1);
+  }
+  return true;
+}
+
 //------------------------------------------------------------------------------
 QString ctkDICOMDatabase::thumbnailPathForInstance(const QString &studyInstanceUID,
                                                    const QString &seriesInstanceUID,
@@ -2433,9 +3670,138 @@ bool ctkDICOMDatabase::storeThumbnailFile(const QString &originalFilePath,
   }
   else
   {
-    DicomImage dcmImage(QDir::toNativeSeparators(originalFilePath).toUtf8().data());
-    return d->ThumbnailGenerator->generateThumbnail(&dcmImage, thumbnailPath, backgroundColor);
+    // Only the first frame is needed for the thumbnail
+    DicomImage dcmImage(QDir::toNativeSeparators(originalFilePath).toUtf8().data(), CIF_UsePartialAccessToPixelData, 0, 1);
+    return d->ThumbnailGenerator->generateThumbnail(&dcmImage, thumbnailPath, backgroundColor);
+  }
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::thumbnailForInstance(const QString& studyInstanceUID,
+                                            const QString& seriesInstanceUID,
+                                            const QString& sopInstanceUID,
+                                            QImage& image)
+{
+  Q_D(ctkDICOMDatabase);
+  if (d->ThumbnailCache->thumbnail(studyInstanceUID, sopInstanceUID, image))
+  {
+    return true;
+  }
+  QString thumbnailPath = this->thumbnailPathForInstance(studyInstanceUID, seriesInstanceUID, sopInstanceUID);
+  if (thumbnailPath.isEmpty())
+  {
+    return false;
+  }
+  return image.load(thumbnailPath);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::storeThumbnail(const QString& originalFilePath,
+                                      const QString& studyInstanceUID,
+                                      const QString& seriesInstanceUID,
+                                      const QString& sopInstanceUID,
+                                      const QString& modality,
+                                      QColor backgroundColor)
+{
+  Q_D(ctkDICOMDatabase);
+  ctkDICOMThumbnailGenerator* generator = qobject_cast<ctkDICOMThumbnailGenerator*>(d->ThumbnailGenerator);
+  if (!generator || d->ThumbnailCache->directory().isEmpty())
+  {
+    return this->storeThumbnailFile(originalFilePath, studyInstanceUID, seriesInstanceUID, sopInstanceUID,
+                                    modality, backgroundColor);
+  }
+  ctkDICOMThumbnailCache::ThumbnailRequest request;
+  request.SOPInstanceUID = sopInstanceUID;
+  request.FilePath = originalFilePath;
+  request.Modality = modality;
+  QList<ctkDICOMThumbnailCache::ThumbnailRequest> requests;
+  requests << request;
+  return d->ThumbnailCache->generateThumbnails(studyInstanceUID, requests, generator, backgroundColor) == 1;
+}
+
+//------------------------------------------------------------------------------
+QMap<QString, QString> ctkDICOMDatabase::storeThumbnails(const QString& studyInstanceUID,
+                                                         const QStringList& sopInstanceUIDs,
+                                                         QColor backgroundColor)
+{
+  Q_D(ctkDICOMDatabase);
+  QMap<QString, QString> seriesForThumbnails;
+  if (!d->ThumbnailGenerator || sopInstanceUIDs.isEmpty())
+  {
+    return seriesForThumbnails;
+  }
+
+  // Get files and modalities of all the instances with a few queries
+  // (number of bound values per query is limited by SQLite)
+  const int maximumInstancesPerQuery = 500;
+  QList<ctkDICOMThumbnailCache::ThumbnailRequest> requests;
+  QMap<QString, QString> seriesForInstances;
+  QSqlQuery query(d->Database);
+  query.setForwardOnly(true);
+  for (int startIndex = 0; startIndex < sopInstanceUIDs.count(); startIndex += maximumInstancesPerQuery)
+  {
+    QStringList instances = sopInstanceUIDs.mid(startIndex, maximumInstancesPerQuery);
+    QStringList placeholders;
+    for (int index = 0; index < instances.count(); ++index)
+    {
+      placeholders << "?";
+    }
+    query.prepare(QString("SELECT Images.SOPInstanceUID, Images.SeriesInstanceUID, Images.Filename, Series.Modality "
+                          "FROM Images, Series WHERE Images.SeriesInstanceUID = Series.SeriesInstanceUID "
+                          "AND Series.StudyInstanceUID = ? AND Images.SOPInstanceUID IN (%1)")
+                    .arg(placeholders.join(",")));
+    query.addBindValue(studyInstanceUID);
+    foreach (const QString& sopInstanceUID, instances)
+    {
+      query.addBindValue(sopInstanceUID);
+    }
+    if (!d->loggedExec(query))
+    {
+      return seriesForThumbnails;
+    }
+    while (query.next())
+    {
+      QString filename = query.value(2).toString();
+      if (filename.isEmpty())
+      {
+        // instance is not retrieved yet
+        continue;
+      }
+      ctkDICOMThumbnailCache::ThumbnailRequest request;
+      request.SOPInstanceUID = query.value(0).toString();
+      request.FilePath = d->absolutePathFromInternal(filename);
+      request.Modality = query.value(3).toString();
+      requests << request;
+      seriesForInstances[request.SOPInstanceUID] = query.value(1).toString();
+    }
+  }
+
+  ctkDICOMThumbnailGenerator* generator = qobject_cast<ctkDICOMThumbnailGenerator*>(d->ThumbnailGenerator);
+  if (generator && !d->ThumbnailCache->directory().isEmpty())
+  {
+    d->ThumbnailCache->generateThumbnails(studyInstanceUID, requests, generator, backgroundColor);
+    foreach (const ctkDICOMThumbnailCache::ThumbnailRequest& request, requests)
+    {
+      if (d->ThumbnailCache->contains(studyInstanceUID, request.SOPInstanceUID))
+      {
+        seriesForThumbnails[request.SOPInstanceUID] = seriesForInstances[request.SOPInstanceUID];
+      }
+    }
+  }
+  else
+  {
+    // Custom thumbnail generators can only write thumbnail files
+    foreach (const ctkDICOMThumbnailCache::ThumbnailRequest& request, requests)
+    {
+      QString seriesInstanceUID = seriesForInstances[request.SOPInstanceUID];
+      if (this->storeThumbnailFile(request.FilePath, studyInstanceUID, seriesInstanceUID,
+                                   request.SOPInstanceUID, request.Modality, backgroundColor))
+      {
+        seriesForThumbnails[request.SOPInstanceUID] = seriesInstanceUID;
+      }
+    }
   }
+  return seriesForThumbnails;
 }
 
 //------------------------------------------------------------------------------
@@ -2790,8 +4156,9 @@ void ctkDICOMDatabase::insert(const QList<ctkDICOMDatabase::IndexingResult>& ind
     ctkDICOMDatabase::InsertResult::NotInserted;
 
   d->TagCacheDatabase.transaction();
-  d->Database.transaction();
+  d->beginWriteTransaction();
 
+  ctkDICOMDatabasePrivate::TagCacheBatch tagCacheBatch;
   QDir databaseDirectory(this->databaseDirectory());
   foreach(const ctkDICOMDatabase::IndexingResult & indexingResult, indexingResults)
   {
@@ -2848,6 +4215,12 @@ void ctkDICOMDatabase::insert(const QList<ctkDICOMDatabase::IndexingResult>& ind
     QString storedFilePath = filePath;
     if (storeFile && !seriesInstanceUID.isEmpty() && !this->isInMemory())
     {
+      if (indexingResult.headerOnly && filePath.isEmpty())
+      {
+        // the dataset is incomplete, it cannot be saved
+        logger.error("Failed to insert dataset into database (no file is available for a header-only dataset): " + sopInstanceUID);
+        continue;
+      }
       if (!d->storeDatasetFile(dataset, filePath, studyInstanceUID, seriesInstanceUID, sopInstanceUID, storedFilePath))
       {
         continue;
@@ -2860,46 +4233,12 @@ void ctkDICOMDatabase::insert(const QList<ctkDICOMDatabase::IndexingResult>& ind
     }
     if (!storedFilePath.isEmpty() && !seriesInstanceUID.isEmpty())
     {
-      // Insert all pre-cached fields into tag cache
-      QSqlQuery insertTags(d->TagCacheDatabase);
-      insertTags.prepare("INSERT OR REPLACE INTO TagCache VALUES(?,?,?)");
-      insertTags.bindValue(0, sopInstanceUID);
-      foreach(const QString & tag, d->TagsToPrecache)
-      {
-        unsigned short group, element;
-        this->tagToGroupElement(tag, group, element);
-        DcmTagKey tagKey(group, element);
-        QString value;
-        if (d->TagsToExcludeFromStorage.contains(tag))
-        {
-          if (dataset.TagExists(tagKey))
-          {
-            value = ValueIsNotStored;
-          }
-          else
-          {
-            value = TagNotInInstance;
-          }
-        }
-        else
-        {
-          value = dataset.GetAllElementValuesAsString(tagKey);
-        }
-        insertTags.bindValue(1, tag);
-        if (value.isEmpty())
-        {
-          insertTags.bindValue(2, TagNotInInstance);
-        }
-        else
-        {
-          insertTags.bindValue(2, value);
-        }
-        insertTags.exec();
-      }
+      // Collect all pre-cached fields, they are written into tag cache at the end
+      d->precacheTags(dataset, sopInstanceUID, tagCacheBatch, indexingResult.headerOnly);
 
       // Insert image files
-      QSqlQuery insertImageStatement(d->Database);
-      insertImageStatement.prepare("INSERT INTO Images ( 'SOPInstanceUID', 'Filename', 'URL', 'SeriesInstanceUID', 'InsertTimestamp' ) VALUES ( ?, ?, ?, ?, ? )");
+      QSqlQuery& insertImageStatement = d->insertSessionQuery(
+        "INSERT INTO Images ( 'SOPInstanceUID', 'Filename', 'URL', 'SeriesInstanceUID', 'InsertTimestamp' ) VALUES ( ?, ?, ?, ?, ? )");
       insertImageStatement.addBindValue(sopInstanceUID);
       insertImageStatement.addBindValue(d->internalPathFromAbsolute(storedFilePath));
       insertImageStatement.addBindValue(QString(""));
@@ -2911,12 +4250,14 @@ void ctkDICOMDatabase::insert(const QList<ctkDICOMDatabase::IndexingResult>& ind
 
       if (generateThumbnail)
       {
-        this->storeThumbnailFile(storedFilePath, studyInstanceUID, seriesInstanceUID, sopInstanceUID);
+        this->storeThumbnail(storedFilePath, studyInstanceUID, seriesInstanceUID, sopInstanceUID);
       }
     }
   }
 
-  d->Database.commit();
+  d->writeTagCacheBatch(tagCacheBatch);
+
+  d->commitWriteTransaction();
   d->TagCacheDatabase.commit();
 
   if (insertOperationResult == ctkDICOMDatabase::InsertResult::Inserted && this->isInMemory())
@@ -2934,7 +4275,8 @@ ctkDICOMDatabase::InsertResult ctkDICOMDatabase::insert(const QList<ctkDICOMJobR
   bool insertFailed = false;
 
   d->TagCacheDatabase.transaction();
-  d->Database.transaction();
+  d->beginWriteTransaction();
+  ctkDICOMDatabasePrivate::TagCacheBatch tagCacheBatch;
   QDir databaseDirectory(this->databaseDirectory());
   foreach (ctkDICOMJobResponseSet* jobResponseSet, jobResponseSets)
   {
@@ -3181,7 +4523,7 @@ ctkDICOMDatabase::InsertResult ctkDICOMDatabase::insert(const QList<ctkDICOMJobR
           else
           {
             // insert was needed, so cache any application-requested tags
-            d->precacheTags(*dataset, sopInstanceUID);
+            d->precacheTags(*dataset, sopInstanceUID, tagCacheBatch);
           }
 
           // let users of this class track when things happen
@@ -3190,13 +4532,21 @@ ctkDICOMDatabase::InsertResult ctkDICOMDatabase::insert(const QList<ctkDICOMJobR
         }
         if (generateThumbnail)
         {
-          this->storeThumbnailFile(storedFilePath, studyInstanceUID, seriesInstanceUID, sopInstanceUID);
+          this->storeThumbnail(storedFilePath, studyInstanceUID, seriesInstanceUID, sopInstanceUID);
         }
       }
     }
+
+    // A staged file that was not moved to its storage path is not used
+    if (storeFile && filePath.endsWith(".part"))
+    {
+      QFile::remove(filePath);
+    }
   }
 
-  d->Database.commit();
+  d->writeTagCacheBatch(tagCacheBatch);
+
+  d->commitWriteTransaction();
   d->TagCacheDatabase.commit();
 
   if (insertFailed)
@@ -3223,6 +4573,7 @@ void ctkDICOMDatabase::setTagsToPrecache(const QStringList tags)
     return;
   }
   d->TagsToPrecache = tags;
+  d->updatePrecachedTags();
   emit tagsToPrecacheChanged();
 }
 
@@ -3247,6 +4598,7 @@ void ctkDICOMDatabase::setTagsToExcludeFromStorage(const QStringList tags)
     return;
   }
   d->TagsToExcludeFromStorage = upperTags;
+  d->updatePrecachedTags();
   emit tagsToExcludeFromStorageChanged();
 }
 
@@ -3297,6 +4649,323 @@ bool ctkDICOMDatabase::allFilesModifiedTimes(QMap<QString, QDateTime>& modifiedT
   return success;
 }
 
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::filesModifiedTimes(const QStringList& filePaths, QMap<QString, QDateTime>& modifiedTimeForFilepath)
+{
+  Q_D(ctkDICOMDatabase);
+  // Number of bound values per query is limited by SQLite
+  const int maximumFilesPerQuery = 500;
+  QSqlQuery query(d->Database);
+  query.setForwardOnly(true);
+  for (int startIndex = 0; startIndex < filePaths.count(); startIndex += maximumFilesPerQuery)
+  {
+    QStringList files = filePaths.mid(startIndex, maximumFilesPerQuery);
+    QStringList placeholders;
+    for (int index = 0; index < files.count(); ++index)
+    {
+      placeholders << "?";
+    }
+    query.prepare(QString("SELECT Filename, InsertTimestamp FROM Images WHERE Filename IN (%1)").arg(placeholders.join(",")));
+    foreach (const QString& filePath, files)
+    {
+      query.addBindValue(d->internalPathFromAbsolute(filePath));
+    }
+    if (!d->loggedExec(query))
+    {
+      return false;
+    }
+    while (query.next())
+    {
+      QString filename = d->absolutePathFromInternal(query.value(0).toString());
+      QDateTime modifiedTime = QDateTime::fromString(query.value(1).toString(), Qt::ISODate);
+      if (modifiedTimeForFilepath.contains(filename) && modifiedTimeForFilepath[filename] <= modifiedTime)
+      {
+        continue;
+      }
+      modifiedTimeForFilepath[filename] = modifiedTime;
+    }
+  }
+  query.finish();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::filesModifiedTimesInDirectory(const QString& directoryPath,
+  QMap<QString, QDateTime>& modifiedTimeForFilepath, QStringList* subdirectoryNames/*=nullptr*/)
+{
+  Q_D(ctkDICOMDatabase);
+  // All files in the directory tree are in the [prefix, prefixEnd) range of the Filename index.
+  QString prefix = d->internalDirectoryPrefix(directoryPath);
+  QString prefixEnd = prefix;
+  prefixEnd[prefixEnd.size() - 1] = QChar('/' + 1);
+  int prefixLength = prefix.length();
+
+  QSqlQuery filesQuery(d->Database);
+  filesQuery.setForwardOnly(true);
+  filesQuery.prepare("SELECT Filename, InsertTimestamp FROM Images WHERE Filename >= ? AND Filename < ? "
+    "AND instr(substr(Filename, ?), '/') = 0");
+  filesQuery.addBindValue(prefix);
+  filesQuery.addBindValue(prefixEnd);
+  filesQuery.addBindValue(prefixLength + 1);
+  if (!d->loggedExec(filesQuery))
+  {
+    return false;
+  }
+  while (filesQuery.next())
+  {
+    QString filename = d->absolutePathFromInternal(filesQuery.value(0).toString());
+    QDateTime modifiedTime = QDateTime::fromString(filesQuery.value(1).toString(), Qt::ISODate);
+    if (modifiedTimeForFilepath.contains(filename) && modifiedTimeForFilepath[filename] <= modifiedTime)
+    {
+      continue;
+    }
+    modifiedTimeForFilepath[filename] = modifiedTime;
+  }
+  filesQuery.finish();
+
+  if (subdirectoryNames)
+  {
+    subdirectoryNames->clear();
+    QSqlQuery subdirectoriesQuery(d->Database);
+    subdirectoriesQuery.setForwardOnly(true);
+    subdirectoriesQuery.prepare("SELECT DISTINCT substr(Filename, ?, instr(substr(Filename, ?), '/') - 1) FROM Images "
+      "WHERE Filename >= ? AND Filename < ? AND instr(substr(Filename, ?), '/') > 0");
+    subdirectoriesQuery.addBindValue(prefixLength + 1);
+    subdirectoriesQuery.addBindValue(prefixLength + 1);
+    subdirectoriesQuery.addBindValue(prefix);
+    subdirectoriesQuery.addBindValue(prefixEnd);
+    subdirectoriesQuery.addBindValue(prefixLength + 1);
+    if (!d->loggedExec(subdirectoriesQuery))
+    {
+      return false;
+    }
+    while (subdirectoriesQuery.next())
+    {
+      *subdirectoryNames << subdirectoriesQuery.value(0).toString();
+    }
+    subdirectoriesQuery.finish();
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::removeFiles(const QStringList& filePaths, bool cleanup/*=true*/)
+{
+  Q_D(ctkDICOMDatabase);
+  if (filePaths.isEmpty())
+  {
+    return true;
+  }
+
+  // Find the instances of the files
+  const int maximumFilesPerQuery = 500;
+  QStringList sopInstanceUIDs;
+  QSet<QString> seriesInstanceUIDs;
+  QMap<QString, QStringList> sopInstanceUIDsForStudy;
+  QSqlQuery query(d->Database);
+  query.setForwardOnly(true);
+  for (int startIndex = 0; startIndex < filePaths.count(); startIndex += maximumFilesPerQuery)
+  {
+    QStringList files = filePaths.mid(startIndex, maximumFilesPerQuery);
+    QStringList placeholders;
+    for (int index = 0; index < files.count(); ++index)
+    {
+      placeholders << "?";
+    }
+    query.prepare(QString("SELECT Images.SOPInstanceUID, Images.SeriesInstanceUID, Series.StudyInstanceUID "
+                          "FROM Images LEFT JOIN Series ON Images.SeriesInstanceUID = Series.SeriesInstanceUID "
+                          "WHERE Images.Filename IN (%1)").arg(placeholders.join(",")));
+    foreach (const QString& filePath, files)
+    {
+      query.addBindValue(d->internalPathFromAbsolute(filePath));
+    }
+    if (!d->loggedExec(query))
+    {
+      return false;
+    }
+    while (query.next())
+    {
+      QString sopInstanceUID = query.value(0).toString();
+      sopInstanceUIDs << sopInstanceUID;
+      seriesInstanceUIDs.insert(query.value(1).toString());
+      sopInstanceUIDsForStudy[query.value(2).toString()] << sopInstanceUID;
+    }
+  }
+  query.finish();
+  if (sopInstanceUIDs.isEmpty())
+  {
+    return true;
+  }
+
+  bool success = true;
+  bool tagCacheAvailable = this->tagCacheExists();
+  if (tagCacheAvailable)
+  {
+    d->TagCacheDatabase.transaction();
+  }
+  d->beginWriteTransaction();
+  QSqlQuery deleteQuery(d->Database);
+  QSqlQuery deleteCachedTagsQuery(d->TagCacheDatabase);
+  for (int startIndex = 0; success && startIndex < sopInstanceUIDs.count(); startIndex += maximumFilesPerQuery)
+  {
+    QStringList instances = sopInstanceUIDs.mid(startIndex, maximumFilesPerQuery);
+    QStringList placeholders;
+    for (int index = 0; index < instances.count(); ++index)
+    {
+      placeholders << "?";
+    }
+    deleteQuery.prepare(QString("DELETE FROM Images WHERE SOPInstanceUID IN (%1)").arg(placeholders.join(",")));
+    foreach (const QString& sopInstanceUID, instances)
+    {
+      deleteQuery.addBindValue(sopInstanceUID);
+    }
+    success = d->loggedExec(deleteQuery);
+    if (success && tagCacheAvailable)
+    {
+      deleteCachedTagsQuery.prepare(QString("DELETE FROM TagCache WHERE SOPInstanceUID IN (%1)").arg(placeholders.join(",")));
+      foreach (const QString& sopInstanceUID, instances)
+      {
+        deleteCachedTagsQuery.addBindValue(sopInstanceUID);
+      }
+      success = d->loggedExec(deleteCachedTagsQuery);
+    }
+  }
+  // Image counts are updated incrementally when images are added, recount the affected series now
+  // (and update the timestamp so that the hierarchy snapshot reads them again)
+  QSqlQuery updateCountQuery(d->Database);
+  updateCountQuery.prepare("UPDATE Series SET DisplayedCount = "
+    "( SELECT COUNT(*) FROM Images WHERE Images.SeriesInstanceUID = Series.SeriesInstanceUID ), "
+    "DisplayedFieldsUpdatedTimestamp = CURRENT_TIMESTAMP WHERE SeriesInstanceUID = ?");
+  foreach (const QString& seriesInstanceUID, seriesInstanceUIDs)
+  {
+    if (!success)
+    {
+      break;
+    }
+    updateCountQuery.bindValue(0, seriesInstanceUID);
+    success = d->loggedExec(updateCountQuery);
+  }
+  deleteQuery.finish();
+  deleteCachedTagsQuery.finish();
+  updateCountQuery.finish();
+  if (!success)
+  {
+    // Leave the database as it was, the files are not removed
+    logger.error("Failed to remove files from the database, changes are rolled back");
+    d->rollbackWriteTransaction();
+    if (tagCacheAvailable)
+    {
+      d->TagCacheDatabase.rollback();
+    }
+    return false;
+  }
+  d->commitWriteTransaction();
+  if (tagCacheAvailable)
+  {
+    d->TagCacheDatabase.commit();
+  }
+  foreach (const QString& sopInstanceUID, sopInstanceUIDs)
+  {
+    d->TagValueCache.remove(sopInstanceUID);
+  }
+
+  for (QMap<QString, QStringList>::const_iterator studyIt = sopInstanceUIDsForStudy.constBegin();
+    studyIt != sopInstanceUIDsForStudy.constEnd(); ++studyIt)
+  {
+    d->ThumbnailCache->removeThumbnails(studyIt.key(), studyIt.value());
+  }
+
+  if (cleanup)
+  {
+    this->cleanup();
+  }
+  d->resetLastInsertedValues();
+  emit databaseChanged();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::removeFilesInDirectory(const QString& directoryPath, bool cleanup/*=true*/)
+{
+  Q_D(ctkDICOMDatabase);
+  QString prefix = d->internalDirectoryPrefix(directoryPath);
+  QString prefixEnd = prefix;
+  prefixEnd[prefixEnd.size() - 1] = QChar('/' + 1);
+  QSqlQuery filesQuery(d->Database);
+  filesQuery.setForwardOnly(true);
+  filesQuery.prepare("SELECT Filename FROM Images WHERE Filename >= ? AND Filename < ?");
+  filesQuery.addBindValue(prefix);
+  filesQuery.addBindValue(prefixEnd);
+  if (!d->loggedExec(filesQuery))
+  {
+    return false;
+  }
+  QStringList filePaths;
+  while (filesQuery.next())
+  {
+    filePaths << d->absolutePathFromInternal(filesQuery.value(0).toString());
+  }
+  filesQuery.finish();
+  return this->removeFiles(filePaths, cleanup);
+}
+
+//------------------------------------------------------------------------------
+QList<ctkDICOMDatabase::WatchedDirectory> ctkDICOMDatabase::watchedDirectories()
+{
+  Q_D(ctkDICOMDatabase);
+  QList<WatchedDirectory> watchedDirectories;
+  QSqlQuery query(d->Database);
+  query.prepare("SELECT Dirname, IncludeHidden, ScanCursor FROM WatchedDirectories");
+  if (!d->loggedExec(query))
+  {
+    return watchedDirectories;
+  }
+  while (query.next())
+  {
+    WatchedDirectory watchedDirectory;
+    watchedDirectory.path = query.value(0).toString();
+    watchedDirectory.includeHidden = query.value(1).toInt() != 0;
+    watchedDirectory.scanCursor = QDateTime::fromString(query.value(2).toString(), Qt::ISODate);
+    watchedDirectories << watchedDirectory;
+  }
+  return watchedDirectories;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::setWatchedDirectory(const WatchedDirectory& watchedDirectory)
+{
+  Q_D(ctkDICOMDatabase);
+  QSqlQuery query(d->Database);
+  query.prepare("INSERT OR REPLACE INTO WatchedDirectories ( 'Dirname', 'IncludeHidden', 'ScanCursor' ) "
+    "VALUES ( ?, ?, ? )");
+  query.addBindValue(QDir::cleanPath(watchedDirectory.path));
+  query.addBindValue(watchedDirectory.includeHidden ? 1 : 0);
+  // an invalid cursor is stored as an empty string
+  query.addBindValue(watchedDirectory.scanCursor.toString(Qt::ISODate));
+  return d->loggedExec(query);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::setWatchedDirectoryScanCursor(const QString& directoryPath, const QDateTime& scanCursor)
+{
+  Q_D(ctkDICOMDatabase);
+  QSqlQuery query(d->Database);
+  query.prepare("UPDATE WatchedDirectories SET ScanCursor = ? WHERE Dirname = ?");
+  query.addBindValue(scanCursor.toString(Qt::ISODate));
+  query.addBindValue(QDir::cleanPath(directoryPath));
+  return d->loggedExec(query);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::removeWatchedDirectory(const QString& directoryPath)
+{
+  Q_D(ctkDICOMDatabase);
+  QSqlQuery query(d->Database);
+  query.prepare("DELETE FROM WatchedDirectories WHERE Dirname = ?");
+  query.addBindValue(QDir::cleanPath(directoryPath));
+  return d->loggedExec(query);
+}
+
 //------------------------------------------------------------------------------
 bool ctkDICOMDatabase::isOpen() const
 {
@@ -3329,6 +4998,7 @@ bool ctkDICOMDatabase::removeSeries(const QString& seriesInstanceUID, bool clear
 
   QList< QPair<QString, QString> > removeList;
   QStringList removeTagCacheSOPInstanceUIDs;
+  QMap<QString, QStringList> removeThumbnailSOPInstanceUIDs;
   while (fileExistsQuery.next())
   {
     QString dbFilePath = fileExistsQuery.value(fileExistsQuery.record().indexOf("Filename")).toString();
@@ -3336,6 +5006,7 @@ bool ctkDICOMDatabase::removeSeries(const QString& seriesInstanceUID, bool clear
     QString sopInstanceUID = fileExistsQuery.value(fileExistsQuery.record().indexOf("SOPInstanceUID")).toString();
     QString thumbnailPath = "thumbs/" + d->internalStoragePath(studyInstanceUID, seriesInstanceUID, sopInstanceUID) + ".png";
     removeList << qMakePair(dbFilePath, thumbnailPath);
+    removeThumbnailSOPInstanceUIDs[studyInstanceUID] << sopInstanceUID;
     if (clearCachedTags)
     {
       removeTagCacheSOPInstanceUIDs << sopInstanceUID;
@@ -3353,6 +5024,14 @@ bool ctkDICOMDatabase::removeSeries(const QString& seriesInstanceUID, bool clear
     logger.error("SQLITE ERROR: " + fileRemove.lastError().driverText());
   }
 
+  // Stored image count of the series is not valid anymore (it is updated incrementally).
+  // The timestamp is updated so that the hierarchy snapshot reads the series again.
+  QSqlQuery invalidateSeriesCount(d->Database);
+  invalidateSeriesCount.prepare("UPDATE Series SET DisplayedCount = NULL, "
+    "DisplayedFieldsUpdatedTimestamp = CURRENT_TIMESTAMP WHERE SeriesInstanceUID == :seriesID");
+  invalidateSeriesCount.bindValue(":seriesID", seriesInstanceUID);
+  d->loggedExec(invalidateSeriesCount);
+
   if (!removeTagCacheSOPInstanceUIDs.isEmpty())
   {
     d->TagCacheDatabase.transaction();
@@ -3408,6 +5087,13 @@ bool ctkDICOMDatabase::removeSeries(const QString& seriesInstanceUID, bool clear
     }
   }
 
+  // Remove thumbnails from the study thumbnail containers
+  for (QMap<QString, QStringList>::const_iterator it = removeThumbnailSOPInstanceUIDs.constBegin();
+       it != removeThumbnailSOPInstanceUIDs.constEnd(); ++it)
+  {
+    d->ThumbnailCache->removeThumbnails(it.key(), it.value());
+  }
+
   // Delete all empty folders that are left after removing DICOM files
   // (folders that still contain files are not removed)
   foreach (QString folderToRemove, foldersToRemove)
@@ -3440,6 +5126,13 @@ bool ctkDICOMDatabase::cleanup(bool vacuum/*=false*/)
     seriesCleanup.exec("VACUUM;");
     QSqlQuery tagcacheCleanup(d->TagCacheDatabase);
     seriesCleanup.exec("VACUUM;");
+    // VACUUM may renumber the rows of the Studies and Series tables
+    d->rebuildFullTextSearchIndexes();
+  }
+  else
+  {
+    // Entries of the removed rows would match the rows that reuse their rowid
+    d->removeOrphanedFullTextSearchEntries();
   }
   d->resetLastInsertedValues();
   return true;
@@ -3573,6 +5266,7 @@ bool ctkDICOMDatabase::initializeTagCache()
     return false;
   }
 
+  d->TagValueCache.clear();
   d->TagCacheVerified = true;
   return true;
 }
@@ -3581,6 +5275,13 @@ bool ctkDICOMDatabase::initializeTagCache()
 QString ctkDICOMDatabase::cachedTag(const QString sopInstanceUID, const QString tag)
 {
   Q_D(ctkDICOMDatabase);
+  QString upperTag = tag.toUpper();
+  QString result("");
+  d->checkTagCacheDataVersion(true);
+  if (d->TagValueCache.value(sopInstanceUID, upperTag, result))
+  {
+    return( result );
+  }
   if ( !this->tagCacheExists() )
   {
     if ( !this->initializeTagCache() )
@@ -3591,9 +5292,8 @@ QString ctkDICOMDatabase::cachedTag(const QString sopInstanceUID, const QString
   QSqlQuery selectValue( d->TagCacheDatabase );
   selectValue.prepare( "SELECT Value FROM TagCache WHERE SOPInstanceUID = :sopInstanceUID AND Tag = :tag" );
   selectValue.bindValue(":sopInstanceUID",sopInstanceUID);
-  selectValue.bindValue(":tag",tag.toUpper());
+  selectValue.bindValue(":tag",upperTag);
   d->loggedExec(selectValue);
-  QString result("");
   if (selectValue.next())
   {
     result = selectValue.value(0).toString();
@@ -3601,6 +5301,7 @@ QString ctkDICOMDatabase::cachedTag(const QString sopInstanceUID, const QString
     {
       result = ValueIsEmptyString;
     }
+    d->TagValueCache.insert(sopInstanceUID, upperTag, result);
   }
   return( result );
 }
@@ -3610,29 +5311,45 @@ void ctkDICOMDatabase::getCachedTags(const QString sopInstanceUID, QMap<QString,
 {
   Q_D(ctkDICOMDatabase);
   cachedTags.clear();
-  if ( !this->tagCacheExists() )
+  QMap<QString, QString> values;
+  d->checkTagCacheDataVersion(true);
+  if (!d->TagValueCache.values(sopInstanceUID, values))
   {
-    if ( !this->initializeTagCache() )
+    if ( !this->tagCacheExists() )
     {
-      // cache is empty
-      return;
+      if ( !this->initializeTagCache() )
+      {
+        // cache is empty
+        return;
+      }
+    }
+    QSqlQuery selectValue( d->TagCacheDatabase );
+    selectValue.prepare( "SELECT Tag, Value FROM TagCache WHERE SOPInstanceUID = :sopInstanceUID" );
+    selectValue.bindValue(":sopInstanceUID",sopInstanceUID);
+    d->loggedExec(selectValue);
+    while (selectValue.next())
+    {
+      QString value = selectValue.value(1).toString();
+      values.insert(selectValue.value(0).toString().toUpper(), value.isEmpty() ? ValueIsEmptyString : value);
+    }
+    if (!values.isEmpty())
+    {
+      d->TagValueCache.insert(sopInstanceUID, values, true);
     }
   }
-  QSqlQuery selectValue( d->TagCacheDatabase );
-  selectValue.prepare( "SELECT Tag, Value FROM TagCache WHERE SOPInstanceUID = :sopInstanceUID" );
-  selectValue.bindValue(":sopInstanceUID",sopInstanceUID);
-  d->loggedExec(selectValue);
-  QString tag;
-  QString value;
-  while (selectValue.next())
+  for (QMap<QString, QString>::const_iterator valueIt = values.constBegin(); valueIt != values.constEnd(); ++valueIt)
   {
-    tag = selectValue.value(0).toString().toUpper();
-    value = selectValue.value(1).toString();
+    QString value = valueIt.value();
+    if (value.isEmpty())
+    {
+      // tag known to be missing from the tag cache
+      continue;
+    }
     if (value == TagNotInInstance || value == ValueIsEmptyString || value == ValueIsNotStored)
     {
       value = QString("");
     }
-    cachedTags.insert(tag, value);
+    cachedTags.insert(valueIt.key(), value);
   }
 }
 
@@ -3665,37 +5382,23 @@ bool ctkDICOMDatabase::cacheTags(const QStringList sopInstanceUIDs, const QStrin
     }
   }
 
-  d->TagCacheDatabase.transaction();
-
-  QSqlQuery insertTags(d->TagCacheDatabase);
-  insertTags.prepare( "INSERT OR REPLACE INTO TagCache VALUES(?,?,?)" );
-
+  ctkDICOMDatabasePrivate::TagCacheBatch tagCacheBatch;
   QStringList::const_iterator sopInstanceUIDsIt = sopInstanceUIDs.begin();
   QStringList::const_iterator tagsIt = tags.begin();
   QStringList::const_iterator valuesIt = values.begin();
-  bool success = true;
   for (int i = 0; i<itemCount; ++i)
   {
-    insertTags.bindValue(0, *sopInstanceUIDsIt);
-    insertTags.bindValue(1, (*tagsIt).toUpper());
-    if (valuesIt->isEmpty())
-    {
-      // replace empty strings with special flag string
-      insertTags.bindValue(2, TagNotInInstance);
-    }
-    else
-    {
-      insertTags.bindValue(2, *valuesIt);
-    }
-    if (!insertTags.exec())
-    {
-      success = false;
-    }
+    tagCacheBatch.SOPInstanceUIDs << *sopInstanceUIDsIt;
+    tagCacheBatch.Tags << (*tagsIt).toUpper();
+    // replace empty strings with special flag string
+    tagCacheBatch.Values << (valuesIt->isEmpty() ? TagNotInInstance : *valuesIt);
     ++sopInstanceUIDsIt;
     ++tagsIt;
     ++valuesIt;
   }
 
+  d->TagCacheDatabase.transaction();
+  bool success = d->writeTagCacheBatch(tagCacheBatch);
   d->TagCacheDatabase.commit();
 
   return success;
@@ -3705,6 +5408,7 @@ bool ctkDICOMDatabase::cacheTags(const QStringList sopInstanceUIDs, const QStrin
 void ctkDICOMDatabase::removeCachedTags(const QString sopInstanceUID)
 {
   Q_D(ctkDICOMDatabase);
+  d->TagValueCache.remove(sopInstanceUID);
   if (!this->tagCacheExists())
   {
     return;
@@ -3719,6 +5423,34 @@ void ctkDICOMDatabase::removeCachedTags(const QString sopInstanceUID)
   }
 }
 
+//------------------------------------------------------------------------------
+bool ctkDICOMDatabase::prefetchTags(const QString seriesInstanceUID, const QStringList tags/*=QStringList()*/)
+{
+  Q_D(ctkDICOMDatabase);
+  return d->loadCachedTags(this->instancesForSeries(seriesInstanceUID), tags);
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMTagValueCache* ctkDICOMDatabase::tagValueCache()
+{
+  Q_D(ctkDICOMDatabase);
+  return &d->TagValueCache;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMDatabase::tagCacheHitCount()
+{
+  Q_D(ctkDICOMDatabase);
+  return d->TagValueCache.hitCount();
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMDatabase::tagCacheMissCount()
+{
+  Q_D(ctkDICOMDatabase);
+  return d->TagValueCache.missCount();
+}
+
 //------------------------------------------------------------------------------
 void ctkDICOMDatabase::updateDisplayedFields()
 {
@@ -3727,8 +5459,12 @@ void ctkDICOMDatabase::updateDisplayedFields()
   // Get the files for which the displayed fields have not been created yet (DisplayedFieldsUpdatedTimestamp is NULL)
   // Note: The per-instance update only covers insertion and schema update. If fields on the series/study/patient level need to be
   // updated on the insertion of a new instance, then it can be handled using the startUpdate/endUpdate functions of the rules.
+  // Only these instances and the series/studies/patients they belong to are updated, therefore the update
+  // time is proportional to the number of new instances and not to the size of the database.
   QSqlQuery newFilesQuery(d->Database);
+  newFilesQuery.setForwardOnly(true);
   d->loggedExec(newFilesQuery,QString("SELECT SOPInstanceUID, SeriesInstanceUID FROM Images WHERE DisplayedFieldsUpdatedTimestamp IS NULL;"));
+  QStringList updatedSOPInstanceUIDs;
 
   // Populate displayed fields maps from the current display tables
   QMap<QString /*SeriesInstanceUID*/, QMap<QString /*DisplayField*/, QString /*Value*/> > displayedFieldsMapSeries;
@@ -3741,11 +5477,25 @@ void ctkDICOMDatabase::updateDisplayedFields()
   // Initialize rules for starting the update
   d->DisplayedFieldGenerator->startUpdate();
 
-  // Get display names for newly added files and add them into the display tables
+  QStringList newSeriesInstanceUIDs;
   while (newFilesQuery.next())
   {
-    QString sopInstanceUID = newFilesQuery.value(0).toString();
-    QString seriesInstanceUID = newFilesQuery.value(1).toString();
+    updatedSOPInstanceUIDs << newFilesQuery.value(0).toString();
+    newSeriesInstanceUIDs << newFilesQuery.value(1).toString();
+  }
+  newFilesQuery.finish();
+
+  // Get display names for newly added files and add them into the display tables
+  const int instancesPerTagsLoad = 500;
+  for (int instanceIndex = 0; instanceIndex < updatedSOPInstanceUIDs.count(); ++instanceIndex)
+  {
+    if (instanceIndex % instancesPerTagsLoad == 0)
+    {
+      // Read the cached tags of the next instances at once instead of one query per instance
+      d->loadCachedTags(updatedSOPInstanceUIDs.mid(instanceIndex, instancesPerTagsLoad));
+    }
+    const QString& sopInstanceUID = updatedSOPInstanceUIDs[instanceIndex];
+    const QString& seriesInstanceUID = newSeriesInstanceUIDs[instanceIndex];
     QMap<QString, QString> cachedTags;
     this->getCachedTags(sopInstanceUID, cachedTags);
 
@@ -3809,23 +5559,26 @@ void ctkDICOMDatabase::updateDisplayedFields()
   // Update/insert the display values
   if (displayedFieldsMapSeries.count() > 0)
   {
-    d->Database.transaction();
+    d->beginWriteTransaction();
 
     if (d->applyDisplayedFieldsChanges(displayedFieldsMapSeries, displayedFieldsMapStudy, displayedFieldsMapPatient))
     {
       // Update image timestamp
-      newFilesQuery.first();
-      newFilesQuery.previous(); // Need to go one before the first record
-      while (newFilesQuery.next())
+      QSqlQuery updateDisplayedFieldsUpdatedTimestampStatement(d->Database);
+      updateDisplayedFieldsUpdatedTimestampStatement.prepare(
+        "UPDATE Images SET DisplayedFieldsUpdatedTimestamp=CURRENT_TIMESTAMP WHERE SOPInstanceUID = ? ;");
+      foreach (const QString& sopInstanceUID, updatedSOPInstanceUIDs)
       {
-        QSqlQuery updateDisplayedFieldsUpdatedTimestampStatement(d->Database);
-        QString updateDisplayedFieldsUpdatedTimestampStatementString =
-          QString("UPDATE IMAGES SET DisplayedFieldsUpdatedTimestamp=CURRENT_TIMESTAMP WHERE SOPInstanceUID='%1';").arg(newFilesQuery.value(0).toString());
-        d->loggedExec(updateDisplayedFieldsUpdatedTimestampStatement, updateDisplayedFieldsUpdatedTimestampStatementString);
+        updateDisplayedFieldsUpdatedTimestampStatement.bindValue(0, sopInstanceUID);
+        d->loggedExec(updateDisplayedFieldsUpdatedTimestampStatement);
       }
+      d->commitWriteTransaction();
+    }
+    else
+    {
+      // Counts are updated incrementally, so partial changes must not be stored
+      d->rollbackWriteTransaction();
     }
-
-    d->Database.commit();
   }
 
   emit displayedFieldsUpdated();
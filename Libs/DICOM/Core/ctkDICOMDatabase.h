@@ -23,17 +23,22 @@
 
 // Qt includes
 #include <QColor>
+#include <QDateTime>
 #include <QObject>
 #include <QStringList>
+#include <QVariant>
 #include <QSqlDatabase>
 
 #include "ctkDICOMItem.h"
 #include "ctkDICOMCoreExport.h"
 
-class QDateTime;
+class QImage;
 class ctkDICOMDatabasePrivate;
 class DcmDataset;
 class ctkDICOMAbstractThumbnailGenerator;
+class ctkDICOMHierarchySnapshot;
+class ctkDICOMTagValueCache;
+class ctkDICOMThumbnailCache;
 class ctkDICOMDisplayedFieldGenerator;
 class ctkDICOMJobResponseSet;
 
@@ -69,14 +74,39 @@ class CTK_DICOM_CORE_EXPORT ctkDICOMDatabase : public QObject
   Q_PROPERTY(QStringList loadedSeries READ loadedSeries WRITE setLoadedSeries)
   Q_PROPERTY(QStringList visibleSeries READ visibleSeries WRITE setVisibleSeries)
   Q_PROPERTY(bool useShortStoragePath READ useShortStoragePath WRITE setUseShortStoragePath)
+  Q_PROPERTY(QString journalMode READ journalMode WRITE setJournalMode)
+  Q_PROPERTY(int maximumReadConnections READ maximumReadConnections WRITE setMaximumReadConnections)
+  Q_PROPERTY(bool hierarchySnapshotEnabled READ isHierarchySnapshotEnabled WRITE setHierarchySnapshotEnabled)
 
 public:
   struct IndexingResult
   {
+    IndexingResult()
+      : copyFile(false)
+      , overwriteExistingDataset(false)
+      , headerOnly(false)
+    {
+    }
+
     QString filePath;
     QSharedPointer<ctkDICOMItem> dataset;
     bool copyFile;
     bool overwriteExistingDataset;
+    /// Set if the dataset was read only up to the pixel data element
+    /// (see ctkDICOMItem::InitializeFromFileUntilTag). The pixel data and all
+    /// elements following it are missing from the dataset, therefore
+    /// the original file must be used for accessing them.
+    bool headerOnly;
+  };
+
+  /// Directory kept in sync with the database by ctkDICOMIndexer::addWatchedDirectory()
+  struct WatchedDirectory
+  {
+    QString path;
+    bool includeHidden;
+    /// All the changes made in the directory before this time are indexed.
+    /// Invalid if the directory has not been completely scanned yet.
+    QDateTime scanCursor;
   };
 
   explicit ctkDICOMDatabase(QObject *parent = 0);
@@ -84,6 +114,14 @@ public:
   virtual ~ctkDICOMDatabase();
 
   const QSqlDatabase& database() const;
+  /// Get a read-only connection to the database for the calling thread.
+  /// Queries on this connection are not blocked by insertions running on the main
+  /// connection (or on other ctkDICOMDatabase objects using the same file), which makes
+  /// it suitable for browsing (e.g. ctkDICOMModel) while a long import is in progress.
+  /// The connection may only be used in the calling thread.
+  /// The main connection is returned for in-memory databases or when no more
+  /// read-only connections can be opened.
+  QSqlDatabase readOnlyDatabase();
   const QString lastError() const;
   const QString databaseFilename() const;
 
@@ -108,6 +146,28 @@ public:
   Q_INVOKABLE void setThumbnailGenerator(ctkDICOMAbstractThumbnailGenerator* generator);
   /// Get thumbnail generator object
   Q_INVOKABLE ctkDICOMAbstractThumbnailGenerator* thumbnailGenerator();
+  /// Get the thumbnail cache, storing the thumbnails of each study in a single
+  /// container file in the "thumbs" folder of the database directory.
+  /// It is disabled for in-memory databases.
+  Q_INVOKABLE ctkDICOMThumbnailCache* thumbnailCache() const;
+
+  ///@{
+  /// Keep a memory-mapped snapshot of the patients, studies and series ("ctkDICOMHierarchy.snapshot"
+  /// in the database directory), so that the hierarchy is available without SQL queries.
+  /// When enabled, patients(), studiesForPatient(), seriesForStudy(), fieldForPatient(),
+  /// fieldForStudy(), fieldForSeries() and insertDateTimeForPatient() (and study, series)
+  /// are answered from the snapshot in the thread of the database object, for the
+  /// fields it contains. These queries see the changes made through this object immediately,
+  /// and the changes made by other connections within one second. Disabled by default.
+  /// \sa ctkDICOMHierarchySnapshot
+  void setHierarchySnapshotEnabled(bool enabled);
+  bool isHierarchySnapshotEnabled() const;
+  ///@}
+
+  /// Get the hierarchy snapshot, updated first if the database file changed.
+  /// Returns nullptr if the snapshot is disabled or not available (e.g. in-memory database,
+  /// call from another thread or during a write transaction).
+  Q_INVOKABLE ctkDICOMHierarchySnapshot* hierarchySnapshot();
 
   /// Open the SQLite database in @param databaseFile . If the file does not
   /// exist, a new database is created and initialized with the
@@ -181,6 +241,19 @@ public:
   Q_INVOKABLE QStringList filesForSeries(const QString seriesUID, int hits=-1);
   Q_INVOKABLE QStringList urlsForSeries(const QString seriesUID, int hits=-1);
 
+  ///@{
+  /// \brief Bulk variants of the hierarchy accessors.
+  ///
+  /// Results are grouped by the given UIDs, with one query per chunk of 500 UIDs
+  /// instead of one query per UID. UIDs that are not found in the database
+  /// are not in the returned map.
+  Q_INVOKABLE QMap<QString, QStringList> studiesForPatients(const QStringList& patientUIDs);
+  Q_INVOKABLE QMap<QString, QStringList> seriesForStudies(const QStringList& studyUIDs);
+  Q_INVOKABLE QMap<QString, QStringList> instancesForMultipleSeries(const QStringList& seriesUIDs);
+  Q_INVOKABLE QMap<QString, QStringList> filesForMultipleSeries(const QStringList& seriesUIDs);
+  Q_INVOKABLE QMap<QString, QString> filesForInstances(const QStringList& sopInstanceUIDs);
+  ///@}
+
   Q_INVOKABLE QHash<QString,QString> descriptionsForFile(QString fileName);
   Q_INVOKABLE QString descriptionForSeries(const QString seriesUID);
   Q_INVOKABLE QString descriptionForStudy(const QString studyUID);
@@ -193,6 +266,57 @@ public:
   Q_INVOKABLE QString fieldForStudy(const QString field, const QString studyInstanceUID);
   Q_INVOKABLE QString fieldForSeries(const QString field, const QString seriesInstanceUID);
 
+  ///@{
+  /// \brief Filtered accessors, e.g. for the filters of the visual browser.
+  ///
+  /// Return the patients (UID of the Patients table), studies (StudyInstanceUID) or
+  /// series (SeriesInstanceUID) matching all the \a filters, using a single query.
+  /// Keys are column names of the table of the level or of its parents
+  /// (e.g. "PatientsName" also filters the studies and the series), filters on
+  /// columns of the children are ignored (e.g. "Modality" for the patients).
+  /// The type of the value selects the test:
+  ///   - QString: the column contains the value, case insensitive for ASCII letters.
+  ///     An empty string does not filter.
+  ///   - QStringList: the column is equal to one of the values. An empty list matches nothing.
+  ///   - int: the column is a date within the last \a value days. -1 does not filter.
+  /// Returns an empty list if a key is not a column of the hierarchy.
+  Q_INVOKABLE QStringList filteredPatients(const QMap<QString, QVariant>& filters);
+  Q_INVOKABLE QStringList filteredStudies(const QMap<QString, QVariant>& filters);
+  Q_INVOKABLE QStringList filteredSeries(const QMap<QString, QVariant>& filters);
+  ///@}
+
+  ///@{
+  /// \brief Full-text search, e.g. for type-ahead search boxes.
+  ///
+  /// Return the patients (UID of the Patients table), studies (StudyInstanceUID) or
+  /// series (SeriesInstanceUID) that have a text field containing \a text (case insensitive),
+  /// at most \a limit of them (-1 for no limit). The searched fields are:
+  ///   - patients: PatientsName, PatientID, DisplayedPatientsName
+  ///   - studies: StudyDescription, StudyID, AccessionNumber, ModalitiesInStudy, InstitutionName, ReferringPhysician
+  ///   - series: SeriesDescription, Modality, BodyPartExamined
+  /// Texts of at least 3 characters are looked up in the full-text search index if it is
+  /// available, the table is scanned otherwise.
+  /// \sa isFullTextSearchAvailable()
+  Q_INVOKABLE QStringList searchPatients(const QString& text, int limit = -1);
+  Q_INVOKABLE QStringList searchStudies(const QString& text, int limit = -1);
+  Q_INVOKABLE QStringList searchSeries(const QString& text, int limit = -1);
+  ///@}
+
+  /// Return true if the full-text search indexes of the searched fields are available.
+  /// They are FTS5 virtual tables named <Table>SearchIndex (e.g. "StudiesSearchIndex"),
+  /// whose rowid is the rowid of the table. They require an SQLite library with the FTS5
+  /// extension and the trigram tokenizer (SQLite 3.34 or later).
+  Q_INVOKABLE bool isFullTextSearchAvailable() const;
+
+  /// Full-text query matching the texts that contain \a text, for the
+  /// "<Table>SearchIndex MATCH ?" condition.
+  /// Returns an empty string if \a text is shorter than 3 characters, that the index cannot match.
+  static QString fullTextSearchExpression(const QString& text);
+
+  /// Columns of \a tableName ("Patients", "Studies" or "Series") that are indexed by its
+  /// full-text search index. Other columns can only be searched by scanning the table.
+  static QStringList fullTextSearchColumns(const QString& tableName);
+
   /// Provide lists of allow and deny servers associated with the patient.
   Q_INVOKABLE QMap<QString, QStringList> connectionsInformationForPatient(const QString patientUID);
   /// Set the allow and deny servers for the patient
@@ -210,6 +334,23 @@ public:
   Q_INVOKABLE QString seriesForFile(QString fileName);
   Q_INVOKABLE QString instanceForFile(const QString fileName);
   Q_INVOKABLE QDateTime insertDateTimeForInstance(const QString fileName);
+  /// Path where the file of an instance is stored when it is copied into the database folder
+  Q_INVOKABLE QString storagePathForInstance(const QString& studyInstanceUID,
+                                             const QString& seriesInstanceUID,
+                                             const QString& sopInstanceUID);
+  /// Write a received instance to a staging file (storagePathForInstance() with a ".part" suffix)
+  /// and return its path in \a storedFilePath. The staging file replaces the file at
+  /// storagePathForInstance() only when the instance is inserted, so that the file of an instance
+  /// that is already indexed is kept if the retrieve fails or is canceled.
+  /// Pixel data (and the elements that follow it) is then removed from \a dataset, so that only the
+  /// header is kept in memory until the instance is inserted; it is read from the file when needed.
+  /// Returns false (and removes the incomplete file) if the instance could not be stored.
+  bool storeInstanceFile(DcmDataset* dataset, const QString& studyInstanceUID,
+                         const QString& seriesInstanceUID, const QString& sopInstanceUID,
+                         QString& storedFilePath);
+  /// Return the path of the thumbnail file of an instance, or an empty string if there is none.
+  /// Only the thumbnails created by storeThumbnailFile() are files: the thumbnails stored in the
+  /// thumbnail cache (see storeThumbnail()) have no path and must be read with thumbnailForInstance().
   Q_INVOKABLE QString thumbnailPathForInstance(const QString& studyInstanceUID,
                                                const QString& seriesInstanceUID,
                                                const QString& sopInstanceUID);
@@ -219,6 +360,30 @@ public:
                                       const QString& sopInstanceUID,
                                       const QString& modality = "",
                                       QColor backgroundColor = Qt::darkGray);
+  /// Get the thumbnail of an instance from the thumbnail cache or, for thumbnails
+  /// created by storeThumbnailFile(), from the thumbnail file.
+  /// Returns false if there is no thumbnail for the instance.
+  Q_INVOKABLE bool thumbnailForInstance(const QString& studyInstanceUID,
+                                        const QString& seriesInstanceUID,
+                                        const QString& sopInstanceUID,
+                                        QImage& image);
+  /// Generate the thumbnail of an instance and store it in the thumbnail cache.
+  /// If the thumbnail generator is not a ctkDICOMThumbnailGenerator or the thumbnail
+  /// cache is disabled, the thumbnail is stored as a file (see storeThumbnailFile()).
+  Q_INVOKABLE bool storeThumbnail(const QString& originalFilePath,
+                                  const QString& studyInstanceUID,
+                                  const QString& seriesInstanceUID,
+                                  const QString& sopInstanceUID,
+                                  const QString& modality = "",
+                                  QColor backgroundColor = Qt::darkGray);
+  /// Generate the thumbnails of several instances of a study (e.g. one instance
+  /// for each series of the study) in a single batch.
+  /// Each file is decoded once and all the thumbnails are written to the
+  /// study container at once.
+  /// Returns the series instance UID of each instance that has an up-to-date thumbnail.
+  QMap<QString, QString> storeThumbnails(const QString& studyInstanceUID,
+                                         const QStringList& sopInstanceUIDs,
+                                         QColor backgroundColor = Qt::darkGray);
 
   Q_INVOKABLE int patientsCount();
   Q_INVOKABLE int studiesCount();
@@ -227,7 +392,34 @@ public:
 
   Q_INVOKABLE QStringList allFiles();
 
+  /// Get the insertion time of all the files in the database.
+  /// \deprecated Reads the whole Images table, which is slow for large databases.
+  /// Use filesModifiedTimes() or filesModifiedTimesInDirectory() instead.
   bool allFilesModifiedTimes(QMap<QString, QDateTime>& modifiedTimeForFilepath);
+  /// Get the insertion time of the given files. Files that are not in the database are not added to the map.
+  bool filesModifiedTimes(const QStringList& filePaths, QMap<QString, QDateTime>& modifiedTimeForFilepath);
+  /// Get the insertion time of the files located directly in a directory.
+  /// If subdirectoryNames is specified then it is set to the names of the subdirectories
+  /// that contain files in the database (at any depth).
+  /// Uses the file name index, therefore it is fast even for very large databases.
+  bool filesModifiedTimesInDirectory(const QString& directoryPath, QMap<QString, QDateTime>& modifiedTimeForFilepath,
+    QStringList* subdirectoryNames = nullptr);
+
+  /// Remove the instances that were loaded from the given files.
+  /// Image counts of the affected series are updated.
+  /// If cleanup is true then series, studies and patients left without images are removed.
+  Q_INVOKABLE bool removeFiles(const QStringList& filePaths, bool cleanup = true);
+  /// Remove the instances of all the files located in a directory or any of its subdirectories.
+  Q_INVOKABLE bool removeFilesInDirectory(const QString& directoryPath, bool cleanup = true);
+
+  ///@{
+  /// Directories watched by the indexer, stored in the database so that watching can be resumed
+  /// after restart. \sa ctkDICOMIndexer::addWatchedDirectory()
+  QList<WatchedDirectory> watchedDirectories();
+  bool setWatchedDirectory(const WatchedDirectory& watchedDirectory);
+  bool setWatchedDirectoryScanCursor(const QString& directoryPath, const QDateTime& scanCursor);
+  bool removeWatchedDirectory(const QString& directoryPath);
+  ///@}
 
   /// \brief Load the header from a file and allow access to elements
   /// @param sopInstanceUID A string with the uid for a given instance
@@ -302,6 +494,23 @@ public:
   void setUseShortStoragePath(bool useShort);
   bool useShortStoragePath()const;
 
+  /// SQLite journal mode of the database and tag cache files.
+  /// Accepted values are DELETE, TRUNCATE, PERSIST, MEMORY, WAL and OFF.
+  /// The default is WAL (write-ahead logging), which allows readers to run concurrently
+  /// with an ongoing insert transaction. WAL requires shared memory, therefore DELETE
+  /// should be used if the database is located on a network file system.
+  /// Changing the mode of an open database requires that no other connection is active.
+  /// In-memory databases are not affected.
+  void setJournalMode(const QString& mode);
+  QString journalMode()const;
+
+  /// Maximum number of read-only connections (one per thread) that are opened for
+  /// browsing queries such as seriesForStudy() or filesForSeries(). Default is 8.
+  /// If set to 0 then all queries run on the main connection.
+  /// \sa readOnlyDatabase()
+  void setMaximumReadConnections(int maximum);
+  int maximumReadConnections()const;
+
   /// Update the fields in the database that are used for displaying information
   /// from information stored in the tag-cache.
   /// Displayed fields are useful if the raw DICOM tags are not human readable, or
@@ -401,6 +610,25 @@ public:
   /// Remove all tags corresponding to a SOP instance UID
   Q_INVOKABLE void removeCachedTags(const QString sopInstanceUID);
 
+  /// \brief Load cached tags of all the instances of a series into memory.
+  ///
+  /// Cached tags are kept in an in-memory least recently used cache in front of
+  /// the tag cache table. This reads the tags of all the instances of the series
+  /// with one query per chunk of instances, so that the next calls of cachedTag(),
+  /// getCachedTags(), instanceValue() and fileValue() for these instances do not
+  /// query the table. If \a tags is empty then all cached tags are loaded.
+  /// Values modified by another connection since the last prefetch are read again,
+  /// other reads of cached tags detect such modifications at most once per second.
+  /// Returns false if the tag cache could not be read.
+  Q_INVOKABLE bool prefetchTags(const QString seriesInstanceUID, const QStringList tags = QStringList());
+  /// In-memory cache of the tag cache table, with its hit and miss statistics
+  ctkDICOMTagValueCache* tagValueCache();
+  ///@{
+  /// Number of lookups of cached tags answered from memory, and of lookups that needed a query
+  Q_INVOKABLE int tagCacheHitCount();
+  Q_INVOKABLE int tagCacheMissCount();
+  ///@}
+
   /// Get displayed name of a given field
   Q_INVOKABLE QString displayedNameForField(QString table, QString field) const;
   /// Set displayed name of a given field
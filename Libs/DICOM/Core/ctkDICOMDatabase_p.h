@@ -32,9 +32,21 @@
 // We mean it.
 //
 
+// Qt includes
+#include <QAtomicPointer>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QSqlQuery>
+
 // ctkDICOM includes
 #include "ctkDICOMDatabase.h"
 #include "ctkDICOMDisplayedFieldGenerator.h"
+#include "ctkDICOMHierarchySnapshot.h"
+#include "ctkDICOMTagValueCache.h"
+#include "ctkDICOMThumbnailCache.h"
+
+class QThread;
 
 class CTK_DICOM_CORE_EXPORT ctkDICOMDatabasePrivate
 {
@@ -107,6 +119,48 @@ public:
   /// \return The series instance UID if successfully found, empty string otherwise
   QString getDisplaySeriesFieldsKey(QString seriesInstanceUID, QMap<QString, QMap<QString, QString> > &displayedFieldsMapSeries);
 
+  /// Create partial index of the instances that need displayed fields update (DisplayedFieldsUpdatedTimestamp is NULL),
+  /// so that updateDisplayedFields does not need to scan all the instances in the database.
+  void createDisplayedFieldsUpdateIndex();
+
+  /// Create the table that stores the directories watched by the indexer.
+  /// Created on demand so that existing databases get it without requiring a schema update.
+  void createWatchedDirectoriesTable();
+
+  /// Create the HierarchyChanges table and the triggers that count the changes and
+  /// removals of patients, studies and series, used to validate the hierarchy snapshot.
+  /// If \a tablesRecreated is true, the hierarchy is counted as removed.
+  void createHierarchyChangeCounters(bool tablesRecreated = false);
+
+  /// Select the UIDs of one level of the hierarchy (0: patients, 1: studies, 2: series)
+  /// matching the filters, with a single query joining the parent tables that are filtered.
+  /// \sa ctkDICOMDatabase::filteredPatients()
+  QStringList filteredUIDs(int level, const QMap<QString, QVariant>& filters);
+
+  /// Create the full-text search indexes of the patients, studies and series (<Table>SearchIndex),
+  /// filling them from the tables if they did not exist or if \a rebuild is set.
+  /// Created here (and not in the schema) so that existing databases get them without requiring a schema
+  /// update, and so that databases remain usable with SQLite libraries that do not support them.
+  /// Sets FullTextSearchAvailable.
+  void createFullTextSearchIndexes(bool rebuild = false);
+  /// Re-create the content of the full-text search indexes from the tables.
+  /// Needed after the rowids of the tables have changed (e.g. VACUUM).
+  void rebuildFullTextSearchIndexes();
+  /// Remove the full-text search index entries of the rows that are not in the tables anymore
+  void removeOrphanedFullTextSearchEntries();
+  /// Update the full-text search index entry of a patient (UID of the Patients table), study or series
+  /// after it has been inserted or modified.
+  void updateFullTextSearchIndex(int level, const QVariant& uid);
+  /// Text columns of a level that are indexed by its full-text search index
+  QStringList searchableColumns(int level) const;
+  /// UIDs of a level whose searchable columns contain \a text, \sa ctkDICOMDatabase::searchPatients()
+  QStringList search(int level, const QString& text, int limit);
+  /// LIKE pattern (with '\' as escape character) matching strings that contain \a text
+  static QString likePattern(const QString& text);
+
+  /// Internal path prefix (ending with "/") of the files located in a directory
+  QString internalDirectoryPrefix(const QString& directoryPath);
+
   /// Get all Filename values from table
   QStringList filenames(QString table);
 
@@ -135,12 +189,69 @@ public:
 
   QString LastError;
   QSqlDatabase Database;
+
+  /// SQLite journal mode applied to the database and tag cache connections
+  QString JournalMode;
+  /// Apply JournalMode to a connection. Has no effect on in-memory databases.
+  void applyJournalMode(QSqlDatabase& database);
+
+  /// Get the connection to use for read-only queries in the calling thread.
+  /// Each thread gets its own read-only connection to the database file, opened
+  /// on first use, so that browsing queries do not wait for the connection that
+  /// is used for inserting. The main connection is returned for in-memory databases,
+  /// when the pool is full, or while a write transaction is in progress on the
+  /// main connection (so that uncommitted changes are visible to the caller).
+  QSqlDatabase readDatabase();
+  /// Close and remove the read-only connections of all the threads, so that no file
+  /// handle is left open on the database file.
+  /// Must be called before the main connection is closed or replaced, while no other
+  /// thread is querying the database.
+  void closeReadDatabases();
+  /// Close and remove the read-only connection of a thread (called when the thread finishes)
+  void closeReadDatabase(QThread* thread);
+  int MaximumReadConnections;
+  QMutex ReadConnectionsMutex;
+  /// Read-only connections, by thread. The connections are kept here (and not looked up
+  /// by name) so that they can be closed from any thread.
+  QHash<QThread*, QSqlDatabase> ReadConnections;
+  /// Used for making connection names unique
+  int ReadConnectionsCounter;
+
+  /// Run a query selecting a key and a value for each row, where the key is in the
+  /// list of placeholders "%1" of \a queryPattern, and group the values by key.
+  /// Keys are bound in chunks (the number of bound values per query is limited by SQLite)
+  /// and the prepared query is reused for all the chunks of the same size.
+  /// Values are converted from internal to absolute paths if \a absolutePaths is set.
+  bool groupedLookup(const QString& queryPattern, const QStringList& keys,
+    QMap<QString, QStringList>& valuesForKey, bool absolutePaths = false);
+
+  /// Start, commit and rollback a transaction on the main connection
+  /// and keep track of it in WriteTransactionThread.
+  bool beginWriteTransaction();
+  bool commitWriteTransaction();
+  bool rollbackWriteTransaction();
+  /// Thread that has a write transaction in progress on the main connection (nullptr if none)
+  QAtomicPointer<void> WriteTransactionThread;
   QMap<QString, QString> LoadedHeader;
   bool DisplayedFieldsTableAvailable;
+  /// Set if the SQLite library supports the FTS5 trigram tokenizer and the search indexes have been created
+  bool FullTextSearchAvailable;
 
   bool UseShortStoragePath;
 
   ctkDICOMAbstractThumbnailGenerator* ThumbnailGenerator;
+  ctkDICOMThumbnailCache* ThumbnailCache;
+
+  ctkDICOMHierarchySnapshot* HierarchySnapshot;
+  bool HierarchySnapshotEnabled;
+  /// Time since the hierarchy snapshot was last found up-to-date, invalidated when
+  /// the hierarchy is modified through this object
+  QElapsedTimer HierarchySnapshotCheckTimer;
+  /// Hierarchy snapshot if it can answer the queries of the calling thread, nullptr otherwise.
+  /// If \a throttled is true, the snapshot is not checked against the database if it was found
+  /// up-to-date less than HierarchySnapshotCheckInterval ago, so that the queries of a view
+  /// being populated do not query the database.
+  ctkDICOMHierarchySnapshot* upToDateHierarchySnapshot(bool throttled = false);
 
   ctkDICOMDisplayedFieldGenerator* DisplayedFieldGenerator;
 
@@ -163,6 +274,18 @@ public:
   /// resets the variables to new inserts won't be fooled by leftover values
   void resetLastInsertedValues();
 
+  /// Get a prepared statement for inserting datasets into the main database.
+  /// Statements are compiled on first use and then kept alive until the database
+  /// connection is closed, so that inserting many images of the same series
+  /// does not require compiling the same statements again and again.
+  /// Bound values must be set by the caller and finish() must be called after
+  /// reading the results of SELECT statements.
+  QSqlQuery& insertSessionQuery(const QString& statement);
+  /// Release all prepared statements of the insert session.
+  /// Must be called before the database connection is closed or replaced.
+  void resetInsertSession();
+  QHash<QString, QSqlQuery> InsertSessionQueries;
+
   /// tagCache table has been checked to exist
   bool TagCacheVerified;
   /// tag cache has independent database to avoid locking issue
@@ -173,7 +296,52 @@ public:
   QStringList TagsToPrecache;
   QStringList TagsToExcludeFromStorage;
   bool openTagCacheDatabase();
-  void precacheTags(const ctkDICOMItem& dataset, const QString sopInstanceUID);
+
+  /// Values of the tag cache table read or written by this object,
+  /// stored as returned by cachedTag() (empty if the tag is not in the table).
+  ctkDICOMTagValueCache TagValueCache;
+  /// Value of PRAGMA data_version of TagCacheDatabase when TagValueCache was last checked (-1 if unknown)
+  qint64 TagCacheDataVersion;
+  /// Time since the last check of TagCacheDataVersion
+  QElapsedTimer TagCacheDataVersionTimer;
+  /// Clear TagValueCache if the tag cache table has been modified by another connection
+  /// (e.g. another ctkDICOMDatabase or another application using the same database) since
+  /// the last check. Modifications made through TagCacheDatabase are already applied to TagValueCache.
+  /// If \a throttled is true, nothing is done if the last check is more recent than
+  /// TagCacheDataVersionCheckInterval, so that reading cached values does not query the database.
+  void checkTagCacheDataVersion(bool throttled = false);
+  /// Read the cached tags of instances into TagValueCache with one query per chunk of instances.
+  /// If \a tags is empty then all tags of the instances are loaded, otherwise the
+  /// requested tags that are not in the table are stored as missing.
+  bool loadCachedTags(const QStringList& sopInstanceUIDs, const QStringList& tags = QStringList());
+
+  /// Tag to precache, resolved to a DCMTK tag key
+  struct PrecachedTag
+  {
+    QString Tag;
+    DcmTagKey TagKey;
+    bool ExcludedFromStorage;
+  };
+  /// TagsToPrecache parsed into tag keys. Updated each time TagsToPrecache
+  /// or TagsToExcludeFromStorage changes, to avoid parsing tag strings for each inserted instance.
+  QList<PrecachedTag> PrecachedTags;
+  void updatePrecachedTags();
+
+  /// Tag values that are collected and then written into the tag cache at once
+  struct TagCacheBatch
+  {
+    QVariantList SOPInstanceUIDs;
+    QVariantList Tags;
+    QVariantList Values;
+  };
+  /// Add values of all tags to precache to the batch.
+  /// If headerOnly is true then tags starting from the pixel data are skipped,
+  /// because they are not present in the dataset.
+  void precacheTags(const ctkDICOMItem& dataset, const QString& sopInstanceUID,
+    TagCacheBatch& batch, bool headerOnly = false);
+  /// Write all values of the batch into the tag cache using multi-row inserts and clear the batch.
+  /// The caller is responsible for starting a transaction on the tag cache database.
+  bool writeTagCacheBatch(TagCacheBatch& batch);
 
   /// Insert metadata
   ctkDICOMDatabase::InsertResult insertPatientStudySeries(const ctkDICOMItem& dataset,
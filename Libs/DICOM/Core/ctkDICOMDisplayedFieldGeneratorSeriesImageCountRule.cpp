@@ -63,14 +63,14 @@ void ctkDICOMDisplayedFieldGeneratorSeriesImageCountRule::getDisplayedFieldsForI
   Q_UNUSED(displayedFieldsForCurrentSeries);
   Q_UNUSED(displayedFieldsForCurrentStudy);
   Q_UNUSED(displayedFieldsForCurrentPatient);
-  // Store series identifiers for the instances that of which displayed fields are updated in this run.
-  this->UpdatedSeriesInstanceUIDs.insert(cachedTagsForInstance[dicomTagToString(DCM_SeriesInstanceUID)]);
+  // Count the instances of which displayed fields are updated in this run for each series.
+  this->AddedInstanceCountForSeries[cachedTagsForInstance[dicomTagToString(DCM_SeriesInstanceUID)]]++;
 }
 
 //------------------------------------------------------------------------------
 void ctkDICOMDisplayedFieldGeneratorSeriesImageCountRule::startUpdate()
 {
-  this->UpdatedSeriesInstanceUIDs.clear();
+  this->AddedInstanceCountForSeries.clear();
 }
 
 //------------------------------------------------------------------------------
@@ -82,19 +82,42 @@ void ctkDICOMDisplayedFieldGeneratorSeriesImageCountRule::endUpdate(
   Q_UNUSED(displayedFieldsMapStudy);
   Q_UNUSED(displayedFieldsMapPatient);
   // Update image count for each updated series
-  foreach (QString currentSeriesInstanceUid, this->UpdatedSeriesInstanceUIDs)
+  QSqlQuery storedCountQuery(this->DICOMDatabase->database());
+  storedCountQuery.prepare("SELECT DisplayedCount FROM Series WHERE SeriesInstanceUID = ? ;");
+  QSqlQuery countQuery(this->DICOMDatabase->database());
+  countQuery.prepare("SELECT COUNT(*) FROM Images WHERE SeriesInstanceUID = ? ;");
+  QMap<QString, int>::const_iterator addedCountIt;
+  for (addedCountIt = this->AddedInstanceCountForSeries.constBegin();
+    addedCountIt != this->AddedInstanceCountForSeries.constEnd(); ++addedCountIt)
   {
-    QSqlQuery countQuery(this->DICOMDatabase->database());
-    countQuery.prepare("SELECT COUNT(*) FROM Images WHERE SeriesInstanceUID = ? ;");
-    countQuery.addBindValue(currentSeriesInstanceUid);
-    if (!countQuery.exec())
+    const QString& currentSeriesInstanceUid = addedCountIt.key();
+    storedCountQuery.bindValue(0, currentSeriesInstanceUid);
+    if (!storedCountQuery.exec())
     {
-      qCritical() << Q_FUNC_INFO << "SQLITE ERROR: " << countQuery.lastError().driverText();
+      qCritical() << Q_FUNC_INFO << "SQLITE ERROR: " << storedCountQuery.lastError().driverText();
       continue;
     }
 
-    countQuery.first();
-    int currentCount = countQuery.value(0).toInt();
+    int currentCount = 0;
+    if (storedCountQuery.next() && !storedCountQuery.value(0).isNull())
+    {
+      // Stored count is valid, only the new instances need to be added
+      currentCount = storedCountQuery.value(0).toInt() + addedCountIt.value();
+      storedCountQuery.finish();
+    }
+    else
+    {
+      storedCountQuery.finish();
+      countQuery.bindValue(0, currentSeriesInstanceUid);
+      if (!countQuery.exec())
+      {
+        qCritical() << Q_FUNC_INFO << "SQLITE ERROR: " << countQuery.lastError().driverText();
+        continue;
+      }
+      countQuery.first();
+      currentCount = countQuery.value(0).toInt();
+      countQuery.finish();
+    }
 
     QMap<QString, QString> displayedFieldsForCurrentSeries = displayedFieldsMapSeries[currentSeriesInstanceUid];
     displayedFieldsForCurrentSeries["DisplayedCount"] = QString::number(currentCount);
@@ -22,7 +22,7 @@
 #define __ctkDICOMDisplayedFieldGeneratorSeriesImageCountRule_h
 
 // Qt includes
-#include <QSet>
+#include <QMap>
 #include <QStringList>
 
 #include "ctkDICOMDisplayedFieldGeneratorAbstractRule.h"
@@ -30,6 +30,10 @@
 /// \ingroup DICOM_Core
 ///
 /// Rule for generating number of images in the series that belong to the newly added instances
+///
+/// The count is updated incrementally: the number of newly added instances is added to the
+/// count stored in the database. The images are only counted in the database if there is no
+/// valid stored count (DisplayedCount is set to NULL when images are removed from a series).
 class CTK_DICOM_CORE_EXPORT ctkDICOMDisplayedFieldGeneratorSeriesImageCountRule : public ctkDICOMDisplayedFieldGeneratorAbstractRule
 {
 public:
@@ -62,8 +66,8 @@ public:
                  QMap<QString, QMap<QString, QString> > &displayedFieldsMapPatient) override;
 
 protected:
-  /// Identifiers of the series that contain instances of which displayed fields are updated in this run.
-  QSet<QString> UpdatedSeriesInstanceUIDs;
+  /// Number of instances of which displayed fields are updated in this run, for each series.
+  QMap<QString, int> AddedInstanceCountForSeries;
 };
 
 #endif
@@ -0,0 +1,1057 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QFile>
+#include <QHash>
+#include <QSaveFile>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVector>
+#include <QtEndian>
+
+// ctkCore includes
+#include <ctkLogger.h>
+
+// ctkDICOMCore includes
+#include "ctkDICOMHierarchySnapshot.h"
+
+// STD includes
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+static ctkLogger logger("org.commontk.dicom.DICOMHierarchySnapshot");
+
+//------------------------------------------------------------------------------
+// Snapshot layout (all integers are little endian, sections start at multiples of 8 bytes):
+//
+//   header:  magic (4) | version (4)
+//            | change count of the hierarchy tables (8) | removal count (8) | reserved (16)
+//            | synchronization time (32, UTF-8, zero padded)
+//            | string count (4) | interned string count (4)
+//            | string offsets position (8) | string data position (8) | string data size (8)
+//            | for each level: row count (4) | field count (4) | columns position (8)
+//   strings: offsets in the string data (4 * (string count + 1)) | UTF-8 string data
+//            (string 0 is the empty string)
+//   columns of a level with n rows and F fields:
+//            F columns of string indices (4 * n each), the first one is the UID
+//            | parent row (4 * n, -1 if none) | rows sorted by UID (4 * n)
+//            | first child row in the next level (4 * (n + 1))
+namespace
+{
+const quint32 SNAPSHOT_MAGIC = 0x48544B43; // "CKTH"
+const quint32 SNAPSHOT_VERSION = 2;
+const int LEVEL_COUNT = 3;
+const int STAMP_POSITION = 8;
+const int SYNC_TIME_POSITION = 40;
+const int SYNC_TIME_SIZE = 32;
+const int STRINGS_HEADER_POSITION = 72;
+const int LEVELS_HEADER_POSITION = 104;
+const int LEVEL_HEADER_SIZE = 16;
+const int HEADER_SIZE = LEVELS_HEADER_POSITION + LEVEL_COUNT * LEVEL_HEADER_SIZE;
+
+/// Rows whose displayed fields were updated less than this before the previous update
+/// are read again, so that transactions committed late are not missed.
+const char* const SYNC_TIME_MARGIN = "-60 seconds";
+
+/// The snapshot is rebuilt when incremental updates have added more strings than this
+/// (in addition to the number of strings of the last rebuild), as they are not fully interned.
+const quint32 STRING_GROWTH_MARGIN = 1024;
+
+const char* const LEVEL_TABLES[LEVEL_COUNT] = { "Patients", "Studies", "Series" };
+
+//------------------------------------------------------------------------------
+qint64 align8(qint64 position)
+{
+  return (position + 7) & ~qint64(7);
+}
+
+//------------------------------------------------------------------------------
+int compareBytes(const char* a, int aSize, const char* b, int bSize)
+{
+  int result = memcmp(a, b, static_cast<size_t>(qMin(aSize, bSize)));
+  if (result != 0)
+  {
+    return result;
+  }
+  return aSize - bSize;
+}
+
+//------------------------------------------------------------------------------
+void put32(QByteArray& content, qint64 position, quint32 value)
+{
+  qToLittleEndian<quint32>(value, reinterpret_cast<uchar*>(content.data() + position));
+}
+
+//------------------------------------------------------------------------------
+void put64(QByteArray& content, qint64 position, qint64 value)
+{
+  qToLittleEndian<qint64>(value, reinterpret_cast<uchar*>(content.data() + position));
+}
+}
+
+//------------------------------------------------------------------------------
+// Counters of the HierarchyChanges table of the database, incremented by triggers
+// of the Patients, Studies and Series tables (whichever connection changes them)
+struct ctkDICOMHierarchySnapshotStamp
+{
+  ctkDICOMHierarchySnapshotStamp()
+    : ChangeCount(-1), RemovalCount(-1) {}
+
+  static bool fromDatabase(const QSqlDatabase& database, ctkDICOMHierarchySnapshotStamp& stamp)
+  {
+    QSqlQuery query(database);
+    if (!query.exec("SELECT ChangeCount, RemovalCount FROM HierarchyChanges") || !query.next())
+    {
+      logger.error("Failed to read the hierarchy changes of the database: " + query.lastError().text());
+      return false;
+    }
+    stamp.ChangeCount = query.value(0).toLongLong();
+    stamp.RemovalCount = query.value(1).toLongLong();
+    return true;
+  }
+
+  bool operator==(const ctkDICOMHierarchySnapshotStamp& other) const
+  {
+    return this->ChangeCount == other.ChangeCount && this->RemovalCount == other.RemovalCount;
+  }
+
+  qint64 ChangeCount;
+  qint64 RemovalCount;
+};
+
+//------------------------------------------------------------------------------
+struct ctkDICOMHierarchySnapshotLevel
+{
+  ctkDICOMHierarchySnapshotLevel() : RowCount(0), FieldCount(0), ColumnsPosition(0) {}
+  quint32 RowCount;
+  quint32 FieldCount;
+  qint64 ColumnsPosition;
+};
+
+//------------------------------------------------------------------------------
+// Content of a snapshot being built
+struct ctkDICOMHierarchySnapshotData
+{
+  ctkDICOMHierarchySnapshotData() : InternedStringCount(0)
+  {
+    this->StringOffsets << 0 << 0;
+  }
+
+  int rowCount(int level) const
+  {
+    return this->Columns[level].isEmpty() ? 0 : this->Columns[level][0].count();
+  }
+
+  quint32 intern(const QByteArray& value)
+  {
+    if (value.isEmpty())
+    {
+      return 0;
+    }
+    QHash<QByteArray, quint32>::const_iterator it = this->Strings.constFind(value);
+    if (it != this->Strings.constEnd())
+    {
+      return it.value();
+    }
+    quint32 index = static_cast<quint32>(this->StringOffsets.count() - 1);
+    this->StringData.append(value);
+    this->StringOffsets.append(static_cast<quint32>(this->StringData.size()));
+    this->Strings.insert(value, index);
+    return index;
+  }
+
+  /// Valid until the next call to intern()
+  QByteArray string(quint32 index) const
+  {
+    return QByteArray::fromRawData(this->StringData.constData() + this->StringOffsets[index],
+      this->StringOffsets[index + 1] - this->StringOffsets[index]);
+  }
+
+  QByteArray StringData;
+  QVector<quint32> StringOffsets;
+  /// Strings interned since the data was created
+  QHash<QByteArray, quint32> Strings;
+  quint32 InternedStringCount;
+  /// String indices, by level and field
+  QVector<QVector<quint32> > Columns[LEVEL_COUNT];
+};
+
+//------------------------------------------------------------------------------
+class ctkDICOMHierarchySnapshotPrivate
+{
+  Q_DECLARE_PUBLIC(ctkDICOMHierarchySnapshot);
+
+protected:
+  ctkDICOMHierarchySnapshot* const q_ptr;
+
+public:
+  ctkDICOMHierarchySnapshotPrivate(ctkDICOMHierarchySnapshot& obj);
+
+  static const QStringList& levelFields(int level);
+
+  bool load();
+  /// Parse and validate the header of a snapshot and use it
+  bool attach(const uchar* data, qint64 size);
+  void detach();
+  /// Write the snapshot file and load it.
+  /// The snapshot is kept in memory if the file cannot be written.
+  bool write(const QByteArray& content);
+
+  /// Copy the loaded snapshot to data that can be modified
+  void copy(ctkDICOMHierarchySnapshotData& data) const;
+  /// Read the rows of a level, or only the rows whose displayed fields were updated since \a syncTime
+  bool readRows(const QSqlDatabase& database, int level, const QString& syncTime,
+                ctkDICOMHierarchySnapshotData& data) const;
+  bool readSyncTime(const QSqlDatabase& database, QString& syncTime) const;
+  QByteArray serialize(const ctkDICOMHierarchySnapshotData& data,
+                       const ctkDICOMHierarchySnapshotStamp& stamp, const QString& syncTime) const;
+  static void serializeStamp(QByteArray& content, qint64 position, const ctkDICOMHierarchySnapshotStamp& stamp);
+
+  bool isValidLevel(int level) const
+  {
+    return this->Data && level >= 0 && level < LEVEL_COUNT;
+  }
+  quint32 read32(qint64 position) const
+  {
+    return qFromLittleEndian<quint32>(this->Data + position);
+  }
+  /// Value of a column (field index, or FieldCount for the parents...) of a level
+  quint32 cell(int level, int column, int row) const
+  {
+    const ctkDICOMHierarchySnapshotLevel& levelInfo = this->Levels[level];
+    return this->read32(levelInfo.ColumnsPosition + 4 * (qint64(column) * levelInfo.RowCount + row));
+  }
+  QByteArray stringBytes(quint32 index) const;
+  QString string(quint32 index) const;
+
+  QString FilePath;
+  QFile File;
+  uchar* Map;
+  /// Content of the snapshot when it could not be written to the file
+  QByteArray Buffer;
+  const uchar* Data;
+  qint64 DataSize;
+  bool NeedsRebuild;
+
+  ctkDICOMHierarchySnapshotStamp Stamp;
+  QString SyncTime;
+  quint32 StringCount;
+  quint32 InternedStringCount;
+  qint64 StringOffsetsPosition;
+  qint64 StringDataPosition;
+  ctkDICOMHierarchySnapshotLevel Levels[LEVEL_COUNT];
+
+  int RebuildCount;
+  int IncrementalUpdateCount;
+};
+
+//------------------------------------------------------------------------------
+// ctkDICOMHierarchySnapshotPrivate methods
+
+//------------------------------------------------------------------------------
+ctkDICOMHierarchySnapshotPrivate::ctkDICOMHierarchySnapshotPrivate(ctkDICOMHierarchySnapshot& obj)
+  : q_ptr(&obj)
+  , Map(nullptr)
+  , Data(nullptr)
+  , DataSize(0)
+  , NeedsRebuild(false)
+  , StringCount(0)
+  , InternedStringCount(0)
+  , StringOffsetsPosition(0)
+  , StringDataPosition(0)
+  , RebuildCount(0)
+  , IncrementalUpdateCount(0)
+{
+}
+
+//------------------------------------------------------------------------------
+const QStringList& ctkDICOMHierarchySnapshotPrivate::levelFields(int level)
+{
+  static const QStringList patientFields = QStringList()
+    << "UID" << "PatientID" << "PatientsName" << "PatientsBirthDate" << "PatientsSex" << "InsertTimestamp"
+    << "DisplayedPatientsName" << "DisplayedNumberOfStudies" << "DisplayedLastStudyDate";
+  static const QStringList studyFields = QStringList()
+    << "StudyInstanceUID" << "PatientsUID" << "StudyID" << "StudyDate" << "StudyTime" << "StudyDescription"
+    << "AccessionNumber" << "ModalitiesInStudy" << "InsertTimestamp" << "DisplayedNumberOfSeries";
+  static const QStringList seriesFields = QStringList()
+    << "SeriesInstanceUID" << "StudyInstanceUID" << "SeriesNumber" << "SeriesDate" << "SeriesTime"
+    << "SeriesDescription" << "Modality" << "BodyPartExamined" << "InsertTimestamp"
+    << "DisplayedCount" << "DisplayedSize" << "DisplayedNumberOfFrames";
+  static const QStringList noFields;
+  switch (level)
+  {
+    case ctkDICOMHierarchySnapshot::PatientLevel: return patientFields;
+    case ctkDICOMHierarchySnapshot::StudyLevel: return studyFields;
+    case ctkDICOMHierarchySnapshot::SeriesLevel: return seriesFields;
+    default: return noFields;
+  }
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMHierarchySnapshotPrivate::load()
+{
+  if (this->Data)
+  {
+    return true;
+  }
+  if (this->FilePath.isEmpty())
+  {
+    return false;
+  }
+  this->File.setFileName(this->FilePath);
+  if (!this->File.exists() || !this->File.open(QIODevice::ReadOnly))
+  {
+    return false;
+  }
+  qint64 fileSize = this->File.size();
+  this->Map = fileSize >= HEADER_SIZE ? this->File.map(0, fileSize) : nullptr;
+  if (!this->Map || !this->attach(this->Map, fileSize))
+  {
+    logger.warn("Ignoring invalid hierarchy snapshot " + this->FilePath);
+    this->detach();
+    return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMHierarchySnapshotPrivate::attach(const uchar* data, qint64 size)
+{
+  if (size < HEADER_SIZE
+    || qFromLittleEndian<quint32>(data) != SNAPSHOT_MAGIC
+    || qFromLittleEndian<quint32>(data + 4) != SNAPSHOT_VERSION)
+  {
+    return false;
+  }
+
+  ctkDICOMHierarchySnapshotStamp stamp;
+  stamp.ChangeCount = qFromLittleEndian<qint64>(data + STAMP_POSITION);
+  stamp.RemovalCount = qFromLittleEndian<qint64>(data + STAMP_POSITION + 8);
+
+  const char* syncTime = reinterpret_cast<const char*>(data + SYNC_TIME_POSITION);
+  int syncTimeSize = 0;
+  while (syncTimeSize < SYNC_TIME_SIZE && syncTime[syncTimeSize] != '\0')
+  {
+    ++syncTimeSize;
+  }
+
+  quint32 stringCount = qFromLittleEndian<quint32>(data + STRINGS_HEADER_POSITION);
+  quint32 internedStringCount = qFromLittleEndian<quint32>(data + STRINGS_HEADER_POSITION + 4);
+  qint64 stringOffsetsPosition = qFromLittleEndian<qint64>(data + STRINGS_HEADER_POSITION + 8);
+  qint64 stringDataPosition = qFromLittleEndian<qint64>(data + STRINGS_HEADER_POSITION + 16);
+  qint64 stringDataSize = qFromLittleEndian<qint64>(data + STRINGS_HEADER_POSITION + 24);
+  if (stringCount == 0
+    || stringOffsetsPosition < HEADER_SIZE || stringOffsetsPosition + 4 * (qint64(stringCount) + 1) > size
+    || stringDataPosition < HEADER_SIZE || stringDataSize < 0 || stringDataPosition + stringDataSize > size)
+  {
+    return false;
+  }
+  // Strings must not point out of the string data
+  quint32 previousOffset = 0;
+  for (quint32 index = 0; index <= stringCount; ++index)
+  {
+    quint32 offset = qFromLittleEndian<quint32>(data + stringOffsetsPosition + 4 * qint64(index));
+    if (offset < previousOffset || offset > stringDataSize)
+    {
+      return false;
+    }
+    previousOffset = offset;
+  }
+
+  ctkDICOMHierarchySnapshotLevel levels[LEVEL_COUNT];
+  for (int level = 0; level < LEVEL_COUNT; ++level)
+  {
+    const uchar* levelHeader = data + LEVELS_HEADER_POSITION + level * LEVEL_HEADER_SIZE;
+    levels[level].RowCount = qFromLittleEndian<quint32>(levelHeader);
+    levels[level].FieldCount = qFromLittleEndian<quint32>(levelHeader + 4);
+    levels[level].ColumnsPosition = qFromLittleEndian<qint64>(levelHeader + 8);
+    qint64 rowCount = levels[level].RowCount;
+    if (levels[level].FieldCount != static_cast<quint32>(levelFields(level).count())
+      || rowCount > std::numeric_limits<int>::max()
+      || levels[level].ColumnsPosition < HEADER_SIZE
+      || levels[level].ColumnsPosition + 4 * (rowCount * (levels[level].FieldCount + 2) + rowCount + 1) > size)
+    {
+      return false;
+    }
+  }
+
+  this->Data = data;
+  this->DataSize = size;
+  this->Stamp = stamp;
+  this->SyncTime = QString::fromUtf8(syncTime, syncTimeSize);
+  this->StringCount = stringCount;
+  this->InternedStringCount = internedStringCount;
+  this->StringOffsetsPosition = stringOffsetsPosition;
+  this->StringDataPosition = stringDataPosition;
+  for (int level = 0; level < LEVEL_COUNT; ++level)
+  {
+    this->Levels[level] = levels[level];
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMHierarchySnapshotPrivate::detach()
+{
+  if (this->Map)
+  {
+    this->File.unmap(this->Map);
+    this->Map = nullptr;
+  }
+  this->File.close();
+  this->Buffer.clear();
+  this->Data = nullptr;
+  this->DataSize = 0;
+  for (int level = 0; level < LEVEL_COUNT; ++level)
+  {
+    this->Levels[level] = ctkDICOMHierarchySnapshotLevel();
+  }
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMHierarchySnapshotPrivate::write(const QByteArray& content)
+{
+  // The file cannot be replaced while it is mapped on some platforms
+  this->detach();
+
+  QSaveFile file(this->FilePath);
+  if (file.open(QIODevice::WriteOnly)
+    && file.write(content) == content.size()
+    && file.commit())
+  {
+    if (this->load())
+    {
+      return true;
+    }
+  }
+  else
+  {
+    logger.warn("Failed to write hierarchy snapshot " + this->FilePath + ": " + file.errorString());
+  }
+
+  this->Buffer = content;
+  if (!this->attach(reinterpret_cast<const uchar*>(this->Buffer.constData()), this->Buffer.size()))
+  {
+    this->detach();
+    return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMHierarchySnapshotPrivate::copy(ctkDICOMHierarchySnapshotData& data) const
+{
+  data.StringData = QByteArray(reinterpret_cast<const char*>(this->Data + this->StringDataPosition),
+    static_cast<int>(this->read32(this->StringOffsetsPosition + 4 * qint64(this->StringCount))));
+  data.StringOffsets.resize(static_cast<int>(this->StringCount) + 1);
+  for (quint32 index = 0; index <= this->StringCount; ++index)
+  {
+    data.StringOffsets[index] = this->read32(this->StringOffsetsPosition + 4 * qint64(index));
+  }
+  data.Strings.clear();
+  data.InternedStringCount = this->InternedStringCount;
+  for (int level = 0; level < LEVEL_COUNT; ++level)
+  {
+    const ctkDICOMHierarchySnapshotLevel& levelInfo = this->Levels[level];
+    data.Columns[level].resize(static_cast<int>(levelInfo.FieldCount));
+    for (int field = 0; field < static_cast<int>(levelInfo.FieldCount); ++field)
+    {
+      QVector<quint32>& column = data.Columns[level][field];
+      column.resize(static_cast<int>(levelInfo.RowCount));
+      for (int row = 0; row < column.count(); ++row)
+      {
+        quint32 index = this->cell(level, field, row);
+        column[row] = index < this->StringCount ? index : 0;
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMHierarchySnapshotPrivate::readRows(const QSqlDatabase& database, int level,
+  const QString& syncTime, ctkDICOMHierarchySnapshotData& data) const
+{
+  const QStringList& fields = levelFields(level);
+  bool incremental = !syncTime.isEmpty();
+  QString queryString = QString("SELECT %1 FROM %2").arg(fields.join(", ")).arg(LEVEL_TABLES[level]);
+  if (incremental)
+  {
+    queryString += " WHERE DisplayedFieldsUpdatedTimestamp IS NULL OR DisplayedFieldsUpdatedTimestamp >= ?";
+  }
+  queryString += " ORDER BY rowid";
+
+  QSqlQuery query(database);
+  query.setForwardOnly(true);
+  query.prepare(queryString);
+  if (incremental)
+  {
+    query.addBindValue(syncTime);
+  }
+  if (!query.exec())
+  {
+    logger.error("Failed to read " + QString(LEVEL_TABLES[level]) + " for the hierarchy snapshot: "
+      + query.lastError().text());
+    return false;
+  }
+
+  QVector<QVector<quint32> >& columns = data.Columns[level];
+  columns.resize(fields.count());
+  QHash<QString, int> addedRows;
+  while (query.next())
+  {
+    QString uid = query.value(0).toString();
+    if (uid.isEmpty())
+    {
+      continue;
+    }
+    int row = -1;
+    if (incremental)
+    {
+      // Rows of the loaded snapshot are the first rows of the data
+      row = this->Data ? q_func()->row(static_cast<ctkDICOMHierarchySnapshot::Level>(level), uid) : -1;
+      if (row < 0)
+      {
+        row = addedRows.value(uid, -1);
+      }
+    }
+    if (row < 0)
+    {
+      row = data.rowCount(level);
+      for (int field = 0; field < fields.count(); ++field)
+      {
+        columns[field].append(data.intern(query.value(field).toString().toUtf8()));
+      }
+      if (incremental)
+      {
+        addedRows.insert(uid, row);
+      }
+      continue;
+    }
+    for (int field = 1; field < fields.count(); ++field)
+    {
+      QByteArray value = query.value(field).toString().toUtf8();
+      if (data.string(columns[field][row]) != value)
+      {
+        columns[field][row] = data.intern(value);
+      }
+    }
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMHierarchySnapshotPrivate::readSyncTime(const QSqlDatabase& database, QString& syncTime) const
+{
+  // Same format as the CURRENT_TIMESTAMP stored in DisplayedFieldsUpdatedTimestamp
+  QSqlQuery query(database);
+  if (!query.exec(QString("SELECT datetime('now', '%1')").arg(SYNC_TIME_MARGIN)) || !query.next())
+  {
+    logger.error("Failed to get the database time for the hierarchy snapshot: " + query.lastError().text());
+    return false;
+  }
+  syncTime = query.value(0).toString();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMHierarchySnapshotPrivate::serializeStamp(QByteArray& content, qint64 position,
+  const ctkDICOMHierarchySnapshotStamp& stamp)
+{
+  put64(content, position, stamp.ChangeCount);
+  put64(content, position + 8, stamp.RemovalCount);
+}
+
+//------------------------------------------------------------------------------
+QByteArray ctkDICOMHierarchySnapshotPrivate::serialize(const ctkDICOMHierarchySnapshotData& data,
+  const ctkDICOMHierarchySnapshotStamp& stamp, const QString& syncTime) const
+{
+  // Order the rows so that the children of a row are contiguous,
+  // rows without parent (e.g. inserted while the snapshot was read) are last.
+  QVector<int> orders[LEVEL_COUNT];
+  QVector<qint32> parents[LEVEL_COUNT];
+  QVector<quint32> firstChildren[LEVEL_COUNT];
+  for (int level = 0; level < LEVEL_COUNT; ++level)
+  {
+    int rowCount = data.rowCount(level);
+    orders[level].resize(rowCount);
+    for (int row = 0; row < rowCount; ++row)
+    {
+      orders[level][row] = row;
+    }
+    if (level == 0)
+    {
+      parents[level].fill(-1, rowCount);
+      continue;
+    }
+
+    int parentCount = data.rowCount(level - 1);
+    QHash<QByteArray, int> parentRows;
+    parentRows.reserve(parentCount);
+    for (int parentRow = 0; parentRow < parentCount; ++parentRow)
+    {
+      parentRows.insert(data.string(data.Columns[level - 1][0][orders[level - 1][parentRow]]), parentRow);
+    }
+    QVector<qint32> unorderedParents(rowCount);
+    for (int row = 0; row < rowCount; ++row)
+    {
+      unorderedParents[row] = parentRows.value(data.string(data.Columns[level][1][row]), -1);
+    }
+    std::stable_sort(orders[level].begin(), orders[level].end(), [&unorderedParents](int a, int b)
+    {
+      quint32 parentA = static_cast<quint32>(unorderedParents[a]);
+      quint32 parentB = static_cast<quint32>(unorderedParents[b]);
+      return parentA < parentB;
+    });
+
+    parents[level].resize(rowCount);
+    firstChildren[level - 1].fill(0, parentCount + 1);
+    for (int row = 0; row < rowCount; ++row)
+    {
+      parents[level][row] = unorderedParents[orders[level][row]];
+      if (parents[level][row] >= 0)
+      {
+        ++firstChildren[level - 1][parents[level][row] + 1];
+      }
+    }
+    for (int parentRow = 0; parentRow < parentCount; ++parentRow)
+    {
+      firstChildren[level - 1][parentRow + 1] += firstChildren[level - 1][parentRow];
+    }
+  }
+  firstChildren[LEVEL_COUNT - 1].fill(0, data.rowCount(LEVEL_COUNT - 1) + 1);
+
+  quint32 stringCount = static_cast<quint32>(data.StringOffsets.count() - 1);
+  qint64 stringOffsetsPosition = HEADER_SIZE;
+  qint64 stringDataPosition = align8(stringOffsetsPosition + 4 * (qint64(stringCount) + 1));
+  qint64 position = align8(stringDataPosition + data.StringData.size());
+  qint64 columnsPositions[LEVEL_COUNT];
+  for (int level = 0; level < LEVEL_COUNT; ++level)
+  {
+    qint64 rowCount = data.rowCount(level);
+    columnsPositions[level] = position;
+    position = align8(position + 4 * (rowCount * (levelFields(level).count() + 2) + rowCount + 1));
+  }
+
+  QByteArray content(static_cast<int>(position), '\0');
+  put32(content, 0, SNAPSHOT_MAGIC);
+  put32(content, 4, SNAPSHOT_VERSION);
+  serializeStamp(content, STAMP_POSITION, stamp);
+  QByteArray syncTimeBytes = syncTime.toUtf8().left(SYNC_TIME_SIZE);
+  memcpy(content.data() + SYNC_TIME_POSITION, syncTimeBytes.constData(), static_cast<size_t>(syncTimeBytes.size()));
+  put32(content, STRINGS_HEADER_POSITION, stringCount);
+  put32(content, STRINGS_HEADER_POSITION + 4, data.InternedStringCount);
+  put64(content, STRINGS_HEADER_POSITION + 8, stringOffsetsPosition);
+  put64(content, STRINGS_HEADER_POSITION + 16, stringDataPosition);
+  put64(content, STRINGS_HEADER_POSITION + 24, data.StringData.size());
+  for (int level = 0; level < LEVEL_COUNT; ++level)
+  {
+    qint64 levelHeaderPosition = LEVELS_HEADER_POSITION + level * LEVEL_HEADER_SIZE;
+    put32(content, levelHeaderPosition, static_cast<quint32>(data.rowCount(level)));
+    put32(content, levelHeaderPosition + 4, static_cast<quint32>(levelFields(level).count()));
+    put64(content, levelHeaderPosition + 8, columnsPositions[level]);
+  }
+
+  for (quint32 index = 0; index <= stringCount; ++index)
+  {
+    put32(content, stringOffsetsPosition + 4 * qint64(index), data.StringOffsets[index]);
+  }
+  memcpy(content.data() + stringDataPosition, data.StringData.constData(), static_cast<size_t>(data.StringData.size()));
+
+  for (int level = 0; level < LEVEL_COUNT; ++level)
+  {
+    const QVector<int>& order = orders[level];
+    int rowCount = order.count();
+    qint64 columnPosition = columnsPositions[level];
+    const QVector<QVector<quint32> >& columns = data.Columns[level];
+    for (int field = 0; field < levelFields(level).count(); ++field)
+    {
+      for (int row = 0; row < rowCount; ++row)
+      {
+        put32(content, columnPosition + 4 * qint64(row), columns[field][order[row]]);
+      }
+      columnPosition += 4 * qint64(rowCount);
+    }
+    for (int row = 0; row < rowCount; ++row)
+    {
+      put32(content, columnPosition + 4 * qint64(row), static_cast<quint32>(parents[level][row]));
+    }
+    columnPosition += 4 * qint64(rowCount);
+
+    QVector<int> uidOrder(rowCount);
+    for (int row = 0; row < rowCount; ++row)
+    {
+      uidOrder[row] = row;
+    }
+    std::sort(uidOrder.begin(), uidOrder.end(), [&data, &columns, &order](int a, int b)
+    {
+      QByteArray uidA = data.string(columns[0][order[a]]);
+      QByteArray uidB = data.string(columns[0][order[b]]);
+      return compareBytes(uidA.constData(), uidA.size(), uidB.constData(), uidB.size()) < 0;
+    });
+    for (int row = 0; row < rowCount; ++row)
+    {
+      put32(content, columnPosition + 4 * qint64(row), static_cast<quint32>(uidOrder[row]));
+    }
+    columnPosition += 4 * qint64(rowCount);
+
+    for (int row = 0; row <= rowCount; ++row)
+    {
+      put32(content, columnPosition + 4 * qint64(row), firstChildren[level][row]);
+    }
+  }
+  return content;
+}
+
+//------------------------------------------------------------------------------
+QByteArray ctkDICOMHierarchySnapshotPrivate::stringBytes(quint32 index) const
+{
+  if (index >= this->StringCount)
+  {
+    return QByteArray();
+  }
+  quint32 begin = this->read32(this->StringOffsetsPosition + 4 * qint64(index));
+  quint32 end = this->read32(this->StringOffsetsPosition + 4 * qint64(index) + 4);
+  return QByteArray::fromRawData(reinterpret_cast<const char*>(this->Data + this->StringDataPosition + begin),
+    static_cast<int>(end - begin));
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMHierarchySnapshotPrivate::string(quint32 index) const
+{
+  QByteArray bytes = this->stringBytes(index);
+  return QString::fromUtf8(bytes.constData(), bytes.size());
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMHierarchySnapshot methods
+
+//------------------------------------------------------------------------------
+ctkDICOMHierarchySnapshot::ctkDICOMHierarchySnapshot(QObject* parent)
+  : QObject(parent)
+  , d_ptr(new ctkDICOMHierarchySnapshotPrivate(*this))
+{
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMHierarchySnapshot::~ctkDICOMHierarchySnapshot()
+{
+  Q_D(ctkDICOMHierarchySnapshot);
+  d->detach();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMHierarchySnapshot::setFilePath(const QString& filePath)
+{
+  Q_D(ctkDICOMHierarchySnapshot);
+  if (d->FilePath == filePath)
+  {
+    return;
+  }
+  d->detach();
+  d->FilePath = filePath;
+  d->NeedsRebuild = false;
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMHierarchySnapshot::filePath() const
+{
+  Q_D(const ctkDICOMHierarchySnapshot);
+  return d->FilePath;
+}
+
+//------------------------------------------------------------------------------
+QStringList ctkDICOMHierarchySnapshot::fields(Level level)
+{
+  return ctkDICOMHierarchySnapshotPrivate::levelFields(level);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMHierarchySnapshot::load()
+{
+  Q_D(ctkDICOMHierarchySnapshot);
+  return d->load();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMHierarchySnapshot::isLoaded() const
+{
+  Q_D(const ctkDICOMHierarchySnapshot);
+  return d->Data != nullptr;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMHierarchySnapshot::isUpToDate(const QSqlDatabase& database) const
+{
+  Q_D(const ctkDICOMHierarchySnapshot);
+  ctkDICOMHierarchySnapshotStamp stamp;
+  return d->Data && !d->NeedsRebuild
+    && ctkDICOMHierarchySnapshotStamp::fromDatabase(database, stamp) && stamp == d->Stamp;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMHierarchySnapshot::update(const QSqlDatabase& database)
+{
+  Q_D(ctkDICOMHierarchySnapshot);
+  if (d->FilePath.isEmpty() || !database.isOpen() || database.databaseName() == ":memory:")
+  {
+    return false;
+  }
+  // Changes committed after the counters are read are picked up by the next update
+  ctkDICOMHierarchySnapshotStamp stamp;
+  if (!ctkDICOMHierarchySnapshotStamp::fromDatabase(database, stamp))
+  {
+    return false;
+  }
+  d->load();
+  if (!d->Data || d->NeedsRebuild
+    || d->StringCount > 2 * d->InternedStringCount + STRING_GROWTH_MARGIN
+    // Removed rows (or a database re-created with fewer changes)
+    || stamp.RemovalCount != d->Stamp.RemovalCount || stamp.ChangeCount < d->Stamp.ChangeCount)
+  {
+    return this->rebuild(database);
+  }
+  if (stamp == d->Stamp)
+  {
+    return true;
+  }
+  QString syncTime;
+  if (!d->readSyncTime(database, syncTime))
+  {
+    return false;
+  }
+
+  ctkDICOMHierarchySnapshotData data;
+  d->copy(data);
+  for (int level = 0; level < LEVEL_COUNT; ++level)
+  {
+    if (!d->readRows(database, level, d->SyncTime, data))
+    {
+      return false;
+    }
+  }
+
+  ++d->IncrementalUpdateCount;
+  return d->write(d->serialize(data, stamp, syncTime));
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMHierarchySnapshot::rebuild(const QSqlDatabase& database)
+{
+  Q_D(ctkDICOMHierarchySnapshot);
+  if (d->FilePath.isEmpty() || !database.isOpen() || database.databaseName() == ":memory:")
+  {
+    return false;
+  }
+
+  ctkDICOMHierarchySnapshotStamp stamp;
+  QString syncTime;
+  if (!ctkDICOMHierarchySnapshotStamp::fromDatabase(database, stamp)
+    || !d->readSyncTime(database, syncTime))
+  {
+    return false;
+  }
+  ctkDICOMHierarchySnapshotData data;
+  for (int level = 0; level < LEVEL_COUNT; ++level)
+  {
+    if (!d->readRows(database, level, QString(), data))
+    {
+      return false;
+    }
+  }
+  data.InternedStringCount = static_cast<quint32>(data.StringOffsets.count() - 1);
+
+  d->NeedsRebuild = false;
+  ++d->RebuildCount;
+  return d->write(d->serialize(data, stamp, syncTime));
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMHierarchySnapshot::invalidate()
+{
+  Q_D(ctkDICOMHierarchySnapshot);
+  d->NeedsRebuild = true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMHierarchySnapshot::close()
+{
+  Q_D(ctkDICOMHierarchySnapshot);
+  d->detach();
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMHierarchySnapshot::count(Level level) const
+{
+  Q_D(const ctkDICOMHierarchySnapshot);
+  return d->isValidLevel(level) ? static_cast<int>(d->Levels[level].RowCount) : 0;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMHierarchySnapshot::row(Level level, const QString& uid) const
+{
+  Q_D(const ctkDICOMHierarchySnapshot);
+  if (!d->isValidLevel(level) || uid.isEmpty())
+  {
+    return -1;
+  }
+  QByteArray key = uid.toUtf8();
+  const ctkDICOMHierarchySnapshotLevel& levelInfo = d->Levels[level];
+  int uidOrderColumn = static_cast<int>(levelInfo.FieldCount) + 1;
+  int begin = 0;
+  int end = static_cast<int>(levelInfo.RowCount);
+  while (begin < end)
+  {
+    int middle = begin + (end - begin) / 2;
+    quint32 middleRow = d->cell(level, uidOrderColumn, middle);
+    if (middleRow >= levelInfo.RowCount)
+    {
+      return -1;
+    }
+    QByteArray middleUID = d->stringBytes(d->cell(level, 0, static_cast<int>(middleRow)));
+    int comparison = compareBytes(middleUID.constData(), middleUID.size(), key.constData(), key.size());
+    if (comparison == 0)
+    {
+      return static_cast<int>(middleRow);
+    }
+    if (comparison < 0)
+    {
+      begin = middle + 1;
+    }
+    else
+    {
+      end = middle;
+    }
+  }
+  return -1;
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMHierarchySnapshot::uid(Level level, int row) const
+{
+  return this->value(level, row, 0);
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMHierarchySnapshot::value(Level level, int row, const QString& field) const
+{
+  return this->value(level, row, ctkDICOMHierarchySnapshotPrivate::levelFields(level).indexOf(field));
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMHierarchySnapshot::value(Level level, int row, int fieldIndex) const
+{
+  Q_D(const ctkDICOMHierarchySnapshot);
+  if (!d->isValidLevel(level) || row < 0 || row >= static_cast<int>(d->Levels[level].RowCount)
+    || fieldIndex < 0 || fieldIndex >= static_cast<int>(d->Levels[level].FieldCount))
+  {
+    return QString();
+  }
+  return d->string(d->cell(level, fieldIndex, row));
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMHierarchySnapshot::parentRow(Level level, int row) const
+{
+  Q_D(const ctkDICOMHierarchySnapshot);
+  if (!d->isValidLevel(level) || level == PatientLevel
+    || row < 0 || row >= static_cast<int>(d->Levels[level].RowCount))
+  {
+    return -1;
+  }
+  quint32 parent = d->cell(level, static_cast<int>(d->Levels[level].FieldCount), row);
+  return parent < d->Levels[level - 1].RowCount ? static_cast<int>(parent) : -1;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMHierarchySnapshot::childRows(Level level, int row, int& begin, int& end) const
+{
+  Q_D(const ctkDICOMHierarchySnapshot);
+  begin = 0;
+  end = 0;
+  if (!d->isValidLevel(level) || level == SeriesLevel
+    || row < 0 || row >= static_cast<int>(d->Levels[level].RowCount))
+  {
+    return;
+  }
+  int firstChildColumn = static_cast<int>(d->Levels[level].FieldCount) + 2;
+  quint32 childCount = d->Levels[level + 1].RowCount;
+  quint32 first = d->cell(level, firstChildColumn, row);
+  quint32 last = d->cell(level, firstChildColumn, row + 1);
+  if (first <= last && last <= childCount)
+  {
+    begin = static_cast<int>(first);
+    end = static_cast<int>(last);
+  }
+}
+
+//------------------------------------------------------------------------------
+QStringList ctkDICOMHierarchySnapshot::uids(Level level) const
+{
+  QStringList result;
+  int rowCount = this->count(level);
+  result.reserve(rowCount);
+  for (int row = 0; row < rowCount; ++row)
+  {
+    result << this->uid(level, row);
+  }
+  return result;
+}
+
+//------------------------------------------------------------------------------
+QStringList ctkDICOMHierarchySnapshot::childUIDs(Level level, const QString& uid) const
+{
+  QStringList result;
+  if (level == SeriesLevel)
+  {
+    return result;
+  }
+  int begin = 0;
+  int end = 0;
+  this->childRows(level, this->row(level, uid), begin, end);
+  Level childLevel = static_cast<Level>(level + 1);
+  for (int childRow = begin; childRow < end; ++childRow)
+  {
+    result << this->uid(childLevel, childRow);
+  }
+  return result;
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMHierarchySnapshot::valueForUID(Level level, const QString& uid, const QString& field) const
+{
+  return this->value(level, this->row(level, uid), field);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMHierarchySnapshot::rebuildCount() const
+{
+  Q_D(const ctkDICOMHierarchySnapshot);
+  return d->RebuildCount;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMHierarchySnapshot::incrementalUpdateCount() const
+{
+  Q_D(const ctkDICOMHierarchySnapshot);
+  return d->IncrementalUpdateCount;
+}
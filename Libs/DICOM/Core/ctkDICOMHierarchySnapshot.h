@@ -0,0 +1,148 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+#ifndef __ctkDICOMHierarchySnapshot_h
+#define __ctkDICOMHierarchySnapshot_h
+
+// Qt includes
+#include <QObject>
+#include <QStringList>
+class QSqlDatabase;
+
+// ctkDICOMCore includes
+#include "ctkDICOMCoreExport.h"
+class ctkDICOMHierarchySnapshotPrivate;
+
+/// \ingroup DICOM_Core
+///
+/// \brief Memory-mapped columnar copy of the Patients, Studies and Series tables.
+///
+/// The snapshot stores the UIDs, the main DICOM fields, the displayed fields and
+/// the counts of the patients, studies and series of a database in a single file
+/// that is memory-mapped when loaded, so that the hierarchy can be browsed right
+/// after startup without running any SQL query:
+///   - strings are interned, each column is an array of indices in the string table,
+///   - the children of a patient (or study) are contiguous rows of the next level,
+///   - rows are indexed by UID for binary search.
+///
+/// The snapshot records the counters of the HierarchyChanges table of the database,
+/// that triggers of the Patients, Studies and Series tables increment whenever a row
+/// is inserted, updated or removed, by any connection or application. When rows were
+/// changed, update() only reads the rows whose displayed fields have been updated
+/// (or not generated yet) since the previous update and rewrites the snapshot.
+/// When rows were removed, the snapshot is rebuilt.
+///
+/// \sa ctkDICOMDatabase::hierarchySnapshot()
+class CTK_DICOM_CORE_EXPORT ctkDICOMHierarchySnapshot : public QObject
+{
+  Q_OBJECT
+  Q_ENUMS(Level)
+  Q_PROPERTY(QString filePath READ filePath WRITE setFilePath)
+
+public:
+  enum Level
+  {
+    PatientLevel = 0,
+    StudyLevel,
+    SeriesLevel
+  };
+
+  explicit ctkDICOMHierarchySnapshot(QObject* parent = nullptr);
+  virtual ~ctkDICOMHierarchySnapshot();
+
+  ///@{
+  /// Snapshot file. Changing it unloads the snapshot.
+  void setFilePath(const QString& filePath);
+  QString filePath() const;
+  ///@}
+
+  /// Table columns stored for a level. The first field is the UID of the row,
+  /// the second one is the UID of the parent (for studies and series).
+  static QStringList fields(Level level);
+
+  /// Map the snapshot file. Returns false if it does not exist or is not valid.
+  Q_INVOKABLE bool load();
+
+  /// Return true if the snapshot file is mapped (or kept in memory if it could not be written)
+  Q_INVOKABLE bool isLoaded() const;
+
+  /// Return true if the snapshot is loaded and no patient, study or series of the
+  /// database changed since it was updated.
+  bool isUpToDate(const QSqlDatabase& database) const;
+
+  /// Load the snapshot file if needed and update it from the database if the hierarchy changed.
+  /// Returns false if the snapshot is not available (e.g. the database has no HierarchyChanges table).
+  bool update(const QSqlDatabase& database);
+
+  /// Re-create the snapshot from all the rows of the database
+  bool rebuild(const QSqlDatabase& database);
+
+  /// Make the next update() rebuild the snapshot, e.g. after rows have been
+  /// modified without updating their displayed fields.
+  Q_INVOKABLE void invalidate();
+
+  /// Unmap the snapshot file
+  Q_INVOKABLE void close();
+
+  /// Number of rows of a level
+  Q_INVOKABLE int count(Level level) const;
+
+  /// Row of a UID, -1 if not found
+  Q_INVOKABLE int row(Level level, const QString& uid) const;
+
+  /// UID of a row
+  Q_INVOKABLE QString uid(Level level, int row) const;
+
+  ///@{
+  /// Value of a field of a row (empty if the field is not in the snapshot)
+  Q_INVOKABLE QString value(Level level, int row, const QString& field) const;
+  QString value(Level level, int row, int fieldIndex) const;
+  ///@}
+
+  /// Row of the parent of a row in the previous level, -1 if none
+  Q_INVOKABLE int parentRow(Level level, int row) const;
+
+  /// Rows of the children of a row in the next level, from \a begin to \a end (excluded)
+  void childRows(Level level, int row, int& begin, int& end) const;
+
+  /// UIDs of all the rows of a level
+  Q_INVOKABLE QStringList uids(Level level) const;
+
+  /// UIDs of the children of a row
+  Q_INVOKABLE QStringList childUIDs(Level level, const QString& uid) const;
+
+  /// Value of a field of the row of a UID
+  Q_INVOKABLE QString valueForUID(Level level, const QString& uid, const QString& field) const;
+
+  ///@{
+  /// Statistics: number of full rebuilds and of incremental updates that rewrote the snapshot
+  Q_INVOKABLE int rebuildCount() const;
+  Q_INVOKABLE int incrementalUpdateCount() const;
+  ///@}
+
+protected:
+  QScopedPointer<ctkDICOMHierarchySnapshotPrivate> d_ptr;
+
+private:
+  Q_DECLARE_PRIVATE(ctkDICOMHierarchySnapshot);
+  Q_DISABLE_COPY(ctkDICOMHierarchySnapshot);
+};
+
+#endif
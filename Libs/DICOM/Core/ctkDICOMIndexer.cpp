@@ -29,10 +29,9 @@
 #include <QFile>
 #include <QDirIterator>
 #include <QFileInfo>
+#include <QThreadPool>
 #include <QDebug>
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
 #include <QElapsedTimer>
-#endif
 
 // ctkDICOM includes
 #include "ctkLogger.h"
@@ -60,12 +59,304 @@ static ctkLogger logger("org.commontk.dicom.DICOMIndexer" );
 /// Increasing cache size increases maximum memory usage, very low cache size
 /// slows down database insertion.
 static int REQUEST_RESULTS_CACHE_MAXIMUM_SIZE = 5000;
+
+/// Maximum number of parsed datasets waiting for the database writer.
+/// Parsing threads are paused when this limit is reached, which keeps memory
+/// usage bounded when parsing is faster than database insertion.
+static int PARSED_RESULTS_QUEUE_MAXIMUM_SIZE = 200;
 //------------------------------------------------------------------------------
 
 
 //------------------------------------------------------------------------------
-// ctkDICOMIndexerPrivate methods
+// DICOMParsedResultRing methods
+
+//------------------------------------------------------------------------------
+DICOMParsedResultRing::DICOMParsedResultRing(int capacity)
+  : Head(0)
+  , CachedTail(0)
+  , Tail(0)
+  , CachedHead(0)
+{
+  // Use a power of two size so that indices can be wrapped by masking
+  quint32 size = 2;
+  while (size < quint32(capacity))
+  {
+    size *= 2;
+  }
+  this->Slots.resize(size);
+  this->Mask = size - 1;
+}
+
+//------------------------------------------------------------------------------
+bool DICOMParsedResultRing::tryPush(const ctkDICOMDatabase::IndexingResult& indexingResult)
+{
+  quint32 tail = this->Tail.loadAcquire();
+  if (tail - this->CachedHead > this->Mask)
+  {
+    this->CachedHead = this->Head.loadAcquire();
+    if (tail - this->CachedHead > this->Mask)
+    {
+      return false;
+    }
+  }
+  this->Slots[tail & this->Mask] = indexingResult;
+  this->Tail.storeRelease(tail + 1);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool DICOMParsedResultRing::tryPop(ctkDICOMDatabase::IndexingResult& indexingResult)
+{
+  quint32 head = this->Head.loadAcquire();
+  if (head == this->CachedTail)
+  {
+    this->CachedTail = this->Tail.loadAcquire();
+    if (head == this->CachedTail)
+    {
+      return false;
+    }
+  }
+  ctkDICOMDatabase::IndexingResult& slot = this->Slots[head & this->Mask];
+  indexingResult = slot;
+  // do not keep the dataset alive until the slot is reused
+  slot.dataset.reset();
+  this->Head.storeRelease(head + 1);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+int DICOMParsedResultRing::size() const
+{
+  return int(this->Tail.loadAcquire() - this->Head.loadAcquire());
+}
+
+//------------------------------------------------------------------------------
+// DICOMParsedResultQueue methods
+
+//------------------------------------------------------------------------------
+DICOMParsedResultQueue::DICOMParsedResultQueue(int capacity, int producerCount)
+  : ActiveProducerCount(producerCount)
+  , ConsumerWaiting(0)
+  , WaitingProducerCount(0)
+  , ProducerBlockedTimeNs(0)
+  , ProducerBlockedCount(0)
+  , ConsumerIdleTimeNs(0)
+  , PoppedCount(0)
+  , PopCount(0)
+  , MaximumDepth(0)
+{
+  producerCount = qMax(1, producerCount);
+  int ringCapacity = qMax(1, (capacity + producerCount - 1) / producerCount);
+  for (int producerIndex = 0; producerIndex < producerCount; ++producerIndex)
+  {
+    this->Rings << new DICOMParsedResultRing(ringCapacity);
+  }
+}
+
+//------------------------------------------------------------------------------
+DICOMParsedResultQueue::~DICOMParsedResultQueue()
+{
+  qDeleteAll(this->Rings);
+}
+
+//------------------------------------------------------------------------------
+void DICOMParsedResultQueue::push(int producerIndex, const ctkDICOMDatabase::IndexingResult& indexingResult)
+{
+  DICOMParsedResultRing* ring = this->Rings[producerIndex];
+  if (!ring->tryPush(indexingResult))
+  {
+    // Ring is full, wait for the consumer
+    QElapsedTimer blockedTimer;
+    blockedTimer.start();
+    QMutexLocker locker(&this->Mutex);
+    // The ordered increment makes sure that either the consumer sees the waiting
+    // producer after popping or this thread sees the popped slots in tryPush.
+    this->WaitingProducerCount.fetchAndAddOrdered(1);
+    while (!ring->tryPush(indexingResult))
+    {
+      this->NotFull.wait(&this->Mutex);
+    }
+    this->WaitingProducerCount.fetchAndAddOrdered(-1);
+    this->ProducerBlockedTimeNs += blockedTimer.nsecsElapsed();
+    this->ProducerBlockedCount++;
+  }
+  if (this->ConsumerWaiting.fetchAndAddOrdered(0))
+  {
+    QMutexLocker locker(&this->Mutex);
+    this->NotEmpty.wakeOne();
+  }
+}
+
+//------------------------------------------------------------------------------
+void DICOMParsedResultQueue::producerFinished()
+{
+  this->ActiveProducerCount.deref();
+  if (this->ConsumerWaiting.fetchAndAddOrdered(0))
+  {
+    QMutexLocker locker(&this->Mutex);
+    this->NotEmpty.wakeOne();
+  }
+}
+
+//------------------------------------------------------------------------------
+bool DICOMParsedResultQueue::popAll(QList<ctkDICOMDatabase::IndexingResult>& indexingResults)
+{
+  indexingResults.clear();
+  while (true)
+  {
+    if (this->tryPopAll(indexingResults) > 0)
+    {
+      return true;
+    }
+    if (this->ActiveProducerCount.loadAcquire() <= 0)
+    {
+      // Results may have been pushed just before the last producer finished
+      return this->tryPopAll(indexingResults) > 0;
+    }
+    // All rings are empty, wait for the producers
+    QElapsedTimer idleTimer;
+    idleTimer.start();
+    {
+      QMutexLocker locker(&this->Mutex);
+      this->ConsumerWaiting.fetchAndStoreOrdered(1);
+      while (this->isEmpty() && this->ActiveProducerCount.loadAcquire() > 0)
+      {
+        this->NotEmpty.wait(&this->Mutex);
+      }
+      this->ConsumerWaiting.fetchAndStoreOrdered(0);
+    }
+    this->ConsumerIdleTimeNs += idleTimer.nsecsElapsed();
+  }
+}
+
+//------------------------------------------------------------------------------
+int DICOMParsedResultQueue::tryPopAll(QList<ctkDICOMDatabase::IndexingResult>& indexingResults)
+{
+  int poppedCount = 0;
+  ctkDICOMDatabase::IndexingResult indexingResult;
+  foreach (DICOMParsedResultRing* ring, this->Rings)
+  {
+    // Results pushed while popping are left for the next batch, so that a batch is
+    // the content of the queue at one time and never exceeds its capacity.
+    for (int ringSize = ring->size(); ringSize > 0 && ring->tryPop(indexingResult); --ringSize)
+    {
+      indexingResults << indexingResult;
+      poppedCount++;
+    }
+  }
+  if (poppedCount == 0)
+  {
+    return 0;
+  }
+  this->PopCount++;
+  this->PoppedCount += poppedCount;
+  this->MaximumDepth = qMax(this->MaximumDepth, poppedCount);
+  if (this->WaitingProducerCount.fetchAndAddOrdered(0) > 0)
+  {
+    QMutexLocker locker(&this->Mutex);
+    this->NotFull.wakeAll();
+  }
+  return poppedCount;
+}
+
+//------------------------------------------------------------------------------
+bool DICOMParsedResultQueue::isEmpty() const
+{
+  foreach (const DICOMParsedResultRing* ring, this->Rings)
+  {
+    if (ring->size() > 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+int DICOMParsedResultQueue::capacity() const
+{
+  int capacity = 0;
+  foreach (const DICOMParsedResultRing* ring, this->Rings)
+  {
+    capacity += ring->capacity();
+  }
+  return capacity;
+}
 
+//------------------------------------------------------------------------------
+int DICOMParsedResultQueue::size() const
+{
+  int size = 0;
+  foreach (const DICOMParsedResultRing* ring, this->Rings)
+  {
+    size += ring->size();
+  }
+  return size;
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMIndexer::PipelineStatistics DICOMParsedResultQueue::statistics() const
+{
+  ctkDICOMIndexer::PipelineStatistics statistics;
+  statistics.ParsedFileCount = int(this->PoppedCount);
+  statistics.QueueCapacity = this->capacity();
+  statistics.MaximumQueueDepth = this->MaximumDepth;
+  statistics.AverageQueueDepth = this->PopCount > 0 ? double(this->PoppedCount) / double(this->PopCount) : 0.0;
+  {
+    QMutexLocker locker(&this->Mutex);
+    statistics.ProducerBlockedCount = this->ProducerBlockedCount;
+    statistics.ProducerBlockedTime = this->ProducerBlockedTimeNs / 1000000;
+  }
+  statistics.WriterIdleTime = this->ConsumerIdleTimeNs / 1000000;
+  return statistics;
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMIndexerPrivateParser methods
+
+//------------------------------------------------------------------------------
+ctkDICOMIndexerPrivateParser::ctkDICOMIndexerPrivateParser(int parserIndex, const QList<ctkDICOMDatabase::IndexingResult>* filesToParse,
+  QAtomicInt* nextFileIndex, DICOMParsedResultQueue* parsedResults, DICOMIndexingQueue* requestQueue)
+: ParserIndex(parserIndex)
+, FilesToParse(filesToParse)
+, NextFileIndex(nextFileIndex)
+, ParsedResults(parsedResults)
+, RequestQueue(requestQueue)
+{
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivateParser::run()
+{
+  while (!this->RequestQueue->isStopRequested())
+  {
+    int fileIndex = this->NextFileIndex->fetchAndAddOrdered(1);
+    if (fileIndex >= this->FilesToParse->size())
+    {
+      break;
+    }
+    // Dataset is left empty if the file cannot be read
+    ctkDICOMDatabase::IndexingResult indexingResult = this->FilesToParse->at(fileIndex);
+    QSharedPointer<ctkDICOMItem> dataset(new ctkDICOMItem);
+    if (indexingResult.headerOnly)
+    {
+      dataset->InitializeFromFileUntilTag(indexingResult.filePath, DCM_PixelData);
+    }
+    else
+    {
+      dataset->InitializeFromFile(indexingResult.filePath);
+    }
+    if (dataset->IsInitialized())
+    {
+      indexingResult.dataset = dataset;
+    }
+    this->ParsedResults->push(this->ParserIndex, indexingResult);
+  }
+  this->ParsedResults->producerFinished();
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMIndexerPrivateWorker methods
 
 //------------------------------------------------------------------------------
 ctkDICOMIndexerPrivateWorker::ctkDICOMIndexerPrivateWorker(DICOMIndexingQueue* queue)
@@ -104,8 +395,8 @@ void ctkDICOMIndexerPrivateWorker::start()
   {
     emit progressStep(ctkDICOMIndexer::tr("Parsing DICOM files"));
     emit progress(0);
-    // Make a local copy to avoid the need of frequent locking
-    this->RequestQueue->modifiedTimeForFilepath(this->ModifiedTimeForFilepath);
+    // Files are looked up in the database again, they may have been changed since the last round
+    this->ModifiedTimeForFilepath.clear();
     this->CompletedRequestCount = 0;
     do
     {
@@ -113,6 +404,8 @@ void ctkDICOMIndexerPrivateWorker::start()
       {
         this->RequestQueue->clear();
         this->RequestQueue->setStopRequested(false);
+        // watched directories are not completely indexed
+        this->PendingScanCursors.clear();
       }
       DICOMIndexingQueue::IndexingRequest indexingRequest;
       this->RemainingRequestCount = this->RequestQueue->popIndexingRequest(indexingRequest);
@@ -176,6 +469,20 @@ void ctkDICOMIndexerPrivateWorker::processIndexingRequest(DICOMIndexingQueue::In
     }
   }
 
+  if (!indexingRequest.directoriesToSynchronize.isEmpty())
+  {
+    // Files to index are selected by comparing the directories with the database
+    if (this->synchronizeDirectories(indexingRequest, database))
+    {
+      this->PendingScanCursors[indexingRequest.watchedDirectoryPath] = indexingRequest.newScanCursor;
+    }
+  }
+  else
+  {
+    // Only look up the files of this request instead of all the files of the database
+    database.filesModifiedTimes(indexingRequest.inputFilesPath, this->ModifiedTimeForFilepath);
+  }
+
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
   QElapsedTimer timeProbe;
 #else
@@ -183,16 +490,13 @@ void ctkDICOMIndexerPrivateWorker::processIndexingRequest(DICOMIndexingQueue::In
 #endif
   timeProbe.start();
 
-  int currentFileIndex = 0;
+  // Select files that need to be parsed (new or modified since last indexing)
+  QList<ctkDICOMDatabase::IndexingResult> filesToParse;
+  bool headerOnly = this->RequestQueue->headerOnlyParsing();
   int alreadyAddedFileCount = 0;
   QStringList alreadyAddedFiles;
   foreach(const QString& filePath, indexingRequest.inputFilesPath)
   {
-    int percent = int(this->TimePercentageIndexing * (this->CompletedRequestCount + double(currentFileIndex++) / double(indexingRequest.inputFilesPath.size()))
-      / double(this->CompletedRequestCount + this->RemainingRequestCount + 1));
-    emit this->progress(percent);
-    emit progressDetail(filePath);
-
     QDateTime fileModifiedTime = QFileInfo(filePath).lastModified();
     bool datasetAlreadyInDatabase = this->ModifiedTimeForFilepath.contains(filePath);
     if (datasetAlreadyInDatabase && this->ModifiedTimeForFilepath[filePath] >= fileModifiedTime)
@@ -207,14 +511,50 @@ void ctkDICOMIndexerPrivateWorker::processIndexingRequest(DICOMIndexingQueue::In
     this->ModifiedTimeForFilepath[filePath] = fileModifiedTime;
 
     ctkDICOMDatabase::IndexingResult indexingResult;
-    indexingResult.dataset = QSharedPointer<ctkDICOMItem>(new ctkDICOMItem);
-    indexingResult.dataset->InitializeFromFile(filePath);
-    if (indexingResult.dataset->IsInitialized())
-    {
-      indexingResult.filePath = filePath;
-      indexingResult.copyFile = indexingRequest.copyFile;
-      indexingResult.overwriteExistingDataset = datasetAlreadyInDatabase;
-      int resultsCount = this->RequestQueue->pushIndexingResult(indexingResult);
+    indexingResult.filePath = filePath;
+    indexingResult.copyFile = indexingRequest.copyFile;
+    indexingResult.overwriteExistingDataset = datasetAlreadyInDatabase;
+    indexingResult.headerOnly = headerOnly;
+    filesToParse << indexingResult;
+  }
+
+  // Parse file headers in worker threads, while results are inserted into
+  // the database in this thread.
+  int parsingThreadCount = qMin(this->RequestQueue->parsingThreadCount(), filesToParse.size());
+  int currentFileIndex = 0;
+  if (parsingThreadCount > 0)
+  {
+    QAtomicInt nextFileIndex(0);
+    DICOMParsedResultQueue parsedResults(PARSED_RESULTS_QUEUE_MAXIMUM_SIZE, parsingThreadCount);
+    QThreadPool parserThreadPool;
+    parserThreadPool.setMaxThreadCount(parsingThreadCount);
+    for (int threadIndex = 0; threadIndex < parsingThreadCount; ++threadIndex)
+    {
+      parserThreadPool.start(new ctkDICOMIndexerPrivateParser(threadIndex, &filesToParse, &nextFileIndex, &parsedResults, this->RequestQueue));
+    }
+
+    QList<ctkDICOMDatabase::IndexingResult> indexingResults;
+    QList<ctkDICOMDatabase::IndexingResult> validIndexingResults;
+    while (parsedResults.popAll(indexingResults))
+    {
+      validIndexingResults.clear();
+      foreach(const ctkDICOMDatabase::IndexingResult& indexingResult, indexingResults)
+      {
+        if (!indexingResult.dataset)
+        {
+          logger.warn(QString("Could not read DICOM file:") + indexingResult.filePath);
+          continue;
+        }
+        validIndexingResults << indexingResult;
+      }
+      currentFileIndex += indexingResults.size();
+      int percent = int(this->TimePercentageIndexing * (this->CompletedRequestCount + double(alreadyAddedFileCount + currentFileIndex) / double(indexingRequest.inputFilesPath.size()))
+        / double(this->CompletedRequestCount + this->RemainingRequestCount + 1));
+      emit this->progress(percent);
+      emit progressDetail(indexingResults.last().filePath);
+
+      // Results are handed over in batches to avoid locking the request queue for each file
+      int resultsCount = this->RequestQueue->pushIndexingResults(validIndexingResults);
       if (resultsCount >= REQUEST_RESULTS_CACHE_MAXIMUM_SIZE)
       {
         emit progressStep(ctkDICOMIndexer::tr("Updating database fields"));
@@ -222,15 +562,15 @@ void ctkDICOMIndexerPrivateWorker::processIndexingRequest(DICOMIndexingQueue::In
         emit progressStep(ctkDICOMIndexer::tr("Parsing DICOM files"));
       }
     }
-    else
-    {
-      logger.warn(QString("Could not read DICOM file:") + filePath);
-    }
-
-    if (this->RequestQueue->isStopRequested())
-    {
-      break;
-    }
+    parserThreadPool.waitForDone();
+
+    ctkDICOMIndexer::PipelineStatistics statistics = parsedResults.statistics();
+    this->RequestQueue->setPipelineStatistics(statistics);
+    logger.debug(QString("DICOM indexer pipeline: %1 files, queue capacity %2, queue depth max %3 average %4,"
+      " parsers blocked %5 times [%6ms], writer idle [%7ms]")
+      .arg(statistics.ParsedFileCount).arg(statistics.QueueCapacity)
+      .arg(statistics.MaximumQueueDepth).arg(QString::number(statistics.AverageQueueDepth, 'f', 1))
+      .arg(statistics.ProducerBlockedCount).arg(statistics.ProducerBlockedTime).arg(statistics.WriterIdleTime));
   }
 
   if (alreadyAddedFileCount > 0)
@@ -247,14 +587,161 @@ void ctkDICOMIndexerPrivateWorker::processIndexingRequest(DICOMIndexingQueue::In
     emit progressStep(ctkDICOMIndexer::tr("Updating database fields"));
     this->writeIndexingResultsToDatabase(database);
     emit progressStep(ctkDICOMIndexer::tr("Parsing DICOM files"));
+
+    // All the files found in the watched directories are in the database now
+    for (QMap<QString, QDateTime>::const_iterator cursorIt = this->PendingScanCursors.constBegin();
+      cursorIt != this->PendingScanCursors.constEnd(); ++cursorIt)
+    {
+      emit scanCursorReached(cursorIt.key(), cursorIt.value());
+    }
+    this->PendingScanCursors.clear();
   }
 
   float elapsedTimeInSeconds = timeProbe.elapsed() / 1000.0;
-  logger.info(QString("DICOM indexer has successfully processed %1 files [%2s]")
-              .arg(currentFileIndex).arg(QString::number(elapsedTimeInSeconds, 'f', 2)));
+  logger.info(QString("DICOM indexer has successfully processed %1 files using %2 parsing threads [%3s]")
+              .arg(currentFileIndex + alreadyAddedFileCount).arg(parsingThreadCount)
+              .arg(QString::number(elapsedTimeInSeconds, 'f', 2)));
 }
 
 
+//------------------------------------------------------------------------------
+bool ctkDICOMIndexerPrivateWorker::synchronizeDirectories(DICOMIndexingQueue::IndexingRequest& indexingRequest, ctkDICOMDatabase& database)
+{
+  QDir::Filters fileFilters = QDir::Files;
+  QDir::Filters directoryFilters = QDir::Dirs | QDir::NoDotAndDotDot;
+  if (indexingRequest.includeHidden)
+  {
+    fileFilters |= QDir::Hidden;
+    directoryFilters |= QDir::Hidden;
+  }
+  if (!indexingRequest.followSymlinks)
+  {
+    directoryFilters |= QDir::NoSymLinks;
+  }
+
+  // Directories to synchronize and whether their subdirectories are synchronized as well
+  QList<QPair<QString, bool> > directoriesToSynchronize;
+  foreach (const QString& directoryPath, indexingRequest.directoriesToSynchronize)
+  {
+    directoriesToSynchronize << qMakePair(directoryPath, indexingRequest.synchronizeRecursively);
+  }
+  QSet<QString> synchronizedCanonicalPaths;
+  QStringList directoriesToWatch;
+  QStringList deferredDirectories;
+  QStringList removedFiles;
+  QStringList removedDirectories;
+  int listedDirectoryCount = 0;
+
+  while (!directoriesToSynchronize.isEmpty() && !this->RequestQueue->isStopRequested())
+  {
+    QPair<QString, bool> directoryToSynchronize = directoriesToSynchronize.takeLast();
+    const QString& directoryPath = directoryToSynchronize.first;
+    bool recursive = directoryToSynchronize.second;
+    QFileInfo directoryInfo(directoryPath);
+    if (!directoryInfo.isDir())
+    {
+      removedDirectories << directoryPath;
+      continue;
+    }
+    // Protect against symlink loops
+    QString canonicalPath = directoryInfo.canonicalFilePath();
+    if (synchronizedCanonicalPaths.contains(canonicalPath))
+    {
+      continue;
+    }
+    synchronizedCanonicalPaths.insert(canonicalPath);
+    directoriesToWatch << directoryPath;
+
+    QDir directory(directoryPath);
+    QStringList subdirectoryNames = directory.entryList(directoryFilters);
+    // Entries of a directory cannot be added, removed, or renamed without changing its modification time
+    if (recursive && indexingRequest.scanCursor.isValid() && directoryInfo.lastModified() < indexingRequest.scanCursor)
+    {
+      foreach (const QString& subdirectoryName, subdirectoryNames)
+      {
+        directoriesToSynchronize << qMakePair(directoryPath + "/" + subdirectoryName, true);
+      }
+      continue;
+    }
+    listedDirectoryCount++;
+
+    QMap<QString, QDateTime> indexedFiles;
+    QStringList indexedSubdirectoryNames;
+    database.filesModifiedTimesInDirectory(directoryPath, indexedFiles, &indexedSubdirectoryNames);
+
+    bool deferred = false;
+    foreach (const QFileInfo& fileInfo, directory.entryInfoList(fileFilters))
+    {
+      QString filePath = directoryPath + "/" + fileInfo.fileName();
+      QDateTime fileModifiedTime = fileInfo.lastModified();
+      if (fileModifiedTime > indexingRequest.newScanCursor)
+      {
+        // The file may still be written
+        deferred = true;
+        indexedFiles.remove(filePath);
+        continue;
+      }
+      QMap<QString, QDateTime>::iterator indexedFileIt = indexedFiles.find(filePath);
+      if (indexedFileIt != indexedFiles.end())
+      {
+        this->ModifiedTimeForFilepath[filePath] = indexedFileIt.value();
+        bool upToDate = (indexedFileIt.value() >= fileModifiedTime);
+        indexedFiles.erase(indexedFileIt);
+        if (upToDate)
+        {
+          continue;
+        }
+      }
+      indexingRequest.inputFilesPath << filePath;
+    }
+    if (deferred)
+    {
+      deferredDirectories << directoryPath;
+    }
+    // Files that are in the database but not in the directory anymore
+    removedFiles << indexedFiles.keys();
+
+    foreach (const QString& indexedSubdirectoryName, indexedSubdirectoryNames)
+    {
+      if (!subdirectoryNames.contains(indexedSubdirectoryName))
+      {
+        removedDirectories << directoryPath + "/" + indexedSubdirectoryName;
+      }
+    }
+    foreach (const QString& subdirectoryName, subdirectoryNames)
+    {
+      if (recursive || !indexedSubdirectoryNames.contains(subdirectoryName))
+      {
+        // New subdirectories are synchronized completely
+        directoriesToSynchronize << qMakePair(directoryPath + "/" + subdirectoryName, true);
+      }
+    }
+  }
+
+  if (!removedFiles.isEmpty() || !removedDirectories.isEmpty())
+  {
+    emit progressStep(ctkDICOMIndexer::tr("Removing deleted files"));
+    database.removeFiles(removedFiles, false);
+    foreach (const QString& removedDirectory, removedDirectories)
+    {
+      database.removeFilesInDirectory(removedDirectory, false);
+    }
+    database.cleanup();
+    emit progressStep(ctkDICOMIndexer::tr("Parsing DICOM files"));
+  }
+
+  logger.info(QString("DICOM indexer has synchronized %1 directories of %2 (%3 listed): %4 new or modified files, %5 removed files")
+    .arg(directoriesToWatch.size()).arg(indexingRequest.watchedDirectoryPath).arg(listedDirectoryCount)
+    .arg(indexingRequest.inputFilesPath.size()).arg(removedFiles.size()));
+
+  emit watchDirectories(directoriesToWatch);
+  if (!deferredDirectories.isEmpty())
+  {
+    emit deferDirectories(indexingRequest.watchedDirectoryPath, deferredDirectories);
+  }
+  return deferredDirectories.isEmpty() && directoriesToSynchronize.isEmpty();
+}
+
 //------------------------------------------------------------------------------
 void ctkDICOMIndexerPrivateWorker::writeIndexingResultsToDatabase(ctkDICOMDatabase& database)
 {
@@ -293,6 +780,8 @@ ctkDICOMIndexerPrivate::ctkDICOMIndexerPrivate(ctkDICOMIndexer& o)
   , Database(nullptr)
   , BackgroundImportEnabled(false)
   , FollowSymlinks(true)
+  , DirectoryWatcher(nullptr)
+  , WatchedDirectorySettleTime(2000)
 {
   ctkDICOMIndexerPrivateWorker* worker = new ctkDICOMIndexerPrivateWorker(&this->RequestQueue);
   worker->moveToThread(&this->WorkerThread);
@@ -307,6 +796,13 @@ ctkDICOMIndexerPrivate::ctkDICOMIndexerPrivate(ctkDICOMIndexer& o)
   connect(worker, &ctkDICOMIndexerPrivateWorker::updatingDatabase, q_ptr, &ctkDICOMIndexer::updatingDatabase);
   connect(worker, &ctkDICOMIndexerPrivateWorker::indexingComplete, q_ptr, &ctkDICOMIndexer::indexingComplete);
 
+  // Watched directories
+  connect(worker, &ctkDICOMIndexerPrivateWorker::watchDirectories, this, &ctkDICOMIndexerPrivate::watchDirectories);
+  connect(worker, &ctkDICOMIndexerPrivateWorker::deferDirectories, this, &ctkDICOMIndexerPrivate::deferDirectories);
+  connect(worker, &ctkDICOMIndexerPrivateWorker::scanCursorReached, this, &ctkDICOMIndexerPrivate::storeScanCursor);
+  this->ChangedDirectoriesTimer.setSingleShot(true);
+  connect(&this->ChangedDirectoriesTimer, &QTimer::timeout, this, &ctkDICOMIndexerPrivate::synchronizeChangedDirectories);
+
   this->WorkerThread.start();
 }
 
@@ -329,13 +825,153 @@ void ctkDICOMIndexerPrivate::pushIndexingRequest(const DICOMIndexingQueue::Index
   {
     // Start background indexing
     this->RequestQueue.setIndexing(true);
-    QMap<QString, QDateTime> modifiedTimeForFilepath;
-    this->Database->allFilesModifiedTimes(modifiedTimeForFilepath);
-    this->RequestQueue.setModifiedTimeForFilepath(modifiedTimeForFilepath);
     emit startWorker();
   }
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivate::watchDirectory(const ctkDICOMDatabase::WatchedDirectory& watchedDirectory)
+{
+  if (!this->DirectoryWatcher)
+  {
+    this->DirectoryWatcher = new QFileSystemWatcher(this);
+    connect(this->DirectoryWatcher, &QFileSystemWatcher::directoryChanged, this, &ctkDICOMIndexerPrivate::onDirectoryChanged);
+  }
+  this->WatchedDirectories[watchedDirectory.path] = watchedDirectory;
+
+  // Subdirectories are watched when they are found by the synchronization
+  DICOMIndexingQueue::IndexingRequest request;
+  request.directoriesToSynchronize << watchedDirectory.path;
+  request.synchronizeRecursively = true;
+  request.includeHidden = watchedDirectory.includeHidden;
+  request.followSymlinks = this->FollowSymlinks;
+  request.watchedDirectoryPath = watchedDirectory.path;
+  request.scanCursor = watchedDirectory.scanCursor;
+  request.newScanCursor = QDateTime::currentDateTime().addMSecs(-this->WatchedDirectorySettleTime);
+  this->pushIndexingRequest(request);
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMIndexerPrivate::watchedDirectoryForPath(const QString& path) const
+{
+  for (QMap<QString, ctkDICOMDatabase::WatchedDirectory>::const_iterator watchedIt = this->WatchedDirectories.constBegin();
+    watchedIt != this->WatchedDirectories.constEnd(); ++watchedIt)
+  {
+    if (path == watchedIt.key() || path.startsWith(watchedIt.key() + "/"))
+    {
+      return watchedIt.key();
+    }
+  }
+  return QString();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivate::onDirectoryChanged(const QString& path)
+{
+  // Wait until the changes settle (e.g., all files of a series are written)
+  this->ChangedDirectories.insert(path);
+  this->ChangedDirectoriesTimer.start(this->WatchedDirectorySettleTime);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivate::synchronizeChangedDirectories()
+{
+  if (!this->Database)
+  {
+    return;
+  }
+  QMap<QString, QStringList> changedDirectoriesForWatchedDirectory;
+  foreach (const QString& changedDirectory, this->ChangedDirectories)
+  {
+    QString watchedDirectoryPath = this->watchedDirectoryForPath(changedDirectory);
+    if (!watchedDirectoryPath.isEmpty())
+    {
+      changedDirectoriesForWatchedDirectory[watchedDirectoryPath] << changedDirectory;
+    }
+  }
+  this->ChangedDirectories.clear();
+
+  QDateTime newScanCursor = QDateTime::currentDateTime().addMSecs(-this->WatchedDirectorySettleTime);
+  for (QMap<QString, QStringList>::const_iterator changedIt = changedDirectoriesForWatchedDirectory.constBegin();
+    changedIt != changedDirectoriesForWatchedDirectory.constEnd(); ++changedIt)
+  {
+    const ctkDICOMDatabase::WatchedDirectory& watchedDirectory = this->WatchedDirectories[changedIt.key()];
+    DICOMIndexingQueue::IndexingRequest request;
+    request.directoriesToSynchronize = changedIt.value();
+    request.synchronizeRecursively = false;
+    request.includeHidden = watchedDirectory.includeHidden;
+    request.followSymlinks = this->FollowSymlinks;
+    request.watchedDirectoryPath = watchedDirectory.path;
+    request.newScanCursor = newScanCursor;
+    this->pushIndexingRequest(request);
+  }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivate::watchDirectories(const QStringList& directories)
+{
+  if (!this->DirectoryWatcher)
+  {
+    return;
+  }
+  QSet<QString> alreadyWatchedDirectories;
+  foreach (const QString& directory, this->DirectoryWatcher->directories())
+  {
+    alreadyWatchedDirectories.insert(directory);
+  }
+  QStringList directoriesToWatch;
+  foreach (const QString& directory, directories)
+  {
+    if (!alreadyWatchedDirectories.contains(directory) && !this->watchedDirectoryForPath(directory).isEmpty())
+    {
+      directoriesToWatch << directory;
+    }
+  }
+  if (directoriesToWatch.isEmpty())
+  {
+    return;
+  }
+  QStringList failedDirectories = this->DirectoryWatcher->addPaths(directoriesToWatch);
+  if (!failedDirectories.isEmpty())
+  {
+    // Changes in these directories are only found when the watched directory is added again
+    logger.warn(QString("DICOM indexer could not watch %1 directories (watch limit of the file system may be reached), first: %2")
+      .arg(failedDirectories.size()).arg(failedDirectories.first()));
+    foreach (const QString& failedDirectory, failedDirectories)
+    {
+      this->IncompletelyWatchedDirectories.insert(this->watchedDirectoryForPath(failedDirectory));
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivate::deferDirectories(const QString& watchedDirectoryPath, const QStringList& directories)
+{
+  if (!this->WatchedDirectories.contains(watchedDirectoryPath))
+  {
+    return;
+  }
+  foreach (const QString& directory, directories)
+  {
+    this->ChangedDirectories.insert(directory);
+  }
+  this->ChangedDirectoriesTimer.start(this->WatchedDirectorySettleTime);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexerPrivate::storeScanCursor(const QString& watchedDirectoryPath, const QDateTime& scanCursor)
+{
+  if (!this->Database || !this->WatchedDirectories.contains(watchedDirectoryPath)
+    || this->IncompletelyWatchedDirectories.contains(watchedDirectoryPath)
+    || !this->ChangedDirectories.isEmpty())
+  {
+    // Not all the changes are indexed
+    return;
+  }
+  this->WatchedDirectories[watchedDirectoryPath].scanCursor = scanCursor;
+  this->Database->setWatchedDirectoryScanCursor(watchedDirectoryPath, scanCursor);
+}
+
 //------------------------------------------------------------------------------
 CTK_GET_CPP(ctkDICOMIndexer, bool, isBackgroundImportEnabled, BackgroundImportEnabled);
 CTK_SET_CPP(ctkDICOMIndexer, bool, setBackgroundImportEnabled, BackgroundImportEnabled);
@@ -344,6 +980,45 @@ CTK_SET_CPP(ctkDICOMIndexer, bool, setBackgroundImportEnabled, BackgroundImportE
 CTK_GET_CPP(ctkDICOMIndexer, bool, followSymlinks, FollowSymlinks);
 CTK_SET_CPP(ctkDICOMIndexer, bool, setFollowSymlinks, FollowSymlinks);
 
+//------------------------------------------------------------------------------
+CTK_GET_CPP(ctkDICOMIndexer, int, watchedDirectorySettleTime, WatchedDirectorySettleTime);
+CTK_SET_CPP(ctkDICOMIndexer, int, setWatchedDirectorySettleTime, WatchedDirectorySettleTime);
+
+//------------------------------------------------------------------------------
+ctkDICOMIndexer::PipelineStatistics ctkDICOMIndexer::pipelineStatistics()const
+{
+  Q_D(const ctkDICOMIndexer);
+  return d->RequestQueue.pipelineStatistics();
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMIndexer::parsingThreadCount()const
+{
+  Q_D(const ctkDICOMIndexer);
+  return d->RequestQueue.parsingThreadCount();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexer::setParsingThreadCount(int count)
+{
+  Q_D(ctkDICOMIndexer);
+  d->RequestQueue.setParsingThreadCount(count);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMIndexer::headerOnlyParsing()const
+{
+  Q_D(const ctkDICOMIndexer);
+  return d->RequestQueue.headerOnlyParsing();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexer::setHeaderOnlyParsing(bool headerOnly)
+{
+  Q_D(ctkDICOMIndexer);
+  d->RequestQueue.setHeaderOnlyParsing(headerOnly);
+}
+
 //------------------------------------------------------------------------------
 // ctkDICOMIndexer methods
 
@@ -373,6 +1048,15 @@ void ctkDICOMIndexer::setDatabase(ctkDICOMDatabase* database)
     QObject::disconnect(d->Database, SIGNAL(tagsToPrecacheChanged()), this, SLOT(tagsToPrecacheChanged()));
     QObject::disconnect(d->Database, SIGNAL(tagsToExcludeFromStorageChanged()), this, SLOT(tagsToExcludeFromStorageChanged()));
   }
+  // Watched directories belong to the database
+  d->WatchedDirectories.clear();
+  d->IncompletelyWatchedDirectories.clear();
+  d->ChangedDirectories.clear();
+  d->ChangedDirectoriesTimer.stop();
+  if (d->DirectoryWatcher && !d->DirectoryWatcher->directories().isEmpty())
+  {
+    d->DirectoryWatcher->removePaths(d->DirectoryWatcher->directories());
+  }
   d->Database = database;
   if (d->Database)
   {
@@ -495,6 +1179,116 @@ void ctkDICOMIndexer::addDirectory(const QString& directoryName, bool copyFile/*
   }
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMIndexer::addWatchedDirectory(const QString& directoryName, bool includeHidden/*=true*/)
+{
+  Q_D(ctkDICOMIndexer);
+  if (!d->Database)
+  {
+    logger.error("addWatchedDirectory failed: no database is set");
+    return;
+  }
+  QFileInfo directoryInfo(directoryName);
+  if (!directoryInfo.isDir())
+  {
+    logger.error("addWatchedDirectory failed: " + directoryName + " is not a directory");
+    return;
+  }
+  QString directoryPath = QDir::cleanPath(directoryInfo.absoluteFilePath());
+
+  ctkDICOMDatabase::WatchedDirectory watchedDirectory;
+  watchedDirectory.path = directoryPath;
+  watchedDirectory.includeHidden = includeHidden;
+  // Keep the scan cursor if the directory was already watched
+  foreach (const ctkDICOMDatabase::WatchedDirectory& storedDirectory, d->Database->watchedDirectories())
+  {
+    if (storedDirectory.path == directoryPath && storedDirectory.includeHidden == includeHidden)
+    {
+      watchedDirectory.scanCursor = storedDirectory.scanCursor;
+    }
+  }
+  if (!d->Database->setWatchedDirectory(watchedDirectory))
+  {
+    return;
+  }
+  d->IncompletelyWatchedDirectories.remove(directoryPath);
+  d->watchDirectory(watchedDirectory);
+  if (!d->BackgroundImportEnabled)
+  {
+    this->waitForImportFinished();
+  }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexer::removeWatchedDirectory(const QString& directoryName, bool removeFiles/*=false*/)
+{
+  Q_D(ctkDICOMIndexer);
+  QString directoryPath = QDir::cleanPath(QFileInfo(directoryName).absoluteFilePath());
+  d->WatchedDirectories.remove(directoryPath);
+  d->IncompletelyWatchedDirectories.remove(directoryPath);
+  if (d->DirectoryWatcher)
+  {
+    QStringList directoriesToRemove;
+    foreach (const QString& directory, d->DirectoryWatcher->directories())
+    {
+      if (d->watchedDirectoryForPath(directory).isEmpty())
+      {
+        directoriesToRemove << directory;
+      }
+    }
+    if (!directoriesToRemove.isEmpty())
+    {
+      d->DirectoryWatcher->removePaths(directoriesToRemove);
+    }
+  }
+  if (!d->Database)
+  {
+    return;
+  }
+  d->Database->removeWatchedDirectory(directoryPath);
+  if (removeFiles)
+  {
+    // Pending requests of the directory must not add files back
+    this->waitForImportFinished();
+    d->Database->removeFilesInDirectory(directoryPath);
+  }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMIndexer::restoreWatchedDirectories()
+{
+  Q_D(ctkDICOMIndexer);
+  if (!d->Database)
+  {
+    logger.error("restoreWatchedDirectories failed: no database is set");
+    return;
+  }
+  foreach (const ctkDICOMDatabase::WatchedDirectory& watchedDirectory, d->Database->watchedDirectories())
+  {
+    if (d->WatchedDirectories.contains(watchedDirectory.path))
+    {
+      continue;
+    }
+    if (!QFileInfo(watchedDirectory.path).isDir())
+    {
+      logger.warn("Watched directory " + watchedDirectory.path + " is not available, it is not synchronized");
+      continue;
+    }
+    d->watchDirectory(watchedDirectory);
+  }
+  if (!d->BackgroundImportEnabled)
+  {
+    this->waitForImportFinished();
+  }
+}
+
+//------------------------------------------------------------------------------
+QStringList ctkDICOMIndexer::watchedDirectories() const
+{
+  Q_D(const ctkDICOMIndexer);
+  return d->WatchedDirectories.keys();
+}
+
 //------------------------------------------------------------------------------
 void ctkDICOMIndexer::addListOfFiles(ctkDICOMDatabase* db, const QStringList& listOfFiles, bool copyFile/*=false*/)
 {
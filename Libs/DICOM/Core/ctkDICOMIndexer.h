@@ -39,9 +39,44 @@ class CTK_DICOM_CORE_EXPORT ctkDICOMIndexer : public QObject
   Q_OBJECT
   Q_PROPERTY(bool backgroundImportEnabled READ isBackgroundImportEnabled WRITE setBackgroundImportEnabled)
   Q_PROPERTY(bool followSymlinks READ followSymlinks WRITE setFollowSymlinks)
+  Q_PROPERTY(int parsingThreadCount READ parsingThreadCount WRITE setParsingThreadCount)
+  Q_PROPERTY(bool headerOnlyParsing READ headerOnlyParsing WRITE setHeaderOnlyParsing)
   Q_PROPERTY(bool importing READ isImporting)
+  Q_PROPERTY(int watchedDirectorySettleTime READ watchedDirectorySettleTime WRITE setWatchedDirectorySettleTime)
 
 public:
+  /// Counters of the parsing and database insertion pipeline of an indexing request.
+  /// Files are parsed by parsingThreadCount() threads and handed over to the
+  /// database writer thread through a bounded queue.
+  struct PipelineStatistics
+  {
+    PipelineStatistics()
+      : ParsedFileCount(0)
+      , QueueCapacity(0)
+      , MaximumQueueDepth(0)
+      , AverageQueueDepth(0.0)
+      , ProducerBlockedCount(0)
+      , ProducerBlockedTime(0)
+      , WriterIdleTime(0)
+    {
+    }
+    /// Number of files parsed
+    int ParsedFileCount;
+    /// Maximum number of parsed files that can wait for the database writer
+    int QueueCapacity;
+    /// Largest and average number of parsed files in the queue when the database writer
+    /// takes them, which it writes as one batch. The depth never exceeds QueueCapacity;
+    /// values close to it mean that the database writer is the bottleneck.
+    int MaximumQueueDepth;
+    double AverageQueueDepth;
+    /// Number of times and total time (in milliseconds, summed for all parsing threads)
+    /// parsing threads were waiting because the queue was full
+    int ProducerBlockedCount;
+    qint64 ProducerBlockedTime;
+    /// Total time (in milliseconds) the database writer was waiting for parsed files
+    qint64 WriterIdleTime;
+  };
+
   explicit ctkDICOMIndexer(QObject *parent = 0);
   virtual ~ctkDICOMIndexer();
 
@@ -61,9 +96,26 @@ public:
   void setFollowSymlinks(bool);
   bool followSymlinks() const;
 
+  /// Number of threads used for parsing DICOM file headers during indexing.
+  /// Parsed datasets are inserted into the database by a single thread.
+  /// Default is the number of CPU cores.
+  void setParsingThreadCount(int count);
+  int parsingThreadCount() const;
+
+  /// If enabled, files are only parsed up to the pixel data element,
+  /// which greatly reduces file reading and memory usage for large
+  /// (e.g., multi-frame) images. Tags after the pixel data are not precached
+  /// during indexing but read from the file when requested.
+  /// Enabled by default.
+  void setHeaderOnlyParsing(bool headerOnly);
+  bool headerOnlyParsing() const;
+
   /// Returns with true if background importing is currently in progress.
   bool isImporting();
 
+  /// Pipeline counters of the most recently completed indexing request
+  PipelineStatistics pipelineStatistics() const;
+
   ///
   /// \brief Adds directory to database and optionally copies files to
   /// destinationDirectory.
@@ -115,6 +167,36 @@ public:
   /// Kept for backward compatibility
   Q_INVOKABLE void addFile(ctkDICOMDatabase* db, const QString filePath, bool copyFile = false);
 
+  ///
+  /// \brief Keeps the database in sync with a directory.
+  ///
+  /// The directory is indexed (without copying files) and then watched for changes:
+  /// created and modified files are indexed and deleted files are removed from the database.
+  /// The directory is stored in the database with a scan cursor (the time up to which
+  /// all the changes are indexed), so that after restart only the subdirectories
+  /// modified since then are listed again. Use restoreWatchedDirectories() to resume
+  /// watching the directories stored in the database.
+  ///
+  /// Files modified in place without changing the content of their directory
+  /// while the application is not running are not re-indexed.
+  ///
+  Q_INVOKABLE void addWatchedDirectory(const QString& directoryName, bool includeHidden = true);
+
+  /// Stop watching a directory. If removeFiles is true then its files are removed from the database.
+  Q_INVOKABLE void removeWatchedDirectory(const QString& directoryName, bool removeFiles = false);
+
+  /// Resume watching all the directories stored in the database
+  Q_INVOKABLE void restoreWatchedDirectories();
+
+  /// Directories currently kept in sync with the database
+  Q_INVOKABLE QStringList watchedDirectories() const;
+
+  /// Time (in milliseconds) to wait after the last change notification
+  /// before indexing the changed directories.
+  /// Default is 2000.
+  void setWatchedDirectorySettleTime(int msec);
+  int watchedDirectorySettleTime() const;
+
   ///
   /// \brief Wait for all the indexing operations to complete
   /// This can be useful to ensure that importing is completed when background indexing is enabled.
@@ -21,7 +21,17 @@
 #ifndef CTKDICOMINDEXERPRIVATE_H
 #define CTKDICOMINDEXERPRIVATE_H
 
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QFileSystemWatcher>
+#include <QMutex>
 #include <QObject>
+#include <QRunnable>
+#include <QSet>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+#include <QWaitCondition>
 
 #include "ctkDICOMIndexer.h"
 #include "ctkDICOMItem.h"
@@ -34,7 +44,14 @@ class DICOMIndexingQueue
 public:
   struct IndexingRequest
   {
-    /// Either inputFolderPath or inputFilesPath is used
+    IndexingRequest()
+      : includeHidden(true)
+      , copyFile(false)
+      , followSymlinks(true)
+      , synchronizeRecursively(false)
+    {
+    }
+    /// Either inputFolderPath, inputFilesPath, or directoriesToSynchronize is used
     QString inputFolderPath;
     QStringList inputFilesPath;
     /// If inputFolderPath is specified, includeHidden is used to decide
@@ -45,12 +62,27 @@ public:
     bool copyFile;
     /// Follow symlinks on platforms that support it.
     bool followSymlinks;
+
+    /// Directories of a watched directory to synchronize with the database:
+    /// new and modified files are indexed and files that do not exist anymore are removed.
+    QStringList directoriesToSynchronize;
+    /// Synchronize all the subdirectories, too. Directories that have not been modified
+    /// since scanCursor are not listed. New subdirectories are always synchronized recursively.
+    bool synchronizeRecursively;
+    /// Root of the watched directory
+    QString watchedDirectoryPath;
+    QDateTime scanCursor;
+    /// Files modified after this time may still be written, they are deferred to a later synchronization.
+    /// The watched directory is completely indexed up to this time when the request is completed
+    /// without deferred files.
+    QDateTime newScanCursor;
   };
 
   DICOMIndexingQueue()
-    : IsIndexing(false)
+    : ParsingThreadCount(qMax(1, QThread::idealThreadCount()))
+    , HeaderOnlyParsing(true)
+    , IsIndexing(false)
     , StopRequested(false)
-    , Mutex(QMutex::Recursive)
   {
   }
 
@@ -94,6 +126,30 @@ public:
     this->TagsToExcludeFromStorage = tags;
   }
 
+  int parsingThreadCount() const
+  {
+    QMutexLocker locker(&this->Mutex);
+    return this->ParsingThreadCount;
+  }
+
+  void setParsingThreadCount(int count)
+  {
+    QMutexLocker locker(&this->Mutex);
+    this->ParsingThreadCount = qMax(1, count);
+  }
+
+  bool headerOnlyParsing() const
+  {
+    QMutexLocker locker(&this->Mutex);
+    return this->HeaderOnlyParsing;
+  }
+
+  void setHeaderOnlyParsing(bool headerOnly)
+  {
+    QMutexLocker locker(&this->Mutex);
+    this->HeaderOnlyParsing = headerOnly;
+  }
+
   void clear()
   {
     QMutexLocker locker(&this->Mutex);
@@ -138,16 +194,23 @@ public:
     return this->IndexingResults.size();
   }
 
-  void modifiedTimeForFilepath(QMap<QString, QDateTime>& timesForPaths)
+  int pushIndexingResults(const QList<ctkDICOMDatabase::IndexingResult>& indexingResults)
   {
     QMutexLocker locker(&this->Mutex);
-    timesForPaths = this->ModifiedTimeForFilepath;
+    this->IndexingResults.append(indexingResults);
+    return this->IndexingResults.size();
   }
 
-  void setModifiedTimeForFilepath(const QMap<QString, QDateTime>& timesForPaths)
+  ctkDICOMIndexer::PipelineStatistics pipelineStatistics() const
   {
     QMutexLocker locker(&this->Mutex);
-    this->ModifiedTimeForFilepath = timesForPaths;
+    return this->PipelineStatistics;
+  }
+
+  void setPipelineStatistics(const ctkDICOMIndexer::PipelineStatistics& statistics)
+  {
+    QMutexLocker locker(&this->Mutex);
+    this->PipelineStatistics = statistics;
   }
 
   void setIndexing(bool indexing)
@@ -185,9 +248,6 @@ public:
   }
 
 protected:
-  // List of already indexed file paths and oldest file modified time in the database
-  QMap<QString, QDateTime> ModifiedTimeForFilepath;
-
   QList<IndexingRequest> IndexingRequests;
   QList<ctkDICOMDatabase::IndexingResult> IndexingResults;
 
@@ -195,12 +255,128 @@ protected:
   QStringList TagsToPrecache;
   QStringList TagsToExcludeFromStorage;
 
+  ctkDICOMIndexer::PipelineStatistics PipelineStatistics;
+
+  int ParsingThreadCount;
+  bool HeaderOnlyParsing;
   bool IsIndexing;
   bool StopRequested;
 
   mutable QMutex Mutex;
 };
 
+/// Bounded single-producer single-consumer ring of indexing results.
+/// Neither tryPush() nor tryPop() locks: the producer only advances Tail and the
+/// consumer only advances Head, each side reading the index of the other side
+/// only when its cached copy indicates that the ring is full or empty.
+class DICOMParsedResultRing
+{
+public:
+  explicit DICOMParsedResultRing(int capacity);
+
+  /// Called by the producer. Returns false if the ring is full.
+  bool tryPush(const ctkDICOMDatabase::IndexingResult& indexingResult);
+  /// Called by the consumer. Returns false if the ring is empty.
+  bool tryPop(ctkDICOMDatabase::IndexingResult& indexingResult);
+  /// Number of results in the ring (approximate if called while the ring is modified).
+  int size() const;
+  int capacity() const { return int(this->Mask + 1); }
+
+protected:
+  QVector<ctkDICOMDatabase::IndexingResult> Slots;
+  quint32 Mask;
+  // Head and Tail are kept on separate cache lines to avoid false sharing
+  // between the producer and the consumer.
+  char PaddingBeforeHead[64];
+  QAtomicInteger<quint32> Head;
+  quint32 CachedTail; // consumer's copy of Tail
+  char PaddingBeforeTail[64];
+  QAtomicInteger<quint32> Tail;
+  quint32 CachedHead; // producer's copy of Head
+  char PaddingAfterTail[64];
+};
+
+/// Hands parsed datasets over from the header parsing threads to the single
+/// thread that writes them into the database.
+///
+/// Each producer has its own lock-free ring, so pushing and popping does not
+/// lock any mutex as long as rings are neither full nor empty. Producers are
+/// blocked while their ring is full (back-pressure keeps memory usage bounded
+/// when the database writer is slower than the parsers) and the consumer is
+/// blocked while all rings are empty. Blocking uses a mutex and wait conditions,
+/// which are only touched by a side that actually has to wait or wake the other side.
+class DICOMParsedResultQueue
+{
+public:
+  DICOMParsedResultQueue(int capacity, int producerCount);
+  ~DICOMParsedResultQueue();
+
+  /// Push a result into the ring of a producer, waiting while the ring is full.
+  void push(int producerIndex, const ctkDICOMDatabase::IndexingResult& indexingResult);
+
+  /// Called by each producer when it has no more results to push.
+  void producerFinished();
+
+  /// Wait until results are available and take all of them (at most capacity() results).
+  /// Returns false if the queue is empty and all producers are finished.
+  bool popAll(QList<ctkDICOMDatabase::IndexingResult>& indexingResults);
+
+  /// Total capacity of all rings
+  int capacity() const;
+  /// Current number of results in the queue
+  int size() const;
+
+  /// Counters collected for tuning the import pipeline
+  ctkDICOMIndexer::PipelineStatistics statistics() const;
+
+protected:
+  /// Pop the results that are in the rings without waiting. Returns the number of popped
+  /// results, which is the depth of the queue at that time.
+  int tryPopAll(QList<ctkDICOMDatabase::IndexingResult>& indexingResults);
+  bool isEmpty() const;
+
+  QVector<DICOMParsedResultRing*> Rings;
+  QAtomicInt ActiveProducerCount;
+
+  /// Set while the consumer waits for NotEmpty
+  QAtomicInt ConsumerWaiting;
+  /// Number of producers waiting for NotFull
+  QAtomicInt WaitingProducerCount;
+  mutable QMutex Mutex;
+  QWaitCondition NotEmpty;
+  QWaitCondition NotFull;
+
+  /// Statistics. Producer counters are only updated while Mutex is locked,
+  /// consumer counters are only accessed by the consumer.
+  qint64 ProducerBlockedTimeNs;
+  int ProducerBlockedCount;
+  qint64 ConsumerIdleTimeNs;
+  qint64 PoppedCount;
+  qint64 PopCount;
+  int MaximumDepth;
+};
+
+
+/// Parses DICOM file headers in a thread pool thread.
+/// All parsers of an indexing request share the list of files to parse and
+/// pick the next file using an atomic index, so that the load is balanced
+/// between the threads regardless of the file sizes.
+class ctkDICOMIndexerPrivateParser : public QRunnable
+{
+public:
+  ctkDICOMIndexerPrivateParser(int parserIndex, const QList<ctkDICOMDatabase::IndexingResult>* filesToParse,
+    QAtomicInt* nextFileIndex, DICOMParsedResultQueue* parsedResults, DICOMIndexingQueue* requestQueue);
+
+  void run() override;
+
+private:
+  int ParserIndex;
+  const QList<ctkDICOMDatabase::IndexingResult>* FilesToParse;
+  QAtomicInt* NextFileIndex;
+  DICOMParsedResultQueue* ParsedResults;
+  DICOMIndexingQueue* RequestQueue;
+};
+
 
 class ctkDICOMIndexerPrivateWorker : public QObject
 {
@@ -219,11 +395,21 @@ Q_SIGNALS:
   void progressStep(QString);
   void updatingDatabase(bool);
   void indexingComplete(int, int, int, int);
+  /// Directories found while synchronizing a watched directory
+  void watchDirectories(QStringList);
+  /// Directories of a watched directory that contain files that may still be written
+  void deferDirectories(QString, QStringList);
+  /// All the changes of a watched directory made before the given time are indexed
+  void scanCursorReached(QString, QDateTime);
 
 private:
 
   void processIndexingRequest(DICOMIndexingQueue::IndexingRequest& request, ctkDICOMDatabase& database);
   void writeIndexingResultsToDatabase(ctkDICOMDatabase& database);
+  /// Compare directories of a watched directory with the database, remove deleted files
+  /// and add new or modified files to the files of the request.
+  /// Returns false if some files are deferred.
+  bool synchronizeDirectories(DICOMIndexingQueue::IndexingRequest& request, ctkDICOMDatabase& database);
 
   DICOMIndexingQueue* RequestQueue;
   int NumberOfInstancesToInsert;
@@ -234,9 +420,12 @@ private:
   int RemainingRequestCount; // the current request in progress is not included
   int CompletedRequestCount; // the current request in progress is not included
 
-  // List of already indexed file paths and oldest file modified time in the database.
-  // Cached here to avoid locking/unlocking a mutex each time a file is looked up.
+  // Already indexed file paths and oldest file modified time in the database.
+  // Only the files of the processed requests are looked up in the database.
   QMap<QString, QDateTime> ModifiedTimeForFilepath;
+
+  // Scan cursors of watched directories to report when indexing results are written into the database
+  QMap<QString, QDateTime> PendingScanCursors;
 };
 
 
@@ -256,15 +445,39 @@ public:
 
   void pushIndexingRequest(const DICOMIndexingQueue::IndexingRequest& request);
 
+  /// Start watching a directory and synchronize it with the database
+  void watchDirectory(const ctkDICOMDatabase::WatchedDirectory& watchedDirectory);
+  /// Path of the watched directory that contains a path (empty if none)
+  QString watchedDirectoryForPath(const QString& path) const;
+
 Q_SIGNALS:
   void startWorker();
 
+public Q_SLOTS:
+  void onDirectoryChanged(const QString& path);
+  void synchronizeChangedDirectories();
+  void watchDirectories(const QStringList& directories);
+  void deferDirectories(const QString& watchedDirectoryPath, const QStringList& directories);
+  void storeScanCursor(const QString& watchedDirectoryPath, const QDateTime& scanCursor);
+
 public:
   DICOMIndexingQueue RequestQueue;
   QThread WorkerThread;
   ctkDICOMDatabase* Database;
   bool BackgroundImportEnabled;
   bool FollowSymlinks;
+
+  /// Watched directories by path. Directories are watched with QFileSystemWatcher
+  /// (inotify on Linux) and changed directories are synchronized once no more changes
+  /// are notified for WatchedDirectorySettleTime milliseconds.
+  QMap<QString, ctkDICOMDatabase::WatchedDirectory> WatchedDirectories;
+  /// Watched directories of which some subdirectories could not be watched
+  /// (e.g., because the inotify watch limit was reached). Their scan cursor is not updated.
+  QSet<QString> IncompletelyWatchedDirectories;
+  QFileSystemWatcher* DirectoryWatcher;
+  QSet<QString> ChangedDirectories;
+  QTimer ChangedDirectoriesTimer;
+  int WatchedDirectorySettleTime;
 };
 
 
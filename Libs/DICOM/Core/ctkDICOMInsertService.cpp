@@ -0,0 +1,425 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QElapsedTimer>
+#include <QMap>
+#include <QMutex>
+#include <QQueue>
+#include <QSet>
+#include <QThread>
+#include <QWaitCondition>
+
+// ctkCore includes
+#include <ctkLogger.h>
+
+// ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
+#include "ctkDICOMInsertService.h"
+#include "ctkDICOMJobResponseSet.h"
+
+static ctkLogger logger("org.commontk.dicom.DICOMInsertService");
+
+class ctkDICOMInsertServicePrivate;
+
+//------------------------------------------------------------------------------
+struct ctkDICOMInsertRequest
+{
+  QString UID;
+  QString DatabaseFilename;
+  QStringList TagsToPrecache;
+  QStringList TagsToExcludeFromStorage;
+  QList<QSharedPointer<ctkDICOMJobResponseSet>> JobResponseSets;
+  qint64 SubmitTime;
+};
+
+//------------------------------------------------------------------------------
+// Thread owning the write connection
+class ctkDICOMInsertServiceThread : public QThread
+{
+public:
+  ctkDICOMInsertServiceThread(ctkDICOMInsertServicePrivate& service)
+    : Service(service)
+  {
+  }
+
+protected:
+  void run() override;
+
+  ctkDICOMInsertServicePrivate& Service;
+};
+
+//------------------------------------------------------------------------------
+class ctkDICOMInsertServicePrivate
+{
+public:
+  ctkDICOMInsertServicePrivate();
+  ~ctkDICOMInsertServicePrivate() = default;
+
+  /// Loop of the service thread
+  void run();
+  /// Wait for the requests of the next transaction and take them.
+  /// Return false if the service is stopping and all the requests are written.
+  bool takeNextBatch(QList<ctkDICOMInsertRequest>& batch);
+  /// Write the requests in one transaction, in the service thread
+  void flush(ctkDICOMDatabase& database, const QString& connectionName,
+             const QList<ctkDICOMInsertRequest>& batch);
+
+  int MaximumBatchSize;
+  int MaximumDelay;
+
+  /// Protects the requests, the results and the settings
+  mutable QMutex Mutex;
+  QWaitCondition RequestsCondition;
+  QWaitCondition InsertedCondition;
+  QQueue<ctkDICOMInsertRequest> Requests;
+  int QueuedJobResponseSetsCount;
+  /// UIDs of the submitted requests that are not waited yet nor canceled
+  QSet<QString> SubmittedRequestUIDs;
+  /// Result of the written requests that are not waited yet nor canceled
+  QMap<QString, bool> Results;
+  QElapsedTimer Timer;
+  bool Stopping;
+  /// False once the service thread does not take requests anymore
+  bool Running;
+
+  int FlushCount;
+  int InsertedJobResponseSetsCount;
+
+  ctkDICOMInsertServiceThread Thread;
+};
+
+//------------------------------------------------------------------------------
+// ctkDICOMInsertServiceThread methods
+
+//------------------------------------------------------------------------------
+void ctkDICOMInsertServiceThread::run()
+{
+  this->Service.run();
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMInsertServicePrivate methods
+
+//------------------------------------------------------------------------------
+ctkDICOMInsertServicePrivate::ctkDICOMInsertServicePrivate()
+  : Thread(*this)
+{
+  this->MaximumBatchSize = 100;
+  this->MaximumDelay = 100;
+  this->QueuedJobResponseSetsCount = 0;
+  this->Stopping = false;
+  this->Running = false;
+  this->FlushCount = 0;
+  this->InsertedJobResponseSetsCount = 0;
+  this->Timer.start();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMInsertServicePrivate::run()
+{
+  // The connection is used only by this thread, so it is created here
+  // and kept open until the service is stopped
+  ctkDICOMDatabase database;
+  QString connectionName =
+    "db_insert_" + QString::number(reinterpret_cast<quint64>(QThread::currentThreadId()), 16);
+
+  QList<ctkDICOMInsertRequest> batch;
+  while (this->takeNextBatch(batch))
+  {
+    this->flush(database, connectionName, batch);
+    batch.clear();
+  }
+
+  if (database.isOpen())
+  {
+    database.closeDatabase();
+  }
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMInsertServicePrivate::takeNextBatch(QList<ctkDICOMInsertRequest>& batch)
+{
+  QMutexLocker locker(&this->Mutex);
+  // Queued requests may be canceled while waiting
+  while (this->Requests.isEmpty())
+  {
+    while (this->Requests.isEmpty())
+    {
+      if (this->Stopping)
+      {
+        this->Running = false;
+        return false;
+      }
+      this->RequestsCondition.wait(&this->Mutex);
+    }
+
+    // Give the other jobs the opportunity to join the transaction
+    while (!this->Stopping && !this->Requests.isEmpty()
+      && this->QueuedJobResponseSetsCount < this->MaximumBatchSize)
+    {
+      qint64 remainingTime = this->Requests.head().SubmitTime + this->MaximumDelay - this->Timer.elapsed();
+      if (remainingTime <= 0)
+      {
+        break;
+      }
+      this->RequestsCondition.wait(&this->Mutex, static_cast<unsigned long>(remainingTime));
+    }
+  }
+
+  QString databaseFilename = this->Requests.head().DatabaseFilename;
+  int batchSize = 0;
+  while (!this->Requests.isEmpty() && this->Requests.head().DatabaseFilename == databaseFilename
+    && (batch.isEmpty() || batchSize + this->Requests.head().JobResponseSets.count() <= this->MaximumBatchSize))
+  {
+    ctkDICOMInsertRequest request = this->Requests.dequeue();
+    batchSize += request.JobResponseSets.count();
+    batch.append(request);
+  }
+  this->QueuedJobResponseSetsCount -= batchSize;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMInsertServicePrivate::flush(ctkDICOMDatabase& database, const QString& connectionName,
+                                         const QList<ctkDICOMInsertRequest>& batch)
+{
+  const ctkDICOMInsertRequest& lastRequest = batch.last();
+  if (database.isOpen() && database.databaseFilename() != lastRequest.DatabaseFilename)
+  {
+    database.closeDatabase();
+  }
+  if (!database.isOpen())
+  {
+    database.openDatabase(lastRequest.DatabaseFilename, connectionName);
+  }
+  // No-op if unchanged, so precached tags are updated only when the settings change
+  database.setTagsToPrecache(lastRequest.TagsToPrecache);
+  database.setTagsToExcludeFromStorage(lastRequest.TagsToExcludeFromStorage);
+
+  QList<ctkDICOMJobResponseSet*> jobResponseSets;
+  foreach (const ctkDICOMInsertRequest& request, batch)
+  {
+    foreach (QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet, request.JobResponseSets)
+    {
+      jobResponseSets.append(jobResponseSet.data());
+    }
+  }
+
+  bool success = false;
+  if (!database.isOpen())
+  {
+    logger.error(QString("Cannot open database %1 to insert %2 response sets")
+                   .arg(lastRequest.DatabaseFilename)
+                   .arg(jobResponseSets.count()));
+  }
+  else
+  {
+    success = database.insert(jobResponseSets) != ctkDICOMDatabase::InsertResult::Failed;
+    database.updateDisplayedFields();
+  }
+
+  QMutexLocker locker(&this->Mutex);
+  foreach (const ctkDICOMInsertRequest& request, batch)
+  {
+    if (this->SubmittedRequestUIDs.contains(request.UID))
+    {
+      this->Results.insert(request.UID, success);
+    }
+  }
+  this->FlushCount++;
+  this->InsertedJobResponseSetsCount += jobResponseSets.count();
+  this->InsertedCondition.wakeAll();
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMInsertService methods
+
+//------------------------------------------------------------------------------
+ctkDICOMInsertService::ctkDICOMInsertService(QObject* parentObject)
+  : QObject(parentObject)
+  , d_ptr(new ctkDICOMInsertServicePrivate)
+{
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMInsertService::~ctkDICOMInsertService()
+{
+  this->stop();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMInsertService::setMaximumBatchSize(int maximumBatchSize)
+{
+  Q_D(ctkDICOMInsertService);
+  QMutexLocker locker(&d->Mutex);
+  d->MaximumBatchSize = qMax(1, maximumBatchSize);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMInsertService::maximumBatchSize() const
+{
+  Q_D(const ctkDICOMInsertService);
+  QMutexLocker locker(&d->Mutex);
+  return d->MaximumBatchSize;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMInsertService::setMaximumDelay(int maximumDelay)
+{
+  Q_D(ctkDICOMInsertService);
+  QMutexLocker locker(&d->Mutex);
+  d->MaximumDelay = qMax(0, maximumDelay);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMInsertService::maximumDelay() const
+{
+  Q_D(const ctkDICOMInsertService);
+  QMutexLocker locker(&d->Mutex);
+  return d->MaximumDelay;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMInsertService::submit(const QString& requestUID,
+                                   const QList<QSharedPointer<ctkDICOMJobResponseSet>>& jobResponseSets,
+                                   const QString& databaseFilename,
+                                   const QStringList& tagsToPrecache,
+                                   const QStringList& tagsToExcludeFromStorage)
+{
+  Q_D(ctkDICOMInsertService);
+  if (databaseFilename.isEmpty())
+  {
+    logger.error("ctkDICOMInsertService::submit failed: no database filename.");
+    return;
+  }
+
+  ctkDICOMInsertRequest request;
+  request.UID = requestUID;
+  request.DatabaseFilename = databaseFilename;
+  request.TagsToPrecache = tagsToPrecache;
+  request.TagsToExcludeFromStorage = tagsToExcludeFromStorage;
+  request.JobResponseSets = jobResponseSets;
+
+  QMutexLocker locker(&d->Mutex);
+  request.SubmitTime = d->Timer.elapsed();
+  d->Requests.enqueue(request);
+  d->QueuedJobResponseSetsCount += jobResponseSets.count();
+  d->SubmittedRequestUIDs.insert(requestUID);
+
+  if (!d->Running)
+  {
+    // Wait for the thread of a previous stop() to be finished before restarting
+    d->Thread.wait();
+    d->Stopping = false;
+    d->Running = true;
+    d->Thread.start();
+  }
+  d->RequestsCondition.wakeAll();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMInsertService::isSubmitted(const QString& requestUID) const
+{
+  Q_D(const ctkDICOMInsertService);
+  QMutexLocker locker(&d->Mutex);
+  return d->SubmittedRequestUIDs.contains(requestUID);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMInsertService::waitForInserted(const QString& requestUID, int msecs)
+{
+  Q_D(ctkDICOMInsertService);
+  QElapsedTimer timer;
+  timer.start();
+  QMutexLocker locker(&d->Mutex);
+  while (d->SubmittedRequestUIDs.contains(requestUID) && !d->Results.contains(requestUID))
+  {
+    if (msecs < 0)
+    {
+      d->InsertedCondition.wait(&d->Mutex);
+      continue;
+    }
+    qint64 remainingTime = msecs - timer.elapsed();
+    if (remainingTime <= 0)
+    {
+      return false;
+    }
+    d->InsertedCondition.wait(&d->Mutex, static_cast<unsigned long>(remainingTime));
+  }
+  if (!d->SubmittedRequestUIDs.remove(requestUID))
+  {
+    // Unknown or canceled
+    return false;
+  }
+  return d->Results.take(requestUID);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMInsertService::cancel(const QString& requestUID)
+{
+  Q_D(ctkDICOMInsertService);
+  QMutexLocker locker(&d->Mutex);
+  if (!d->SubmittedRequestUIDs.remove(requestUID))
+  {
+    return;
+  }
+  d->Results.remove(requestUID);
+  // The request is written anyway if its transaction is already started
+  for (QQueue<ctkDICOMInsertRequest>::iterator requestIt = d->Requests.begin(); requestIt != d->Requests.end(); ++requestIt)
+  {
+    if (requestIt->UID == requestUID)
+    {
+      d->QueuedJobResponseSetsCount -= requestIt->JobResponseSets.count();
+      d->Requests.erase(requestIt);
+      break;
+    }
+  }
+  // Waiting threads return false
+  d->InsertedCondition.wakeAll();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMInsertService::stop()
+{
+  Q_D(ctkDICOMInsertService);
+  {
+    QMutexLocker locker(&d->Mutex);
+    d->Stopping = true;
+    d->RequestsCondition.wakeAll();
+  }
+  d->Thread.wait();
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMInsertService::flushCount() const
+{
+  Q_D(const ctkDICOMInsertService);
+  QMutexLocker locker(&d->Mutex);
+  return d->FlushCount;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMInsertService::insertedJobResponseSetsCount() const
+{
+  Q_D(const ctkDICOMInsertService);
+  QMutexLocker locker(&d->Mutex);
+  return d->InsertedJobResponseSetsCount;
+}
@@ -0,0 +1,117 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+#ifndef __ctkDICOMInsertService_h
+#define __ctkDICOMInsertService_h
+
+// Qt includes
+#include <QObject>
+#include <QSharedPointer>
+#include <QStringList>
+
+// ctkDICOMCore includes
+#include "ctkDICOMCoreExport.h"
+
+class ctkDICOMInsertServicePrivate;
+class ctkDICOMJobResponseSet;
+
+/// \ingroup DICOM_Core
+///
+/// Single writer of the job response sets into a database.
+///
+/// The service owns a thread and a database connection that stay open as long as
+/// the service is running. Response sets are queued with submit() by any thread
+/// (e.g. when the scheduler creates an inserter job) and the service writes them in
+/// transactions of up to maximumBatchSize response sets, waiting at most maximumDelay
+/// msec after the first queued request for more response sets to arrive.
+/// Displayed fields are updated once per transaction.
+///
+/// Requests are written in the order they are submitted: when waitForInserted()
+/// returns true for a request, all the requests submitted before it are written as well.
+class CTK_DICOM_CORE_EXPORT ctkDICOMInsertService : public QObject
+{
+  Q_OBJECT
+  Q_PROPERTY(int maximumBatchSize READ maximumBatchSize WRITE setMaximumBatchSize);
+  Q_PROPERTY(int maximumDelay READ maximumDelay WRITE setMaximumDelay);
+
+public:
+  explicit ctkDICOMInsertService(QObject* parent = 0);
+  virtual ~ctkDICOMInsertService();
+
+  ///@{
+  /// Maximum number of response sets written in one transaction.
+  /// A request is never split, so a single request can exceed it.
+  /// 100 by default.
+  void setMaximumBatchSize(int maximumBatchSize);
+  int maximumBatchSize() const;
+  ///@}
+
+  ///@{
+  /// Maximum time (in msec) a queued request waits for other requests
+  /// before its transaction is written. 100 msec by default.
+  void setMaximumDelay(int maximumDelay);
+  int maximumDelay() const;
+  ///@}
+
+  /// Queue response sets to be written into \a databaseFilename, with the
+  /// TagsToPrecache and TagsToExcludeFromStorage of the database that requests them.
+  /// \a requestUID (e.g. the UID of the inserter job) identifies the request in
+  /// waitForInserted() and cancel().
+  /// Thread-safe, the response sets are kept until written.
+  /// The connection is reopened when the file of the next transaction is different.
+  void submit(const QString& requestUID,
+              const QList<QSharedPointer<ctkDICOMJobResponseSet>>& jobResponseSets,
+              const QString& databaseFilename,
+              const QStringList& tagsToPrecache = QStringList(),
+              const QStringList& tagsToExcludeFromStorage = QStringList());
+
+  /// Return true if the request is submitted and its result was not taken
+  /// by waitForInserted() yet, nor canceled.
+  Q_INVOKABLE bool isSubmitted(const QString& requestUID) const;
+
+  /// Block until the transaction of the request is written, at most \a msecs msec
+  /// (-1 for no limit). Return true if the request is written successfully.
+  /// Return false if the transaction failed, if the request is unknown or canceled,
+  /// or if the time limit is reached (the request is then still submitted).
+  Q_INVOKABLE bool waitForInserted(const QString& requestUID, int msecs = -1);
+
+  /// Forget a request, e.g. when its job is stopped or removed: it is not written if it is
+  /// still queued, and waitForInserted() returns false.
+  Q_INVOKABLE void cancel(const QString& requestUID);
+
+  /// Write the queued requests, then stop the thread and close the connection.
+  /// The service is restarted by the next submit().
+  Q_INVOKABLE void stop();
+
+  ///@{
+  /// Statistics: number of transactions and of response sets written
+  Q_INVOKABLE int flushCount() const;
+  Q_INVOKABLE int insertedJobResponseSetsCount() const;
+  ///@}
+
+protected:
+  QScopedPointer<ctkDICOMInsertServicePrivate> d_ptr;
+
+private:
+  Q_DECLARE_PRIVATE(ctkDICOMInsertService);
+  Q_DISABLE_COPY(ctkDICOMInsertService);
+};
+
+#endif
@@ -30,6 +30,7 @@
 // ctkDICOMCore includes
 #include "ctkDICOMDatabase.h"
 #include "ctkDICOMInserter.h"
+#include "ctkDICOMInsertService.h"
 #include "ctkDICOMJobResponseSet.h"
 
 //------------------------------------------------------------------------------
@@ -43,6 +44,8 @@ public:
   QString DatabaseFilename;
   QStringList TagsToPrecache;
   QStringList TagsToExcludeFromStorage;
+  QString JobUID;
+  QSharedPointer<ctkDICOMInsertService> InsertService;
 };
 
 //------------------------------------------------------------------------------
@@ -74,6 +77,10 @@ CTK_SET_CPP(ctkDICOMInserter, const QStringList&, setTagsToPrecache, TagsToPreca
 CTK_GET_CPP(ctkDICOMInserter, QStringList, tagsToPrecache, TagsToPrecache)
 CTK_SET_CPP(ctkDICOMInserter, const QStringList&, setTagsToExcludeFromStorage, TagsToExcludeFromStorage);
 CTK_GET_CPP(ctkDICOMInserter, QStringList, tagsToExcludeFromStorage, TagsToExcludeFromStorage)
+CTK_SET_CPP(ctkDICOMInserter, const QString&, setJobUID, JobUID);
+CTK_GET_CPP(ctkDICOMInserter, QString, jobUID, JobUID)
+CTK_SET_CPP(ctkDICOMInserter, QSharedPointer<ctkDICOMInsertService>, setInsertService, InsertService);
+CTK_GET_CPP(ctkDICOMInserter, QSharedPointer<ctkDICOMInsertService>, insertService, InsertService)
 
 //------------------------------------------------------------------------------
 bool ctkDICOMInserter::wasCanceled()
@@ -93,6 +100,27 @@ bool ctkDICOMInserter::addJobResponseSets(const QList<ctkDICOMJobResponseSet*>&
 
   emit updatingDatabase(true);
 
+  // The insert service owns the write connection and coalesces the response sets of
+  // the jobs, in the order they were submitted
+  if (d->InsertService && d->InsertService->isSubmitted(d->JobUID))
+  {
+    // Stop waiting when the job is canceled
+    bool success = false;
+    while (!(success = d->InsertService->waitForInserted(d->JobUID, 100))
+      && d->InsertService->isSubmitted(d->JobUID))
+    {
+      if (d->Canceled)
+      {
+        d->InsertService->cancel(d->JobUID);
+      }
+    }
+
+    emit updatingDatabase(false);
+    emit done();
+
+    return success;
+  }
+
   ctkDICOMDatabase database;
   QString dbConnectionName =
     "db_" + QString::number(reinterpret_cast<quint64>(QThread::currentThreadId()), 16);
@@ -101,12 +129,8 @@ bool ctkDICOMInserter::addJobResponseSets(const QList<ctkDICOMJobResponseSet*>&
   database.setTagsToPrecache(d->TagsToPrecache);
   database.setTagsToExcludeFromStorage(d->TagsToExcludeFromStorage);
 
-  // To Do: We should ensure that only one write operation occurs at a time.
-  // In the ctkDICOMScheduler, we ensure this by utilizing a job queue, preventing multiple inserter jobs from running concurrently.
-  // Similarly, it would be necessary to implement a check in the insert method of ctkDICOMDatabase
-  // to determine if any other process is currently writing (for example, a UI element writing the patient's name into the database).
-  // Therefore, we propose the inclusion of a static variable in ctkDICOMDatabase that indicates ongoing write operations
-  // for each DatabaseFilename, except in cases where it is an in-memory database.
+  // Without insert service, only one write operation at a time is ensured by
+  // the scheduler, which runs one inserter job at a time.
   ctkDICOMDatabase::InsertResult result = database.insert(jobResponseSets);
   database.updateDisplayedFields();
   database.closeDatabase();
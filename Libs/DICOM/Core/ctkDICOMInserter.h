@@ -26,11 +26,13 @@
 
 // Qt includes
 #include <QObject>
+#include <QSharedPointer>
 
 // ctkDICOMCore includes
 #include "ctkDICOMCoreExport.h"
 
 class ctkDICOMInserterPrivate;
+class ctkDICOMInsertService;
 class ctkDICOMJobResponseSet;
 
 /// \ingroup DICOM_Core
@@ -40,6 +42,7 @@ class CTK_DICOM_CORE_EXPORT ctkDICOMInserter : public QObject
   Q_PROPERTY(QString databaseFilename READ databaseFilename WRITE setDatabaseFilename);
   Q_PROPERTY(QStringList tagsToPrecache READ tagsToPrecache WRITE setTagsToPrecache);
   Q_PROPERTY(QStringList tagsToExcludeFromStorage READ tagsToExcludeFromStorage WRITE setTagsToExcludeFromStorage);
+  Q_PROPERTY(QString jobUID READ jobUID WRITE setJobUID);
 
 public:
   explicit ctkDICOMInserter(QObject* parent = 0);
@@ -63,10 +66,26 @@ public:
   QStringList tagsToExcludeFromStorage() const;
   ///@}
 
+  ///@{
+  /// Reference job uid.
+  void setJobUID(const QString& jobUID);
+  QString jobUID() const;
+  ///@}
+
+  ///@{
+  /// Insert service that writes the response sets submitted with the job uid.
+  /// If the job was not submitted to a service, addJobResponseSets() opens
+  /// its own connection to the database.
+  void setInsertService(QSharedPointer<ctkDICOMInsertService> insertService);
+  QSharedPointer<ctkDICOMInsertService> insertService() const;
+  ///@}
+
   /// Return true if the operation was canceled.
   Q_INVOKABLE bool wasCanceled();
 
-  /// add JobResponseSets from queries and retrieves
+  /// add JobResponseSets from queries and retrieves.
+  /// If the job response sets were submitted to the insert service,
+  /// wait for the service to write them instead.
   Q_INVOKABLE bool addJobResponseSets(const QList<ctkDICOMJobResponseSet*>& jobResponseSets);
 
 Q_SIGNALS:
@@ -30,7 +30,9 @@
 // ctkDICOMCore includes
 #include "ctkDICOMInserterJob.h"
 #include "ctkDICOMInserterWorker_p.h"
+#include "ctkDICOMInsertService.h"
 #include "ctkDICOMJobResponseSet.h"
+#include "ctkDICOMScheduler.h"
 
 // DCMTK includes
 #include <dcmtk/oflog/spi/logevent.h>
@@ -62,6 +64,7 @@ void ctkDICOMInserterWorkerPrivate::setInserterParameters()
     return;
   }
 
+  this->Inserter->setJobUID(inserterJob->jobUID());
   this->Inserter->setDatabaseFilename(inserterJob->databaseFilename());
   this->Inserter->setTagsToPrecache(inserterJob->tagsToPrecache());
   this->Inserter->setTagsToExcludeFromStorage(inserterJob->tagsToExcludeFromStorage());
@@ -114,6 +117,10 @@ void ctkDICOMInserterWorker::run()
 
   inserterJob->setStatus(ctkAbstractJob::JobStatus::Running);
 
+  QSharedPointer<ctkDICOMScheduler> scheduler =
+    qSharedPointerObjectCast<ctkDICOMScheduler>(this->Scheduler);
+  d->Inserter->setInsertService(scheduler ? scheduler->insertServiceShared() : QSharedPointer<ctkDICOMInsertService>());
+
   logger.debug(QString("ctkDICOMInserterWorker : running job %1 in thread %2.\n")
                        .arg(inserterJob->jobUID())
                        .arg(QString::number(reinterpret_cast<quint64>(QThread::currentThreadId())), 16));
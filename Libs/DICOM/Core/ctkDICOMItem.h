@@ -26,6 +26,7 @@
 #include "ctkDICOMPersonName.h"
 
 #include <dcmtk/dcmdata/dcdatset.h> // DCMTK DcmDataset
+#include <dcmtk/dcmdata/dcdeftag.h> // DCMTK DCM_PixelData
 
 #include <QCoreApplication>
 #include <QtCore>
@@ -96,6 +97,19 @@ class CTK_DICOM_CORE_EXPORT ctkDICOMItem
                     const Uint32 maxReadLength = DCM_MaxReadLength,
                     const E_FileReadMode readMode = ERM_autoDetect);
 
+    ///
+    /// \brief For initialization from file, stopping when stopParsingAtElement is reached.
+    ///
+    /// Elements starting from stopParsingAtElement (by default the pixel data) are not
+    /// read from the file, which makes this method well suited for indexing, where only
+    /// the header of the file is needed.
+    virtual void InitializeFromFileUntilTag(const QString& filename,
+                    const DcmTagKey& stopParsingAtElement = DCM_PixelData,
+                    const E_TransferSyntax readXfer = EXS_Unknown,
+                    const E_GrpLenEncoding groupLength = EGL_noChange,
+                    const Uint32 maxReadLength = DCM_MaxReadLength,
+                    const E_FileReadMode readMode = ERM_autoDetect);
+
     /// \brief Clone this object.
     ///
     /// \returns deep copy of this object.
@@ -168,6 +168,35 @@ void ctkDICOMJob::copyJobResponseSets(const QList<QSharedPointer<ctkDICOMJobResp
   }
 }
 
+//------------------------------------------------------------------------------
+QVariantMap ctkDICOMJob::parameters() const
+{
+  QVariantMap parameters = this->Superclass::parameters();
+  parameters["dicomLevel"] = static_cast<int>(this->DICOMLevel);
+  parameters["patientID"] = this->PatientID;
+  parameters["studyInstanceUID"] = this->StudyInstanceUID;
+  parameters["seriesInstanceUID"] = this->SeriesInstanceUID;
+  parameters["sopInstanceUID"] = this->SOPInstanceUID;
+  return parameters;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMJob::setParameters(const QVariantMap& parameters)
+{
+  if (!this->Superclass::setParameters(parameters))
+  {
+    return false;
+  }
+
+  this->DICOMLevel = static_cast<DICOMLevels>(
+    parameters.value("dicomLevel", static_cast<int>(this->DICOMLevel)).toInt());
+  this->PatientID = parameters.value("patientID", this->PatientID).toString();
+  this->StudyInstanceUID = parameters.value("studyInstanceUID", this->StudyInstanceUID).toString();
+  this->SeriesInstanceUID = parameters.value("seriesInstanceUID", this->SeriesInstanceUID).toString();
+  this->SOPInstanceUID = parameters.value("sopInstanceUID", this->SOPInstanceUID).toString();
+  return true;
+}
+
 //------------------------------------------------------------------------------
 ctkDICOMJobResponseSet::JobType ctkDICOMJob::getJobType() const
 {
@@ -107,6 +107,15 @@ public:
   void copyJobResponseSets(const QList<QSharedPointer<ctkDICOMJobResponseSet>>& jobResponseSets);
   ///@}
 
+  ///@{
+  /// Parameters of the job: the ones of ctkAbstractJob, the DICOM level and the UIDs.
+  /// The reference inserter job UID is not a parameter: the inserter job only exists
+  /// in the scheduler that created it.
+  /// \sa ctkAbstractJob::parameters
+  Q_INVOKABLE virtual QVariantMap parameters() const override;
+  Q_INVOKABLE virtual bool setParameters(const QVariantMap& parameters) override;
+  ///@}
+
   /// Return job type.
   Q_INVOKABLE virtual ctkDICOMJobResponseSet::JobType getJobType() const;
 
@@ -19,6 +19,7 @@
 =========================================================================*/
 
 // Qt includes
+#include <QAtomicInt>
 #include <QDebug>
 #include <QDate>
 #include <QDirIterator>
@@ -26,16 +27,19 @@
 #include <QFileInfo>
 #include <QMutex>
 #include <QPair>
+#include <QRunnable>
 #include <QSet>
 #include <QSqlQuery>
 #include <QSqlRecord>
 #include <QStringList>
+#include <QThreadPool>
 #include <QVariant>
 
 // ctkCore includes
 #include <ctkPimpl.h>
 
 // ctkDICOMCore includes
+#include "ctkDICOMAssociationPool.h"
 #include "ctkDICOMQuery.h"
 #include "ctkDICOMJobResponseSet.h"
 
@@ -51,6 +55,9 @@
 #include <dcmtk/ofstd/ofstd.h>        /* for class OFStandard */
 #include <dcmtk/dcmdata/dcddirif.h>   /* for class DicomDirInterface */
 
+// STD includes
+#include <vector>
+
 //------------------------------------------------------------------------------
 // Using dcmtk root log4cplus logger instead of ctkLogger because with ctkDICOMJobsAppender (dcmtk::log4cplus::Appender),
 // logging is filtered by threadID and reported in the GUI per job.
@@ -81,9 +88,12 @@ class ctkDICOMQuerySCUPrivate : public DcmSCU
 {
 public:
   ctkDICOMQuery *query;
+  /// True for the additional associations sending series C-FINDs in parallel in query()
+  bool FanOutAssociation;
   ctkDICOMQuerySCUPrivate()
   {
     this->query = 0;
+    this->FanOutAssociation = false;
   };
   ~ctkDICOMQuerySCUPrivate() {};
   virtual OFCondition handleFINDResponse(const T_ASC_PresentationContextID  presID,
@@ -99,7 +109,14 @@ public:
     {
       // send cancel can fail and be ignored (but DCMTK will report still good == true).
       // Therefore, we need to force the release of the association to cancel the worker
-      this->query->releaseAssociation();
+      if (this->FanOutAssociation)
+      {
+        this->releaseAssociation();
+      }
+      else
+      {
+        this->query->releaseAssociation();
+      }
       return EC_IllegalCall;
     }
 
@@ -125,6 +142,34 @@ public:
   /// Therefore use this method instead of calling directly SCU->releaseAssociation()
   OFCondition releaseAssociation();
 
+  /// Give the association back to the pool at the end of a request,
+  /// or release it if no slot of the pool is acquired.
+  void returnAssociation();
+
+  /// State shared by the associations sending the series C-FINDs of query()
+  struct SeriesFanOut
+  {
+    QStringList StudyInstanceUIDs;
+    std::vector<OFList<QRResponse*>> Responses;
+    std::vector<char> Succeeded;
+    QAtomicInt NextStudyIndex;
+    /// Studies to query again because the association of their request was lost
+    QList<int> RequeuedStudyIndexes;
+    std::vector<char> Requeued;
+    QMutex Mutex;
+    Uint32 ACSETimeout;
+    Sint32 ConnectionTimeout;
+  };
+
+  /// Send the series C-FINDs of the studies not yet taken by another association,
+  /// starting with the studies requeued by the associations that were lost.
+  void findSeries(ctkDICOMQuerySCUPrivate* scu, SeriesFanOut& fanOut, DcmDataset& queryDataset);
+
+  /// Open an additional association for the series C-FINDs of query().
+  /// Returns nullptr if it fails or if the association pool has no free slot.
+  ctkDICOMQuerySCUPrivate* openFanOutAssociation(ctkDICOMQuery* q, const SeriesFanOut& fanOut);
+  void closeFanOutAssociation(ctkDICOMQuerySCUPrivate* scu);
+
   QString ConnectionName;
   QString CallingAETitle;
   QString CalledAETitle;
@@ -136,12 +181,67 @@ public:
   QSharedPointer<DcmDataset> QueryDcmDataset;
   QList<QPair<QString,QString>> StudyAndSeriesInstanceUIDPairList;
   QMap<QString, DcmDataset*> StudyDatasets;
-  bool Canceled;
+  QAtomicInt Canceled;
   bool AssociationClosing;
   QMutex AssociationMutex;
   int MaximumPatientsQuery;
   QString JobUID;
   QList<QSharedPointer<ctkDICOMJobResponseSet>> JobResponseSets;
+  QSharedPointer<ctkDICOMAssociationPool> AssociationPool;
+  QString AssociationKey;
+  bool AssociationAcquired;
+  int MaximumParallelQueries;
+};
+
+//------------------------------------------------------------------------------
+// Gives the association back when a request is finished, including when it is
+// canceled or failed.
+class ctkDICOMQueryAssociationGuard
+{
+public:
+  ctkDICOMQueryAssociationGuard(ctkDICOMQueryPrivate* d) : d(d) {}
+  ~ctkDICOMQueryAssociationGuard()
+  {
+    this->d->returnAssociation();
+  }
+
+private:
+  ctkDICOMQueryPrivate* d;
+};
+
+//------------------------------------------------------------------------------
+// Sends series C-FINDs of query() on an additional association
+class ctkDICOMQuerySeriesRunnable : public QRunnable
+{
+public:
+  ctkDICOMQuerySeriesRunnable(ctkDICOMQueryPrivate* d, ctkDICOMQuery* q,
+                              ctkDICOMQueryPrivate::SeriesFanOut* fanOut,
+                              const DcmDataset& queryDataset)
+    : d(d)
+    , q(q)
+    , FanOut(fanOut)
+    , QueryDataset(queryDataset)
+  {
+  }
+
+  void run() override
+  {
+    ctkDICOMQuerySCUPrivate* scu = this->d->openFanOutAssociation(this->q, *this->FanOut);
+    if (!scu)
+    {
+      // the other associations send the C-FINDs
+      return;
+    }
+    this->d->findSeries(scu, *this->FanOut, this->QueryDataset);
+    this->d->closeFanOutAssociation(scu);
+  }
+
+private:
+  ctkDICOMQueryPrivate* d;
+  ctkDICOMQuery* q;
+  ctkDICOMQueryPrivate::SeriesFanOut* FanOut;
+  // copied from the calling thread, DCMTK datasets are not thread safe
+  DcmDataset QueryDataset;
 };
 
 //------------------------------------------------------------------------------
@@ -152,9 +252,11 @@ ctkDICOMQueryPrivate::ctkDICOMQueryPrivate()
 {
   this->QueryDcmDataset = QSharedPointer<DcmDataset>(new DcmDataset);
   this->Port = 0;
-  this->Canceled = false;
+  this->Canceled.storeRelease(0);
   this->AssociationClosing = false;
   this->MaximumPatientsQuery = 25;
+  this->AssociationAcquired = false;
+  this->MaximumParallelQueries = 1;
 
   this->PresentationContext = 0;
   this->SCU = new ctkDICOMQuerySCUPrivate();
@@ -165,6 +267,11 @@ ctkDICOMQueryPrivate::ctkDICOMQueryPrivate()
 //------------------------------------------------------------------------------
 ctkDICOMQueryPrivate::~ctkDICOMQueryPrivate()
 {
+  if (this->AssociationAcquired)
+  {
+    this->returnAssociation();
+  }
+
   if (this->SCU && this->SCU->isConnected())
   {
     this->releaseAssociation();
@@ -212,6 +319,160 @@ OFCondition ctkDICOMQueryPrivate::releaseAssociation()
   return status;
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMQueryPrivate::returnAssociation()
+{
+  if (!this->AssociationAcquired)
+  {
+    if (this->SCU && this->SCU->isConnected())
+    {
+      this->releaseAssociation();
+    }
+    return;
+  }
+
+  // The pool takes the SCU with its association, continue with a new one
+  ctkDICOMQuerySCUPrivate* association = nullptr;
+  {
+    QMutexLocker locker(&this->AssociationMutex);
+    association = this->SCU;
+    this->SCU = new ctkDICOMQuerySCUPrivate();
+    this->SCU->query = association->query;
+    this->SCU->setVerbosePCMode(false);
+    this->SCU->setACSETimeout(association->getACSETimeout());
+    this->SCU->setConnectionTimeout(association->getConnectionTimeout());
+    this->PresentationContext = 0;
+    this->AssociationAcquired = false;
+  }
+  association->query = nullptr;
+  this->AssociationPool->release(this->AssociationKey, association);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMQueryPrivate::findSeries(ctkDICOMQuerySCUPrivate* scu, SeriesFanOut& fanOut, DcmDataset& queryDataset)
+{
+  T_ASC_PresentationContextID presentationContext =
+    scu->findPresentationContextID(UID_FINDStudyRootQueryRetrieveInformationModel, "");
+  forever
+  {
+    if (this->Canceled.loadAcquire())
+    {
+      return;
+    }
+
+    int studyIndex = -1;
+    {
+      QMutexLocker locker(&fanOut.Mutex);
+      if (!fanOut.RequeuedStudyIndexes.isEmpty())
+      {
+        studyIndex = fanOut.RequeuedStudyIndexes.takeFirst();
+      }
+    }
+    if (studyIndex < 0)
+    {
+      studyIndex = fanOut.NextStudyIndex.fetchAndAddOrdered(1);
+      if (studyIndex >= fanOut.StudyInstanceUIDs.count())
+      {
+        return;
+      }
+    }
+
+    queryDataset.putAndInsertString(DCM_StudyInstanceUID, fanOut.StudyInstanceUIDs.at(studyIndex).toStdString().c_str());
+    OFList<QRResponse*>& responses = fanOut.Responses[studyIndex];
+    OFCondition status = scu->sendFINDRequest(presentationContext, &queryDataset, &responses);
+    fanOut.Succeeded[studyIndex] = status.good();
+    if (!scu->isConnected())
+    {
+      // Requeue the study once for the other associations,
+      // and leave them the remaining studies
+      if (!status.good() && !fanOut.Requeued[studyIndex])
+      {
+        for (OFListIterator(QRResponse*) it = responses.begin(); it != responses.end(); it++)
+        {
+          delete *it;
+        }
+        responses.clear();
+        QMutexLocker locker(&fanOut.Mutex);
+        fanOut.Requeued[studyIndex] = true;
+        fanOut.RequeuedStudyIndexes.append(studyIndex);
+      }
+      return;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMQuerySCUPrivate* ctkDICOMQueryPrivate::openFanOutAssociation(ctkDICOMQuery* q, const SeriesFanOut& fanOut)
+{
+  if (this->AssociationPool)
+  {
+    // Do not wait for a slot, the association of the query is always available
+    if (!this->AssociationPool->acquire(0))
+    {
+      return nullptr;
+    }
+    DcmSCU* association = this->AssociationPool->takeIdleAssociation(this->AssociationKey);
+    if (association)
+    {
+      ctkDICOMQuerySCUPrivate* scu = static_cast<ctkDICOMQuerySCUPrivate*>(association);
+      scu->query = q;
+      scu->FanOutAssociation = true;
+      return scu;
+    }
+  }
+
+  ctkDICOMQuerySCUPrivate* scu = new ctkDICOMQuerySCUPrivate();
+  scu->query = q;
+  scu->FanOutAssociation = true;
+  scu->setVerbosePCMode(false);
+  scu->setAETitle(OFString(this->CallingAETitle.toStdString().c_str()));
+  scu->setPeerAETitle(OFString(this->CalledAETitle.toStdString().c_str()));
+  scu->setPeerHostName(OFString(this->Host.toStdString().c_str()));
+  scu->setPeerPort(this->Port);
+  scu->setACSETimeout(fanOut.ACSETimeout);
+  scu->setConnectionTimeout(fanOut.ConnectionTimeout);
+
+  OFList<OFString> transferSyntaxes;
+  transferSyntaxes.push_back(UID_LittleEndianExplicitTransferSyntax);
+  transferSyntaxes.push_back(UID_BigEndianExplicitTransferSyntax);
+  transferSyntaxes.push_back(UID_LittleEndianImplicitTransferSyntax);
+  scu->addPresentationContext(UID_FINDStudyRootQueryRetrieveInformationModel, transferSyntaxes);
+  if (this->AssociationPool)
+  {
+    scu->addPresentationContext(UID_VerificationSOPClass, transferSyntaxes);
+  }
+
+  if (!scu->initNetwork().good() || !scu->negotiateAssociation().good())
+  {
+    DCMTK_LOG4CPLUS_WARN_STR(rootLogQuery, "Error negotiating an additional association for the series queries");
+    delete scu;
+    if (this->AssociationPool)
+    {
+      this->AssociationPool->release();
+    }
+    return nullptr;
+  }
+  return scu;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMQueryPrivate::closeFanOutAssociation(ctkDICOMQuerySCUPrivate* scu)
+{
+  scu->query = nullptr;
+  // the pooled association may be reused as the association of a query
+  scu->FanOutAssociation = false;
+  if (this->AssociationPool)
+  {
+    this->AssociationPool->release(this->AssociationKey, scu);
+    return;
+  }
+  if (scu->isConnected())
+  {
+    scu->releaseAssociation();
+  }
+  delete scu;
+}
+
 //------------------------------------------------------------------------------
 // ctkDICOMQuery methods
 
@@ -244,9 +505,36 @@ CTK_SET_CPP(ctkDICOMQuery, const int&, setPort, Port);
 CTK_GET_CPP(ctkDICOMQuery, int, port, Port)
 CTK_SET_CPP(ctkDICOMQuery, const int&, setMaximumPatientsQuery, MaximumPatientsQuery);
 CTK_GET_CPP(ctkDICOMQuery, int, maximumPatientsQuery, MaximumPatientsQuery);
+CTK_GET_CPP(ctkDICOMQuery, int, maximumParallelQueries, MaximumParallelQueries);
 CTK_SET_CPP(ctkDICOMQuery, const QString&, setJobUID, JobUID);
 CTK_GET_CPP(ctkDICOMQuery, QString, jobUID, JobUID)
 
+//-----------------------------------------------------------------------------
+void ctkDICOMQuery::setMaximumParallelQueries(int maximumParallelQueries)
+{
+  Q_D(ctkDICOMQuery);
+  d->MaximumParallelQueries = qMax(1, maximumParallelQueries);
+}
+
+//-----------------------------------------------------------------------------
+void ctkDICOMQuery::setAssociationPool(QSharedPointer<ctkDICOMAssociationPool> associationPool)
+{
+  Q_D(ctkDICOMQuery);
+  if (d->AssociationPool == associationPool)
+  {
+    return;
+  }
+  d->returnAssociation();
+  d->AssociationPool = associationPool;
+}
+
+//-----------------------------------------------------------------------------
+QSharedPointer<ctkDICOMAssociationPool> ctkDICOMQuery::associationPool() const
+{
+  Q_D(const ctkDICOMQuery);
+  return d->AssociationPool;
+}
+
 //-----------------------------------------------------------------------------
 void ctkDICOMQuery::setConnectionTimeout(const int& timeout)
 {
@@ -266,7 +554,7 @@ int ctkDICOMQuery::connectionTimeout() const
 bool ctkDICOMQuery::wasCanceled()
 {
   Q_D(const ctkDICOMQuery);
-  return d->Canceled;
+  return d->Canceled.loadAcquire() != 0;
 }
 
 //------------------------------------------------------------------------------
@@ -314,6 +602,7 @@ QList<QSharedPointer<ctkDICOMJobResponseSet>> ctkDICOMQuery::jobResponseSetsShar
 bool ctkDICOMQuery::query(ctkDICOMDatabase& database)
 {
   Q_D(ctkDICOMQuery);
+  ctkDICOMQueryAssociationGuard associationGuard(d);
   if (database.database().isOpen())
   {
     LOG_AND_EMIT_DEBUG(QString("DB open in Query"), debug);
@@ -324,7 +613,7 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database)
   }
 
   emit progress(0);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
@@ -332,6 +621,7 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database)
 
   d->StudyAndSeriesInstanceUIDPairList.clear();
   d->StudyDatasets.clear();
+  d->JobResponseSets.clear();
 
   // initSCU
   if (!this->initializeSCU())
@@ -362,7 +652,7 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database)
   d->QueryDcmDataset->putAndInsertString (DCM_QueryRetrieveLevel, "STUDY");
 
   QString seriesDescription = this->applyFilters(d->Filters);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
@@ -382,7 +672,7 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database)
   }
 
   emit progress(40);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
@@ -400,7 +690,7 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database)
   LOG_AND_EMIT_DEBUG(QString("Find succeeded"), debug)
 
   emit progress(50);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
@@ -417,7 +707,7 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database)
       d->addStudyInstanceUIDAndDataset(StudyInstanceUID.c_str(), dataset);
       emit progress("Processing: " + QString(StudyInstanceUID.c_str()));
       emit progress(50);
-      if (d->Canceled)
+      if (d->Canceled.loadAcquire())
       {
         emit done(false);
         return false;
@@ -442,29 +732,67 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database)
 
   // Now search each within each Study that was identified
   d->QueryDcmDataset->putAndInsertString(DCM_QueryRetrieveLevel, "SERIES");
-  float progressRatio = 25. / d->StudyDatasets.count();
-  int i = 0;
+  QStringList studyInstanceUIDs = d->StudyDatasets.keys();
+  ctkDICOMQueryPrivate::SeriesFanOut fanOut;
+  fanOut.StudyInstanceUIDs = studyInstanceUIDs;
+  fanOut.ACSETimeout = d->SCU->getACSETimeout();
+  fanOut.ConnectionTimeout = d->SCU->getConnectionTimeout();
+  fanOut.Responses.resize(studyInstanceUIDs.count());
+  fanOut.Succeeded.resize(studyInstanceUIDs.count(), false);
+  fanOut.Requeued.resize(studyInstanceUIDs.count(), false);
+
+  // The series C-FINDs of the studies are sent on this association and,
+  // in parallel, on up to maximumParallelQueries - 1 additional associations
+  int parallelQueries = qMin(d->MaximumParallelQueries, studyInstanceUIDs.count());
+  LOG_AND_EMIT_DEBUG(QString("Starting Series C-FIND for %1 studies on %2 associations")
+    .arg(studyInstanceUIDs.count()).arg(qMax(1, parallelQueries)), debug)
+  emit progress(50);
+  QThreadPool fanOutThreadPool;
+  fanOutThreadPool.setMaxThreadCount(qMax(1, parallelQueries - 1));
+  for (int index = 1; index < parallelQueries; ++index)
+  {
+    fanOutThreadPool.start(new ctkDICOMQuerySeriesRunnable(d, this, &fanOut, *d->QueryDcmDataset));
+  }
+  d->findSeries(d->SCU, fanOut, *d->QueryDcmDataset);
+  fanOutThreadPool.waitForDone();
+  if (d->SCU->isConnected())
+  {
+    // studies requeued by additional associations lost after this one was done
+    d->findSeries(d->SCU, fanOut, *d->QueryDcmDataset);
+  }
+  if (d->Canceled.loadAcquire())
+  {
+    emit done(false);
+    return false;
+  }
 
-  foreach(QString studyInstanceUID, d->StudyDatasets.keys())
+  // Merge the results in the order of the studies
+  float progressRatio = 50. / qMax(1, studyInstanceUIDs.count());
+  for (int studyIndex = 0; studyIndex < studyInstanceUIDs.count(); ++studyIndex)
   {
+    QString studyInstanceUID = studyInstanceUIDs[studyIndex];
     DcmDataset *studyDataset = d->StudyDatasets.value(studyInstanceUID);
     DcmElement *patientName, *patientID;
     studyDataset->findAndGetElement(DCM_PatientName, patientName);
     studyDataset->findAndGetElement(DCM_PatientID, patientID);
 
-    LOG_AND_EMIT_DEBUG(QString("Starting Series C-FIND for Study: %1").arg(studyInstanceUID), debug)
-    emit progress(50 + (progressRatio * i++));
-    if (d->Canceled)
+    if (fanOut.Succeeded[studyIndex])
     {
-      emit done(false);
-      return false;
-    }
+      QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet =
+        QSharedPointer<ctkDICOMJobResponseSet>(new ctkDICOMJobResponseSet);
+      jobResponseSet->setJobType(ctkDICOMJobResponseSet::JobType::QuerySeries);
+      jobResponseSet->setStudyInstanceUID(studyInstanceUID);
+      jobResponseSet->setConnectionName(d->ConnectionName);
+      jobResponseSet->setJobUID(d->JobUID);
+      if (patientID)
+      {
+        OFString patientIDString;
+        patientID->getOFStringArray(patientIDString);
+        jobResponseSet->setPatientID(patientIDString.c_str());
+      }
+      QMap<QString, DcmItem*> datasetsMap;
 
-    d->QueryDcmDataset->putAndInsertString (DCM_StudyInstanceUID, studyInstanceUID.toStdString().c_str());
-    OFList<QRResponse *> responses;
-    status = d->SCU->sendFINDRequest(presentationContext, d->QueryDcmDataset.data(), &responses);
-    if (status.good())
-    {
+      OFList<QRResponse *>& responses = fanOut.Responses[studyIndex];
       for (OFListIterator(QRResponse*) it = responses.begin(); it != responses.end(); it++)
       {
         DcmDataset *dataset = (*it)->m_dataset;
@@ -478,29 +806,26 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database)
           dataset->insert(patientID, true);
           // insert series dataset
           database.insert(dataset, false /* do not store */, false /* no thumbnail */);
+          datasetsMap.insert(seriesInstanceUID.c_str(), dataset);
         }
       }
+      jobResponseSet->setDatasets(datasetsMap, false);
+      d->JobResponseSets.append(jobResponseSet);
 
       LOG_AND_EMIT_DEBUG(QString("Find succeeded at Series level for Study: %1").arg(studyInstanceUID), debug)
-      emit progress(50 + (progressRatio * i++));
-      if (d->Canceled)
-      {
-        emit done(false);
-        return false;
-      }
     }
     else
     {
       LOG_AND_EMIT_ERROR(QString("Find at Series level failed for Study: %1").arg(studyInstanceUID), error)
     }
-    emit progress(50 + (progressRatio * i++));
-    if (d->Canceled)
+    emit progress(50 + (progressRatio * (studyIndex + 1)));
+    if (d->Canceled.loadAcquire())
     {
-    emit done(false);
-    return false;
+      emit done(false);
+      return false;
     }
   }
-  d->releaseAssociation();
+  d->returnAssociation();
   emit progress(100);
   emit done(true);
   return true;
@@ -510,9 +835,10 @@ bool ctkDICOMQuery::query(ctkDICOMDatabase& database)
 bool ctkDICOMQuery::queryPatients()
 {
   Q_D(ctkDICOMQuery);
+  ctkDICOMQueryAssociationGuard associationGuard(d);
 
   emit progress(0);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
@@ -543,7 +869,7 @@ bool ctkDICOMQuery::queryPatients()
   filters["Name"] = d->Filters["Name"];
   filters["ID"] = d->Filters["ID"];
   this->applyFilters(filters);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
@@ -561,7 +887,7 @@ bool ctkDICOMQuery::queryPatients()
     LOG_AND_EMIT_DEBUG(QString("Found useful presentation context"), debug)
   }
   emit progress(40);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
@@ -569,7 +895,7 @@ bool ctkDICOMQuery::queryPatients()
 
   LOG_AND_EMIT_DEBUG(QString("Starting patients C-FIND"), debug)
   emit progress(50);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
@@ -621,13 +947,13 @@ bool ctkDICOMQuery::queryPatients()
   }
 
   emit progress(100);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
   }
 
-  d->releaseAssociation();
+  d->returnAssociation();
   emit done(true);
   return true;
 }
@@ -636,9 +962,10 @@ bool ctkDICOMQuery::queryPatients()
 bool ctkDICOMQuery::queryStudies(const QString& patientID)
 {
   Q_D(ctkDICOMQuery);
+  ctkDICOMQueryAssociationGuard associationGuard(d);
 
   emit progress(0);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
@@ -682,7 +1009,7 @@ bool ctkDICOMQuery::queryStudies(const QString& patientID)
   filters["StartDate"] = d->Filters["StartDate"];
   filters["EndDate"] = d->Filters["EndDate"];
   this->applyFilters(filters);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
@@ -700,7 +1027,7 @@ bool ctkDICOMQuery::queryStudies(const QString& patientID)
     LOG_AND_EMIT_DEBUG(QString("Found useful presentation context"), debug);
   }
   emit progress(40);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
@@ -708,7 +1035,7 @@ bool ctkDICOMQuery::queryStudies(const QString& patientID)
 
   LOG_AND_EMIT_DEBUG(QString("Starting studies C-FIND for patient: %1").arg(patientID), debug)
   emit progress(50);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
@@ -751,13 +1078,13 @@ bool ctkDICOMQuery::queryStudies(const QString& patientID)
   }
 
   emit progress(100);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
   }
 
-  d->releaseAssociation();
+  d->returnAssociation();
   emit done(true);
   return true;
 }
@@ -767,9 +1094,10 @@ bool ctkDICOMQuery::querySeries(const QString& patientID,
                                 const QString& studyInstanceUID)
 {
   Q_D(ctkDICOMQuery);
+  ctkDICOMQueryAssociationGuard associationGuard(d);
 
   emit progress(0);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
@@ -803,7 +1131,7 @@ bool ctkDICOMQuery::querySeries(const QString& patientID,
   filters["EndDate"] = d->Filters["EndDate"];
   filters["Series"] = d->Filters["Series"];
   QString seriesDescription = this->applyFilters(filters);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
@@ -825,7 +1153,7 @@ bool ctkDICOMQuery::querySeries(const QString& patientID,
     LOG_AND_EMIT_DEBUG(QString("Found useful presentation context"), debug);
   }
   emit progress(40);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
@@ -833,7 +1161,7 @@ bool ctkDICOMQuery::querySeries(const QString& patientID,
 
   LOG_AND_EMIT_DEBUG(QString("Starting series C-FIND for study: %1").arg(studyInstanceUID), debug)
   emit progress(50);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
@@ -878,13 +1206,13 @@ bool ctkDICOMQuery::querySeries(const QString& patientID,
   }
 
   emit progress(100);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
   }
 
-  d->releaseAssociation();
+  d->returnAssociation();
   emit done(true);
   return true;
 }
@@ -895,9 +1223,10 @@ bool ctkDICOMQuery::queryInstances(const QString& patientID,
                                    const QString& seriesInstanceUID)
 {
   Q_D(ctkDICOMQuery);
+  ctkDICOMQueryAssociationGuard associationGuard(d);
 
   emit progress(0);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
@@ -928,7 +1257,7 @@ bool ctkDICOMQuery::queryInstances(const QString& patientID,
   filters["EndDate"] = d->Filters["EndDate"];
   filters["Series"] = d->Filters["Series"];
   QString seriesDescription = this->applyFilters(filters);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
@@ -949,7 +1278,7 @@ bool ctkDICOMQuery::queryInstances(const QString& patientID,
     LOG_AND_EMIT_DEBUG(QString("Found useful presentation context"), debug)
   }
   emit progress(40);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
@@ -957,7 +1286,7 @@ bool ctkDICOMQuery::queryInstances(const QString& patientID,
 
   LOG_AND_EMIT_DEBUG(QString("Starting sop instances C-FIND for series: %1").arg(seriesInstanceUID), debug)
   emit progress(50);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
@@ -1004,13 +1333,13 @@ bool ctkDICOMQuery::queryInstances(const QString& patientID,
   d->JobResponseSets.append(JobResponseSet);
 
   emit progress(100);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     emit done(false);
     return false;
   }
 
-  d->releaseAssociation();
+  d->returnAssociation();
   emit done(true);
   return true;
 }
@@ -1019,7 +1348,7 @@ bool ctkDICOMQuery::queryInstances(const QString& patientID,
 void ctkDICOMQuery::cancel()
 {
   Q_D(ctkDICOMQuery);
-  d->Canceled = true;
+  d->Canceled.storeRelease(1);
 
   if (d->PresentationContext != 0)
   {
@@ -1045,9 +1374,42 @@ bool ctkDICOMQuery::initializeSCU()
   d->SCU->setPeerHostName(OFString(this->host().toStdString().c_str()));
   d->SCU->setPeerPort(this->port());
 
+  if (d->AssociationPool)
+  {
+    d->returnAssociation();
+    while (!d->AssociationPool->acquire(500))
+    {
+      if (d->Canceled.loadAcquire())
+      {
+        return false;
+      }
+    }
+    d->AssociationAcquired = true;
+    d->AssociationKey = ctkDICOMAssociationPool::associationKey(
+      "ctkDICOMQuery", this->callingAETitle(), this->calledAETitle(), this->host(), this->port());
+
+    DcmSCU* association = d->AssociationPool->takeIdleAssociation(d->AssociationKey);
+    if (association)
+    {
+      ctkDICOMQuerySCUPrivate* scu = static_cast<ctkDICOMQuerySCUPrivate*>(association);
+      scu->query = this;
+      scu->FanOutAssociation = false;
+      scu->setACSETimeout(d->SCU->getACSETimeout());
+      scu->setConnectionTimeout(d->SCU->getConnectionTimeout());
+      QMutexLocker locker(&d->AssociationMutex);
+      delete d->SCU;
+      d->SCU = scu;
+      locker.unlock();
+
+      LOG_AND_EMIT_DEBUG(QString("Reusing Association"), debug)
+      emit progress(20);
+      return true;
+    }
+  }
+
   LOG_AND_EMIT_DEBUG(QString("Setting Transfer Syntaxes"), debug)
   emit progress(10);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     return false;
   }
@@ -1058,6 +1420,11 @@ bool ctkDICOMQuery::initializeSCU()
   transferSyntaxes.push_back(UID_LittleEndianImplicitTransferSyntax);
 
   d->SCU->addPresentationContext(UID_FINDStudyRootQueryRetrieveInformationModel, transferSyntaxes);
+  if (d->AssociationPool)
+  {
+    // used by the pool to check idle associations
+    d->SCU->addPresentationContext(UID_VerificationSOPClass, transferSyntaxes);
+  }
   if (!d->SCU->initNetwork().good())
   {
     LOG_AND_EMIT_ERROR(QString("Error initializing the network"), error)
@@ -1066,7 +1433,7 @@ bool ctkDICOMQuery::initializeSCU()
 
   LOG_AND_EMIT_DEBUG(QString("Negotiating Association"), debug)
   emit progress(20);
-  if (d->Canceled)
+  if (d->Canceled.loadAcquire())
   {
     return false;
   }
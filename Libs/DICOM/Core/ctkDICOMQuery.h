@@ -24,6 +24,7 @@
 // Qt includes
 #include <QObject>
 #include <QMap>
+#include <QSharedPointer>
 #include <QString>
 
 // ctkCore includes
@@ -32,6 +33,7 @@
 // ctkDICOMCore includes
 #include "ctkDICOMCoreExport.h"
 #include "ctkDICOMDatabase.h"
+class ctkDICOMAssociationPool;
 class ctkDICOMQueryPrivate;
 class ctkDICOMJobResponseSet;
 
@@ -46,6 +48,7 @@ class CTK_DICOM_CORE_EXPORT ctkDICOMQuery : public QObject
   Q_PROPERTY(int port READ port WRITE setPort);
   Q_PROPERTY(int connectionTimeout READ connectionTimeout WRITE setConnectionTimeout);
   Q_PROPERTY(int maximumPatientsQuery READ maximumPatientsQuery WRITE setMaximumPatientsQuery);
+  Q_PROPERTY(int maximumParallelQueries READ maximumParallelQueries WRITE setMaximumParallelQueries);
   Q_PROPERTY(QList<QPair<QString,QString>> studyAndSeriesInstanceUIDQueried READ studyAndSeriesInstanceUIDQueried);
   Q_PROPERTY(QString jobUID READ jobUID WRITE setJobUID);
 
@@ -97,6 +100,16 @@ public:
   int maximumPatientsQuery() const;
   ///@}
 
+  ///@{
+  /// Maximum number of associations used by query() to send the series level
+  /// C-FINDs of the studies in parallel. Default is 1 (one study after the other).
+  /// With an association pool, additional associations are only opened if the
+  /// pool has free slots.
+  /// Only query() uses it: querySeries() sends the C-FIND of a single study.
+  void setMaximumParallelQueries(int maximumParallelQueries);
+  int maximumParallelQueries() const;
+  ///@}
+
   ///@{
   /// Filters are keyword/value pairs as generated by
   /// the ctkDICOMWidgets in a human readable (and editable)
@@ -123,6 +136,10 @@ public:
 
   /// Query a remote DICOM Image Store SCP.
   /// You must at least set the host and port before calling query()
+  /// Studies and series are inserted in the database. The series of each study
+  /// are also stored in a QuerySeries job response set (see jobResponseSets()),
+  /// in the order of the studies.
+  /// \sa setMaximumParallelQueries()
   Q_INVOKABLE bool query(ctkDICOMDatabase& database);
 
   /// Access the list of study and series instance UIDs from the last query method.
@@ -166,6 +183,15 @@ public:
   QString jobUID() const;
   ///@}
 
+  ///@{
+  /// Pool of associations shared with other queries and retrieves (none by default).
+  /// If set, requests reuse the idle associations of the pool and give their
+  /// association back to the pool when they are done instead of releasing it.
+  /// \sa ctkDICOMServer::associationPool()
+  void setAssociationPool(QSharedPointer<ctkDICOMAssociationPool> associationPool);
+  QSharedPointer<ctkDICOMAssociationPool> associationPool() const;
+  ///@}
+
 Q_SIGNALS:
   /// Signal is emitted inside the query() function. It ranges from 0 to 100.
   /// In case of an error, you are assured that the progress value 100 is fired
@@ -72,6 +72,7 @@ void ctkDICOMQueryWorkerPrivate::setQueryParameters()
   this->Query->setHost(server->host());
   this->Query->setPort(server->port());
   this->Query->setConnectionTimeout(server->connectionTimeout());
+  this->Query->setAssociationPool(server->associationPoolShared());
   this->Query->setJobUID(queryJob->jobUID());
   this->Query->setFilters(queryJob->filters());
 }
@@ -19,12 +19,16 @@
 =========================================================================*/
 
 // Qt includes
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <QMutex>
 
 // ctkCore includes
 #include <ctkPimpl.h>
 
 // ctkDICOMCore includes
+#include "ctkDICOMAssociationPool.h"
 #include "ctkDICOMRetrieve.h"
 #include "ctkDICOMJobResponseSet.h"
 
@@ -155,6 +159,26 @@ public:
       jobResponseSet->setSeriesInstanceUID(this->retrieve->seriesInstanceUID());
       jobResponseSet->setSOPInstanceUID(qInstanceUID);
       jobResponseSet->setConnectionName(this->retrieve->connectionName());
+      if (this->retrieve->streamToStorage() && this->retrieve->dicomDatabase())
+      {
+        // The UIDs of the retrieve are used if the instance does not have them
+        OFString studyInstanceUID;
+        OFString seriesInstanceUID;
+        incomingObject->findAndGetOFString(DCM_StudyInstanceUID, studyInstanceUID);
+        incomingObject->findAndGetOFString(DCM_SeriesInstanceUID, seriesInstanceUID);
+        QString storedFilePath;
+        if (!this->retrieve->dicomDatabase()->storeInstanceFile(incomingObject,
+          studyInstanceUID.empty() ? this->retrieve->studyInstanceUID() : QString(studyInstanceUID.c_str()),
+          seriesInstanceUID.empty() ? this->retrieve->seriesInstanceUID() : QString(seriesInstanceUID.c_str()),
+          qInstanceUID, storedFilePath))
+        {
+          LOG_AND_EMIT_ERROR(QString("Cannot store instance %1").arg(qInstanceUID), this->retrieve->error)
+          delete incomingObject;
+          cStoreReturnStatus = STATUS_STORE_Refused_OutOfResources;
+          return EC_Normal;
+        }
+        jobResponseSet->setFilePath(storedFilePath);
+      }
       jobResponseSet->setDataset(incomingObject);
       jobResponseSet->setJobUID(this->retrieve->jobUID());
       jobResponseSet->setCopyFile(true);
@@ -168,6 +192,12 @@ public:
       }
 
       this->retrieve->addJobResponseSet(jobResponseSet);
+      // One instance is kept for the final insert, which is referenced by the retrieve job
+      if (this->retrieve->streamToStorage()
+        && this->retrieve->jobResponseSetsShared().count() > this->retrieve->streamingBatchSize())
+      {
+        emit this->retrieve->jobResponseSetsReady();
+      }
       return EC_Normal;
     }
     else if (this->retrieve->dicomDatabase())
@@ -225,6 +255,14 @@ public:
   /// Therefore use this method instead of calling directly SCU->releaseAssociation()
   OFCondition releaseAssociation();
 
+  /// Give the association back to the pool at the end of a request.
+  /// Without pool, the association is released unless KeepAssociationOpen is true.
+  void returnAssociation();
+
+  /// Create a SCU with the storage and retrieve presentation contexts.
+  /// The connection parameters are copied from \a parameters if not null.
+  ctkDICOMRetrieveSCUPrivate* createSCU(ctkDICOMRetrieveSCUPrivate* parameters = nullptr);
+
   bool Canceled;
   bool KeepAssociationOpen;
   bool ConnectionParamsChanged;
@@ -244,6 +282,11 @@ public:
   T_ASC_PresentationContextID PresentationContext;
   QString MoveDestinationAETitle;
   QList<QSharedPointer<ctkDICOMJobResponseSet>> JobResponseSets;
+  bool StreamToStorage;
+  int StreamingBatchSize;
+  QSharedPointer<ctkDICOMAssociationPool> AssociationPool;
+  QString AssociationKey;
+  bool AssociationAcquired;
 
   bool initializeSCU(const QString& patientID,
                      const QString& studyInstanceUID,
@@ -263,6 +306,22 @@ public:
            const ctkDICOMRetrieve::RetrieveType retrieveType);
 };
 
+//------------------------------------------------------------------------------
+// Gives the association back when a request is finished, including when it is
+// canceled or failed.
+class ctkDICOMRetrieveAssociationGuard
+{
+public:
+  ctkDICOMRetrieveAssociationGuard(ctkDICOMRetrievePrivate* d) : d(d) {}
+  ~ctkDICOMRetrieveAssociationGuard()
+  {
+    this->d->returnAssociation();
+  }
+
+private:
+  ctkDICOMRetrievePrivate* d;
+};
+
 //------------------------------------------------------------------------------
 // ctkDICOMRetrievePrivate methods
 
@@ -276,6 +335,9 @@ ctkDICOMRetrievePrivate::ctkDICOMRetrievePrivate(ctkDICOMRetrieve& obj)
   this->ConnectionParamsChanged = false;
   this->AssociationClosing = false;
   this->LastRetrieveType = ctkDICOMRetrieve::RetrieveNone;
+  this->StreamToStorage = false;
+  this->StreamingBatchSize = 10;
+  this->AssociationAcquired = false;
 
   // Register the JPEG libraries in case we need them
   // (registration only happens once, so it's okay to call repeatedly)
@@ -288,32 +350,18 @@ ctkDICOMRetrievePrivate::ctkDICOMRetrievePrivate(ctkDICOMRetrieve& obj)
   // register RLE decompression codec
   DcmRLEDecoderRegistration::registerCodecs();
 
-  OFList<OFString> transferSyntaxes;
-  transferSyntaxes.push_back(UID_LittleEndianExplicitTransferSyntax);
-  transferSyntaxes.push_back(UID_BigEndianExplicitTransferSyntax);
-  transferSyntaxes.push_back(UID_LittleEndianImplicitTransferSyntax);
-
   this->PresentationContext = 0;
-  this->SCU = new ctkDICOMRetrieveSCUPrivate();
-  this->SCU->addPresentationContext(
-    UID_MOVEStudyRootQueryRetrieveInformationModel, transferSyntaxes);
-  this->SCU->addPresentationContext(
-    UID_GETStudyRootQueryRetrieveInformationModel, transferSyntaxes);
-
-  for (Uint16 index = 0; index < numberOfDcmLongSCUStorageSOPClassUIDs; index++)
-  {
-    this->SCU->addPresentationContext(dcmLongSCUStorageSOPClassUIDs[index],
-      transferSyntaxes, ASC_SC_ROLE_SCP);
-  }
-
-  this->SCU->setACSETimeout(3);
-  this->SCU->setConnectionTimeout(3);
-  this->SCU->setStorageDir(QStandardPaths::writableLocation(QStandardPaths::TempLocation).toStdString().c_str());
+  this->SCU = this->createSCU();
 }
 
 //------------------------------------------------------------------------------
 ctkDICOMRetrievePrivate::~ctkDICOMRetrievePrivate()
 {
+  if (this->AssociationAcquired)
+  {
+    this->returnAssociation();
+  }
+
   if (this->SCU && this->SCU->isConnected())
   {
     this->releaseAssociation();
@@ -349,6 +397,74 @@ OFCondition ctkDICOMRetrievePrivate::releaseAssociation()
   return status;
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMRetrievePrivate::returnAssociation()
+{
+  if (!this->AssociationAcquired)
+  {
+    if (!this->KeepAssociationOpen && this->SCU && this->SCU->isConnected())
+    {
+      this->releaseAssociation();
+    }
+    return;
+  }
+
+  // The pool takes the SCU with its association, continue with a new one
+  ctkDICOMRetrieveSCUPrivate* association = nullptr;
+  {
+    QMutexLocker locker(&this->AssociationMutex);
+    association = this->SCU;
+    this->SCU = this->createSCU(association);
+    this->PresentationContext = 0;
+    this->AssociationAcquired = false;
+  }
+  association->retrieve = nullptr;
+  this->AssociationPool->release(this->AssociationKey, association);
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMRetrieveSCUPrivate* ctkDICOMRetrievePrivate::createSCU(ctkDICOMRetrieveSCUPrivate* parameters)
+{
+  OFList<OFString> transferSyntaxes;
+  transferSyntaxes.push_back(UID_LittleEndianExplicitTransferSyntax);
+  transferSyntaxes.push_back(UID_BigEndianExplicitTransferSyntax);
+  transferSyntaxes.push_back(UID_LittleEndianImplicitTransferSyntax);
+
+  ctkDICOMRetrieveSCUPrivate* scu = new ctkDICOMRetrieveSCUPrivate();
+  scu->addPresentationContext(
+    UID_MOVEStudyRootQueryRetrieveInformationModel, transferSyntaxes);
+  scu->addPresentationContext(
+    UID_GETStudyRootQueryRetrieveInformationModel, transferSyntaxes);
+  // used by the association pool to check idle associations
+  scu->addPresentationContext(UID_VerificationSOPClass, transferSyntaxes);
+
+  for (Uint16 index = 0; index < numberOfDcmLongSCUStorageSOPClassUIDs; index++)
+  {
+    scu->addPresentationContext(dcmLongSCUStorageSOPClassUIDs[index],
+      transferSyntaxes, ASC_SC_ROLE_SCP);
+  }
+
+  scu->setVerbosePCMode(false);
+  scu->retrieve = this->q_ptr; // give the dcmtk level access to this for emitting signals
+  if (parameters)
+  {
+    scu->setAETitle(parameters->getAETitle());
+    scu->setPeerAETitle(parameters->getPeerAETitle());
+    scu->setPeerHostName(parameters->getPeerHostName());
+    scu->setPeerPort(parameters->getPeerPort());
+    scu->setACSETimeout(parameters->getACSETimeout());
+    scu->setConnectionTimeout(parameters->getConnectionTimeout());
+    scu->setStorageDir(parameters->getStorageDir());
+  }
+  else
+  {
+    scu->setACSETimeout(3);
+    scu->setConnectionTimeout(3);
+    scu->setStorageDir(QStandardPaths::writableLocation(QStandardPaths::TempLocation).toStdString().c_str());
+  }
+  return scu;
+}
+
 //------------------------------------------------------------------------------
 bool ctkDICOMRetrievePrivate::initializeSCU(const QString& patientID,
                                             const QString& studyInstanceUID,
@@ -359,6 +475,42 @@ bool ctkDICOMRetrievePrivate::initializeSCU(const QString& patientID,
 {
   Q_Q(ctkDICOMRetrieve);
 
+  if (this->AssociationPool && !this->AssociationAcquired)
+  {
+    if (this->SCU->isConnected())
+    {
+      this->releaseAssociation();
+    }
+    while (!this->AssociationPool->acquire(500))
+    {
+      if (this->Canceled)
+      {
+        return false;
+      }
+    }
+    this->AssociationAcquired = true;
+    this->AssociationKey = ctkDICOMAssociationPool::associationKey(
+      "ctkDICOMRetrieve", q->callingAETitle(), q->calledAETitle(), q->host(), q->port());
+
+    DcmSCU* association = this->AssociationPool->takeIdleAssociation(this->AssociationKey);
+    if (association)
+    {
+      ctkDICOMRetrieveSCUPrivate* scu = static_cast<ctkDICOMRetrieveSCUPrivate*>(association);
+      scu->retrieve = q;
+      scu->setACSETimeout(this->SCU->getACSETimeout());
+      scu->setConnectionTimeout(this->SCU->getConnectionTimeout());
+      scu->setStorageDir(this->SCU->getStorageDir());
+      QMutexLocker locker(&this->AssociationMutex);
+      delete this->SCU;
+      this->SCU = scu;
+      locker.unlock();
+
+      // the association was negotiated with the same connection parameters
+      this->ConnectionParamsChanged = false;
+      LOG_AND_EMIT_DEBUG(QString("Reusing Association"), q->debug);
+    }
+  }
+
   // If we like to query another server than before, be sure to disconnect first
   if (this->SCU->isConnected() && this->ConnectionParamsChanged)
   {
@@ -439,6 +591,7 @@ bool ctkDICOMRetrievePrivate::move(const QString& patientID,
                                    const ctkDICOMRetrieve::RetrieveType retrieveType)
 {
   Q_Q(ctkDICOMRetrieve);
+  ctkDICOMRetrieveAssociationGuard associationGuard(this);
 
   this->JobResponseSets.clear();
   this->PatientID = patientID;
@@ -476,10 +629,7 @@ bool ctkDICOMRetrievePrivate::move(const QString& patientID,
   if (this->PresentationContext == 0)
   {
     LOG_AND_EMIT_ERROR(QString("MOVE Request failed: No valid Study Root MOVE Presentation Context available"), q->error)
-    if (!this->KeepAssociationOpen)
-    {
-      this->releaseAssociation();
-    }
+    this->returnAssociation();
     delete retrieveParameters;
     emit q->done(false);
     return false;
@@ -502,11 +652,9 @@ bool ctkDICOMRetrievePrivate::move(const QString& patientID,
   LOG_AND_EMIT_DEBUG(QString("Sent MOVE Request"), q->debug)
   emit q->progress(2);
 
-  // Close association if we do not want to explicitly keep it open
-  if (!this->KeepAssociationOpen)
-  {
-    this->releaseAssociation();
-  }
+  // Give the association back to the pool, or close it if we do not want
+  // to explicitly keep it open
+  this->returnAssociation();
   // Free some (little) memory
   delete retrieveParameters;
 
@@ -626,6 +774,7 @@ bool ctkDICOMRetrievePrivate::get(const QString& patientID,
                                   const ctkDICOMRetrieve::RetrieveType retrieveType)
 {
   Q_Q(ctkDICOMRetrieve);
+  ctkDICOMRetrieveAssociationGuard associationGuard(this);
 
   this->JobResponseSets.clear();
   this->PatientID = patientID;
@@ -670,10 +819,7 @@ bool ctkDICOMRetrievePrivate::get(const QString& patientID,
   if (this->PresentationContext == 0)
   {
     LOG_AND_EMIT_ERROR(QString("GET Request failed: No valid Study Root GET Presentation Context available"), q->error)
-    if (!this->KeepAssociationOpen)
-    {
-      this->releaseAssociation();
-    }
+    this->returnAssociation();
     delete retrieveParameters;
     emit q->done(false);
     return false;
@@ -694,11 +840,9 @@ bool ctkDICOMRetrievePrivate::get(const QString& patientID,
   LOG_AND_EMIT_DEBUG(QString("Sent GET Request"), q->debug)
   emit q->progress(2);
 
-  // Close association if we do not want to explicitly keep it open
-  if (!this->KeepAssociationOpen)
-  {
-    this->releaseAssociation();
-  }
+  // Give the association back to the pool, or close it if we do not want
+  // to explicitly keep it open
+  this->returnAssociation();
   // Free some (little) memory
   delete retrieveParameters;
 
@@ -791,10 +935,6 @@ ctkDICOMRetrieve::ctkDICOMRetrieve(QObject* parent)
   : QObject(parent),
     d_ptr(new ctkDICOMRetrievePrivate(*this))
 {
-  Q_D(ctkDICOMRetrieve);
-
-  d->SCU->setVerbosePCMode(false);
-  d->SCU->retrieve = this; // give the dcmtk level access to this for emitting signals
 }
 
 //------------------------------------------------------------------------------
@@ -814,6 +954,38 @@ CTK_GET_CPP(ctkDICOMRetrieve, QString, seriesInstanceUID, SeriesInstanceUID)
 CTK_GET_CPP(ctkDICOMRetrieve, QString, sopInstanceUID, SOPInstanceUID)
 CTK_SET_CPP(ctkDICOMRetrieve, const bool, setKeepAssociationOpen, KeepAssociationOpen);
 CTK_GET_CPP(ctkDICOMRetrieve, bool, keepAssociationOpen, KeepAssociationOpen)
+CTK_SET_CPP(ctkDICOMRetrieve, bool, setStreamToStorage, StreamToStorage);
+CTK_GET_CPP(ctkDICOMRetrieve, bool, streamToStorage, StreamToStorage)
+CTK_GET_CPP(ctkDICOMRetrieve, int, streamingBatchSize, StreamingBatchSize)
+
+//------------------------------------------------------------------------------
+void ctkDICOMRetrieve::setAssociationPool(QSharedPointer<ctkDICOMAssociationPool> associationPool)
+{
+  Q_D(ctkDICOMRetrieve);
+  if (d->AssociationPool == associationPool)
+  {
+    return;
+  }
+  if (d->AssociationAcquired)
+  {
+    d->returnAssociation();
+  }
+  d->AssociationPool = associationPool;
+}
+
+//------------------------------------------------------------------------------
+QSharedPointer<ctkDICOMAssociationPool> ctkDICOMRetrieve::associationPool() const
+{
+  Q_D(const ctkDICOMRetrieve);
+  return d->AssociationPool;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMRetrieve::setStreamingBatchSize(int batchSize)
+{
+  Q_D(ctkDICOMRetrieve);
+  d->StreamingBatchSize = qMax(1, batchSize);
+}
 
 //------------------------------------------------------------------------------
 void ctkDICOMRetrieve::setCallingAETitle(const QString& callingAETitle)
@@ -967,6 +1139,21 @@ void ctkDICOMRetrieve::addJobResponseSet(QSharedPointer<ctkDICOMJobResponseSet>
   d->JobResponseSets.append(jobResponseSet);
 }
 
+//------------------------------------------------------------------------------
+QList<QSharedPointer<ctkDICOMJobResponseSet>> ctkDICOMRetrieve::takeJobResponseSets(int count)
+{
+  Q_D(ctkDICOMRetrieve);
+  if (count < 0 || count >= d->JobResponseSets.count())
+  {
+    QList<QSharedPointer<ctkDICOMJobResponseSet>> jobResponseSets;
+    jobResponseSets.swap(d->JobResponseSets);
+    return jobResponseSets;
+  }
+  QList<QSharedPointer<ctkDICOMJobResponseSet>> jobResponseSets = d->JobResponseSets.mid(0, count);
+  d->JobResponseSets.erase(d->JobResponseSets.begin(), d->JobResponseSets.begin() + count);
+  return jobResponseSets;
+}
+
 //------------------------------------------------------------------------------
 void ctkDICOMRetrieve::removeJobResponseSet(QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet)
 {
@@ -33,6 +33,7 @@
 #include "ctkDICOMDatabase.h"
 #include "ctkErrorLogLevel.h"
 
+class ctkDICOMAssociationPool;
 class ctkDICOMRetrievePrivate;
 class ctkDICOMJobResponse;
 
@@ -51,6 +52,8 @@ class CTK_DICOM_CORE_EXPORT ctkDICOMRetrieve : public QObject
   Q_PROPERTY(QString seriesInstanceUID READ seriesInstanceUID);
   Q_PROPERTY(QString studyInstanceUID READ studyInstanceUID);
   Q_PROPERTY(QString jobUID READ jobUID WRITE setJobUID);
+  Q_PROPERTY(bool streamToStorage READ streamToStorage WRITE setStreamToStorage);
+  Q_PROPERTY(int streamingBatchSize READ streamingBatchSize WRITE setStreamingBatchSize);
 
 public:
   explicit ctkDICOMRetrieve(QObject* parent = 0);
@@ -103,6 +106,15 @@ public:
   bool keepAssociationOpen() const;
   ///@}
 
+  ///@{
+  /// Pool of associations shared with other queries and retrieves (none by default).
+  /// If set, requests reuse the idle associations of the pool and give their
+  /// association back to the pool when they are done, keepAssociationOpen is ignored.
+  /// \sa ctkDICOMServer::associationPool()
+  void setAssociationPool(QSharedPointer<ctkDICOMAssociationPool> associationPool);
+  QSharedPointer<ctkDICOMAssociationPool> associationPool() const;
+  ///@}
+
   ///@{
   /// connection timeout, default 3 sec.
   void setConnectionTimeout(int timeout);
@@ -130,6 +142,29 @@ public:
   void removeJobResponseSet(QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet);
   ///@}
 
+  ///@{
+  /// If enabled, instances received by C-GET are written to their storage location
+  /// in the database folder as they arrive and only their header (without pixel data)
+  /// is kept in the job response sets, so that memory usage does not depend on the number
+  /// of retrieved instances. Each time streamingBatchSize instances are kept,
+  /// jobResponseSetsReady() is emitted so that they can be inserted into the database
+  /// (see takeJobResponseSets()) before the retrieve is completed.
+  /// Requires a database (see setDatabase()) and a job UID.
+  /// Disabled by default.
+  void setStreamToStorage(bool streamToStorage);
+  bool streamToStorage() const;
+  ///@}
+
+  ///@{
+  /// Number of instances passed at once to the inserter in streaming mode.
+  /// Default is 10.
+  void setStreamingBatchSize(int batchSize);
+  int streamingBatchSize() const;
+  ///@}
+
+  /// Remove the first \a count (all if negative) job response sets of the last operation and return them.
+  QList<QSharedPointer<ctkDICOMJobResponseSet>> takeJobResponseSets(int count = -1);
+
   ///@{
   /// Reference job uid.
   void setJobUID(const QString& jobUID);
@@ -204,6 +239,10 @@ Q_SIGNALS:
   void done(const bool& error);
   /// Signal is emitted inside the retrieve() function when a frame has been fetched
   void progressJobDetail(QVariant data);
+  /// Signal is emitted inside the get() function in streaming mode when a batch of
+  /// streamingBatchSize instances is stored and can be inserted into the database.
+  /// The receiver must be directly connected.
+  void jobResponseSetsReady();
 
 protected:
   QScopedPointer<ctkDICOMRetrievePrivate> d_ptr;
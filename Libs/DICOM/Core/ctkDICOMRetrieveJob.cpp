@@ -187,6 +187,17 @@ ctkAbstractJob* ctkDICOMRetrieveJob::clone() const
   return newRetrieveJob;
 }
 
+//------------------------------------------------------------------------------
+QVariantMap ctkDICOMRetrieveJob::parameters() const
+{
+  QVariantMap parameters = this->Superclass::parameters();
+  if (this->server())
+  {
+    parameters["connectionName"] = this->server()->connectionName();
+  }
+  return parameters;
+}
+
 //------------------------------------------------------------------------------
 ctkAbstractWorker* ctkDICOMRetrieveJob::createWorker()
 {
@@ -59,6 +59,11 @@ public:
   /// \see ctkAbstractJob::clone()
   Q_INVOKABLE ctkAbstractJob* clone() const override;
 
+  /// Parameters of the job: the ones of ctkDICOMJob and the connection name of the server.
+  /// The server is not restored by setParameters(): it must be set from the connection name.
+  /// \sa ctkAbstractJob::parameters
+  Q_INVOKABLE virtual QVariantMap parameters() const override;
+
   /// Generate worker for job
   Q_INVOKABLE ctkAbstractWorker* createWorker() override;
 
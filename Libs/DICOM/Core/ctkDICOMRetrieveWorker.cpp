@@ -21,6 +21,9 @@
 
 =========================================================================*/
 
+// Qt includes
+#include <QFile>
+
 // ctkCore includes
 #include <ctkLogger.h>
 
@@ -63,6 +66,39 @@ ctkDICOMRetrieveWorkerPrivate::~ctkDICOMRetrieveWorkerPrivate()
                       retrieveJob.data(), SIGNAL(progressJobDetail(QVariant)));
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMRetrieveWorkerPrivate::removeStreamedFiles()
+{
+  if (!this->Retrieve->streamToStorage())
+  {
+    return;
+  }
+  foreach (QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet, this->Retrieve->takeJobResponseSets())
+  {
+    // Only the staging files that were not inserted are removed
+    // (see ctkDICOMDatabase::storeInstanceFile)
+    if (jobResponseSet->filePath().endsWith(".part"))
+    {
+      QFile::remove(jobResponseSet->filePath());
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMRetrieveWorkerPrivate::insertStreamedJobResponseSets()
+{
+  Q_Q(ctkDICOMRetrieveWorker);
+
+  QSharedPointer<ctkDICOMScheduler> scheduler =
+      qSharedPointerObjectCast<ctkDICOMScheduler>(q->Scheduler);
+  if (!scheduler || this->Retrieve->wasCanceled())
+  {
+    return;
+  }
+  this->LastInserterJobUID = scheduler->insertJobResponseSets(
+    this->Retrieve->takeJobResponseSets(this->Retrieve->streamingBatchSize()));
+}
+
 //------------------------------------------------------------------------------
 void ctkDICOMRetrieveWorkerPrivate::setRetrieveParameters()
 {
@@ -89,10 +125,14 @@ void ctkDICOMRetrieveWorkerPrivate::setRetrieveParameters()
   this->Retrieve->setConnectionTimeout(server->connectionTimeout());
   this->Retrieve->setMoveDestinationAETitle(server->moveDestinationAETitle());
   this->Retrieve->setKeepAssociationOpen(server->keepAssociationOpen());
+  this->Retrieve->setAssociationPool(server->associationPoolShared());
   this->Retrieve->setJobUID(retrieveJob->jobUID());
 
   QObject::connect(this->Retrieve.data(), SIGNAL(progressJobDetail(QVariant)),
                    retrieveJob.data(), SIGNAL(progressJobDetail(QVariant)), Qt::DirectConnection);
+  QObject::connect(this->Retrieve.data(), SIGNAL(jobResponseSetsReady()),
+                   this, SLOT(insertStreamedJobResponseSets()),
+                   static_cast<Qt::ConnectionType>(Qt::UniqueConnection | Qt::DirectConnection));
 
 }
 
@@ -148,6 +188,17 @@ void ctkDICOMRetrieveWorker::run()
 
   retrieveJob->setStatus(ctkAbstractJob::JobStatus::Running);
 
+  // Instances retrieved by C-GET are written to the database folder as they arrive
+  // and inserted in batches, unless they are forwarded to a proxy server
+  ctkDICOMServer* proxyServer = server->proxyServer();
+  ctkDICOMDatabase* database = scheduler->dicomDatabase();
+  bool streamToStorage = server->retrieveProtocol() == ctkDICOMServer::CGET
+    && database && database->isOpen() && !database->isInMemory()
+    && !(proxyServer && proxyServer->queryRetrieveEnabled());
+  d->Retrieve->setStreamToStorage(streamToStorage);
+  d->Retrieve->setDatabase(streamToStorage ? scheduler->dicomDatabaseShared() : QSharedPointer<ctkDICOMDatabase>());
+  d->LastInserterJobUID.clear();
+
   logger.debug(QString("ctkDICOMRetrieveWorker : running job %1 in thread %2.\n")
                        .arg(retrieveJob->jobUID())
                        .arg(QString::number(reinterpret_cast<quint64>(QThread::currentThreadId())), 16));
@@ -169,6 +220,7 @@ void ctkDICOMRetrieveWorker::run()
           if (!d->Retrieve->getStudy(retrieveJob->studyInstanceUID(),
                                      retrieveJob->patientID()))
           {
+            d->removeStreamedFiles();
             this->onJobCanceled(d->Retrieve->wasCanceled());
             return;
           }
@@ -178,6 +230,7 @@ void ctkDICOMRetrieveWorker::run()
                                       retrieveJob->seriesInstanceUID(),
                                       retrieveJob->patientID()))
           {
+            d->removeStreamedFiles();
             this->onJobCanceled(d->Retrieve->wasCanceled());
             return;
           }
@@ -188,6 +241,7 @@ void ctkDICOMRetrieveWorker::run()
                                            retrieveJob->sopInstanceUID(),
                                            retrieveJob->patientID()))
           {
+            d->removeStreamedFiles();
             this->onJobCanceled(d->Retrieve->wasCanceled());
             return;
           }
@@ -239,11 +293,11 @@ void ctkDICOMRetrieveWorker::run()
 
   if (d->Retrieve->wasCanceled())
   {
+    d->removeStreamedFiles();
     this->onJobCanceled(d->Retrieve->wasCanceled());
     return;
   }
 
-  ctkDICOMServer* proxyServer = server->proxyServer();
   if (proxyServer && proxyServer->queryRetrieveEnabled())
   {
     ctkDICOMRetrieveJob* newJob = qobject_cast<ctkDICOMRetrieveJob*>(retrieveJob->clone());
@@ -255,13 +309,15 @@ void ctkDICOMRetrieveWorker::run()
   else if (d->Retrieve->jobResponseSetsShared().count() > 0 &&
     server->retrieveProtocol() == ctkDICOMServer::RetrieveProtocol::CGET)
   {
-    // To Do: this insert should happen in batch of 10 frames (configurable),
-    // instead of at the end of operation (all frames requested)).
-    // This would avoid memory usage spikes when requesting a series with a lot of frames.
-    // NOTE: the memory should be released as soon as the response is inserted.
+    // Remaining instances (in streaming mode, the previous batches are already inserted).
+    // Inserter jobs run one at a time, so the last one completes the retrieve.
     retrieveJob->setReferenceInserterJobUID
       (scheduler->insertJobResponseSets(d->Retrieve->jobResponseSetsShared()));
   }
+  else if (!d->LastInserterJobUID.isEmpty())
+  {
+    retrieveJob->setReferenceInserterJobUID(d->LastInserterJobUID);
+  }
 
   retrieveJob->setStatus(ctkAbstractJob::JobStatus::Finished);
 }
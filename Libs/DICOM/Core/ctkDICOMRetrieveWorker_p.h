@@ -47,7 +47,17 @@ public:
 
   void setRetrieveParameters();
 
+  /// Remove the files of the instances that were streamed to the
+  /// database folder but are not inserted (e.g., retrieve was canceled)
+  void removeStreamedFiles();
+
   QSharedPointer<ctkDICOMRetrieve> Retrieve;
+  /// UID of the last inserter job created for a batch of streamed instances
+  QString LastInserterJobUID;
+
+public Q_SLOTS:
+  /// Insert a batch of streamed instances while the retrieve is in progress
+  void insertStreamedJobResponseSets();
 };
 
 #endif
@@ -30,6 +30,7 @@
 #include "ctkDICOMEchoJob.h"
 #include "ctkDICOMThumbnailGeneratorJob.h"
 #include "ctkDICOMInserterJob.h"
+#include "ctkDICOMInsertService.h"
 #include "ctkDICOMJobResponseSet.h"
 #include "ctkDICOMQueryJob.h"
 #include "ctkDICOMRetrieveJob.h"
@@ -113,6 +114,8 @@ ctkDICOMSchedulerPrivate::ctkDICOMSchedulerPrivate(ctkDICOMScheduler& obj)
 {
   ctk::setDICOMLogLevel(ctkErrorLogLevel::Warning);
 
+  this->InsertService = QSharedPointer<ctkDICOMInsertService>(new ctkDICOMInsertService);
+
   OFunique_ptr<dcmtk::log4cplus::Layout> layout(new dcmtk::log4cplus::PatternLayout("%D{%Y-%m-%d %H:%M:%S.%q} %5p: %m%n"));
   this->Appender = (new ctkDICOMJobsAppender());
   this->Appender->setName("ctkDICOM");
@@ -136,6 +139,79 @@ ctkDICOMSchedulerPrivate::~ctkDICOMSchedulerPrivate()
   }
 }
 
+//------------------------------------------------------------------------------
+void ctkDICOMSchedulerPrivate::init()
+{
+  Q_Q(ctkDICOMScheduler);
+  this->ctkJobSchedulerPrivate::init();
+
+  // Queries, retrieves and echoes mostly wait for the servers, thumbnails generation
+  // uses the processors and the inserter jobs write to the database one at a time:
+  // each group runs in its own lane, so that a slow server does not delay the thumbnails.
+  // The storage listener stays in the default lane.
+  // The lanes are sized from the maximum thread count of the scheduler.
+  this->setMaximumThreadCount(q->maximumThreadCount());
+  q->setJobClassLane(ctkDICOMQueryJob::staticMetaObject.className(), "Network");
+  q->setJobClassLane(ctkDICOMRetrieveJob::staticMetaObject.className(), "Network");
+  q->setJobClassLane(ctkDICOMEchoJob::staticMetaObject.className(), "Network");
+  q->setJobClassLane(ctkDICOMThumbnailGeneratorJob::staticMetaObject.className(), "CPU");
+  q->setJobClassLane(ctkDICOMInserterJob::staticMetaObject.className(), "DatabaseWriter");
+
+  // Retrieve jobs can be resumed from the journal, with the server of the same connection name
+  q->registerJobFactory(ctkDICOMRetrieveJob::staticMetaObject.className(),
+    [q](const QVariantMap& parameters) -> ctkAbstractJob* {
+      ctkDICOMServer* server = q->server(parameters.value("connectionName").toString());
+      if (!server)
+      {
+        return nullptr;
+      }
+      ctkDICOMRetrieveJob* job = new ctkDICOMRetrieveJob;
+      job->setServer(*server);
+      job->setParameters(parameters);
+      return job;
+    });
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMSchedulerPrivate::removeJob(const QString& jobUID)
+{
+  // Response sets of a removed inserter job are not written
+  this->InsertService->cancel(jobUID);
+  return this->ctkJobSchedulerPrivate::removeJob(jobUID);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMSchedulerPrivate::removeJobs(const QStringList& jobUIDs)
+{
+  foreach (const QString& jobUID, jobUIDs)
+  {
+    this->InsertService->cancel(jobUID);
+  }
+  this->ctkJobSchedulerPrivate::removeJobs(jobUIDs);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMSchedulerPrivate::setMaximumThreadCount(int maximumThreadCount)
+{
+  Q_Q(ctkDICOMScheduler);
+  this->ctkJobSchedulerPrivate::setMaximumThreadCount(maximumThreadCount);
+  // Network bound jobs can use all the threads, CPU bound jobs no more than the processors,
+  // and the database is written by one job at a time
+  q->setLane("Network", maximumThreadCount);
+  q->setLane("CPU", qMin(maximumThreadCount, qMax(1, QThread::idealThreadCount())));
+  q->setLane("DatabaseWriter", 1);
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMSchedulerPrivate::progressJobUID(const QVariant& data) const
+{
+  if (!data.canConvert<ctkDICOMJobDetail>())
+  {
+    return this->ctkJobSchedulerPrivate::progressJobUID(data);
+  }
+  return data.value<ctkDICOMJobDetail>().JobUID;
+}
+
 //------------------------------------------------------------------------------
 bool ctkDICOMSchedulerPrivate::isServerAllowed(ctkDICOMServer *server,
                                                const QStringList& allowedSeversForPatient)
@@ -412,7 +488,8 @@ void ctkDICOMScheduler::retrieveSOPInstance(const QString& patientID,
 //----------------------------------------------------------------------------
 void ctkDICOMScheduler::startListener(int port,
                                       const QString& AETitle,
-                                      QThread::Priority priority)
+                                      QThread::Priority priority,
+                                      int maximumAssociations)
 {
   Q_D(ctkDICOMScheduler);
 
@@ -420,6 +497,7 @@ void ctkDICOMScheduler::startListener(int port,
     QSharedPointer<ctkDICOMStorageListenerJob>(new ctkDICOMStorageListenerJob);
   job->setPort(port);
   job->setAETitle(AETitle);
+  job->setMaximumAssociations(maximumAssociations);
   job->setMaximumNumberOfRetry(d->MaximumNumberOfRetry);
   job->setRetryDelay(d->RetryDelay);
   job->setPriority(priority);
@@ -495,6 +573,33 @@ void ctkDICOMScheduler::generateThumbnail(const QString &originalFilePath,
   d->insertJob(job);
 }
 
+//----------------------------------------------------------------------------
+void ctkDICOMScheduler::generateThumbnails(const QString &patientID,
+                                           const QString &studyInstanceUID,
+                                           const QStringList &sopInstanceUIDs,
+                                           QColor backgroundColor,
+                                           QThread::Priority priority)
+{
+  Q_D(ctkDICOMScheduler);
+
+  if (sopInstanceUIDs.isEmpty())
+  {
+    return;
+  }
+
+  QSharedPointer<ctkDICOMThumbnailGeneratorJob> job =
+    QSharedPointer<ctkDICOMThumbnailGeneratorJob>(new ctkDICOMThumbnailGeneratorJob);
+  job->setDatabaseFilename(d->DicomDatabase->databaseFilename());
+  job->setSOPInstanceUIDs(sopInstanceUIDs);
+  job->setBackgroundColor(backgroundColor);
+  job->setPatientID(patientID);
+  job->setStudyInstanceUID(studyInstanceUID);
+  job->setMaximumNumberOfRetry(0);
+  job->setPriority(priority);
+
+  d->insertJob(job);
+}
+
 //----------------------------------------------------------------------------
 QString ctkDICOMScheduler::insertJobResponseSet(const QSharedPointer<ctkDICOMJobResponseSet>& jobResponseSet,
                                                 QThread::Priority priority)
@@ -520,6 +625,15 @@ QString ctkDICOMScheduler::insertJobResponseSets(const QList<QSharedPointer<ctkD
   job->setTagsToExcludeFromStorage(d->DicomDatabase->tagsToExcludeFromStorage());
   job->setPriority(priority);
 
+  // The insert service writes the response sets in the order the inserter jobs are created,
+  // the inserter job waits for them to be written.
+  // In-memory databases cannot be shared with another connection, they are left to the inserter.
+  if (!d->DicomDatabase->isInMemory())
+  {
+    d->InsertService->submit(job->jobUID(), job->jobResponseSetsShared(), job->databaseFilename(),
+                             job->tagsToPrecache(), job->tagsToExcludeFromStorage());
+  }
+
   QString inserterJobUID = job->jobUID();
   d->insertJob(job);
   return inserterJobUID;
@@ -547,6 +661,20 @@ QSharedPointer<ctkDICOMDatabase> ctkDICOMScheduler::dicomDatabaseShared() const
   return d->DicomDatabase;
 }
 
+//----------------------------------------------------------------------------
+ctkDICOMInsertService* ctkDICOMScheduler::insertService() const
+{
+  Q_D(const ctkDICOMScheduler);
+  return d->InsertService.data();
+}
+
+//----------------------------------------------------------------------------
+QSharedPointer<ctkDICOMInsertService> ctkDICOMScheduler::insertServiceShared() const
+{
+  Q_D(const ctkDICOMScheduler);
+  return d->InsertService;
+}
+
 //----------------------------------------------------------------------------
 void ctkDICOMScheduler::setDicomDatabase(ctkDICOMDatabase& dicomDatabase)
 {
@@ -803,17 +931,16 @@ void ctkDICOMScheduler::waitForFinishByDICOMUIDs(const QStringList& patientIDs,
     return;
   }
 
+  // Wait for the matching jobs until they are completed, then for the ones added
+  // in the meanwhile (e.g. inserter jobs of queries and retrieves, or retries).
+  QStringList jobUIDs;
+  do
   {
-    // The QReadLocker is enclosed within brackets to restrict its scope and
-    // prevent conflicts with other QReadLockers within the scheduler's methods.
-    QReadLocker locker(&d->QueueLock);
-    bool wait = true;
-    while (wait)
+    jobUIDs.clear();
     {
-      qApp->processEvents(QEventLoop::ExcludeUserInputEvents);
-      d->ThreadPool->waitForDone(300);
-
-      wait = false;
+      // The QReadLocker is enclosed within brackets to restrict its scope and
+      // prevent conflicts with other QReadLockers within the scheduler's methods.
+      QReadLocker locker(&d->QueueLock);
       foreach (QSharedPointer<ctkAbstractJob> job, d->JobsQueue)
       {
         if (!job)
@@ -821,7 +948,7 @@ void ctkDICOMScheduler::waitForFinishByDICOMUIDs(const QStringList& patientIDs,
           continue;
         }
 
-        if (job->isPersistent())
+        if (job->isPersistent() || job->status() > ctkAbstractJob::JobStatus::Running)
         {
           continue;
         }
@@ -836,15 +963,14 @@ void ctkDICOMScheduler::waitForFinishByDICOMUIDs(const QStringList& patientIDs,
           (!dicomJob->seriesInstanceUID().isEmpty() && seriesInstanceUIDs.contains(dicomJob->seriesInstanceUID())) ||
           (!dicomJob->sopInstanceUID().isEmpty() && sopInstanceUIDs.contains(dicomJob->sopInstanceUID())))
         {
-          if (job->status() != ctkAbstractJob::JobStatus::Finished)
-          {
-            wait = true;
-            break;
-          }
+          jobUIDs.append(job->jobUID());
         }
       }
     }
+
+    this->waitForJobs(jobUIDs, -1, true);
   }
+  while (!jobUIDs.isEmpty());
 }
 
 //----------------------------------------------------------------------------
@@ -1000,12 +1126,14 @@ void ctkDICOMScheduler::raiseJobsPriorityForSeries(const QStringList& selectedSe
         continue;
       }
 
+      QThread::Priority jobPriority = priority;
       if (!selectedSeriesInstanceUIDs.contains(dicomJob->seriesInstanceUID()))
       {
-        priority = QThread::Priority::LowPriority;
+        jobPriority = QThread::Priority::LowPriority;
       }
 
-      job->setPriority(priority);
+      // Waiting jobs are moved in the run-queue of the scheduler
+      d->setJobPriority(job, jobPriority);
     }
   }
 }
@@ -1094,6 +1222,8 @@ void ctkDICOMScheduler::onJobUserStopped(ctkAbstractJob* job)
     job->addLog(appender->messageByThreadID(job->runningThreadID()));
   }
 
+  d->InsertService->cancel(job->jobUID());
+
   ctkJobScheduler::onJobUserStopped(job);
 }
 
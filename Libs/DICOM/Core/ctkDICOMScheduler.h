@@ -37,6 +37,7 @@ class ctkAbstractJob;
 #include "ctkDICOMDatabase.h"
 class ctkDICOMJob;
 class ctkDICOMIndexer;
+class ctkDICOMInsertService;
 class ctkDICOMSchedulerPrivate;
 class ctkDICOMServer;
 class ctkDICOMStorageListenerJob;
@@ -102,10 +103,12 @@ public:
                                        QThread::Priority priority = QThread::LowPriority,
                                        const QStringList& allowedSeversForPatient = QStringList());
 
-  /// Start a storage listener
+  /// Start a storage listener.
+  /// If maximumAssociations is greater than 1, several associations are received simultaneously.
   Q_INVOKABLE void startListener(int port,
                                  const QString &AETitle,
-                                 QThread::Priority priority = QThread::LowPriority);
+                                 QThread::Priority priority = QThread::LowPriority,
+                                 int maximumAssociations = 1);
 
   /// Echo a server
   Q_INVOKABLE void echo(const QString& connectionName,
@@ -113,7 +116,7 @@ public:
   Q_INVOKABLE void echo(ctkDICOMServer& server,
                         QThread::Priority priority = QThread::LowPriority);
 
-  /// Generate thumbnail and save it as png on local disk
+  /// Generate thumbnail and store it in the database thumbnail cache
   Q_INVOKABLE void generateThumbnail(const QString &originalFilePath,
                                      const QString &patientID,
                                      const QString &studyInstanceUID,
@@ -123,6 +126,15 @@ public:
                                      QColor backgroundColor,
                                      QThread::Priority priority = QThread::HighPriority);
 
+  /// Generate the thumbnails of several instances of a study (e.g. one instance
+  /// for each series) in a single job, see ctkDICOMDatabase::storeThumbnails().
+  /// A job detail is reported for each generated thumbnail.
+  Q_INVOKABLE void generateThumbnails(const QString &patientID,
+                                      const QString &studyInstanceUID,
+                                      const QStringList &sopInstanceUIDs,
+                                      QColor backgroundColor,
+                                      QThread::Priority priority = QThread::HighPriority);
+
   ///@{
   /// Insert results from a job
   QString insertJobResponseSet(const QSharedPointer<ctkDICOMJobResponseSet>& jobResponseSet,
@@ -143,6 +155,14 @@ public:
   /// (not Python-wrappable).
   void setDicomDatabase(QSharedPointer<ctkDICOMDatabase> dicomDatabase);
 
+  /// Return the service writing the response sets of the inserter jobs into the database.
+  /// Response sets are submitted when the inserter job is created, so that the service
+  /// coalesces those of all the retrieve and listener jobs into few transactions.
+  Q_INVOKABLE ctkDICOMInsertService* insertService() const;
+  /// Return the insert service as a shared pointer
+  /// (not Python-wrappable).
+  QSharedPointer<ctkDICOMInsertService> insertServiceShared() const;
+
   ///@{
   /// Filters are keyword/value pairs as generated by
   /// the ctkDICOMWidgets in a human readable (and editable)
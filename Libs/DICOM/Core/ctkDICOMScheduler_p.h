@@ -36,6 +36,7 @@ class QVariant;
 class ctkAbstractJob;
 class ctkAbstractWorker;
 class ctkDICOMDatabase;
+class ctkDICOMInsertService;
 class ctkDICOMServer;
 
 // ctkDICOMCore includes
@@ -59,11 +60,21 @@ public:
   ctkDICOMSchedulerPrivate(ctkDICOMScheduler& obj);
   virtual ~ctkDICOMSchedulerPrivate();
 
+  /// Convenient setup methods
+  void init() override;
+  bool removeJob(const QString& jobUID) override;
+  void removeJobs(const QStringList& jobUIDs) override;
+  /// Also sets the maximum number of threads of the Network, CPU and DatabaseWriter lanes
+  void setMaximumThreadCount(int maximumThreadCount) override;
+  /// The progress details of the DICOM jobs are ctkDICOMJobDetail
+  QString progressJobUID(const QVariant& data) const override;
+
   bool isServerAllowed(ctkDICOMServer* server, const QStringList& allowedSeversForPatient);
   ctkDICOMServer* getServerFromProxyServersByConnectionName(const QString&);
   bool isJobDuplicate(ctkDICOMJob* job);
 
   QSharedPointer<ctkDICOMDatabase> DicomDatabase;
+  QSharedPointer<ctkDICOMInsertService> InsertService;
   QList<QSharedPointer<ctkDICOMServer>> Servers;
   QMap<QString, QMetaObject::Connection> ServersConnections;
   QMap<QString, QVariant> Filters;
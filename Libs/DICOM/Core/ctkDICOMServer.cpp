@@ -29,6 +29,7 @@
 #include <ctkLogger.h>
 
 // ctkDICOMCore includes
+#include "ctkDICOMAssociationPool.h"
 #include "ctkDICOMServer.h"
 
 static ctkLogger logger("org.commontk.dicom.DICOMServer");
@@ -58,6 +59,7 @@ public:
   QString MoveDestinationAETitle;
   int ConnectionTimeout;
   ctkDICOMServer* ProxyServer;
+  QSharedPointer<ctkDICOMAssociationPool> AssociationPool;
 };
 
 //------------------------------------------------------------------------------
@@ -75,6 +77,7 @@ ctkDICOMServerPrivate::ctkDICOMServerPrivate(ctkDICOMServer& obj)
   this->Port = 80;
   this->RetrieveProtocol = ctkDICOMServer::RetrieveProtocol::CGET;
   this->ProxyServer = nullptr;
+  this->AssociationPool = QSharedPointer<ctkDICOMAssociationPool>(new ctkDICOMAssociationPool);
 }
 
 //------------------------------------------------------------------------------
@@ -288,6 +291,22 @@ ctkDICOMServer *ctkDICOMServer::clone() const
     {
     newServer->setProxyServer(*this->proxyServer());
     }
+  // clones send requests to the same peer, they share the associations
+  newServer->d_func()->AssociationPool = this->associationPoolShared();
 
   return newServer;
 }
+
+//----------------------------------------------------------------------------
+ctkDICOMAssociationPool* ctkDICOMServer::associationPool() const
+{
+  Q_D(const ctkDICOMServer);
+  return d->AssociationPool.data();
+}
+
+//----------------------------------------------------------------------------
+QSharedPointer<ctkDICOMAssociationPool> ctkDICOMServer::associationPoolShared() const
+{
+  Q_D(const ctkDICOMServer);
+  return d->AssociationPool;
+}
@@ -26,9 +26,11 @@
 
 // Qt includes
 #include <QObject>
+#include <QSharedPointer>
 
 // ctkDICOMCore includes
 #include "ctkDICOMCoreExport.h"
+class ctkDICOMAssociationPool;
 class ctkDICOMServerPrivate;
 
 /// \ingroup DICOM_Core
@@ -149,6 +151,13 @@ public:
   Q_INVOKABLE void setProxyServer(const ctkDICOMServer& proxyServer);
   ///}@
 
+  ///@{
+  /// Pool of the associations negotiated with the peer host by the query
+  /// and retrieve jobs. It is shared with the clones of the server.
+  Q_INVOKABLE ctkDICOMAssociationPool* associationPool() const;
+  QSharedPointer<ctkDICOMAssociationPool> associationPoolShared() const;
+  ///}@
+
   /// Create a copy of this Server.
   Q_INVOKABLE ctkDICOMServer* clone() const;
 
@@ -19,17 +19,28 @@
 =========================================================================*/
 
 // Qt includes
+#include <QAtomicInt>
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QQueue>
+#include <QSet>
 #include <QSettings>
 #include <QString>
 #include <QStringList>
 
 // ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
 #include "ctkDICOMJobResponseSet.h"
 #include "ctkDICOMStorageListener.h"
 
 // DCMTK includes
 #include <dcmtk/dcmnet/dstorscp.h> /* for DcmStorageSCP */
+#ifdef WITH_THREADS
+#include <dcmtk/dcmnet/scppool.h> /* for DcmBaseSCPPool */
+#include <dcmtk/dcmnet/scpthrd.h> /* for DcmThreadSCP */
+#endif
 
 //------------------------------------------------------------------------------
 // Using dcmtk root log4cplus logger instead of ctkLogger because with ctkDICOMJobsAppender (dcmtk::log4cplus::Appender),
@@ -37,42 +48,155 @@
 dcmtk::log4cplus::Logger rootLogStorageListener = dcmtk::log4cplus::Logger::getRoot();
 
 //------------------------------------------------------------------------------
-// A customized implementation so that Qt signals can be emitted
-// when query results are obtained
-class ctkDICOMStorageListenerSCUPrivate : public DcmStorageSCP
+// Handling of the incoming commands, shared by the single association SCP
+// (DcmStorageSCP) and the workers of the association pool (DcmThreadSCP)
+template <typename SCPBase>
+class ctkDICOMStorageListenerSCPHandler : public SCPBase
 {
 public:
   ctkDICOMStorageListener* listener;
-  ctkDICOMStorageListenerSCUPrivate()
+  /// Name of the current association, see ctkDICOMStorageListener::associationQueueDepths()
+  QString AssociationName;
+
+  ctkDICOMStorageListenerSCPHandler()
   {
     this->listener = 0;
   };
-  ~ctkDICOMStorageListenerSCUPrivate() = default;
-
-  virtual OFCondition acceptAssociations();
+  virtual ~ctkDICOMStorageListenerSCPHandler() = default;
 
   virtual OFBool stopAfterCurrentAssociation();
   virtual OFBool stopAfterConnectionTimeout();
 
+  virtual void notifyAssociationAcknowledge();
+  virtual void notifyAssociationTermination();
+
   virtual OFCondition handleIncomingCommand(T_DIMSE_Message* incomingMsg,
     const DcmPresentationContextInfo& presInfo);
+
 };
 
 //------------------------------------------------------------------------------
-// ctkDICOMStorageListenerSCUPrivate methods
+// A customized implementation so that Qt signals can be emitted
+// when query results are obtained
+class ctkDICOMStorageListenerSCUPrivate : public ctkDICOMStorageListenerSCPHandler<DcmStorageSCP>
+{
+public:
+  ctkDICOMStorageListenerSCUPrivate() = default;
+  ~ctkDICOMStorageListenerSCUPrivate() = default;
 
+  virtual OFCondition acceptAssociations();
+};
+
+#ifdef WITH_THREADS
 //------------------------------------------------------------------------------
-OFCondition ctkDICOMStorageListenerSCUPrivate::acceptAssociations()
+// Pool of threads, each one receiving an association, so that several
+// associations are received simultaneously
+class ctkDICOMStorageListenerSCPPool : public DcmBaseSCPPool
 {
-  if (!this->listener || this->listener->wasCanceled())
+public:
+  ctkDICOMStorageListener* listener;
+  ctkDICOMStorageListenerSCPPool()
   {
-    return EC_IllegalCall;
-  }
-  return DcmSCP::acceptAssociations();
-}
+    this->listener = 0;
+  };
+  ~ctkDICOMStorageListenerSCPPool() = default;
+
+protected:
+  class SCPWorker : public DcmBaseSCPPool::DcmBaseSCPWorker,
+                    public ctkDICOMStorageListenerSCPHandler<DcmThreadSCP>
+  {
+  public:
+    SCPWorker(ctkDICOMStorageListenerSCPPool& pool)
+      : DcmBaseSCPPool::DcmBaseSCPWorker(pool)
+    {
+      this->listener = pool.listener;
+    };
+    virtual OFCondition setSharedConfig(const DcmSharedSCPConfig& config)
+    {
+      return DcmThreadSCP::setSharedConfig(config);
+    };
+    virtual OFBool busy()
+    {
+      return DcmThreadSCP::isConnected();
+    };
+
+  protected:
+    virtual OFCondition workerListen(T_ASC_Association* const assoc)
+    {
+      return DcmThreadSCP::run(assoc);
+    };
+  };
+
+  virtual DcmBaseSCPWorker* createSCPWorker()
+  {
+    return new SCPWorker(*this);
+  };
+};
+#endif
+
+//------------------------------------------------------------------------------
+// ctkDICOMStorageListenerPrivate
+
+//------------------------------------------------------------------------------
+class ctkDICOMStorageListenerPrivate
+{
+public:
+  ctkDICOMStorageListenerPrivate();
+  ~ctkDICOMStorageListenerPrivate() = default;
+
+  QString findFile(const QStringList& nameFilters, const QString& subDir) const;
+  QString defaultConfigFile() const;
+
+  /// Register a new association and return its name
+  QString beginAssociation(const QString& peerAETitle, const QString& peerHost);
+  void endAssociation(const QString& associationName);
+  /// Add a received instance and return the number of pending instances
+  int appendJobResponseSet(QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet,
+                           const QString& associationName);
+  /// Update the queue depth of the association of a job response set
+  /// that is taken or removed. JobResponseSetsMutex must be locked.
+  void releaseJobResponseSet(ctkDICOMJobResponseSet* jobResponseSet);
+  /// Forget the receive times that are out of the objects per second window.
+  /// JobResponseSetsMutex must be locked.
+  void removeExpiredReceiveTimes() const;
+
+  QString ConnectionName;
+  QString AETitle;
+  int Port;
+  QString JobUID;
+  QList<QSharedPointer<ctkDICOMJobResponseSet>> JobResponseSets;
+  int MaximumAssociations;
+  int InsertBatchSize;
+  bool StreamToStorage;
+  QSharedPointer<ctkDICOMDatabase> Database;
+
+  /// Protects the job response sets and the statistics, updated by the association threads
+  mutable QMutex JobResponseSetsMutex;
+  QHash<ctkDICOMJobResponseSet*, QString> JobResponseSetAssociations;
+  QMap<QString, int> AssociationQueueDepths;
+  QSet<QString> ActiveAssociations;
+  int AssociationsCount;
+  int ReceivedObjectsCount;
+  QElapsedTimer ReceiveTimer;
+  mutable QQueue<qint64> ReceiveTimes;
+
+  ctkDICOMStorageListenerSCUPrivate SCU;
+#ifdef WITH_THREADS
+  ctkDICOMStorageListenerSCPPool SCPPool;
+#endif
+  /// Read by the association threads
+  QAtomicInt Canceled;
+};
+
+// Period over which the number of received objects per second is averaged, in msec
+static const qint64 ObjectsPerSecondWindow = 5000;
+
+//------------------------------------------------------------------------------
+// ctkDICOMStorageListenerSCPHandler methods
 
 //------------------------------------------------------------------------------
-OFBool ctkDICOMStorageListenerSCUPrivate::stopAfterCurrentAssociation()
+template <typename SCPBase>
+OFBool ctkDICOMStorageListenerSCPHandler<SCPBase>::stopAfterCurrentAssociation()
 {
   if (!this->listener || this->listener->wasCanceled())
   {
@@ -82,7 +206,8 @@ OFBool ctkDICOMStorageListenerSCUPrivate::stopAfterCurrentAssociation()
 }
 
 //------------------------------------------------------------------------------
-OFBool ctkDICOMStorageListenerSCUPrivate::stopAfterConnectionTimeout()
+template <typename SCPBase>
+OFBool ctkDICOMStorageListenerSCPHandler<SCPBase>::stopAfterConnectionTimeout()
 {
   if (!this->listener || this->listener->wasCanceled())
   {
@@ -92,7 +217,32 @@ OFBool ctkDICOMStorageListenerSCUPrivate::stopAfterConnectionTimeout()
 }
 
 //------------------------------------------------------------------------------
-OFCondition ctkDICOMStorageListenerSCUPrivate::handleIncomingCommand(T_DIMSE_Message* incomingMsg,
+template <typename SCPBase>
+void ctkDICOMStorageListenerSCPHandler<SCPBase>::notifyAssociationAcknowledge()
+{
+  SCPBase::notifyAssociationAcknowledge();
+  if (this->listener)
+  {
+    this->AssociationName = this->listener->d_func()->beginAssociation(
+      this->getPeerAETitle().c_str(), this->getPeerIP().c_str());
+  }
+}
+
+//------------------------------------------------------------------------------
+template <typename SCPBase>
+void ctkDICOMStorageListenerSCPHandler<SCPBase>::notifyAssociationTermination()
+{
+  SCPBase::notifyAssociationTermination();
+  if (this->listener && !this->AssociationName.isEmpty())
+  {
+    this->listener->d_func()->endAssociation(this->AssociationName);
+  }
+  this->AssociationName.clear();
+}
+
+//------------------------------------------------------------------------------
+template <typename SCPBase>
+OFCondition ctkDICOMStorageListenerSCPHandler<SCPBase>::handleIncomingCommand(T_DIMSE_Message* incomingMsg,
     const DcmPresentationContextInfo& presInfo)
 {
   OFCondition status = EC_IllegalParameter;
@@ -102,7 +252,7 @@ OFCondition ctkDICOMStorageListenerSCUPrivate::handleIncomingCommand(T_DIMSE_Mes
     if (incomingMsg->CommandField == DIMSE_C_ECHO_RQ)
     {
       // handle incoming C-ECHO request
-      status = handleECHORequest(incomingMsg->msg.CEchoRQ, presInfo.presentationContextID);
+      status = this->handleECHORequest(incomingMsg->msg.CEchoRQ, presInfo.presentationContextID);
     }
     else if (incomingMsg->CommandField == DIMSE_C_STORE_RQ)
     {
@@ -111,7 +261,7 @@ OFCondition ctkDICOMStorageListenerSCUPrivate::handleIncomingCommand(T_DIMSE_Mes
       Uint16 rspStatusCode = STATUS_STORE_Error_CannotUnderstand;
       DcmDataset* reqDataset = new DcmDataset;
       // receive dataset in memory
-      status = receiveSTORERequest(storeReq, presInfo.presentationContextID, reqDataset);
+      status = this->receiveSTORERequest(storeReq, presInfo.presentationContextID, reqDataset);
       if (status.good())
       {
         rspStatusCode = STATUS_Success;
@@ -130,31 +280,55 @@ OFCondition ctkDICOMStorageListenerSCUPrivate::handleIncomingCommand(T_DIMSE_Mes
       emit this->listener->progress(0);
       if (!this->listener->jobUID().isEmpty() && !this->listener->wasCanceled())
       {
-        QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet =
-            QSharedPointer<ctkDICOMJobResponseSet>(new ctkDICOMJobResponseSet);
-        jobResponseSet->setJobType(ctkDICOMJobResponseSet::JobType::StoreSOPInstance);
-        jobResponseSet->setPatientID(patientID.c_str());
-        jobResponseSet->setStudyInstanceUID(studyUID.c_str());
-        jobResponseSet->setSeriesInstanceUID(seriesUID.c_str());
-        jobResponseSet->setSOPInstanceUID(instanceUID.c_str());
-        jobResponseSet->setConnectionName(this->listener->AETitle());
-        jobResponseSet->setDataset(reqDataset);
-        jobResponseSet->setJobUID(this->listener->jobUID());
-        jobResponseSet->setCopyFile(true);
-
-        this->listener->addJobResponseSet(jobResponseSet);
-
-        emit this->listener->progressJobDetail(jobResponseSet->toVariant());
+        // In streaming mode, the instance is written by the thread of its association
+        // and it is acknowledged only once stored
+        QString storedFilePath;
+        if (status.good() && this->listener->streamToStorage() && this->listener->dicomDatabase()
+          && !this->listener->dicomDatabase()->storeInstanceFile(reqDataset, studyUID.c_str(), seriesUID.c_str(),
+                                                                 instanceUID.c_str(), storedFilePath))
+        {
+          QString error = QString("Cannot store instance %1").arg(instanceUID.c_str());
+          DCMTK_LOG4CPLUS_ERROR_STR(rootLogStorageListener, error.toStdString().c_str());
+          delete reqDataset;
+          rspStatusCode = STATUS_STORE_Refused_OutOfResources;
+        }
+        else
+        {
+          QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet =
+              QSharedPointer<ctkDICOMJobResponseSet>(new ctkDICOMJobResponseSet);
+          jobResponseSet->setJobType(ctkDICOMJobResponseSet::JobType::StoreSOPInstance);
+          jobResponseSet->setPatientID(patientID.c_str());
+          jobResponseSet->setStudyInstanceUID(studyUID.c_str());
+          jobResponseSet->setSeriesInstanceUID(seriesUID.c_str());
+          jobResponseSet->setSOPInstanceUID(instanceUID.c_str());
+          jobResponseSet->setConnectionName(this->listener->AETitle());
+          if (!storedFilePath.isEmpty())
+          {
+            jobResponseSet->setFilePath(storedFilePath);
+          }
+          jobResponseSet->setDataset(reqDataset);
+          jobResponseSet->setJobUID(this->listener->jobUID());
+          jobResponseSet->setCopyFile(true);
+
+          int pendingJobResponseSets =
+            this->listener->d_func()->appendJobResponseSet(jobResponseSet, this->AssociationName);
+
+          emit this->listener->progressJobDetail(jobResponseSet->toVariant());
+          if (pendingJobResponseSets >= this->listener->insertBatchSize())
+          {
+            emit this->listener->jobResponseSetsReady();
+          }
+        }
       }
       // send C-STORE response (with DIMSE status code)
       if (status.good())
       {
-        status = sendSTOREResponse(presInfo.presentationContextID, storeReq, rspStatusCode);
+        status = this->sendSTOREResponse(presInfo.presentationContextID, storeReq, rspStatusCode);
       }
       else if (status == DIMSE_OUTOFRESOURCES)
       {
         // do not overwrite the previous error status
-        sendSTOREResponse(presInfo.presentationContextID, storeReq, STATUS_STORE_Refused_OutOfResources);
+        this->sendSTOREResponse(presInfo.presentationContextID, storeReq, STATUS_STORE_Refused_OutOfResources);
       }
     }
     else
@@ -173,27 +347,17 @@ OFCondition ctkDICOMStorageListenerSCUPrivate::handleIncomingCommand(T_DIMSE_Mes
 }
 
 //------------------------------------------------------------------------------
-// ctkDICOMStorageListenerPrivate
+// ctkDICOMStorageListenerSCUPrivate methods
 
 //------------------------------------------------------------------------------
-class ctkDICOMStorageListenerPrivate
+OFCondition ctkDICOMStorageListenerSCUPrivate::acceptAssociations()
 {
-public:
-  ctkDICOMStorageListenerPrivate();
-  ~ctkDICOMStorageListenerPrivate() = default;
-
-  QString findFile(const QStringList& nameFilters, const QString& subDir) const;
-  QString defaultConfigFile() const;
-
-  QString ConnectionName;
-  QString AETitle;
-  int Port;
-  QString JobUID;
-  QList<QSharedPointer<ctkDICOMJobResponseSet>> JobResponseSets;
-
-  ctkDICOMStorageListenerSCUPrivate SCU;
-  bool Canceled;
-};
+  if (!this->listener || this->listener->wasCanceled())
+  {
+    return EC_IllegalCall;
+  }
+  return DcmSCP::acceptAssociations();
+}
 
 //------------------------------------------------------------------------------
 // ctkDICOMStorageListenerPrivate methods
@@ -203,7 +367,13 @@ ctkDICOMStorageListenerPrivate::ctkDICOMStorageListenerPrivate()
 {
   this->Port = 11112;
   this->AETitle = "CTKSTORE";
-  this->Canceled = false;
+  this->MaximumAssociations = 1;
+  this->InsertBatchSize = 10;
+  this->StreamToStorage = false;
+  this->AssociationsCount = 0;
+  this->ReceivedObjectsCount = 0;
+  this->Canceled.storeRelease(0);
+  this->ReceiveTimer.start();
 
   this->SCU.setConnectionBlockingMode(DUL_NOBLOCK);
   this->SCU.setACSETimeout(1);
@@ -253,6 +423,72 @@ QString ctkDICOMStorageListenerPrivate::defaultConfigFile() const
   return configFile;
 }
 
+//------------------------------------------------------------------------------
+QString ctkDICOMStorageListenerPrivate::beginAssociation(const QString& peerAETitle, const QString& peerHost)
+{
+  QMutexLocker locker(&this->JobResponseSetsMutex);
+  QString associationName = QString("%1@%2#%3")
+    .arg(peerAETitle)
+    .arg(peerHost)
+    .arg(++this->AssociationsCount);
+  this->ActiveAssociations.insert(associationName);
+  this->AssociationQueueDepths.insert(associationName, 0);
+  return associationName;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListenerPrivate::endAssociation(const QString& associationName)
+{
+  QMutexLocker locker(&this->JobResponseSetsMutex);
+  this->ActiveAssociations.remove(associationName);
+  if (this->AssociationQueueDepths.value(associationName) == 0)
+  {
+    this->AssociationQueueDepths.remove(associationName);
+  }
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMStorageListenerPrivate::appendJobResponseSet(
+  QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet, const QString& associationName)
+{
+  QMutexLocker locker(&this->JobResponseSetsMutex);
+  this->JobResponseSets.append(jobResponseSet);
+  if (!associationName.isEmpty())
+  {
+    this->JobResponseSetAssociations.insert(jobResponseSet.data(), associationName);
+    this->AssociationQueueDepths[associationName]++;
+  }
+  this->ReceivedObjectsCount++;
+  this->ReceiveTimes.enqueue(this->ReceiveTimer.elapsed());
+  this->removeExpiredReceiveTimes();
+  return this->JobResponseSets.count();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListenerPrivate::releaseJobResponseSet(ctkDICOMJobResponseSet* jobResponseSet)
+{
+  QString associationName = this->JobResponseSetAssociations.take(jobResponseSet);
+  if (associationName.isEmpty())
+  {
+    return;
+  }
+  int queueDepth = --this->AssociationQueueDepths[associationName];
+  if (queueDepth <= 0 && !this->ActiveAssociations.contains(associationName))
+  {
+    this->AssociationQueueDepths.remove(associationName);
+  }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListenerPrivate::removeExpiredReceiveTimes() const
+{
+  qint64 windowStart = this->ReceiveTimer.elapsed() - ObjectsPerSecondWindow;
+  while (!this->ReceiveTimes.isEmpty() && this->ReceiveTimes.head() < windowStart)
+  {
+    this->ReceiveTimes.dequeue();
+  }
+}
+
 //------------------------------------------------------------------------------
 // ctkDICOMStorageListener methods
 
@@ -263,6 +499,9 @@ ctkDICOMStorageListener::ctkDICOMStorageListener(QObject* parentObject)
 {
   Q_D(ctkDICOMStorageListener);
   d->SCU.listener = this; // give the dcmtk level access to this for emitting signals
+#ifdef WITH_THREADS
+  d->SCPPool.listener = this;
+#endif
 }
 
 //------------------------------------------------------------------------------
@@ -279,6 +518,24 @@ CTK_SET_CPP(ctkDICOMStorageListener, const int&, setPort, Port);
 CTK_GET_CPP(ctkDICOMStorageListener, int, port, Port)
 CTK_SET_CPP(ctkDICOMStorageListener, const QString&, setJobUID, JobUID);
 CTK_GET_CPP(ctkDICOMStorageListener, QString, jobUID, JobUID)
+CTK_GET_CPP(ctkDICOMStorageListener, int, maximumAssociations, MaximumAssociations)
+CTK_GET_CPP(ctkDICOMStorageListener, int, insertBatchSize, InsertBatchSize)
+CTK_SET_CPP(ctkDICOMStorageListener, bool, setStreamToStorage, StreamToStorage);
+CTK_GET_CPP(ctkDICOMStorageListener, bool, streamToStorage, StreamToStorage)
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListener::setMaximumAssociations(int maximumAssociations)
+{
+  Q_D(ctkDICOMStorageListener);
+  d->MaximumAssociations = qMax(1, maximumAssociations);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListener::setInsertBatchSize(int batchSize)
+{
+  Q_D(ctkDICOMStorageListener);
+  d->InsertBatchSize = qMax(1, batchSize);
+}
 
 //------------------------------------------------------------------------------
 bool ctkDICOMStorageListener::listen()
@@ -289,8 +546,18 @@ bool ctkDICOMStorageListener::listen()
     return false;
   }
 
-  OFCondition status = d->SCU.listen();
-  if (status.bad() || d->Canceled)
+  OFCondition status;
+#ifdef WITH_THREADS
+  if (d->MaximumAssociations > 1)
+  {
+    status = d->SCPPool.listen();
+  }
+  else
+#endif
+  {
+    status = d->SCU.listen();
+  }
+  if (status.bad() || d->Canceled.loadAcquire())
   {
     QString error = QString("SCP stopped, it was listening on port %1 : %2 ")
                             .arg(QString::number(d->Port))
@@ -305,14 +572,17 @@ bool ctkDICOMStorageListener::listen()
 bool ctkDICOMStorageListener::wasCanceled()
 {
   Q_D(const ctkDICOMStorageListener);
-  return d->Canceled;
+  return d->Canceled.loadAcquire() != 0;
 }
 
 //------------------------------------------------------------------------------
 void ctkDICOMStorageListener::cancel()
 {
   Q_D(ctkDICOMStorageListener);
-  d->Canceled = true;
+  d->Canceled.storeRelease(1);
+#ifdef WITH_THREADS
+  d->SCPPool.stopAfterCurrentAssociations();
+#endif
 }
 
 //------------------------------------------------------------------------------
@@ -323,8 +593,8 @@ bool ctkDICOMStorageListener::initializeSCU()
   d->SCU.setAETitle(OFString(this->AETitle().toStdString().c_str()));
 
   /* load association negotiation profile from configuration file (if specified) */
-  OFCondition status = d->SCU.loadAssociationConfiguration(
-      OFString(d->defaultConfigFile().toStdString().c_str()), "alldicom");
+  OFString configFile(d->defaultConfigFile().toStdString().c_str());
+  OFCondition status = d->SCU.loadAssociationConfiguration(configFile, "alldicom");
   if (status.bad())
   {
     QString error = QString("Cannot load association configuration: %1").arg(status.text());
@@ -332,6 +602,40 @@ bool ctkDICOMStorageListener::initializeSCU()
     return false;
   }
 
+  if (d->MaximumAssociations <= 1)
+  {
+    return true;
+  }
+
+#ifdef WITH_THREADS
+  // Same settings as the single association SCP, shared by the workers of the pool
+  DcmSCPConfig& poolConfig = d->SCPPool.getConfig();
+  poolConfig.setPort(this->port());
+  poolConfig.setAETitle(OFString(this->AETitle().toStdString().c_str()));
+  poolConfig.setConnectionBlockingMode(DUL_NOBLOCK);
+  poolConfig.setACSETimeout(d->SCU.getACSETimeout());
+  poolConfig.setConnectionTimeout(d->SCU.getConnectionTimeout());
+  poolConfig.setRespondWithCalledAETitle(false);
+  poolConfig.setHostLookupEnabled(true);
+  poolConfig.setVerbosePCMode(false);
+  d->SCPPool.setMaxThreads(static_cast<Uint16>(qMin(d->MaximumAssociations, 65535)));
+
+  status = poolConfig.loadAssociationCfgFile(configFile);
+  if (status.good())
+  {
+    status = poolConfig.setAndCheckAssociationProfile("alldicom");
+  }
+  if (status.bad())
+  {
+    QString error = QString("Cannot load association configuration: %1").arg(status.text());
+    DCMTK_LOG4CPLUS_ERROR_STR(rootLogStorageListener, error.toStdString().c_str());
+    return false;
+  }
+#else
+  QString warning = QString("DCMTK is built without thread support: associations are received one at a time");
+  DCMTK_LOG4CPLUS_WARN_STR(rootLogStorageListener, warning.toStdString().c_str());
+#endif
+
   return true;
 }
 
@@ -354,6 +658,7 @@ int ctkDICOMStorageListener::connectionTimeout() const
 QList<ctkDICOMJobResponseSet*> ctkDICOMStorageListener::jobResponseSets() const
 {
   Q_D(const ctkDICOMStorageListener);
+  QMutexLocker locker(&d->JobResponseSetsMutex);
   QList<ctkDICOMJobResponseSet*> jobResponseSets;
   foreach (QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet, d->JobResponseSets)
   {
@@ -367,6 +672,7 @@ QList<ctkDICOMJobResponseSet*> ctkDICOMStorageListener::jobResponseSets() const
 QList<QSharedPointer<ctkDICOMJobResponseSet>> ctkDICOMStorageListener::jobResponseSetsShared() const
 {
   Q_D(const ctkDICOMStorageListener);
+  QMutexLocker locker(&d->JobResponseSetsMutex);
   return d->JobResponseSets;
 }
 
@@ -388,12 +694,105 @@ void ctkDICOMStorageListener::addJobResponseSet(ctkDICOMJobResponseSet& jobRespo
 void ctkDICOMStorageListener::addJobResponseSet(QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet)
 {
   Q_D(ctkDICOMStorageListener);
-  d->JobResponseSets.append(jobResponseSet);
+  d->appendJobResponseSet(jobResponseSet, QString());
 }
 
 //------------------------------------------------------------------------------
 void ctkDICOMStorageListener::removeJobResponseSet(QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet)
 {
   Q_D(ctkDICOMStorageListener);
-  d->JobResponseSets.removeOne(jobResponseSet);
+  QMutexLocker locker(&d->JobResponseSetsMutex);
+  if (d->JobResponseSets.removeOne(jobResponseSet))
+  {
+    d->releaseJobResponseSet(jobResponseSet.data());
+  }
+}
+
+//------------------------------------------------------------------------------
+QList<QSharedPointer<ctkDICOMJobResponseSet>> ctkDICOMStorageListener::takeJobResponseSets(int count)
+{
+  Q_D(ctkDICOMStorageListener);
+  QMutexLocker locker(&d->JobResponseSetsMutex);
+  QList<QSharedPointer<ctkDICOMJobResponseSet>> jobResponseSets;
+  if (count < 0 || count >= d->JobResponseSets.count())
+  {
+    jobResponseSets.swap(d->JobResponseSets);
+  }
+  else
+  {
+    jobResponseSets = d->JobResponseSets.mid(0, count);
+    d->JobResponseSets.erase(d->JobResponseSets.begin(), d->JobResponseSets.begin() + count);
+  }
+  foreach (QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet, jobResponseSets)
+  {
+    d->releaseJobResponseSet(jobResponseSet.data());
+  }
+  return jobResponseSets;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListener::setDatabase(ctkDICOMDatabase& dicomDatabase)
+{
+  Q_D(ctkDICOMStorageListener);
+  d->Database = QSharedPointer<ctkDICOMDatabase>(&dicomDatabase, skipDelete);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListener::setDatabase(QSharedPointer<ctkDICOMDatabase> dicomDatabase)
+{
+  Q_D(ctkDICOMStorageListener);
+  d->Database = dicomDatabase;
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMDatabase* ctkDICOMStorageListener::dicomDatabase() const
+{
+  Q_D(const ctkDICOMStorageListener);
+  return d->Database.data();
+}
+
+//------------------------------------------------------------------------------
+QSharedPointer<ctkDICOMDatabase> ctkDICOMStorageListener::dicomDatabaseShared() const
+{
+  Q_D(const ctkDICOMStorageListener);
+  return d->Database;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMStorageListener::receivedObjectsCount() const
+{
+  Q_D(const ctkDICOMStorageListener);
+  QMutexLocker locker(&d->JobResponseSetsMutex);
+  return d->ReceivedObjectsCount;
+}
+
+//------------------------------------------------------------------------------
+double ctkDICOMStorageListener::objectsPerSecond() const
+{
+  Q_D(const ctkDICOMStorageListener);
+  QMutexLocker locker(&d->JobResponseSetsMutex);
+  d->removeExpiredReceiveTimes();
+  return d->ReceiveTimes.count() * 1000. / ObjectsPerSecondWindow;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMStorageListener::queueDepth() const
+{
+  Q_D(const ctkDICOMStorageListener);
+  QMutexLocker locker(&d->JobResponseSetsMutex);
+  return d->JobResponseSets.count();
+}
+
+//------------------------------------------------------------------------------
+QMap<QString, QVariant> ctkDICOMStorageListener::associationQueueDepths() const
+{
+  Q_D(const ctkDICOMStorageListener);
+  QMutexLocker locker(&d->JobResponseSetsMutex);
+  QMap<QString, QVariant> queueDepths;
+  for (QMap<QString, int>::const_iterator it = d->AssociationQueueDepths.constBegin();
+       it != d->AssociationQueueDepths.constEnd(); ++it)
+  {
+    queueDepths.insert(it.key(), it.value());
+  }
+  return queueDepths;
 }
@@ -24,6 +24,7 @@
 // Qt includes
 #include <QObject>
 #include <QMap>
+#include <QSharedPointer>
 #include <QString>
 #include <QVariant>
 
@@ -32,6 +33,7 @@
 
 // ctkDICOMCore includes
 #include "ctkDICOMCoreExport.h"
+class ctkDICOMDatabase;
 class ctkDICOMJobResponseSet;
 class ctkDICOMStorageListenerPrivate;
 
@@ -43,6 +45,9 @@ class CTK_DICOM_CORE_EXPORT ctkDICOMStorageListener : public QObject
   Q_PROPERTY(int port READ port WRITE setPort);
   Q_PROPERTY(int connectionTimeout READ connectionTimeout WRITE setConnectionTimeout);
   Q_PROPERTY(QString jobUID READ jobUID WRITE setJobUID);
+  Q_PROPERTY(int maximumAssociations READ maximumAssociations WRITE setMaximumAssociations);
+  Q_PROPERTY(int insertBatchSize READ insertBatchSize WRITE setInsertBatchSize);
+  Q_PROPERTY(bool streamToStorage READ streamToStorage WRITE setStreamToStorage);
 
 public:
   explicit ctkDICOMStorageListener(QObject* parent = 0);
@@ -69,13 +74,64 @@ public:
   int connectionTimeout() const;
   ///@}
 
+  ///@{
+  /// Maximum number of associations handled simultaneously.
+  /// If greater than 1, each association is handled by a thread of a pool,
+  /// so that several modalities can send at the same time.
+  /// 1 by default (associations are handled one after the other).
+  void setMaximumAssociations(int maximumAssociations);
+  int maximumAssociations() const;
+  ///@}
+
+  ///@{
+  /// Number of received instances that are passed at once to the inserter.
+  /// jobResponseSetsReady() is emitted each time this number of instances is pending.
+  /// 10 by default.
+  void setInsertBatchSize(int batchSize);
+  int insertBatchSize() const;
+  ///@}
+
+  ///@{
+  /// If enabled, received instances are written to their storage location in the
+  /// database folder by the thread of their association, and only their header
+  /// (without pixel data) is kept in the job response sets.
+  /// Requires a database (see setDatabase()).
+  /// Disabled by default.
+  void setStreamToStorage(bool streamToStorage);
+  bool streamToStorage() const;
+  ///@}
+
+  ///@{
+  /// Database where the received instances are stored in streaming mode.
+  Q_INVOKABLE void setDatabase(ctkDICOMDatabase& dicomDatabase);
+  void setDatabase(QSharedPointer<ctkDICOMDatabase> dicomDatabase);
+  Q_INVOKABLE ctkDICOMDatabase* dicomDatabase() const;
+  QSharedPointer<ctkDICOMDatabase> dicomDatabaseShared() const;
+  ///@}
+
+  ///@{
+  /// Statistics of the received instances.
+  /// objectsPerSecond() is averaged over the last 5 seconds.
+  /// associationQueueDepths() returns, for each active association (and each
+  /// terminated association with pending instances), the number of received instances
+  /// that are not yet taken by the inserter. Associations are named
+  /// "<calling AE title>@<peer host>#<association number>".
+  Q_INVOKABLE int receivedObjectsCount() const;
+  Q_INVOKABLE double objectsPerSecond() const;
+  Q_INVOKABLE int queueDepth() const;
+  Q_INVOKABLE QMap<QString, QVariant> associationQueueDepths() const;
+  ///@}
+
   ///@{
   /// Access the list of datasets from the last operation.
+  /// These methods can be called while the listener receives instances.
   Q_INVOKABLE QList<ctkDICOMJobResponseSet*> jobResponseSets() const;
   QList<QSharedPointer<ctkDICOMJobResponseSet>> jobResponseSetsShared() const;
   Q_INVOKABLE void addJobResponseSet(ctkDICOMJobResponseSet& jobResponseSet);
   void addJobResponseSet(QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet);
   void removeJobResponseSet(QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet);
+  /// Remove the first \a count (all if negative) job response sets and return them.
+  QList<QSharedPointer<ctkDICOMJobResponseSet>> takeJobResponseSets(int count = -1);
   ///@}
 
   ///@{
@@ -107,6 +163,10 @@ Q_SIGNALS:
   void done(bool error);
   /// Signal is emitted inside the listener() function when a frame has been fetched
   void progressJobDetail(QVariant);
+  /// Signal is emitted inside the listener() function each time insertBatchSize
+  /// instances are pending (see takeJobResponseSets()).
+  /// It is emitted by the thread of the association: the receiver must be directly connected.
+  void jobResponseSetsReady();
 
 public Q_SLOTS:
   void cancel();
@@ -120,6 +180,7 @@ private:
   Q_DECLARE_PRIVATE(ctkDICOMStorageListener);
   Q_DISABLE_COPY(ctkDICOMStorageListener);
 
+  template <typename SCPBase> friend class ctkDICOMStorageListenerSCPHandler;
   friend class ctkDICOMStorageListenerSCUPrivate;
 };
 
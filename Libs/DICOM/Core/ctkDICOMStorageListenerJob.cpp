@@ -40,6 +40,8 @@ ctkDICOMStorageListenerJobPrivate::ctkDICOMStorageListenerJobPrivate(ctkDICOMSto
   this->AETitle = "CTKSTORE";
   this->Port = 11112;
   this->ConnectionTimeout = 1;
+  this->MaximumAssociations = 1;
+  this->InsertBatchSize = 10;
 }
 
 //------------------------------------------------------------------------------
@@ -71,6 +73,10 @@ CTK_SET_CPP(ctkDICOMStorageListenerJob, const int&, setConnectionTimeout, Connec
 CTK_GET_CPP(ctkDICOMStorageListenerJob, int, connectionTimeout, ConnectionTimeout)
 CTK_SET_CPP(ctkDICOMStorageListenerJob, const QString&, setAETitle, AETitle);
 CTK_GET_CPP(ctkDICOMStorageListenerJob, QString, AETitle, AETitle)
+CTK_SET_CPP(ctkDICOMStorageListenerJob, const int&, setMaximumAssociations, MaximumAssociations);
+CTK_GET_CPP(ctkDICOMStorageListenerJob, int, maximumAssociations, MaximumAssociations)
+CTK_SET_CPP(ctkDICOMStorageListenerJob, const int&, setInsertBatchSize, InsertBatchSize);
+CTK_GET_CPP(ctkDICOMStorageListenerJob, int, insertBatchSize, InsertBatchSize)
 
 //----------------------------------------------------------------------------
 QString ctkDICOMStorageListenerJob::loggerReport(const QString& status)
@@ -94,6 +100,8 @@ ctkAbstractJob* ctkDICOMStorageListenerJob::clone() const
   newListenerJob->setAETitle(this->AETitle());
   newListenerJob->setPort(this->port());
   newListenerJob->setConnectionTimeout(this->connectionTimeout());
+  newListenerJob->setMaximumAssociations(this->maximumAssociations());
+  newListenerJob->setInsertBatchSize(this->insertBatchSize());
   newListenerJob->setMaximumNumberOfRetry(this->maximumNumberOfRetry());
   newListenerJob->setRetryDelay(this->retryDelay());
   newListenerJob->setRetryCounter(this->retryCounter());
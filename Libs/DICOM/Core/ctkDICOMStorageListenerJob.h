@@ -44,6 +44,8 @@ class CTK_DICOM_CORE_EXPORT ctkDICOMStorageListenerJob : public ctkDICOMJob
   Q_PROPERTY(int port READ port WRITE setPort);
   Q_PROPERTY(QString AETitle READ AETitle WRITE setAETitle);
   Q_PROPERTY(int connectionTimeout READ connectionTimeout WRITE setConnectionTimeout);
+  Q_PROPERTY(int maximumAssociations READ maximumAssociations WRITE setMaximumAssociations);
+  Q_PROPERTY(int insertBatchSize READ insertBatchSize WRITE setInsertBatchSize);
 
 public:
   typedef ctkDICOMJob Superclass;
@@ -68,6 +70,20 @@ public:
   int connectionTimeout() const;
   ///@}
 
+  ///@{
+  /// Maximum number of associations received simultaneously, default: 1
+  /// \sa ctkDICOMStorageListener::setMaximumAssociations()
+  void setMaximumAssociations(const int& maximumAssociations);
+  int maximumAssociations() const;
+  ///@}
+
+  ///@{
+  /// Number of received instances inserted at once, default: 10
+  /// \sa ctkDICOMStorageListener::setInsertBatchSize()
+  void setInsertBatchSize(const int& batchSize);
+  int insertBatchSize() const;
+  ///@}
+
   /// Logger report string formatting for specific task
   Q_INVOKABLE QString loggerReport(const QString& status) override;
 
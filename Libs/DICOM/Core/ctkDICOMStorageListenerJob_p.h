@@ -43,6 +43,8 @@ public:
   QString AETitle;
   int Port;
   int ConnectionTimeout;
+  int MaximumAssociations;
+  int InsertBatchSize;
 };
 
 #endif
@@ -28,6 +28,7 @@
 #include <ctkLogger.h>
 
 // ctkDICOMCore includes
+#include "ctkDICOMDatabase.h"
 #include "ctkDICOMJobResponseSet.h"
 #include "ctkDICOMScheduler.h"
 #include "ctkDICOMStorageListenerJob.h"
@@ -67,22 +68,46 @@ void ctkDICOMStorageListenerWorkerPrivate::setStorageListenerParameters()
   this->StorageListener->setPort(storageListenerJob->port());
   this->StorageListener->setConnectionTimeout(storageListenerJob->connectionTimeout());
   this->StorageListener->setJobUID(storageListenerJob->jobUID());
+  this->StorageListener->setMaximumAssociations(storageListenerJob->maximumAssociations());
+  this->StorageListener->setInsertBatchSize(storageListenerJob->insertBatchSize());
 
   QObject::connect(this->StorageListener.data(), SIGNAL(progressJobDetail(QVariant)),
                    storageListenerJob.data(), SIGNAL(progressJobDetail(QVariant)),
                    Qt::DirectConnection);
+  // The batch is inserted by the thread of the scheduler (that created the worker, as for the
+  // insert timer), the association threads go back to receiving instances immediately.
+  QObject::connect(this->StorageListener.data(), SIGNAL(jobResponseSetsReady()),
+                   this, SLOT(insertJobResponseSetsBatch()),
+                   static_cast<Qt::ConnectionType>(Qt::UniqueConnection | Qt::QueuedConnection));
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMStorageListenerWorkerPrivate::insertJobResponseSetsBatch()
+{
+  Q_Q(ctkDICOMStorageListenerWorker);
+
+  QSharedPointer<ctkDICOMScheduler> scheduler =
+      qSharedPointerObjectCast<ctkDICOMScheduler>(q->Scheduler);
+  if (!scheduler || this->StorageListener->wasCanceled())
+  {
+    return;
+  }
+
+  // Batches that were already taken by the insert timer leave nothing to insert
+  QList<QSharedPointer<ctkDICOMJobResponseSet>> jobResponseSets =
+    this->StorageListener->takeJobResponseSets(this->StorageListener->insertBatchSize());
+  if (jobResponseSets.count() > 0)
+  {
+    scheduler->insertJobResponseSets(jobResponseSets);
+  }
 }
 
 //------------------------------------------------------------------------------
 void ctkDICOMStorageListenerWorkerPrivate::init()
 {
   Q_Q(ctkDICOMStorageListenerWorker);
-  // To Do: this insert should happen in batch of 10 frames (configurable),
-  // instead of every 1 sec.
-  // This would avoid memory usage spikes when requesting a series or study with a lot of frames.
-  // i.e. the slot should be connected to progressJobDetail from this->StorageListener.
-  // The slot should have a counter. When the counter > batchLimit -> insert
-  // NOTE: the memory release should happen as soon as we insert the response.
+  // Full batches are inserted as soon as they are received (see insertJobResponseSetsBatch()),
+  // the timer inserts the instances of incomplete batches.
   QTimer* timer = new QTimer(this);
   connect(timer, SIGNAL(timeout()), q, SLOT(onInsertJobDetail()));
   timer->start(1000);
@@ -141,6 +166,12 @@ void ctkDICOMStorageListenerWorker::run()
   storageListenerJob->setStatus(ctkAbstractJob::JobStatus::Running);
   emit storageListenerJob->started();
 
+  // Received instances are written to the database folder by the association threads
+  ctkDICOMDatabase* database = scheduler->dicomDatabase();
+  bool streamToStorage = database && database->isOpen() && !database->isInMemory();
+  d->StorageListener->setStreamToStorage(streamToStorage);
+  d->StorageListener->setDatabase(streamToStorage ? scheduler->dicomDatabaseShared() : QSharedPointer<ctkDICOMDatabase>());
+
   logger.debug(QString("ctkDICOMStorageListenerWorker : running job %1 in thread %2.\n")
                        .arg(storageListenerJob->jobUID())
                        .arg(QString::number(reinterpret_cast<quint64>(QThread::currentThreadId())), 16));
@@ -204,15 +235,11 @@ void ctkDICOMStorageListenerWorker::onInsertJobDetail()
   }
 
   QList<QSharedPointer<ctkDICOMJobResponseSet>> jobResponseSets =
-    d->StorageListener->jobResponseSetsShared();
+    d->StorageListener->takeJobResponseSets();
   if (jobResponseSets.count() == 0)
   {
     return;
   }
 
   scheduler->insertJobResponseSets(jobResponseSets);
-  foreach (QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet, jobResponseSets)
-  {
-    d->StorageListener->removeJobResponseSet(jobResponseSet);
-  }
 }
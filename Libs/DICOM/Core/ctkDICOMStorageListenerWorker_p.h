@@ -45,6 +45,11 @@ public:
   void setStorageListenerParameters();
 
   QSharedPointer<ctkDICOMStorageListener> StorageListener;
+
+public Q_SLOTS:
+  /// Insert a batch of received instances while the listener is running.
+  /// Queued to the thread of the scheduler when an association completes a batch.
+  void insertJobResponseSetsBatch();
 };
 
 #endif
@@ -0,0 +1,360 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QAtomicInt>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+
+// ctkDICOMCore includes
+#include "ctkDICOMTagValueCache.h"
+
+// STD includes
+#include <list>
+
+namespace
+{
+const int SHARD_COUNT = 16;
+}
+
+//------------------------------------------------------------------------------
+struct ctkDICOMTagValueCacheEntry
+{
+  QHash<QString, QString> Values;
+  /// Set if Values contains all the tags of the instance
+  bool Complete;
+  /// Position of the instance in the least recently used list of the shard
+  std::list<QString>::iterator Position;
+};
+
+//------------------------------------------------------------------------------
+struct ctkDICOMTagValueCacheShard
+{
+  ctkDICOMTagValueCacheShard() : Count(0) {}
+
+  mutable QMutex Mutex;
+  QHash<QString, ctkDICOMTagValueCacheEntry> Entries;
+  /// Instances from the most to the least recently used
+  std::list<QString> Order;
+  /// Number of values of all entries
+  int Count;
+};
+
+//------------------------------------------------------------------------------
+class ctkDICOMTagValueCachePrivate
+{
+public:
+  ctkDICOMTagValueCachePrivate(int capacity);
+
+  ctkDICOMTagValueCacheShard& shard(const QString& sopInstanceUID);
+  const ctkDICOMTagValueCacheShard& shard(const QString& sopInstanceUID) const;
+
+  /// Return the entry of an instance and make it the most recently used one.
+  /// The shard must be locked.
+  ctkDICOMTagValueCacheEntry* touch(ctkDICOMTagValueCacheShard& shard, const QString& sopInstanceUID, bool create);
+  /// Remove least recently used instances until the shard fits in its share of the capacity,
+  /// keeping the most recently used one. The shard must be locked.
+  void evict(ctkDICOMTagValueCacheShard& shard);
+  void clearShard(ctkDICOMTagValueCacheShard& shard);
+
+  ctkDICOMTagValueCacheShard Shards[SHARD_COUNT];
+  QAtomicInt Capacity;
+  QAtomicInt HitCount;
+  QAtomicInt MissCount;
+};
+
+//------------------------------------------------------------------------------
+// ctkDICOMTagValueCachePrivate methods
+
+//------------------------------------------------------------------------------
+ctkDICOMTagValueCachePrivate::ctkDICOMTagValueCachePrivate(int capacity)
+  : Capacity(capacity)
+  , HitCount(0)
+  , MissCount(0)
+{
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMTagValueCacheShard& ctkDICOMTagValueCachePrivate::shard(const QString& sopInstanceUID)
+{
+  return this->Shards[qHash(sopInstanceUID) % SHARD_COUNT];
+}
+
+//------------------------------------------------------------------------------
+const ctkDICOMTagValueCacheShard& ctkDICOMTagValueCachePrivate::shard(const QString& sopInstanceUID) const
+{
+  return this->Shards[qHash(sopInstanceUID) % SHARD_COUNT];
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMTagValueCacheEntry* ctkDICOMTagValueCachePrivate::touch(
+  ctkDICOMTagValueCacheShard& shard, const QString& sopInstanceUID, bool create)
+{
+  QHash<QString, ctkDICOMTagValueCacheEntry>::iterator entryIt = shard.Entries.find(sopInstanceUID);
+  if (entryIt == shard.Entries.end())
+  {
+    if (!create)
+    {
+      return nullptr;
+    }
+    shard.Order.push_front(sopInstanceUID);
+    ctkDICOMTagValueCacheEntry entry;
+    entry.Complete = false;
+    entry.Position = shard.Order.begin();
+    entryIt = shard.Entries.insert(sopInstanceUID, entry);
+  }
+  else if (entryIt.value().Position != shard.Order.begin())
+  {
+    shard.Order.splice(shard.Order.begin(), shard.Order, entryIt.value().Position);
+  }
+  return &entryIt.value();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTagValueCachePrivate::evict(ctkDICOMTagValueCacheShard& shard)
+{
+  int shardCapacity = (this->Capacity.load() + SHARD_COUNT - 1) / SHARD_COUNT;
+  while (shard.Count > shardCapacity && shard.Order.size() > 1)
+  {
+    QHash<QString, ctkDICOMTagValueCacheEntry>::iterator entryIt = shard.Entries.find(shard.Order.back());
+    shard.Count -= entryIt.value().Values.count();
+    shard.Entries.erase(entryIt);
+    shard.Order.pop_back();
+  }
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTagValueCachePrivate::clearShard(ctkDICOMTagValueCacheShard& shard)
+{
+  shard.Entries.clear();
+  shard.Order.clear();
+  shard.Count = 0;
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMTagValueCache methods
+
+//------------------------------------------------------------------------------
+ctkDICOMTagValueCache::ctkDICOMTagValueCache(int capacity/*=200000*/)
+  : d_ptr(new ctkDICOMTagValueCachePrivate(capacity))
+{
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMTagValueCache::~ctkDICOMTagValueCache()
+{
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTagValueCache::setCapacity(int capacity)
+{
+  Q_D(ctkDICOMTagValueCache);
+  d->Capacity.store(qMax(0, capacity));
+  for (int shardIndex = 0; shardIndex < SHARD_COUNT; ++shardIndex)
+  {
+    ctkDICOMTagValueCacheShard& shard = d->Shards[shardIndex];
+    QMutexLocker locker(&shard.Mutex);
+    if (capacity <= 0)
+    {
+      d->clearShard(shard);
+    }
+    else
+    {
+      d->evict(shard);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMTagValueCache::capacity() const
+{
+  Q_D(const ctkDICOMTagValueCache);
+  return d->Capacity.load();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMTagValueCache::value(const QString& sopInstanceUID, const QString& tag, QString& value)
+{
+  Q_D(ctkDICOMTagValueCache);
+  ctkDICOMTagValueCacheShard& shard = d->shard(sopInstanceUID);
+  QMutexLocker locker(&shard.Mutex);
+  ctkDICOMTagValueCacheEntry* entry = d->touch(shard, sopInstanceUID, false);
+  if (entry)
+  {
+    QHash<QString, QString>::const_iterator valueIt = entry->Values.constFind(tag);
+    if (valueIt != entry->Values.constEnd())
+    {
+      value = valueIt.value();
+      d->HitCount.ref();
+      return true;
+    }
+  }
+  d->MissCount.ref();
+  return false;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMTagValueCache::values(const QString& sopInstanceUID, QMap<QString, QString>& values)
+{
+  Q_D(ctkDICOMTagValueCache);
+  ctkDICOMTagValueCacheShard& shard = d->shard(sopInstanceUID);
+  QMutexLocker locker(&shard.Mutex);
+  ctkDICOMTagValueCacheEntry* entry = d->touch(shard, sopInstanceUID, false);
+  if (!entry || !entry->Complete)
+  {
+    d->MissCount.ref();
+    return false;
+  }
+  values.clear();
+  for (QHash<QString, QString>::const_iterator valueIt = entry->Values.constBegin();
+    valueIt != entry->Values.constEnd(); ++valueIt)
+  {
+    values.insert(valueIt.key(), valueIt.value());
+  }
+  d->HitCount.ref();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTagValueCache::insert(const QString& sopInstanceUID, const QString& tag, const QString& value)
+{
+  QMap<QString, QString> values;
+  values.insert(tag, value);
+  this->insert(sopInstanceUID, values);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTagValueCache::insert(const QString& sopInstanceUID, const QMap<QString, QString>& values,
+  bool complete/*=false*/)
+{
+  Q_D(ctkDICOMTagValueCache);
+  if (d->Capacity.load() <= 0)
+  {
+    return;
+  }
+  ctkDICOMTagValueCacheShard& shard = d->shard(sopInstanceUID);
+  QMutexLocker locker(&shard.Mutex);
+  ctkDICOMTagValueCacheEntry* entry = d->touch(shard, sopInstanceUID, true);
+  shard.Count -= entry->Values.count();
+  if (complete)
+  {
+    entry->Values.clear();
+    entry->Complete = true;
+  }
+  for (QMap<QString, QString>::const_iterator valueIt = values.constBegin(); valueIt != values.constEnd(); ++valueIt)
+  {
+    entry->Values.insert(valueIt.key(), valueIt.value());
+  }
+  shard.Count += entry->Values.count();
+  d->evict(shard);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTagValueCache::update(const QString& sopInstanceUID, const QString& tag, const QString& value)
+{
+  Q_D(ctkDICOMTagValueCache);
+  ctkDICOMTagValueCacheShard& shard = d->shard(sopInstanceUID);
+  QMutexLocker locker(&shard.Mutex);
+  QHash<QString, ctkDICOMTagValueCacheEntry>::iterator entryIt = shard.Entries.find(sopInstanceUID);
+  if (entryIt == shard.Entries.end())
+  {
+    return;
+  }
+  if (!entryIt.value().Values.contains(tag))
+  {
+    ++shard.Count;
+  }
+  entryIt.value().Values.insert(tag, value);
+  d->evict(shard);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTagValueCache::remove(const QString& sopInstanceUID)
+{
+  Q_D(ctkDICOMTagValueCache);
+  ctkDICOMTagValueCacheShard& shard = d->shard(sopInstanceUID);
+  QMutexLocker locker(&shard.Mutex);
+  QHash<QString, ctkDICOMTagValueCacheEntry>::iterator entryIt = shard.Entries.find(sopInstanceUID);
+  if (entryIt == shard.Entries.end())
+  {
+    return;
+  }
+  shard.Count -= entryIt.value().Values.count();
+  shard.Order.erase(entryIt.value().Position);
+  shard.Entries.erase(entryIt);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTagValueCache::clear()
+{
+  Q_D(ctkDICOMTagValueCache);
+  for (int shardIndex = 0; shardIndex < SHARD_COUNT; ++shardIndex)
+  {
+    ctkDICOMTagValueCacheShard& shard = d->Shards[shardIndex];
+    QMutexLocker locker(&shard.Mutex);
+    d->clearShard(shard);
+  }
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMTagValueCache::contains(const QString& sopInstanceUID) const
+{
+  Q_D(const ctkDICOMTagValueCache);
+  const ctkDICOMTagValueCacheShard& shard = d->shard(sopInstanceUID);
+  QMutexLocker locker(&shard.Mutex);
+  return shard.Entries.contains(sopInstanceUID);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMTagValueCache::count() const
+{
+  Q_D(const ctkDICOMTagValueCache);
+  int count = 0;
+  for (int shardIndex = 0; shardIndex < SHARD_COUNT; ++shardIndex)
+  {
+    const ctkDICOMTagValueCacheShard& shard = d->Shards[shardIndex];
+    QMutexLocker locker(&shard.Mutex);
+    count += shard.Count;
+  }
+  return count;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMTagValueCache::hitCount() const
+{
+  Q_D(const ctkDICOMTagValueCache);
+  return d->HitCount.load();
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMTagValueCache::missCount() const
+{
+  Q_D(const ctkDICOMTagValueCache);
+  return d->MissCount.load();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMTagValueCache::resetStatistics()
+{
+  Q_D(ctkDICOMTagValueCache);
+  d->HitCount.store(0);
+  d->MissCount.store(0);
+}
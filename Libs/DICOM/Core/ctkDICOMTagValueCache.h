@@ -0,0 +1,108 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+#ifndef __ctkDICOMTagValueCache_h
+#define __ctkDICOMTagValueCache_h
+
+// Qt includes
+#include <QMap>
+#include <QScopedPointer>
+#include <QString>
+
+// ctkDICOMCore includes
+#include "ctkDICOMCoreExport.h"
+class ctkDICOMTagValueCachePrivate;
+
+/// \ingroup DICOM_Core
+///
+/// \brief In-memory least recently used cache of tag values, by instance.
+///
+/// Used by ctkDICOMDatabase in front of its tag cache table so that the values
+/// requested again and again (e.g. the same tags of all the instances of a series)
+/// do not require a query each time.
+///
+/// Instances are distributed in shards, each one with its own lock and its own
+/// least recently used list, so that threads looking up different instances
+/// do not wait for each other. When a shard holds more values than its share of
+/// the capacity, its least recently used instances are evicted.
+///
+/// Values are stored as given: the caller defines how missing tags are represented.
+/// This class is thread-safe.
+class CTK_DICOM_CORE_EXPORT ctkDICOMTagValueCache
+{
+public:
+  explicit ctkDICOMTagValueCache(int capacity = 200000);
+  virtual ~ctkDICOMTagValueCache();
+
+  ///@{
+  /// Maximum number of values kept in memory (200000 by default).
+  /// Setting 0 disables the cache.
+  void setCapacity(int capacity);
+  int capacity() const;
+  ///@}
+
+  /// Look up the value of a tag of an instance.
+  /// Returns false (and counts a miss) if the value is not in memory.
+  bool value(const QString& sopInstanceUID, const QString& tag, QString& value);
+
+  /// Look up all the values of an instance.
+  /// Returns false (and counts a miss) unless all the values of the instance have been inserted
+  /// with \a complete set.
+  bool values(const QString& sopInstanceUID, QMap<QString, QString>& values);
+
+  ///@{
+  /// Store values of an instance, replacing the values of the same tags.
+  /// Set \a complete if \a values contains all the values of the instance.
+  void insert(const QString& sopInstanceUID, const QString& tag, const QString& value);
+  void insert(const QString& sopInstanceUID, const QMap<QString, QString>& values, bool complete = false);
+  ///@}
+
+  /// Replace the value of a tag only if the instance is already in memory,
+  /// so that writing values of many new instances does not evict the ones in use.
+  void update(const QString& sopInstanceUID, const QString& tag, const QString& value);
+
+  /// Remove all values of an instance
+  void remove(const QString& sopInstanceUID);
+
+  /// Remove all values
+  void clear();
+
+  /// Return true if values of the instance are in memory
+  bool contains(const QString& sopInstanceUID) const;
+
+  /// Number of values in memory
+  int count() const;
+
+  ///@{
+  /// Statistics of value() and values() calls
+  int hitCount() const;
+  int missCount() const;
+  void resetStatistics();
+  ///@}
+
+protected:
+  QScopedPointer<ctkDICOMTagValueCachePrivate> d_ptr;
+
+private:
+  Q_DECLARE_PRIVATE(ctkDICOMTagValueCache);
+  Q_DISABLE_COPY(ctkDICOMTagValueCache);
+};
+
+#endif
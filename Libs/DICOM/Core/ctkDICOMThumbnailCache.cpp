@@ -0,0 +1,970 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+// Qt includes
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSet>
+#include <QSharedPointer>
+#include <QtEndian>
+
+// ctkCore includes
+#include <ctkLogger.h>
+
+// ctkDICOMCore includes
+#include "ctkDICOMThumbnailCache.h"
+#include "ctkDICOMThumbnailGenerator.h"
+
+// DCMTK includes
+#include <dcmtk/dcmimgle/dcmimage.h>
+
+static ctkLogger logger("org.commontk.dicom.DICOMThumbnailCache");
+
+//------------------------------------------------------------------------------
+// Container layout (all integers are big endian):
+//
+//   header:       magic (4) | version (4) | flags (4)
+//   record:       type (1) | payload size (4) | payload
+//   blob record:  SHA-1 of the encoded image (20) | codec (1) | width (4) | height (4)
+//                 | QImage::Format (4) | bytes per line (4) | encoded image data
+//   index record: SHA-1 of the blob (20, all zeros if the thumbnail was removed)
+//                 | source file modification time in ms since epoch (8) | SOPInstanceUID (UTF-8)
+//
+// Records are only appended. The last index record of an instance wins.
+// A container file is never truncated, as other instances may have it mapped:
+// it is replaced by a new file instead (see replaceContainer()).
+namespace
+{
+const quint32 CONTAINER_MAGIC = 0x43544B54; // "CTKT"
+const quint32 CONTAINER_VERSION = 1;
+const int CONTAINER_HEADER_SIZE = 12;
+const int CONTAINER_FLAGS_OFFSET = 8;
+/// Set in the header of a container that was replaced (compacted) or removed,
+/// other instances that have it mapped must reopen the file.
+const quint32 CONTAINER_FLAG_OBSOLETE = 0x1;
+
+const quint8 BLOB_RECORD = 1;
+const quint8 INDEX_RECORD = 2;
+const int RECORD_HEADER_SIZE = 5;
+const int HASH_SIZE = 20;
+const int BLOB_HEADER_SIZE = HASH_SIZE + 1 + 4 * 4;
+const int INDEX_HEADER_SIZE = HASH_SIZE + 8;
+
+/// A container is compacted when less than half of it is used and it is larger than this
+const qint64 COMPACTION_MINIMUM_SIZE = 1024 * 1024;
+
+const int DEFAULT_MAXIMUM_OPEN_CONTAINERS = 64;
+
+/// Appends to a container are serialized across all the cache instances of the process
+const int WRITE_LOCK_COUNT = 64;
+QMutex WriteLocks[WRITE_LOCK_COUNT];
+
+QMutex& writeLockForContainer(const QString& containerPath)
+{
+  return WriteLocks[qHash(containerPath) % WRITE_LOCK_COUNT];
+}
+}
+
+//------------------------------------------------------------------------------
+struct ctkDICOMThumbnailBlob
+{
+  qint64 DataOffset;
+  quint32 DataSize;
+  quint8 Codec;
+  qint32 Width;
+  qint32 Height;
+  qint32 Format;
+  qint32 BytesPerLine;
+};
+
+//------------------------------------------------------------------------------
+struct ctkDICOMThumbnailEntry
+{
+  QByteArray Hash;
+  qint64 SourceTimestamp;
+};
+
+//------------------------------------------------------------------------------
+struct ctkDICOMThumbnailContainer
+{
+  ctkDICOMThumbnailContainer() : Map(nullptr), MappedSize(0), ScannedSize(0) {}
+
+  QString Path;
+  QFile File;
+  uchar* Map;
+  qint64 MappedSize;
+  /// End of the last complete record
+  qint64 ScannedSize;
+  QHash<QString, ctkDICOMThumbnailEntry> Entries;
+  QHash<QByteArray, ctkDICOMThumbnailBlob> Blobs;
+};
+
+//------------------------------------------------------------------------------
+struct ctkDICOMEncodedThumbnail
+{
+  QString SOPInstanceUID;
+  qint64 SourceTimestamp;
+  QByteArray Hash;
+  quint8 Codec;
+  qint32 Width;
+  qint32 Height;
+  qint32 Format;
+  qint32 BytesPerLine;
+  QByteArray Data;
+};
+
+//------------------------------------------------------------------------------
+class ctkDICOMThumbnailCachePrivate
+{
+  Q_DECLARE_PUBLIC(ctkDICOMThumbnailCache);
+
+protected:
+  ctkDICOMThumbnailCache* const q_ptr;
+
+public:
+  ctkDICOMThumbnailCachePrivate(ctkDICOMThumbnailCache& obj);
+
+  /// Return the container of a study, mapped and up-to-date.
+  /// Returns nullptr if the study has no container.
+  ctkDICOMThumbnailContainer* container(const QString& studyInstanceUID);
+  /// Map the new records appended to the container file (by this or another instance)
+  bool refresh(ctkDICOMThumbnailContainer& container);
+  bool scan(ctkDICOMThumbnailContainer& container);
+  void unmap(ctkDICOMThumbnailContainer& container);
+  void closeContainer(const QString& studyInstanceUID);
+  void touch(const QString& studyInstanceUID);
+
+  bool encode(const QImage& image, ctkDICOMEncodedThumbnail& thumbnail) const;
+  bool decode(const ctkDICOMThumbnailContainer& container, const ctkDICOMThumbnailBlob& blob, QImage& image) const;
+  void appendBlobRecord(QByteArray& records, const ctkDICOMThumbnailBlob& blob, const QByteArray& hash,
+                        const char* data) const;
+  void appendIndexRecord(QByteArray& records, const QString& sopInstanceUID, const QByteArray& hash,
+                         qint64 sourceTimestamp) const;
+
+  /// Append blob and index records to the container of a study, creating it if needed.
+  /// Blobs already in the container are not written again.
+  bool appendThumbnails(const QString& studyInstanceUID, const QList<ctkDICOMEncodedThumbnail>& thumbnails);
+  bool appendRecords(const QString& studyInstanceUID, const QByteArray& records);
+  /// Records of the thumbnails still referenced by the container
+  QByteArray liveRecords(const ctkDICOMThumbnailContainer& container) const;
+  /// Replace the container file of a study by a new file made of \a records.
+  bool replaceContainer(const QString& studyInstanceUID, const QByteArray& records);
+  bool setObsolete(const QString& containerPath, bool obsolete);
+  bool removeContainer(const QString& studyInstanceUID);
+  bool needsCompaction(const ctkDICOMThumbnailContainer& container) const;
+  bool compact(const QString& studyInstanceUID);
+
+  QString Directory;
+  ctkDICOMThumbnailCache::Codec Codec;
+  int MaximumOpenContainers;
+  QHash<QString, QSharedPointer<ctkDICOMThumbnailContainer> > Containers;
+  /// Study UIDs of the open containers, least recently used first
+  QStringList RecentlyUsedStudies;
+};
+
+//------------------------------------------------------------------------------
+// ctkDICOMThumbnailCachePrivate methods
+
+//------------------------------------------------------------------------------
+ctkDICOMThumbnailCachePrivate::ctkDICOMThumbnailCachePrivate(ctkDICOMThumbnailCache& obj)
+  : q_ptr(&obj)
+  , Codec(ctkDICOMThumbnailCache::RawCodec)
+  , MaximumOpenContainers(DEFAULT_MAXIMUM_OPEN_CONTAINERS)
+{
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMThumbnailContainer* ctkDICOMThumbnailCachePrivate::container(const QString& studyInstanceUID)
+{
+  Q_Q(ctkDICOMThumbnailCache);
+  if (this->Directory.isEmpty() || studyInstanceUID.isEmpty())
+  {
+    return nullptr;
+  }
+  QSharedPointer<ctkDICOMThumbnailContainer> container = this->Containers.value(studyInstanceUID);
+  if (!container)
+  {
+    container = QSharedPointer<ctkDICOMThumbnailContainer>(new ctkDICOMThumbnailContainer);
+    container->Path = q->containerPathForStudy(studyInstanceUID);
+    container->File.setFileName(container->Path);
+  }
+  if (!this->refresh(*container))
+  {
+    this->closeContainer(studyInstanceUID);
+    return nullptr;
+  }
+  if (!this->Containers.contains(studyInstanceUID))
+  {
+    this->Containers[studyInstanceUID] = container;
+  }
+  this->touch(studyInstanceUID);
+  return container.data();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailCachePrivate::refresh(ctkDICOMThumbnailContainer& container)
+{
+  if (container.Map)
+  {
+    quint32 flags = qFromBigEndian<quint32>(container.Map + CONTAINER_FLAGS_OFFSET);
+    if (flags & CONTAINER_FLAG_OBSOLETE)
+    {
+      // The file was compacted or removed by another instance, start over
+      this->unmap(container);
+    }
+  }
+  if (!container.File.isOpen())
+  {
+    if (!container.File.exists() || !container.File.open(QIODevice::ReadOnly))
+    {
+      return false;
+    }
+  }
+  qint64 fileSize = container.File.size();
+  if (fileSize < container.MappedSize)
+  {
+    // The file was truncated, start over
+    this->unmap(container);
+    return this->refresh(container);
+  }
+  if (fileSize == container.MappedSize)
+  {
+    return container.Map != nullptr;
+  }
+  if (container.Map)
+  {
+    container.File.unmap(container.Map);
+    container.Map = nullptr;
+    container.MappedSize = 0;
+  }
+  if (fileSize < CONTAINER_HEADER_SIZE)
+  {
+    return false;
+  }
+  container.Map = container.File.map(0, fileSize);
+  if (!container.Map)
+  {
+    logger.error("Failed to map thumbnail container " + container.Path + ": " + container.File.errorString());
+    return false;
+  }
+  container.MappedSize = fileSize;
+  return this->scan(container);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailCachePrivate::scan(ctkDICOMThumbnailContainer& container)
+{
+  const uchar* map = container.Map;
+  if (container.ScannedSize == 0)
+  {
+    if (qFromBigEndian<quint32>(map) != CONTAINER_MAGIC
+      || qFromBigEndian<quint32>(map + 4) != CONTAINER_VERSION)
+    {
+      logger.warn("Invalid thumbnail container " + container.Path);
+      return false;
+    }
+    container.ScannedSize = CONTAINER_HEADER_SIZE;
+  }
+
+  qint64 offset = container.ScannedSize;
+  while (offset + RECORD_HEADER_SIZE <= container.MappedSize)
+  {
+    quint8 type = map[offset];
+    quint32 payloadSize = qFromBigEndian<quint32>(map + offset + 1);
+    qint64 payloadOffset = offset + RECORD_HEADER_SIZE;
+    if (payloadOffset + payloadSize > container.MappedSize)
+    {
+      // Incomplete record (interrupted write), it is overwritten by the next append
+      break;
+    }
+    const uchar* payload = map + payloadOffset;
+    if (type == BLOB_RECORD && payloadSize >= static_cast<quint32>(BLOB_HEADER_SIZE))
+    {
+      ctkDICOMThumbnailBlob blob;
+      QByteArray hash(reinterpret_cast<const char*>(payload), HASH_SIZE);
+      blob.Codec = payload[HASH_SIZE];
+      blob.Width = qFromBigEndian<qint32>(payload + HASH_SIZE + 1);
+      blob.Height = qFromBigEndian<qint32>(payload + HASH_SIZE + 5);
+      blob.Format = qFromBigEndian<qint32>(payload + HASH_SIZE + 9);
+      blob.BytesPerLine = qFromBigEndian<qint32>(payload + HASH_SIZE + 13);
+      blob.DataOffset = payloadOffset + BLOB_HEADER_SIZE;
+      blob.DataSize = payloadSize - BLOB_HEADER_SIZE;
+      container.Blobs[hash] = blob;
+    }
+    else if (type == INDEX_RECORD && payloadSize >= static_cast<quint32>(INDEX_HEADER_SIZE))
+    {
+      ctkDICOMThumbnailEntry entry;
+      entry.Hash = QByteArray(reinterpret_cast<const char*>(payload), HASH_SIZE);
+      entry.SourceTimestamp = qFromBigEndian<qint64>(payload + HASH_SIZE);
+      QString sopInstanceUID = QString::fromUtf8(reinterpret_cast<const char*>(payload + INDEX_HEADER_SIZE),
+                                                 payloadSize - INDEX_HEADER_SIZE);
+      if (entry.Hash == QByteArray(HASH_SIZE, '\0'))
+      {
+        container.Entries.remove(sopInstanceUID);
+      }
+      else
+      {
+        container.Entries[sopInstanceUID] = entry;
+      }
+    }
+    offset = payloadOffset + payloadSize;
+  }
+  container.ScannedSize = offset;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailCachePrivate::unmap(ctkDICOMThumbnailContainer& container)
+{
+  if (container.Map)
+  {
+    container.File.unmap(container.Map);
+  }
+  container.File.close();
+  container.Map = nullptr;
+  container.MappedSize = 0;
+  container.ScannedSize = 0;
+  container.Entries.clear();
+  container.Blobs.clear();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailCachePrivate::closeContainer(const QString& studyInstanceUID)
+{
+  QSharedPointer<ctkDICOMThumbnailContainer> container = this->Containers.take(studyInstanceUID);
+  if (container)
+  {
+    this->unmap(*container);
+  }
+  this->RecentlyUsedStudies.removeOne(studyInstanceUID);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailCachePrivate::touch(const QString& studyInstanceUID)
+{
+  if (this->RecentlyUsedStudies.isEmpty() || this->RecentlyUsedStudies.last() != studyInstanceUID)
+  {
+    this->RecentlyUsedStudies.removeOne(studyInstanceUID);
+    this->RecentlyUsedStudies.append(studyInstanceUID);
+  }
+  while (this->RecentlyUsedStudies.count() > qMax(1, this->MaximumOpenContainers))
+  {
+    this->closeContainer(this->RecentlyUsedStudies.first());
+  }
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailCachePrivate::encode(const QImage& image, ctkDICOMEncodedThumbnail& thumbnail) const
+{
+  if (image.isNull())
+  {
+    return false;
+  }
+  thumbnail.Codec = static_cast<quint8>(this->Codec);
+  thumbnail.Width = image.width();
+  thumbnail.Height = image.height();
+  thumbnail.Format = static_cast<qint32>(image.format());
+  thumbnail.BytesPerLine = image.bytesPerLine();
+  if (this->Codec == ctkDICOMThumbnailCache::RawCodec)
+  {
+    thumbnail.Data = QByteArray(reinterpret_cast<const char*>(image.constBits()),
+                                image.bytesPerLine() * image.height());
+  }
+  else
+  {
+    thumbnail.Data.clear();
+    QBuffer buffer(&thumbnail.Data);
+    buffer.open(QIODevice::WriteOnly);
+    const char* format = (this->Codec == ctkDICOMThumbnailCache::JPEGCodec ? "JPG" : "PNG");
+    if (!image.save(&buffer, format, this->Codec == ctkDICOMThumbnailCache::JPEGCodec ? 90 : -1))
+    {
+      logger.error(QString("Failed to encode thumbnail as %1").arg(format));
+      return false;
+    }
+  }
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  QByteArray header;
+  QDataStream stream(&header, QIODevice::WriteOnly);
+  stream << thumbnail.Codec << thumbnail.Width << thumbnail.Height << thumbnail.Format << thumbnail.BytesPerLine;
+  hash.addData(header);
+  hash.addData(thumbnail.Data);
+  thumbnail.Hash = hash.result();
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailCachePrivate::decode(const ctkDICOMThumbnailContainer& container,
+                                           const ctkDICOMThumbnailBlob& blob, QImage& image) const
+{
+  const uchar* data = container.Map + blob.DataOffset;
+  if (blob.Codec == ctkDICOMThumbnailCache::RawCodec)
+  {
+    if (static_cast<qint64>(blob.BytesPerLine) * blob.Height > blob.DataSize)
+    {
+      return false;
+    }
+    // Copy, the mapping is released when the container grows
+    image = QImage(data, blob.Width, blob.Height, blob.BytesPerLine,
+                   static_cast<QImage::Format>(blob.Format)).copy();
+  }
+  else
+  {
+    image = QImage::fromData(data, static_cast<int>(blob.DataSize),
+                             blob.Codec == ctkDICOMThumbnailCache::JPEGCodec ? "JPG" : "PNG");
+  }
+  return !image.isNull();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailCachePrivate::appendBlobRecord(QByteArray& records, const ctkDICOMThumbnailBlob& blob,
+                                                     const QByteArray& hash, const char* data) const
+{
+  QDataStream stream(&records, QIODevice::WriteOnly | QIODevice::Append);
+  stream << BLOB_RECORD << static_cast<quint32>(BLOB_HEADER_SIZE + blob.DataSize);
+  stream.writeRawData(hash.constData(), HASH_SIZE);
+  stream << blob.Codec << blob.Width << blob.Height << blob.Format << blob.BytesPerLine;
+  stream.writeRawData(data, static_cast<int>(blob.DataSize));
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailCachePrivate::appendIndexRecord(QByteArray& records, const QString& sopInstanceUID,
+                                                      const QByteArray& hash, qint64 sourceTimestamp) const
+{
+  QByteArray uid = sopInstanceUID.toUtf8();
+  QDataStream stream(&records, QIODevice::WriteOnly | QIODevice::Append);
+  stream << INDEX_RECORD << static_cast<quint32>(INDEX_HEADER_SIZE + uid.size());
+  stream.writeRawData(hash.constData(), HASH_SIZE);
+  stream << sourceTimestamp;
+  stream.writeRawData(uid.constData(), uid.size());
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailCachePrivate::appendThumbnails(const QString& studyInstanceUID,
+                                                     const QList<ctkDICOMEncodedThumbnail>& thumbnails)
+{
+  Q_Q(ctkDICOMThumbnailCache);
+  if (thumbnails.isEmpty())
+  {
+    return true;
+  }
+  QMutexLocker locker(&writeLockForContainer(q->containerPathForStudy(studyInstanceUID)));
+
+  // Refresh under the lock so that blobs written by other instances are reused
+  ctkDICOMThumbnailContainer* container = this->container(studyInstanceUID);
+  QByteArray records;
+  QSet<QByteArray> writtenHashes;
+  foreach (const ctkDICOMEncodedThumbnail& thumbnail, thumbnails)
+  {
+    if ((!container || !container->Blobs.contains(thumbnail.Hash)) && !writtenHashes.contains(thumbnail.Hash))
+    {
+      ctkDICOMThumbnailBlob blob;
+      blob.DataSize = static_cast<quint32>(thumbnail.Data.size());
+      blob.Codec = thumbnail.Codec;
+      blob.Width = thumbnail.Width;
+      blob.Height = thumbnail.Height;
+      blob.Format = thumbnail.Format;
+      blob.BytesPerLine = thumbnail.BytesPerLine;
+      this->appendBlobRecord(records, blob, thumbnail.Hash, thumbnail.Data.constData());
+      writtenHashes.insert(thumbnail.Hash);
+    }
+    this->appendIndexRecord(records, thumbnail.SOPInstanceUID, thumbnail.Hash, thumbnail.SourceTimestamp);
+  }
+  return this->appendRecords(studyInstanceUID, records);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailCachePrivate::appendRecords(const QString& studyInstanceUID, const QByteArray& records)
+{
+  Q_Q(ctkDICOMThumbnailCache);
+  // The caller holds the write lock and refreshed the container
+  QString containerPath = q->containerPathForStudy(studyInstanceUID);
+  ctkDICOMThumbnailContainer* container = this->Containers.value(studyInstanceUID).data();
+
+  bool success = false;
+  if (!container || container->ScannedSize < CONTAINER_HEADER_SIZE
+    || QFileInfo(containerPath).size() > container->ScannedSize)
+  {
+    // New container, existing file that is not a valid container, or incomplete record
+    // left by an interrupted write: the file is replaced instead of being truncated.
+    QByteArray allRecords = (container ? this->liveRecords(*container) : QByteArray());
+    allRecords.append(records);
+    success = this->replaceContainer(studyInstanceUID, allRecords);
+  }
+  else
+  {
+    // Appending does not change the part of the file mapped by other instances
+    QFile file(containerPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+    {
+      logger.error("Failed to open thumbnail container " + containerPath + ": " + file.errorString());
+      return false;
+    }
+    success = (file.write(records) == records.size());
+    if (!success)
+    {
+      logger.error("Failed to write thumbnail container " + containerPath + ": " + file.errorString());
+    }
+    file.close();
+  }
+
+  // Map the new records
+  container = this->container(studyInstanceUID);
+  if (success && container && this->needsCompaction(*container))
+  {
+    this->compact(studyInstanceUID);
+  }
+  return success;
+}
+
+//------------------------------------------------------------------------------
+QByteArray ctkDICOMThumbnailCachePrivate::liveRecords(const ctkDICOMThumbnailContainer& container) const
+{
+  QByteArray records;
+  QSet<QByteArray> writtenHashes;
+  for (QHash<QString, ctkDICOMThumbnailEntry>::const_iterator it = container.Entries.constBegin();
+       it != container.Entries.constEnd(); ++it)
+  {
+    const QByteArray& hash = it.value().Hash;
+    if (!container.Blobs.contains(hash))
+    {
+      continue;
+    }
+    if (!writtenHashes.contains(hash))
+    {
+      const ctkDICOMThumbnailBlob& blob = container.Blobs[hash];
+      this->appendBlobRecord(records, blob, hash,
+                             reinterpret_cast<const char*>(container.Map + blob.DataOffset));
+      writtenHashes.insert(hash);
+    }
+    this->appendIndexRecord(records, it.key(), hash, it.value().SourceTimestamp);
+  }
+  return records;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailCachePrivate::replaceContainer(const QString& studyInstanceUID, const QByteArray& records)
+{
+  Q_Q(ctkDICOMThumbnailCache);
+  // The caller holds the write lock
+  QString containerPath = q->containerPathForStudy(studyInstanceUID);
+  if (!QDir().mkpath(this->Directory))
+  {
+    logger.error("Failed to create thumbnail directory " + this->Directory);
+    return false;
+  }
+  QSaveFile file(containerPath);
+  if (!file.open(QIODevice::WriteOnly))
+  {
+    logger.error("Failed to create thumbnail container " + containerPath + ": " + file.errorString());
+    return false;
+  }
+  {
+    QDataStream stream(&file);
+    stream << CONTAINER_MAGIC << CONTAINER_VERSION << static_cast<quint32>(0);
+  }
+  if (file.write(records) != records.size())
+  {
+    logger.error("Failed to write thumbnail container " + containerPath + ": " + file.errorString());
+    file.cancelWriting();
+    return false;
+  }
+
+  // The previous file is renamed over, not truncated, so that the mapping of other
+  // instances remains valid until they see the obsolete flag and reopen the container.
+  bool validContainer = this->Containers.contains(studyInstanceUID);
+  this->closeContainer(studyInstanceUID);
+  if (validContainer)
+  {
+    this->setObsolete(containerPath, true);
+  }
+  if (!file.commit())
+  {
+    // On Windows, a file cannot be replaced while another process has it mapped.
+    logger.warn("Failed to replace thumbnail container " + containerPath + ": " + file.errorString());
+    if (validContainer)
+    {
+      this->setObsolete(containerPath, false);
+    }
+    return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailCachePrivate::setObsolete(const QString& containerPath, bool obsolete)
+{
+  QFile file(containerPath);
+  if (!file.open(QIODevice::ReadWrite) || !file.seek(CONTAINER_FLAGS_OFFSET))
+  {
+    return false;
+  }
+  QDataStream stream(&file);
+  stream << static_cast<quint32>(obsolete ? CONTAINER_FLAG_OBSOLETE : 0);
+  return stream.status() == QDataStream::Ok;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailCachePrivate::removeContainer(const QString& studyInstanceUID)
+{
+  Q_Q(ctkDICOMThumbnailCache);
+  // The caller holds the write lock
+  QString containerPath = q->containerPathForStudy(studyInstanceUID);
+  this->closeContainer(studyInstanceUID);
+  if (!QFile::exists(containerPath))
+  {
+    return true;
+  }
+  // Let other instances know that they have to reopen the container
+  this->setObsolete(containerPath, true);
+  if (!QFile::remove(containerPath))
+  {
+    logger.warn("Failed to remove thumbnail container " + containerPath);
+    this->setObsolete(containerPath, false);
+    return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailCachePrivate::needsCompaction(const ctkDICOMThumbnailContainer& container) const
+{
+  if (container.MappedSize < COMPACTION_MINIMUM_SIZE)
+  {
+    return false;
+  }
+  qint64 usedSize = CONTAINER_HEADER_SIZE;
+  QSet<QByteArray> usedHashes;
+  for (QHash<QString, ctkDICOMThumbnailEntry>::const_iterator it = container.Entries.constBegin();
+       it != container.Entries.constEnd(); ++it)
+  {
+    usedSize += RECORD_HEADER_SIZE + INDEX_HEADER_SIZE + it.key().size();
+    if (!usedHashes.contains(it.value().Hash))
+    {
+      usedHashes.insert(it.value().Hash);
+      usedSize += RECORD_HEADER_SIZE + BLOB_HEADER_SIZE + container.Blobs.value(it.value().Hash).DataSize;
+    }
+  }
+  return container.MappedSize > 2 * usedSize;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailCachePrivate::compact(const QString& studyInstanceUID)
+{
+  // The caller holds the write lock
+  ctkDICOMThumbnailContainer* container = this->container(studyInstanceUID);
+  if (!container)
+  {
+    return false;
+  }
+  QString containerPath = container->Path;
+  int thumbnailCount = container->Entries.count();
+  if (!this->replaceContainer(studyInstanceUID, this->liveRecords(*container)))
+  {
+    // Retried at the next append
+    logger.warn("Failed to compact thumbnail container " + containerPath);
+    return false;
+  }
+  logger.debug(QString("Compacted thumbnail container of study %1 (%2 thumbnails)")
+    .arg(studyInstanceUID).arg(thumbnailCount));
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// ctkDICOMThumbnailCache methods
+
+//------------------------------------------------------------------------------
+ctkDICOMThumbnailCache::ctkDICOMThumbnailCache(QObject* parentValue)
+  : QObject(parentValue)
+  , d_ptr(new ctkDICOMThumbnailCachePrivate(*this))
+{
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMThumbnailCache::~ctkDICOMThumbnailCache()
+{
+  this->close();
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailCache::setDirectory(const QString& directory)
+{
+  Q_D(ctkDICOMThumbnailCache);
+  if (d->Directory == directory)
+  {
+    return;
+  }
+  this->close();
+  d->Directory = directory;
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMThumbnailCache::directory() const
+{
+  Q_D(const ctkDICOMThumbnailCache);
+  return d->Directory;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailCache::setCodec(Codec codec)
+{
+  Q_D(ctkDICOMThumbnailCache);
+  d->Codec = codec;
+}
+
+//------------------------------------------------------------------------------
+ctkDICOMThumbnailCache::Codec ctkDICOMThumbnailCache::codec() const
+{
+  Q_D(const ctkDICOMThumbnailCache);
+  return d->Codec;
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailCache::setMaximumOpenContainers(int maximum)
+{
+  Q_D(ctkDICOMThumbnailCache);
+  d->MaximumOpenContainers = maximum;
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMThumbnailCache::maximumOpenContainers() const
+{
+  Q_D(const ctkDICOMThumbnailCache);
+  return d->MaximumOpenContainers;
+}
+
+//------------------------------------------------------------------------------
+QString ctkDICOMThumbnailCache::containerPathForStudy(const QString& studyInstanceUID) const
+{
+  Q_D(const ctkDICOMThumbnailCache);
+  return d->Directory + "/" + studyInstanceUID + ".ctkthumbs";
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailCache::contains(const QString& studyInstanceUID, const QString& sopInstanceUID,
+                                      const QDateTime& sourceLastModified)
+{
+  Q_D(ctkDICOMThumbnailCache);
+  ctkDICOMThumbnailContainer* container = d->container(studyInstanceUID);
+  if (!container || !container->Entries.contains(sopInstanceUID))
+  {
+    return false;
+  }
+  if (sourceLastModified.isValid()
+    && container->Entries[sopInstanceUID].SourceTimestamp < sourceLastModified.toMSecsSinceEpoch())
+  {
+    return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailCache::thumbnail(const QString& studyInstanceUID, const QString& sopInstanceUID, QImage& image)
+{
+  Q_D(ctkDICOMThumbnailCache);
+  ctkDICOMThumbnailContainer* container = d->container(studyInstanceUID);
+  if (!container)
+  {
+    return false;
+  }
+  QHash<QString, ctkDICOMThumbnailEntry>::const_iterator entry = container->Entries.constFind(sopInstanceUID);
+  if (entry == container->Entries.constEnd())
+  {
+    return false;
+  }
+  QHash<QByteArray, ctkDICOMThumbnailBlob>::const_iterator blob = container->Blobs.constFind(entry.value().Hash);
+  if (blob == container->Blobs.constEnd())
+  {
+    logger.warn("Missing thumbnail data for instance " + sopInstanceUID + " in " + container->Path);
+    return false;
+  }
+  return d->decode(*container, blob.value(), image);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailCache::storeThumbnail(const QString& studyInstanceUID, const QString& sopInstanceUID,
+                                            const QImage& image, const QDateTime& sourceLastModified)
+{
+  Q_D(ctkDICOMThumbnailCache);
+  if (d->Directory.isEmpty() || studyInstanceUID.isEmpty() || sopInstanceUID.isEmpty())
+  {
+    return false;
+  }
+  ctkDICOMEncodedThumbnail thumbnail;
+  thumbnail.SOPInstanceUID = sopInstanceUID;
+  thumbnail.SourceTimestamp = sourceLastModified.isValid() ? sourceLastModified.toMSecsSinceEpoch() : 0;
+  if (!d->encode(image, thumbnail))
+  {
+    return false;
+  }
+  return d->appendThumbnails(studyInstanceUID, QList<ctkDICOMEncodedThumbnail>() << thumbnail);
+}
+
+//------------------------------------------------------------------------------
+int ctkDICOMThumbnailCache::generateThumbnails(const QString& studyInstanceUID,
+                                               const QList<ThumbnailRequest>& requests,
+                                               ctkDICOMThumbnailGenerator* generator,
+                                               QColor backgroundColor)
+{
+  Q_D(ctkDICOMThumbnailCache);
+  if (!generator || d->Directory.isEmpty() || studyInstanceUID.isEmpty())
+  {
+    return 0;
+  }
+
+  int availableCount = 0;
+  QList<ctkDICOMEncodedThumbnail> thumbnails;
+  // Thumbnails of the files decoded in this batch
+  QHash<QString, ctkDICOMEncodedThumbnail> thumbnailsForFile;
+  foreach (const ThumbnailRequest& request, requests)
+  {
+    QFileInfo fileInfo(request.FilePath);
+    if (request.SOPInstanceUID.isEmpty() || !fileInfo.exists())
+    {
+      continue;
+    }
+    QDateTime lastModified = fileInfo.lastModified();
+    if (this->contains(studyInstanceUID, request.SOPInstanceUID, lastModified))
+    {
+      ++availableCount;
+      continue;
+    }
+
+    ctkDICOMEncodedThumbnail thumbnail;
+    QString fileKey = fileInfo.absoluteFilePath();
+    if (thumbnailsForFile.contains(fileKey))
+    {
+      thumbnail = thumbnailsForFile[fileKey];
+    }
+    else
+    {
+      QImage image;
+      if (request.Modality == "SEG")
+      {
+        // Same as ctkDICOMDatabase::storeThumbnailFile: SEG objects are not rendered
+        generator->generateDocumentThumbnail(image, backgroundColor);
+      }
+      else
+      {
+        // Only the first frame is needed for the thumbnail
+        DicomImage dcmImage(QDir::toNativeSeparators(request.FilePath).toUtf8().data(),
+                            CIF_UsePartialAccessToPixelData, 0, 1);
+        if (!generator->generateThumbnail(&dcmImage, image))
+        {
+          generator->generateDocumentThumbnail(image, backgroundColor);
+        }
+      }
+      thumbnail.SourceTimestamp = lastModified.toMSecsSinceEpoch();
+      if (!d->encode(image, thumbnail))
+      {
+        continue;
+      }
+      thumbnailsForFile[fileKey] = thumbnail;
+    }
+    thumbnail.SOPInstanceUID = request.SOPInstanceUID;
+    thumbnails.append(thumbnail);
+  }
+
+  if (!d->appendThumbnails(studyInstanceUID, thumbnails))
+  {
+    return availableCount;
+  }
+  return availableCount + thumbnails.count();
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailCache::removeThumbnails(const QString& studyInstanceUID, const QStringList& sopInstanceUIDs)
+{
+  Q_D(ctkDICOMThumbnailCache);
+  if (d->Directory.isEmpty())
+  {
+    return false;
+  }
+  QMutexLocker locker(&writeLockForContainer(this->containerPathForStudy(studyInstanceUID)));
+  ctkDICOMThumbnailContainer* container = d->container(studyInstanceUID);
+  if (!container)
+  {
+    // nothing to remove
+    return true;
+  }
+  QByteArray records;
+  QByteArray removedHash(HASH_SIZE, '\0');
+  int removedCount = 0;
+  foreach (const QString& sopInstanceUID, sopInstanceUIDs)
+  {
+    if (container->Entries.contains(sopInstanceUID))
+    {
+      d->appendIndexRecord(records, sopInstanceUID, removedHash, 0);
+      ++removedCount;
+    }
+  }
+  if (removedCount == 0)
+  {
+    return true;
+  }
+  if (removedCount == container->Entries.count())
+  {
+    // No thumbnail left in the study
+    return d->removeContainer(studyInstanceUID);
+  }
+  return d->appendRecords(studyInstanceUID, records);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailCache::removeStudy(const QString& studyInstanceUID)
+{
+  Q_D(ctkDICOMThumbnailCache);
+  if (d->Directory.isEmpty())
+  {
+    return false;
+  }
+  QMutexLocker locker(&writeLockForContainer(this->containerPathForStudy(studyInstanceUID)));
+  return d->removeContainer(studyInstanceUID);
+}
+
+//------------------------------------------------------------------------------
+bool ctkDICOMThumbnailCache::compact(const QString& studyInstanceUID)
+{
+  Q_D(ctkDICOMThumbnailCache);
+  if (d->Directory.isEmpty())
+  {
+    return false;
+  }
+  QMutexLocker locker(&writeLockForContainer(this->containerPathForStudy(studyInstanceUID)));
+  return d->compact(studyInstanceUID);
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailCache::close()
+{
+  Q_D(ctkDICOMThumbnailCache);
+  foreach (const QString& studyInstanceUID, d->Containers.keys())
+  {
+    d->closeContainer(studyInstanceUID);
+  }
+}
@@ -0,0 +1,153 @@
+/*=========================================================================
+
+  Library:   CTK
+
+  Copyright (c) Kitware Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0.txt
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+=========================================================================*/
+
+#ifndef __ctkDICOMThumbnailCache_h
+#define __ctkDICOMThumbnailCache_h
+
+// Qt includes
+#include <QColor>
+#include <QDateTime>
+#include <QObject>
+#include <QStringList>
+class QImage;
+
+// ctkDICOMCore includes
+#include "ctkDICOMCoreExport.h"
+class ctkDICOMThumbnailCachePrivate;
+class ctkDICOMThumbnailGenerator;
+
+/// \ingroup DICOM_Core
+///
+/// \brief Persistent thumbnail store with one container file per study.
+///
+/// All the thumbnails of a study are packed into a single append-only
+/// container file (<directory>/<StudyInstanceUID>.ctkthumbs). The container is
+/// memory-mapped when the study is first accessed and an in-memory index
+/// (SOPInstanceUID -> thumbnail) is built from it, so that showing the
+/// thumbnails of a study costs one open() and one mmap() instead of one file
+/// access per thumbnail.
+///
+/// Thumbnail images are content-addressed: identical images (e.g. document
+/// icons used for all the SEG series of a study) are stored only once.
+///
+/// Several instances (e.g. one per worker thread) can share the same
+/// directory: appends are serialized within the process and each instance
+/// picks up the records appended by the others on the next lookup.
+/// Concurrent writes from different processes are not supported.
+class CTK_DICOM_CORE_EXPORT ctkDICOMThumbnailCache : public QObject
+{
+  Q_OBJECT
+  Q_ENUMS(Codec)
+  Q_PROPERTY(QString directory READ directory WRITE setDirectory)
+  Q_PROPERTY(Codec codec READ codec WRITE setCodec)
+  Q_PROPERTY(int maximumOpenContainers READ maximumOpenContainers WRITE setMaximumOpenContainers)
+
+public:
+  /// Encoding of the thumbnail pixels in the container
+  enum Codec
+  {
+    /// Uncompressed pixels, decoding is a single copy from the mapped file
+    RawCodec = 0,
+    /// JPEG, compact and faster to decode than PNG
+    JPEGCodec,
+    /// PNG, lossless and compact but slowest to decode
+    PNGCodec
+  };
+
+  /// Thumbnail to generate in a batch, \sa generateThumbnails()
+  struct ThumbnailRequest
+  {
+    QString SOPInstanceUID;
+    QString FilePath;
+    QString Modality;
+  };
+
+  explicit ctkDICOMThumbnailCache(QObject* parent = nullptr);
+  virtual ~ctkDICOMThumbnailCache();
+
+  ///@{
+  /// Folder containing the study containers. Changing it closes all the open containers.
+  void setDirectory(const QString& directory);
+  QString directory() const;
+  ///@}
+
+  ///@{
+  /// Codec used to encode new thumbnails. RawCodec by default.
+  /// Containers can mix thumbnails encoded with different codecs.
+  void setCodec(Codec codec);
+  Codec codec() const;
+  ///@}
+
+  ///@{
+  /// Maximum number of study containers kept mapped at the same time (64 by default).
+  /// Least recently used containers are unmapped first.
+  void setMaximumOpenContainers(int maximum);
+  int maximumOpenContainers() const;
+  ///@}
+
+  /// Path of the container file of a study
+  Q_INVOKABLE QString containerPathForStudy(const QString& studyInstanceUID) const;
+
+  /// Returns true if a thumbnail is stored for the instance.
+  /// If \a sourceLastModified is valid, the thumbnail must have been generated
+  /// from a source file with the same or a more recent modification time.
+  Q_INVOKABLE bool contains(const QString& studyInstanceUID, const QString& sopInstanceUID,
+                            const QDateTime& sourceLastModified = QDateTime());
+
+  /// Get the thumbnail of an instance. Returns false if no thumbnail is stored.
+  Q_INVOKABLE bool thumbnail(const QString& studyInstanceUID, const QString& sopInstanceUID, QImage& image);
+
+  /// Store the thumbnail of an instance, replacing any previous thumbnail.
+  /// \a sourceLastModified is the modification time of the file the thumbnail was created from.
+  Q_INVOKABLE bool storeThumbnail(const QString& studyInstanceUID, const QString& sopInstanceUID,
+                                  const QImage& image, const QDateTime& sourceLastModified = QDateTime());
+
+  /// Generate and store the thumbnails of several instances of a study at once.
+  ///
+  /// Each source file is decoded once, even if it is listed several times, thumbnails
+  /// that are already up-to-date are skipped and all the new thumbnails are appended
+  /// to the container in a single write.
+  /// SEG instances get a document thumbnail instead of being decoded.
+  /// Returns the number of thumbnails available for the requested instances.
+  int generateThumbnails(const QString& studyInstanceUID, const QList<ThumbnailRequest>& requests,
+                         ctkDICOMThumbnailGenerator* generator, QColor backgroundColor = Qt::darkGray);
+
+  /// Remove the thumbnails of instances of a study.
+  /// The container is compacted when most of it is unused.
+  Q_INVOKABLE bool removeThumbnails(const QString& studyInstanceUID, const QStringList& sopInstanceUIDs);
+
+  /// Remove the container of a study
+  Q_INVOKABLE bool removeStudy(const QString& studyInstanceUID);
+
+  /// Rewrite the container of a study with only the thumbnails that are still referenced
+  Q_INVOKABLE bool compact(const QString& studyInstanceUID);
+
+  /// Unmap all containers
+  Q_INVOKABLE void close();
+
+protected:
+  QScopedPointer<ctkDICOMThumbnailCachePrivate> d_ptr;
+
+private:
+  Q_DECLARE_PRIVATE(ctkDICOMThumbnailCache);
+  Q_DISABLE_COPY(ctkDICOMThumbnailCache);
+};
+
+#endif
@@ -29,6 +29,9 @@
 #include <QPainter>
 #include <QtSvg/QSvgRenderer>
 
+// STD includes
+#include <cstring>
+
 // DCMTK includes
 #include "dcmtk/dcmimgle/dcmimage.h"
 
@@ -152,44 +155,79 @@ bool ctkDICOMThumbnailGenerator::generateThumbnail(DicomImage *dcmImage, QImage&
       dcmImage->setMinMaxWindow(OFTrue /* ignore extreme values */);
     }
   }
-  /* get image extension and prepare image header */
+  // Ask DCMTK for a copy of the image already reduced to the thumbnail size (keeping
+  // the aspect ratio), so that the full resolution pixels are never rendered to 8 bits.
   const unsigned long width = dcmImage->getWidth();
   const unsigned long height = dcmImage->getHeight();
-  unsigned long offset = 0;
-  unsigned long length = 0;
-  QString header;
-
-  if (dcmImage->isMonochrome())
+  if (width == 0 || height == 0)
   {
-    // write PGM header (binary monochrome image format)
-    header = QString("P5 %1 %2 255\n").arg(width).arg(height);
-    offset = header.length();
-    length = width * height + offset;
+    DCMTK_LOG4CPLUS_WARN_STR(rootLogThumbnailGenerator, "Rendering of DICOM image failed for thumbnail: empty image");
+    return false;
   }
-  else
+  const double scale = qMin(static_cast<double>(d->Width) / width, static_cast<double>(d->Height) / height);
+  QScopedPointer<DicomImage> scaledImage;
+  if (scale > 0. && scale < 1.)
+  {
+    const unsigned long scaledWidth = qMax(1ul, static_cast<unsigned long>(qRound(width * scale)));
+    const unsigned long scaledHeight = qMax(1ul, static_cast<unsigned long>(qRound(height * scale)));
+    // interpolate: 0 = pixel replication/suppression (fast), 1 = bilinear (smooth).
+    // The scaled copy inherits the window selected above.
+    scaledImage.reset(dcmImage->createScaledImage(scaledWidth, scaledHeight, d->SmoothResize ? 1 : 0));
+    if (scaledImage.isNull() || scaledImage->getStatus() != EIS_Normal)
+    {
+      DCMTK_LOG4CPLUS_DEBUG_STR(rootLogThumbnailGenerator, "Downscaling of DICOM image failed, rendering at full resolution.");
+      scaledImage.reset();
+    }
+  }
+  DicomImage* renderedImage = scaledImage.isNull() ? dcmImage : scaledImage.data();
+
+  /* render pixel data straight into the QImage buffer */
+  const int renderedWidth = static_cast<int>(renderedImage->getWidth());
+  const int renderedHeight = static_cast<int>(renderedImage->getHeight());
+  const bool monochrome = renderedImage->isMonochrome();
+  const int bytesPerPixel = monochrome ? 1 : 3 /* RGB */;
+  const int rowLength = renderedWidth * bytesPerPixel;
+  QImage renderedQImage(renderedWidth, renderedHeight, monochrome ? QImage::Format_Grayscale8 : QImage::Format_RGB888);
+  if (renderedQImage.isNull())
   {
-    // write PPM header (binary color image format)
-    header = QString("P6 %1 %2 255\n").arg(width).arg(height);
-    offset = header.length();
-    length = width * height * 3 /* RGB */ + offset;
+    DCMTK_LOG4CPLUS_ERROR_STR(rootLogThumbnailGenerator, "QImage couldn't created");
+    return false;
   }
-  /* create output buffer for DicomImage class */
-  QByteArray buffer;
-  /* copy header to output buffer and resize it for pixel data */
-  buffer.append(header.toUtf8().data());
-  buffer.resize(length);
-
-  /* render pixel data to buffer */
-  if (dcmImage->getOutputData(static_cast<void *>(buffer.data() + offset), length - offset, 8, 0))
+  if (renderedQImage.bytesPerLine() == rowLength)
   {
-    if (!image.loadFromData( buffer ))
+    // No row padding: DCMTK can write directly into the image memory.
+    if (!renderedImage->getOutputData(static_cast<void *>(renderedQImage.bits()),
+                                      static_cast<unsigned long>(rowLength) * renderedHeight, 8, 0))
     {
-      DCMTK_LOG4CPLUS_ERROR_STR(rootLogThumbnailGenerator, "QImage couldn't created");
+      DCMTK_LOG4CPLUS_ERROR_STR(rootLogThumbnailGenerator, "Rendering of DICOM image pixel data failed");
       return false;
     }
   }
-  image = image.scaled( d->Width, d->Height, Qt::KeepAspectRatio,
-    (d->SmoothResize ? Qt::SmoothTransformation : Qt::FastTransformation) );
+  else
+  {
+    // QImage rows are 32-bit aligned, DCMTK output rows are not: copy row by row
+    // from the DCMTK internal output buffer.
+    const uchar* outputData = static_cast<const uchar*>(renderedImage->getOutputData(8, 0));
+    if (!outputData)
+    {
+      DCMTK_LOG4CPLUS_ERROR_STR(rootLogThumbnailGenerator, "Rendering of DICOM image pixel data failed");
+      return false;
+    }
+    for (int row = 0; row < renderedHeight; ++row)
+    {
+      memcpy(renderedQImage.scanLine(row), outputData + row * rowLength, rowLength);
+    }
+    renderedImage->deleteOutputData();
+  }
+
+  if (scale > 1. || renderedWidth > d->Width || renderedHeight > d->Height)
+  {
+    // Images smaller than the thumbnail are scaled up here (the rendered image is
+    // small, so this is cheap), as well as images that DCMTK could not downscale.
+    renderedQImage = renderedQImage.scaled(d->Width, d->Height, Qt::KeepAspectRatio,
+      (d->SmoothResize ? Qt::SmoothTransformation : Qt::FastTransformation));
+  }
+  image = renderedQImage;
   return true;
 }
 
@@ -211,14 +249,16 @@ bool ctkDICOMThumbnailGenerator::generateThumbnail(DicomImage *dcmImage, const Q
 //------------------------------------------------------------------------------
 bool ctkDICOMThumbnailGenerator::generateThumbnail(const QString& dcmImagePath, QImage& image)
 {
-  DicomImage dcmImage(QDir::toNativeSeparators(dcmImagePath).toUtf8().data());
+  // Only the first frame is needed for the thumbnail
+  DicomImage dcmImage(QDir::toNativeSeparators(dcmImagePath).toUtf8().data(), CIF_UsePartialAccessToPixelData, 0, 1);
   return this->generateThumbnail(&dcmImage, image);
 }
 
 //------------------------------------------------------------------------------
 bool ctkDICOMThumbnailGenerator::generateThumbnail(const QString& dcmImagePath, const QString& thumbnailPath)
 {
-  DicomImage dcmImage(QDir::toNativeSeparators(dcmImagePath).toUtf8().data());
+  // Only the first frame is needed for the thumbnail
+  DicomImage dcmImage(QDir::toNativeSeparators(dcmImagePath).toUtf8().data(), CIF_UsePartialAccessToPixelData, 0, 1);
   return this->generateThumbnail(&dcmImage, thumbnailPath);
 }
 
@@ -238,16 +278,21 @@ void ctkDICOMThumbnailGenerator::generateDocumentThumbnail(const QString &thumbn
                                                            QColor backgroundColor)
 {
   QImage image;
+  this->generateDocumentThumbnail(image, backgroundColor);
+  image.save(thumbnailPath, "PNG");
+}
+
+//------------------------------------------------------------------------------
+void ctkDICOMThumbnailGenerator::generateDocumentThumbnail(QImage& image, QColor backgroundColor)
+{
   this->generateBlankThumbnail(image, backgroundColor);
-  QPixmap pixmap = QPixmap::fromImage(image);
+  // Paint on the QImage (not on a QPixmap) so that it can be used from worker threads
   QPainter painter;
-  if (painter.begin(&pixmap))
+  if (painter.begin(&image))
   {
     painter.setRenderHint(QPainter::Antialiasing);
     QSvgRenderer renderer(QString(":Icons/text_document.svg"));
     renderer.render(&painter);
     painter.end();
   }
-  image = pixmap.toImage();
-  image.save(thumbnailPath, "PNG");
 }
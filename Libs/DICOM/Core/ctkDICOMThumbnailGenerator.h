@@ -61,6 +61,9 @@ public:
   Q_INVOKABLE void generateBlankThumbnail(QImage& image, QColor backgroundColor = Qt::darkGray);
   Q_INVOKABLE virtual void generateDocumentThumbnail(const QString &thumbnailPath,
                                                      QColor backgroundColor = Qt::darkGray);
+  /// Generate a document thumbnail image (a document icon on a solid background).
+  /// It is used for objects that cannot be rendered (e.g. SEG).
+  Q_INVOKABLE void generateDocumentThumbnail(QImage& image, QColor backgroundColor = Qt::darkGray);
 
   /// Set thumbnail width
   void setWidth(int width);
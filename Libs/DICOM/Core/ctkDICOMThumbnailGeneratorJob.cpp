@@ -51,6 +51,8 @@ CTK_GET_CPP(ctkDICOMThumbnailGeneratorJob, QString, databaseFilename, DatabaseFi
 CTK_SET_CPP(ctkDICOMThumbnailGeneratorJob, QString, setDatabaseFilename, DatabaseFilename);
 CTK_GET_CPP(ctkDICOMThumbnailGeneratorJob, QString, dicomFilePath, DicomFilePath);
 CTK_SET_CPP(ctkDICOMThumbnailGeneratorJob, QString, setDicomFilePath, DicomFilePath);
+CTK_GET_CPP(ctkDICOMThumbnailGeneratorJob, QStringList, sopInstanceUIDs, SOPInstanceUIDs);
+CTK_SET_CPP(ctkDICOMThumbnailGeneratorJob, const QStringList&, setSOPInstanceUIDs, SOPInstanceUIDs);
 CTK_GET_CPP(ctkDICOMThumbnailGeneratorJob, QString, modality, Modality);
 CTK_SET_CPP(ctkDICOMThumbnailGeneratorJob, QString, setModality, Modality);
 CTK_GET_CPP(ctkDICOMThumbnailGeneratorJob, QColor, backgroundColor, BackgroundColor);
@@ -100,6 +102,7 @@ ctkAbstractJob* ctkDICOMThumbnailGeneratorJob::clone() const
   newThumbnailGeneratorJob->setBackgroundColor(this->backgroundColor());
   newThumbnailGeneratorJob->setModality(this->modality());
   newThumbnailGeneratorJob->setDicomFilePath(this->dicomFilePath());
+  newThumbnailGeneratorJob->setSOPInstanceUIDs(this->sopInstanceUIDs());
 
   return newThumbnailGeneratorJob;
 }
@@ -28,6 +28,7 @@
 #include <QColor>
 #include <QObject>
 #include <QSharedPointer>
+#include <QStringList>
 
 // ctkCore includes
 class ctkAbstractWorker;
@@ -43,6 +44,7 @@ class CTK_DICOM_CORE_EXPORT ctkDICOMThumbnailGeneratorJob : public ctkDICOMJob
   Q_OBJECT
   Q_PROPERTY(QString databaseFilename READ databaseFilename WRITE setDatabaseFilename);
   Q_PROPERTY(QString dicomFilePath READ dicomFilePath WRITE setDicomFilePath);
+  Q_PROPERTY(QStringList sopInstanceUIDs READ sopInstanceUIDs WRITE setSOPInstanceUIDs);
   Q_PROPERTY(QString modality READ modality WRITE setModality);
   Q_PROPERTY(QColor backgroundColor READ backgroundColor WRITE setBackgroundColor);
 
@@ -63,6 +65,14 @@ public:
   QString dicomFilePath() const;
   ///@}
 
+  ///@{
+  /// Instances of the study to generate thumbnails for in a single batch.
+  /// If set, dicomFilePath, modality and sopInstanceUID are ignored: files and
+  /// modalities are read from the database.
+  void setSOPInstanceUIDs(const QStringList& sopInstanceUIDs);
+  QStringList sopInstanceUIDs() const;
+  ///@}
+
   ///@{
   /// Modality
   void setModality(QString modality);
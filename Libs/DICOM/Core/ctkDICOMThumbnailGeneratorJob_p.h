@@ -27,6 +27,7 @@
 // Qt includes
 #include <QColor>
 #include <QObject>
+#include <QStringList>
 
 // ctkDICOMCore includes
 #include "ctkDICOMThumbnailGeneratorJob.h"
@@ -47,6 +48,7 @@ public:
 public:
   QString DatabaseFilename;
   QString DicomFilePath;
+  QStringList SOPInstanceUIDs;
   QString Modality;
   QColor BackgroundColor;
 };
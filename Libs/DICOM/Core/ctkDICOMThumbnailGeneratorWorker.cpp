@@ -108,12 +108,26 @@ void ctkDICOMThumbnailGeneratorWorker::run()
   QSharedPointer<ctkDICOMThumbnailGenerator> thumbnailGenerator =
     QSharedPointer<ctkDICOMThumbnailGenerator>(new ctkDICOMThumbnailGenerator);
   database.setThumbnailGenerator(thumbnailGenerator.data());
-  database.storeThumbnailFile(thumbnailGeneratorJob->dicomFilePath(),
-                              thumbnailGeneratorJob->studyInstanceUID(),
-                              thumbnailGeneratorJob->seriesInstanceUID(),
-                              thumbnailGeneratorJob->sopInstanceUID(),
-                              thumbnailGeneratorJob->modality(),
-                              thumbnailGeneratorJob->backgroundColor());
+
+  QStringList sopInstanceUIDs = thumbnailGeneratorJob->sopInstanceUIDs();
+  QMap<QString, QString> seriesForThumbnails;
+  if (sopInstanceUIDs.isEmpty())
+  {
+    database.storeThumbnail(thumbnailGeneratorJob->dicomFilePath(),
+                            thumbnailGeneratorJob->studyInstanceUID(),
+                            thumbnailGeneratorJob->seriesInstanceUID(),
+                            thumbnailGeneratorJob->sopInstanceUID(),
+                            thumbnailGeneratorJob->modality(),
+                            thumbnailGeneratorJob->backgroundColor());
+    seriesForThumbnails[thumbnailGeneratorJob->sopInstanceUID()] = thumbnailGeneratorJob->seriesInstanceUID();
+  }
+  else
+  {
+    // Batch: all files are decoded in this worker and written to the study container at once
+    seriesForThumbnails = database.storeThumbnails(thumbnailGeneratorJob->studyInstanceUID(),
+                                                   sopInstanceUIDs,
+                                                   thumbnailGeneratorJob->backgroundColor());
+  }
   database.closeDatabase();
 
   if (d->wasCancelled)
@@ -121,17 +135,23 @@ void ctkDICOMThumbnailGeneratorWorker::run()
     this->onJobCanceled(d->wasCancelled);
     return;
   }
-  QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet =
-    QSharedPointer<ctkDICOMJobResponseSet>(new ctkDICOMJobResponseSet);
 
-  jobResponseSet->setJobType(ctkDICOMJobResponseSet::JobType::ThumbnailGenerator);
-  jobResponseSet->setPatientID(thumbnailGeneratorJob->patientID());
-  jobResponseSet->setStudyInstanceUID(thumbnailGeneratorJob->studyInstanceUID());
-  jobResponseSet->setSeriesInstanceUID(thumbnailGeneratorJob->seriesInstanceUID());
-  jobResponseSet->setSOPInstanceUID(thumbnailGeneratorJob->sopInstanceUID());
-  jobResponseSet->setJobUID(thumbnailGeneratorJob->jobUID());
+  // Report each thumbnail, so that the series widgets can update
+  for (QMap<QString, QString>::const_iterator it = seriesForThumbnails.constBegin();
+       it != seriesForThumbnails.constEnd(); ++it)
+  {
+    QSharedPointer<ctkDICOMJobResponseSet> jobResponseSet =
+      QSharedPointer<ctkDICOMJobResponseSet>(new ctkDICOMJobResponseSet);
+
+    jobResponseSet->setJobType(ctkDICOMJobResponseSet::JobType::ThumbnailGenerator);
+    jobResponseSet->setPatientID(thumbnailGeneratorJob->patientID());
+    jobResponseSet->setStudyInstanceUID(thumbnailGeneratorJob->studyInstanceUID());
+    jobResponseSet->setSeriesInstanceUID(it.value());
+    jobResponseSet->setSOPInstanceUID(it.key());
+    jobResponseSet->setJobUID(thumbnailGeneratorJob->jobUID());
 
-  thumbnailGeneratorJob->progressJobDetail(jobResponseSet->toVariant());
+    thumbnailGeneratorJob->progressJobDetail(jobResponseSet->toVariant());
+  }
   thumbnailGeneratorJob->setStatus(ctkAbstractJob::JobStatus::Finished);
 }
 
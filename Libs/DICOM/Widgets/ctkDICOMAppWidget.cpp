@@ -266,6 +266,7 @@ ctkDICOMAppWidget::ctkDICOMAppWidget(QWidget* _parent):Superclass(_parent),
 
   d->ThumbnailsWidget->setThumbnailSize(
     QSize(d->ThumbnailWidthSlider->value(), d->ThumbnailWidthSlider->value()));
+  d->ThumbnailsWidget->setDatabase(d->DICOMDatabase.data());
 
   // Treeview signals
   connect(d->TreeView, SIGNAL(collapsed(QModelIndex)), this, SLOT(onTreeCollapsed(QModelIndex)));
@@ -425,7 +426,7 @@ void ctkDICOMAppWidget::setDatabaseDirectory(const QString& directory)
   // update the database schema if needed and provide progress
   this->updateDatabaseSchemaIfNeeded();
 
-  d->DICOMModel.setDatabase(d->DICOMDatabase->database());
+  d->DICOMModel.setDatabase(d->DICOMDatabase->readOnlyDatabase());
   d->DICOMModel.setEndLevel(ctkDICOMModel::SeriesType);
   d->TreeView->resizeColumnToContents(0);
 
@@ -596,7 +597,7 @@ void ctkDICOMAppWidget::resumeModel()
 {
   Q_D(ctkDICOMAppWidget);
 
-  d->DICOMModel.setDatabase(d->DICOMDatabase->database());
+  d->DICOMModel.setDatabase(d->DICOMDatabase->readOnlyDatabase());
 }
 
 //----------------------------------------------------------------------------
@@ -980,7 +981,7 @@ void ctkDICOMAppWidget::onThumbnailWidthSliderValueChanged(int val){
 //----------------------------------------------------------------------------
 void ctkDICOMAppWidget::onSearchParameterChanged(){
   Q_D(ctkDICOMAppWidget);
-  d->DICOMModel.setDatabase(d->DICOMDatabase->database(), d->SearchOption->parameters());
+  d->DICOMModel.setDatabase(d->DICOMDatabase->readOnlyDatabase(), d->SearchOption->parameters());
 
   this->onModelSelected(d->DICOMModel.index(0,0));
   d->ThumbnailsWidget->clearThumbnails();
@@ -1394,9 +1394,14 @@ void ctkDICOMBrowser::exportSeries(QString dirPath, QStringList uids)
 {
   Q_D(ctkDICOMBrowser);
 
+  QMap<QString, QStringList> filesForMultipleSeries = d->DICOMDatabase->filesForMultipleSeries(uids);
   foreach (const QString& uid, uids)
   {
-    QStringList filesForSeries = d->DICOMDatabase->filesForSeries(uid);
+    QStringList filesForSeries = filesForMultipleSeries.value(uid);
+    if (filesForSeries.isEmpty())
+    {
+      continue;
+    }
 
     // Use the first file to get the overall series information
     QString firstFilePath = filesForSeries[0];
@@ -1599,9 +1604,10 @@ QStringList ctkDICOMBrowser::fileListForCurrentSelection(ctkDICOMModel::IndexTyp
   if (level == ctkDICOMModel::PatientType)
   {
     QStringList uids = d->dicomTableManager->currentPatientsSelection();
-    foreach(const QString& uid, uids)
+    QMap<QString, QStringList> studiesForPatients = d->DICOMDatabase->studiesForPatients(uids);
+    foreach (const QString& uid, uids)
     {
-      selectedStudyUIDs << d->DICOMDatabase->studiesForPatient(uid);
+      selectedStudyUIDs << studiesForPatients.value(uid);
     }
   }
   if (level == ctkDICOMModel::StudyType)
@@ -1616,16 +1622,18 @@ QStringList ctkDICOMBrowser::fileListForCurrentSelection(ctkDICOMModel::IndexTyp
   }
   else
   {
-    foreach(const QString& uid, selectedStudyUIDs)
+    QMap<QString, QStringList> seriesForStudies = d->DICOMDatabase->seriesForStudies(selectedStudyUIDs);
+    foreach (const QString& uid, selectedStudyUIDs)
     {
-      selectedSeriesUIDs << d->DICOMDatabase->seriesForStudy(uid);
+      selectedSeriesUIDs << seriesForStudies.value(uid);
     }
   }
 
+  QMap<QString, QStringList> filesForSeries = d->DICOMDatabase->filesForMultipleSeries(selectedSeriesUIDs);
   QStringList fileList;
   foreach(const QString& selectedSeriesUID, selectedSeriesUIDs)
   {
-    fileList << d->DICOMDatabase->filesForSeries(selectedSeriesUID);
+    fileList << filesForSeries.value(selectedSeriesUID);
   }
   return fileList;
 }
@@ -1659,9 +1667,10 @@ void ctkDICOMBrowser::exportSelectedItems(ctkDICOMModel::IndexType level)
   if (level == ctkDICOMModel::PatientType)
   {
     QStringList uids = d->dicomTableManager->currentPatientsSelection();
-    foreach(const QString & uid, uids)
+    QMap<QString, QStringList> studiesForPatients = d->DICOMDatabase->studiesForPatients(uids);
+    foreach (const QString& uid, uids)
     {
-      selectedStudyUIDs << d->DICOMDatabase->studiesForPatient(uid);
+      selectedStudyUIDs << studiesForPatients.value(uid);
     }
   }
   if (level == ctkDICOMModel::StudyType)
@@ -1676,9 +1685,10 @@ void ctkDICOMBrowser::exportSelectedItems(ctkDICOMModel::IndexType level)
   }
   else
   {
-    foreach(const QString & uid, selectedStudyUIDs)
+    QMap<QString, QStringList> seriesForStudies = d->DICOMDatabase->seriesForStudies(selectedStudyUIDs);
+    foreach (const QString& uid, selectedStudyUIDs)
     {
-      selectedSeriesUIDs << d->DICOMDatabase->seriesForStudy(uid);
+      selectedSeriesUIDs << seriesForStudies.value(uid);
     }
   }
 
@@ -1698,9 +1708,10 @@ void ctkDICOMBrowser::removeSelectedItems(ctkDICOMModel::IndexType level)
     {
       return;
     }
-    foreach(const QString & uid, selectedPatientUIDs)
+    QMap<QString, QStringList> studiesForPatients = d->DICOMDatabase->studiesForPatients(selectedPatientUIDs);
+    foreach (const QString& uid, selectedPatientUIDs)
     {
-      selectedStudyUIDs << d->DICOMDatabase->studiesForPatient(uid);
+      selectedStudyUIDs << studiesForPatients.value(uid);
     }
   }
   if (level == ctkDICOMModel::StudyType)
@@ -1723,9 +1734,10 @@ void ctkDICOMBrowser::removeSelectedItems(ctkDICOMModel::IndexType level)
   }
   else
   {
-    foreach(const QString & uid, selectedStudyUIDs)
+    QMap<QString, QStringList> seriesForStudies = d->DICOMDatabase->seriesForStudies(selectedStudyUIDs);
+    foreach (const QString& uid, selectedStudyUIDs)
     {
-      selectedSeriesUIDs << d->DICOMDatabase->seriesForStudy(uid);
+      selectedSeriesUIDs << seriesForStudies.value(uid);
     }
   }
 
@@ -647,6 +647,7 @@ public:
   void retryJobs();
 
   QSharedPointer<ctkDICOMScheduler> Scheduler;
+  QList<int> JobEventsSubscriptionIDs;
   QSharedPointer<QSortFilterProxyModel> proxyModel;
   QSharedPointer<QSortFilterProxyModel> showCompletedProxyModel;
   QSharedPointer<QCenteredItemModel> dataModel;
@@ -776,18 +777,11 @@ void ctkDICOMJobListWidgetPrivate::disconnectScheduler()
                                     q, SLOT(onJobInitialized(QVariant)));
   ctkDICOMJobListWidget::disconnect(this->Scheduler.data(), SIGNAL(jobQueued(QVariant)),
                                     q, SLOT(onJobQueued(QVariant)));
-  ctkDICOMJobListWidget::disconnect(this->Scheduler.data(), SIGNAL(jobStarted(QList<QVariant>)),
-                                    q, SLOT(onJobStarted(QList<QVariant>)));
-  ctkDICOMJobListWidget::disconnect(this->Scheduler.data(), SIGNAL(jobUserStopped(QList<QVariant>)),
-                                    q, SLOT(onJobUserStopped(QList<QVariant>)));
-  ctkDICOMJobListWidget::disconnect(this->Scheduler.data(), SIGNAL(jobFinished(QList<QVariant>)),
-                                    q, SLOT(onJobFinished(QList<QVariant>)));
-  ctkDICOMJobListWidget::disconnect(this->Scheduler.data(), SIGNAL(jobAttemptFailed(QList<QVariant>)),
-                                    q, SLOT(onJobAttemptFailed(QList<QVariant>)));
-  ctkDICOMJobListWidget::disconnect(this->Scheduler.data(), SIGNAL(jobFailed(QList<QVariant>)),
-                                    q, SLOT(onJobFailed(QList<QVariant>)));
-  ctkDICOMJobListWidget::disconnect(this->Scheduler.data(), SIGNAL(progressJobDetail(QList<QVariant>)),
-                                    q, SLOT(onProgressJobDetail(QList<QVariant>)));
+  foreach (int subscriptionID, this->JobEventsSubscriptionIDs)
+  {
+    this->Scheduler->unsubscribeFromJobEvents(subscriptionID);
+  }
+  this->JobEventsSubscriptionIDs.clear();
 }
 
 //----------------------------------------------------------------------------
@@ -803,18 +797,31 @@ void ctkDICOMJobListWidgetPrivate::connectScheduler()
                                  q, SLOT(onJobInitialized(QVariant)));
   ctkDICOMJobListWidget::connect(this->Scheduler.data(), SIGNAL(jobQueued(QVariant)),
                                  q, SLOT(onJobQueued(QVariant)));
-  ctkDICOMJobListWidget::connect(this->Scheduler.data(), SIGNAL(jobStarted(QList<QVariant>)),
-                                 q, SLOT(onJobStarted(QList<QVariant>)));
-  ctkDICOMJobListWidget::connect(this->Scheduler.data(), SIGNAL(jobUserStopped(QList<QVariant>)),
-                                 q, SLOT(onJobUserStopped(QList<QVariant>)));
-  ctkDICOMJobListWidget::connect(this->Scheduler.data(), SIGNAL(jobFinished(QList<QVariant>)),
-                                 q, SLOT(onJobFinished(QList<QVariant>)));
-  ctkDICOMJobListWidget::connect(this->Scheduler.data(), SIGNAL(jobAttemptFailed(QList<QVariant>)),
-                                 q, SLOT(onJobAttemptFailed(QList<QVariant>)));
-  ctkDICOMJobListWidget::connect(this->Scheduler.data(), SIGNAL(jobFailed(QList<QVariant>)),
-                                 q, SLOT(onJobFailed(QList<QVariant>)));
-  ctkDICOMJobListWidget::connect(this->Scheduler.data(), SIGNAL(progressJobDetail(QList<QVariant>)),
-                                 q, SLOT(onProgressJobDetail(QList<QVariant>)));
+  // One subscription per type keeps the order of the signals
+  this->JobEventsSubscriptionIDs << this->Scheduler->subscribeToJobEvents(q,
+    [q](const QList<ctkJobEventPointer>& jobEvents){
+      q->onJobStarted(ctkJobScheduler::jobEventsDetails(jobEvents));
+    }, ctkJobEvent::Started);
+  this->JobEventsSubscriptionIDs << this->Scheduler->subscribeToJobEvents(q,
+    [q](const QList<ctkJobEventPointer>& jobEvents){
+      q->onJobUserStopped(ctkJobScheduler::jobEventsDetails(jobEvents));
+    }, ctkJobEvent::UserStopped);
+  this->JobEventsSubscriptionIDs << this->Scheduler->subscribeToJobEvents(q,
+    [q](const QList<ctkJobEventPointer>& jobEvents){
+      q->onJobFinished(ctkJobScheduler::jobEventsDetails(jobEvents));
+    }, ctkJobEvent::Finished);
+  this->JobEventsSubscriptionIDs << this->Scheduler->subscribeToJobEvents(q,
+    [q](const QList<ctkJobEventPointer>& jobEvents){
+      q->onJobAttemptFailed(ctkJobScheduler::jobEventsDetails(jobEvents));
+    }, ctkJobEvent::AttemptFailed);
+  this->JobEventsSubscriptionIDs << this->Scheduler->subscribeToJobEvents(q,
+    [q](const QList<ctkJobEventPointer>& jobEvents){
+      q->onJobFailed(ctkJobScheduler::jobEventsDetails(jobEvents));
+    }, ctkJobEvent::Failed);
+  this->JobEventsSubscriptionIDs << this->Scheduler->subscribeToJobEvents(q,
+    [q](const QList<ctkJobEventPointer>& jobEvents){
+      q->onProgressJobDetail(ctkJobScheduler::jobEventsDetails(jobEvents));
+    }, ctkJobEvent::Progress);
 }
 
 //----------------------------------------------------------------------------
@@ -187,6 +187,8 @@ QString ctkDICOMSeriesItemWidgetPrivate::getDICOMCenterFrameFromInstances(QStrin
   // NOTE: we sort by the instance number.
   // We could sort for 3D spatial values (ImagePatientPosition and ImagePatientOrientation),
   // plus time information (for 4D datasets). However, this would require additional metadata fetching and logic, which can slow down.
+  // Instance numbers (and the rows and columns shown on the thumbnail) of all instances are read at once.
+  this->DicomDatabase->prefetchTags(this->SeriesInstanceUID, QStringList() << "0020,0013" << "0028,0010" << "0028,0011");
   QMap<int, QString> sortedInstancesMap;
   foreach (QString instanceItem, instancesList)
   {
@@ -239,7 +241,9 @@ void ctkDICOMSeriesItemWidgetPrivate::createThumbnail(ctkDICOMJobDetail td)
     return;
   }
 
-  QStringList filesList = this->DicomDatabase->filesForSeries(this->SeriesInstanceUID);
+  // Files of all the instances, including the central frame, are looked up at once
+  QMap<QString, QString> filesForInstances = this->DicomDatabase->filesForInstances(instancesList);
+  QStringList filesList = filesForInstances.values();
   filesList.removeAll(QString(""));
   int numberOfFiles = filesList.count();
   QStringList urlsList = this->DicomDatabase->urlsForSeries(this->SeriesInstanceUID);
@@ -284,7 +288,7 @@ void ctkDICOMSeriesItemWidgetPrivate::createThumbnail(ctkDICOMJobDetail td)
   if (this->CentralFrameSOPInstanceUID.isEmpty())
   {
     this->CentralFrameSOPInstanceUID = this->getDICOMCenterFrameFromInstances(instancesList);
-    file = this->DicomDatabase->fileForInstance(this->CentralFrameSOPInstanceUID);
+    file = filesForInstances.value(this->CentralFrameSOPInstanceUID);
 
     // Since getDICOMCenterFrameFromInstances is based on the sorting of the instance number,
     // which is not always reliable, it could fail to get the right central frame.
@@ -306,7 +310,7 @@ void ctkDICOMSeriesItemWidgetPrivate::createThumbnail(ctkDICOMJobDetail td)
   }
   else
   {
-    file = this->DicomDatabase->fileForInstance(this->CentralFrameSOPInstanceUID);
+    file = filesForInstances.value(this->CentralFrameSOPInstanceUID);
   }
 
   if (!this->StopJobs &&
@@ -352,7 +356,7 @@ void ctkDICOMSeriesItemWidgetPrivate::createThumbnail(ctkDICOMJobDetail td)
        jobSopInstanceUID == this->CentralFrameSOPInstanceUID) ||
       renderThumbnail)
   {
-    this->drawThumbnail(this->DicomDatabase->fileForInstance(this->CentralFrameSOPInstanceUID),
+    this->drawThumbnail(file,
                         this->PatientID,
                         this->StudyInstanceUID,
                         this->SeriesInstanceUID,
@@ -466,31 +470,19 @@ void ctkDICOMSeriesItemWidgetPrivate::drawThumbnail(const QString& dicomFilePath
 
   if (this->ThumbnailImage.isNull())
   {
-    QString thumbnailPath = this->DicomDatabase->thumbnailPathForInstance(studyInstanceUID, seriesInstanceUID, sopInstanceUID);
-    if (thumbnailPath.isEmpty() && !this->ThumbnailIsGenerating)
-    {
-      QColor backgroundColor = this->SeriesThumbnail->palette().color(QPalette::Normal, QPalette::Window);
-      this->ThumbnailIsGenerating = true;
-      this->Scheduler->generateThumbnail(dicomFilePath, patientID, studyInstanceUID, seriesInstanceUID,
-                                         sopInstanceUID, modality, backgroundColor,
-                                         this->RaiseJobsPriority ? QThread::HighestPriority : QThread::HighPriority);
-      return;
-    }
-
-    if (thumbnailPath.isEmpty())
-    {
-      return;
-    }
-    else
+    if (!this->DicomDatabase->thumbnailForInstance(studyInstanceUID, seriesInstanceUID, sopInstanceUID, this->ThumbnailImage))
     {
-      this->ThumbnailIsGenerating = false;
-    }
-
-    if (!this->ThumbnailImage.load(thumbnailPath))
-    {
-      logger.error("drawThumbnail failed, could not load png file. \n");
+      if (!this->ThumbnailIsGenerating)
+      {
+        QColor backgroundColor = this->SeriesThumbnail->palette().color(QPalette::Normal, QPalette::Window);
+        this->ThumbnailIsGenerating = true;
+        this->Scheduler->generateThumbnail(dicomFilePath, patientID, studyInstanceUID, seriesInstanceUID,
+                                           sopInstanceUID, modality, backgroundColor,
+                                           this->RaiseJobsPriority ? QThread::HighestPriority : QThread::HighPriority);
+      }
       return;
     }
+    this->ThumbnailIsGenerating = false;
   }
 
   QPixmap resultPixmap(this->ThumbnailSizePixel, this->ThumbnailSizePixel);
@@ -702,7 +694,8 @@ void ctkDICOMSeriesItemWidgetPrivate::updateRetrieveUIOnFinished()
   QStringList instancesList = this->DicomDatabase->instancesForSeries(this->SeriesInstanceUID);
   int numberOfFrames = instancesList.count();
 
-  QStringList filesList = this->DicomDatabase->filesForSeries(this->SeriesInstanceUID);
+  QMap<QString, QString> filesForInstances = this->DicomDatabase->filesForInstances(instancesList);
+  QStringList filesList = filesForInstances.values();
   filesList.removeAll(QString(""));
   int numberOfFiles = filesList.count();
 
@@ -727,7 +720,7 @@ void ctkDICOMSeriesItemWidgetPrivate::updateRetrieveUIOnFinished()
     this->SeriesThumbnail->operationProgressBar()->hide();
   }
 
-  this->drawThumbnail(this->DicomDatabase->fileForInstance(this->CentralFrameSOPInstanceUID),
+  this->drawThumbnail(filesForInstances.value(this->CentralFrameSOPInstanceUID),
                       this->PatientID,
                       this->StudyInstanceUID,
                       this->SeriesInstanceUID,
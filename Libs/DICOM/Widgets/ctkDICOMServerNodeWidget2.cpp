@@ -46,6 +46,7 @@
 
 // ctkDICOMCore includes
 #include <ctkDICOMEcho.h>
+#include <ctkDICOMEchoJob.h>
 #include <ctkDICOMJob.h>
 #include <ctkDICOMScheduler.h>
 #include <ctkDICOMServer.h>
@@ -268,6 +269,7 @@ public:
 
   void updateServerVerification(const ctkDICOMJobDetail& td,
                                 const QString& status);
+  void updateServersVerification(const QList<ctkJobEventPointer>& jobEvents);
 
   void settingsModified();
   void restoreFocus(QModelIndexList selectedIndexes,
@@ -278,6 +280,7 @@ public:
 
   bool SettingsModified;
   QSharedPointer<ctkDICOMScheduler> Scheduler;
+  int JobEventsSubscriptionID;
   QPushButton* SaveButton;
   QPushButton* CancelButton;
   QPalette DefaultPalette;
@@ -293,6 +296,7 @@ ctkDICOMServerNodeWidget2Private::ctkDICOMServerNodeWidget2Private(ctkDICOMServe
 {
   this->SettingsModified = false;
   this->Scheduler = nullptr;
+  this->JobEventsSubscriptionID = 0;
   this->CancelButton = nullptr;
   this->SaveButton = nullptr;
   this->DefaultPalette.setColor(QPalette::Button, ctkDICOMServerNodeWidget2DefaultColor);
@@ -397,14 +401,8 @@ void ctkDICOMServerNodeWidget2Private::disconnectScheduler()
     return;
   }
 
-  QObject::disconnect(this->Scheduler.data(), SIGNAL(jobStarted(QList<QVariant>)),
-                      q, SLOT(onJobStarted(QList<QVariant>)));
-  QObject::disconnect(this->Scheduler.data(), SIGNAL(jobUserStopped(QList<QVariant>)),
-                      q, SLOT(onJobUserStopped(QList<QVariant>)));
-  QObject::disconnect(this->Scheduler.data(), SIGNAL(jobFinished(QList<QVariant>)),
-                      q, SLOT(onJobFinished(QList<QVariant>)));
-  QObject::disconnect(this->Scheduler.data(), SIGNAL(jobFailed(QList<QVariant>)),
-                      q, SLOT(onJobFailed(QList<QVariant>)));
+  this->Scheduler->unsubscribeFromJobEvents(this->JobEventsSubscriptionID);
+  this->JobEventsSubscriptionID = 0;
   QObject::disconnect(this->Scheduler.data(), SIGNAL(serverModified(QString)),
                       q, SLOT(updateGUIFromServerNodes()));
 }
@@ -418,14 +416,13 @@ void ctkDICOMServerNodeWidget2Private::connectScheduler()
     return;
   }
 
-  QObject::connect(this->Scheduler.data(), SIGNAL(jobStarted(QList<QVariant>)),
-                   q, SLOT(onJobStarted(QList<QVariant>)));
-  QObject::connect(this->Scheduler.data(), SIGNAL(jobUserStopped(QList<QVariant>)),
-                   q, SLOT(onJobUserStopped(QList<QVariant>)));
-  QObject::connect(this->Scheduler.data(), SIGNAL(jobFinished(QList<QVariant>)),
-                   q, SLOT(onJobFinished(QList<QVariant>)));
-  QObject::connect(this->Scheduler.data(), SIGNAL(jobFailed(QList<QVariant>)),
-                   q, SLOT(onJobFailed(QList<QVariant>)));
+  // Only the events of the echo jobs update the verification of the servers
+  this->JobEventsSubscriptionID = this->Scheduler->subscribeToJobEvents(q,
+    [this](const QList<ctkJobEventPointer>& jobEvents){
+      this->updateServersVerification(jobEvents);
+    },
+    ctkJobEvent::Started | ctkJobEvent::UserStopped | ctkJobEvent::Finished | ctkJobEvent::Failed,
+    QStringList() << ctkDICOMEchoJob::staticMetaObject.className());
   QObject::connect(this->Scheduler.data(), SIGNAL(serverModified(QString)),
                    q, SLOT(updateGUIFromServerNodes()));
 }
@@ -857,6 +854,41 @@ void ctkDICOMServerNodeWidget2Private::updateProxyComboBoxes() const
   }
 }
 
+//----------------------------------------------------------------------------
+void ctkDICOMServerNodeWidget2Private::updateServersVerification(const QList<ctkJobEventPointer>& jobEvents)
+{
+  Q_Q(ctkDICOMServerNodeWidget2);
+
+  foreach (const ctkJobEventPointer& jobEvent, jobEvents)
+  {
+    ctkDICOMEchoJob* echoJob = qobject_cast<ctkDICOMEchoJob*>(jobEvent->Job.data());
+    if (!echoJob || !echoJob->server())
+    {
+      continue;
+    }
+
+    ctkDICOMJobDetail td(*echoJob, echoJob->server()->connectionName());
+    switch (jobEvent->Type)
+    {
+      case ctkJobEvent::Started:
+        this->updateServerVerification(td, QString(ctkDICOMServerNodeWidget2::tr("in-progress")));
+        break;
+      case ctkJobEvent::UserStopped:
+        this->updateServerVerification(td, QString(ctkDICOMServerNodeWidget2::tr("user-stopped")));
+        break;
+      case ctkJobEvent::Failed:
+        this->updateServerVerification(td, QString(ctkDICOMServerNodeWidget2::tr("failed")));
+        break;
+      case ctkJobEvent::Finished:
+        this->updateServerVerification(td, QString(ctkDICOMServerNodeWidget2::tr("success")));
+        break;
+      default:
+        break;
+    }
+  }
+  q->updateGUIState();
+}
+
 //----------------------------------------------------------------------------
 void ctkDICOMServerNodeWidget2Private::updateServerVerification(const ctkDICOMJobDetail& td,
                                                                 const QString &status)
@@ -111,10 +111,14 @@ public Q_SLOTS:
   /// Verify the current selected row (different from the checked rows)
   void onVerifyCurrentServerNode();
 
+  ///@{
+  /// \deprecated The widget is not connected to the job signals of the scheduler anymore:
+  /// it subscribes to the events of the echo jobs (see ctkJobScheduler::subscribeToJobEvents).
   void onJobStarted(QList<QVariant>);
   void onJobUserStopped(QList<QVariant>);
   void onJobFailed(QList<QVariant>);
   void onJobFinished(QList<QVariant>);
+  ///@}
 
   void readSettings();
   void saveSettings();
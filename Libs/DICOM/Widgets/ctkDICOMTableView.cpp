@@ -124,6 +124,13 @@ public:
 
   /// Less than or equal to SQL where conditions
   QMap<QString, QVariant> sqlLessEqualWhereConditions;
+
+  /// Foreign key values of the current query
+  QStringList queryUIDs;
+
+  /// Search box text that selects the rows in the query, using the full-text search index
+  /// of the table for the indexed columns. Empty if the rows are not selected in the query.
+  QString fullTextSearchText;
 };
 
 //------------------------------------------------------------------------------
@@ -555,12 +562,27 @@ void ctkDICOMTableView::onFilterChanged(const QString& filterText)
 {
   Q_D(ctkDICOMTableView);
 
+  // Select the candidate rows in the query using the full-text search index of the database
+  // when possible, the wildcard expression is matched in all the columns of the loaded rows
+  QString searchText;
+  bool wildcardExpression = filterText.contains('*') || filterText.contains('?') || filterText.contains('[');
+  if (d->dicomDatabase && d->dicomDatabase->isFullTextSearchAvailable() && !wildcardExpression
+    && !ctkDICOMDatabase::fullTextSearchExpression(filterText).isEmpty()
+    && !ctkDICOMDatabase::fullTextSearchColumns(d->queryTableName).isEmpty())
+  {
+    searchText = filterText;
+  }
+  if (searchText != d->fullTextSearchText)
+  {
+    d->fullTextSearchText = searchText;
+    this->setQuery(d->queryUIDs);
+  }
   d->dicomSQLFilterModel->setFilterWildcard(filterText);
 
   const QStringList uids = this->uidsForAllRows();
 
   bool showWarning = d->dicomSQLFilterModel->rowCount() == 0 &&
-    d->dicomSQLModel.rowCount() != 0;
+    (d->dicomSQLModel.rowCount() != 0 || !searchText.isEmpty());
   d->showFilterActiveWarning(showWarning);
   emit showFilterActiveWarning(showWarning);
 
@@ -665,6 +687,7 @@ void ctkDICOMTableView::setQuery(const QStringList &uids)
                    "Patients.UID = Studies.PatientsUID AND Studies.StudyInstanceUID = Series.StudyInstanceUID");
   QList<QVariant> boundValues;
   int columnCountBefore = d->dicomSQLModel.columnCount();
+  d->queryUIDs = uids;
 
   if (!uids.empty() && d->queryForeignKey.length() != 0)
   {
@@ -711,6 +734,39 @@ void ctkDICOMTableView::setQuery(const QStringList &uids)
     queryString += " AND " + column + " <= ?" ;
     boundValues << d->sqlLessEqualWhereConditions[column];
   }
+  if (!d->fullTextSearchText.isEmpty() && d->dicomDatabase)
+  {
+    // Columns that are not in the index (e.g. dates) are scanned
+    QStringList fieldNames;
+    if (d->queryTableName == "Patients")
+    {
+      fieldNames = d->dicomDatabase->patientFieldNames();
+    }
+    else if (d->queryTableName == "Studies")
+    {
+      fieldNames = d->dicomDatabase->studyFieldNames();
+    }
+    else if (d->queryTableName == "Series")
+    {
+      fieldNames = d->dicomDatabase->seriesFieldNames();
+    }
+    QString likePattern = d->fullTextSearchText;
+    likePattern.replace("\\", "\\\\").replace("%", "\\%").replace("_", "\\_");
+    likePattern = "%" + likePattern + "%";
+
+    queryString += " AND (%1.rowid IN (SELECT rowid FROM %1SearchIndex WHERE %1SearchIndex MATCH ?)";
+    boundValues << ctkDICOMDatabase::fullTextSearchExpression(d->fullTextSearchText);
+    QStringList indexedFieldNames = ctkDICOMDatabase::fullTextSearchColumns(d->queryTableName);
+    foreach (const QString& fieldName, fieldNames)
+    {
+      if (!indexedFieldNames.contains(fieldName))
+      {
+        queryString += " OR %1." + fieldName + " LIKE ? ESCAPE '\\'";
+        boundValues << likePattern;
+      }
+    }
+    queryString += ")";
+  }
 
   if (d->dicomDatabase != 0 && d->dicomDatabase->isOpen()
     && (d->queryForeignKey.isEmpty() || !uids.empty()) )
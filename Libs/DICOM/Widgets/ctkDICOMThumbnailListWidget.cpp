@@ -25,8 +25,10 @@
 #include <QFileInfo>
 #include <QGridLayout>
 #include <QMetaType>
+#include <QImage>
 #include <QPersistentModelIndex>
 #include <QPixmap>
+#include <QPointer>
 #include <QPushButton>
 #include <QResizeEvent>
 
@@ -68,6 +70,7 @@ public:
   ctkDICOMThumbnailListWidgetPrivate(ctkDICOMThumbnailListWidget* parent);
 
   QString DatabaseDirectory;
+  QPointer<ctkDICOMDatabase> Database;
   QModelIndex CurrentSelectedModel;
 
   void addThumbnailWidget(const QModelIndex &imageIndex, const QModelIndex& sourceIndex, const QString& text);
@@ -183,20 +186,38 @@ void ctkDICOMThumbnailListWidgetPrivate
   QModelIndex seriesIndex = imageIndex.parent();
   QModelIndex studyIndex = seriesIndex.parent();
 
-  QString thumbnailPath = this->DatabaseDirectory +
-                          "/thumbs/" + model->data(studyIndex ,ctkDICOMModel::UIDRole).toString() + "/" +
-                          model->data(seriesIndex ,ctkDICOMModel::UIDRole).toString() + "/" +
-                          model->data(imageIndex, ctkDICOMModel::UIDRole).toString() + ".png";
-  if(!QFileInfo(thumbnailPath).exists())
+  QString studyInstanceUID = model->data(studyIndex ,ctkDICOMModel::UIDRole).toString();
+  QString seriesInstanceUID = model->data(seriesIndex ,ctkDICOMModel::UIDRole).toString();
+  QString sopInstanceUID = model->data(imageIndex, ctkDICOMModel::UIDRole).toString();
+  QPixmap pix;
+  if (this->Database)
   {
-    return;
+    // Thumbnails may be stored in the thumbnail cache of the database, without file
+    QImage thumbnailImage;
+    if (!this->Database->thumbnailForInstance(studyInstanceUID, seriesInstanceUID, sopInstanceUID, thumbnailImage))
+    {
+      return;
+    }
+    pix = QPixmap::fromImage(thumbnailImage);
+    logger.debug("Setting pixmap to the thumbnail of " + sopInstanceUID);
+  }
+  else
+  {
+    QString thumbnailPath = this->DatabaseDirectory +
+                            "/thumbs/" + studyInstanceUID + "/" +
+                            seriesInstanceUID + "/" +
+                            sopInstanceUID + ".png";
+    if(!QFileInfo(thumbnailPath).exists())
+    {
+      return;
+    }
+    pix.load(thumbnailPath);
+    logger.debug("Setting pixmap to " + thumbnailPath);
   }
   ctkThumbnailLabel* widget = new ctkThumbnailLabel(this->ScrollAreaContentWidget);
 
   QString widgetLabel = text;
   widget->setText( widgetLabel );
-  QPixmap pix(thumbnailPath);
-  logger.debug("Setting pixmap to " + thumbnailPath);
   if(this->ThumbnailSize.isValid())
   {
     widget->setFixedSize(this->ThumbnailSize);
@@ -233,6 +254,14 @@ void ctkDICOMThumbnailListWidget::setDatabaseDirectory(const QString &directory)
   d->DatabaseDirectory = directory;
 }
 
+//----------------------------------------------------------------------------
+void ctkDICOMThumbnailListWidget::setDatabase(ctkDICOMDatabase* database)
+{
+  Q_D(ctkDICOMThumbnailListWidget);
+
+  d->Database = database;
+}
+
 //----------------------------------------------------------------------------
 void ctkDICOMThumbnailListWidget::selectThumbnailFromIndex(const QModelIndex &index){
   Q_D(ctkDICOMThumbnailListWidget);
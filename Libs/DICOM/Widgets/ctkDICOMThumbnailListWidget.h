@@ -25,6 +25,7 @@
 #include "ctkThumbnailListWidget.h"
 
 class QModelIndex;
+class ctkDICOMDatabase;
 class ctkDICOMThumbnailListWidgetPrivate;
 class ctkThumbnailWidget;
 
@@ -39,6 +40,10 @@ public:
 
   void setDatabaseDirectory(const QString& directory);
 
+  /// Database providing the thumbnails of the instances (see ctkDICOMDatabase::thumbnailForInstance).
+  /// If no database is set, the thumbnail files of the database directory are displayed.
+  void setDatabase(ctkDICOMDatabase* database);
+
   void selectThumbnailFromIndex(const QModelIndex& index);
 
 private:
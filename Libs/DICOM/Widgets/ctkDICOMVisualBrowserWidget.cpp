@@ -44,13 +44,19 @@
 
 // ctkDICOMCore includes
 #include "ctkDICOMDatabase.h"
+#include "ctkDICOMHierarchySnapshot.h"
 #include "ctkDICOMIndexer.h"
+#include "ctkDICOMInserterJob.h"
 #include "ctkDICOMJob.h"
 #include "ctkDICOMJobResponseSet.h"
+#include "ctkDICOMQueryJob.h"
+#include "ctkDICOMRetrieveJob.h"
 #include "ctkDICOMScheduler.h"
 #include "ctkDICOMScheduler.h"
 #include "ctkDICOMServer.h"
+#include "ctkDICOMStorageListenerJob.h"
 #include "ctkDICOMThumbnailGenerator.h"
+#include "ctkDICOMThumbnailGeneratorJob.h"
 #include "ctkUtils.h"
 
 // ctkDICOMWidgets includes
@@ -171,12 +177,6 @@ public:
                                       QList<QWidget*> selectedWidgets);
   QStringList getSeriesUIDsFromWidgets(ctkDICOMModel::IndexType level,
                                        QList<QWidget*> selectedWidgets);
-  QStringList filterPatientList(const QStringList& patientList,
-                                const QMap<QString, QVariant>& filters);
-  QStringList filterStudyList(const QStringList& patientList,
-                              const QMap<QString, QVariant>& filters);
-  QStringList filterSeriesList(const QStringList& patientList,
-                               const QMap<QString, QVariant>& filters);
   ctkDICOMStudyItemWidget* getCurrentPatientStudyWidgetByUIDs(const QString& studyInstanceUID);
   ctkDICOMSeriesItemWidget* getCurrentPatientSeriesWidgetByUIDs(const QString& studyInstanceUID,
                                                                 const QString& seriesInstanceUID);
@@ -230,6 +230,7 @@ public:
   QSharedPointer<ctkDICOMDatabase> DicomDatabase;
   QSharedPointer<ctkDICOMThumbnailGenerator> ThumbnailGenerator;
   QSharedPointer<ctkDICOMScheduler> Scheduler;
+  QList<int> JobEventsSubscriptionIDs;
   QSharedPointer<ctkDICOMIndexer> Indexer;
 
   QString FilteringPatientID;
@@ -268,6 +269,8 @@ ctkDICOMVisualBrowserWidgetPrivate::ctkDICOMVisualBrowserWidgetPrivate(ctkDICOMV
 
   this->DicomDatabase = QSharedPointer<ctkDICOMDatabase>(new ctkDICOMDatabase);
   this->DicomDatabase->setThumbnailGenerator(ThumbnailGenerator.data());
+  // Populate the patients, studies and series from the memory-mapped snapshot of the database
+  this->DicomDatabase->setHierarchySnapshotEnabled(true);
 
   this->Scheduler = QSharedPointer<ctkDICOMScheduler>(new ctkDICOMScheduler);
   this->Scheduler->setDicomDatabase(this->DicomDatabase);
@@ -483,22 +486,16 @@ void ctkDICOMVisualBrowserWidgetPrivate::init()
 //----------------------------------------------------------------------------
 void ctkDICOMVisualBrowserWidgetPrivate::disconnectScheduler()
 {
-  Q_Q(ctkDICOMVisualBrowserWidget);
   if (!this->Scheduler)
   {
     return;
   }
 
-  QObject::disconnect(this->Scheduler.data(), SIGNAL(progressJobDetail(QList<QVariant>)),
-                      q, SLOT(updateGUIFromScheduler(QList<QVariant>)));
-  QObject::disconnect(this->Scheduler.data(), SIGNAL(jobStarted(QList<QVariant>)),
-                      q, SLOT(onJobStarted(QList<QVariant>)));
-  QObject::disconnect(this->Scheduler.data(), SIGNAL(jobUserStopped(QList<QVariant>)),
-                      q, SLOT(onJobUserStopped(QList<QVariant>)));
-  QObject::disconnect(this->Scheduler.data(), SIGNAL(jobFailed(QList<QVariant>)),
-                      q, SLOT(onJobFailed(QList<QVariant>)));
-  QObject::disconnect(this->Scheduler.data(), SIGNAL(jobFinished(QList<QVariant>)),
-                      q, SLOT(onJobFinished(QList<QVariant>)));
+  foreach (int subscriptionID, this->JobEventsSubscriptionIDs)
+  {
+    this->Scheduler->unsubscribeFromJobEvents(subscriptionID);
+  }
+  this->JobEventsSubscriptionIDs.clear();
 }
 
 //----------------------------------------------------------------------------
@@ -510,16 +507,35 @@ void ctkDICOMVisualBrowserWidgetPrivate::connectScheduler()
     return;
   }
 
-  QObject::connect(this->Scheduler.data(), SIGNAL(progressJobDetail(QList<QVariant>)),
-                   q, SLOT(updateGUIFromScheduler(QList<QVariant>)));
-  QObject::connect(this->Scheduler.data(), SIGNAL(jobStarted(QList<QVariant>)),
-                   q, SLOT(onJobStarted(QList<QVariant>)));
-  QObject::connect(this->Scheduler.data(), SIGNAL(jobUserStopped(QList<QVariant>)),
-                   q, SLOT(onJobUserStopped(QList<QVariant>)));
-  QObject::connect(this->Scheduler.data(), SIGNAL(jobFailed(QList<QVariant>)),
-                   q, SLOT(onJobFailed(QList<QVariant>)));
-  QObject::connect(this->Scheduler.data(), SIGNAL(jobFinished(QList<QVariant>)),
-                   q, SLOT(onJobFinished(QList<QVariant>)));
+  // Only the jobs of the patients are followed, the details are built for their events only.
+  // One subscription per type keeps the order of the signals: started, user-stopped,
+  // finished, failed and progress.
+  QStringList jobClasses;
+  jobClasses << ctkDICOMQueryJob::staticMetaObject.className()
+             << ctkDICOMRetrieveJob::staticMetaObject.className()
+             << ctkDICOMInserterJob::staticMetaObject.className()
+             << ctkDICOMThumbnailGeneratorJob::staticMetaObject.className()
+             << ctkDICOMStorageListenerJob::staticMetaObject.className();
+  this->JobEventsSubscriptionIDs << this->Scheduler->subscribeToJobEvents(q,
+    [q](const QList<ctkJobEventPointer>& jobEvents){
+      q->onJobStarted(ctkJobScheduler::jobEventsDetails(jobEvents));
+    }, ctkJobEvent::Started, jobClasses);
+  this->JobEventsSubscriptionIDs << this->Scheduler->subscribeToJobEvents(q,
+    [q](const QList<ctkJobEventPointer>& jobEvents){
+      q->onJobUserStopped(ctkJobScheduler::jobEventsDetails(jobEvents));
+    }, ctkJobEvent::UserStopped, jobClasses);
+  this->JobEventsSubscriptionIDs << this->Scheduler->subscribeToJobEvents(q,
+    [q](const QList<ctkJobEventPointer>& jobEvents){
+      q->onJobFinished(ctkJobScheduler::jobEventsDetails(jobEvents));
+    }, ctkJobEvent::Finished, jobClasses);
+  this->JobEventsSubscriptionIDs << this->Scheduler->subscribeToJobEvents(q,
+    [q](const QList<ctkJobEventPointer>& jobEvents){
+      q->onJobFailed(ctkJobScheduler::jobEventsDetails(jobEvents));
+    }, ctkJobEvent::Failed, jobClasses);
+  this->JobEventsSubscriptionIDs << this->Scheduler->subscribeToJobEvents(q,
+    [q](const QList<ctkJobEventPointer>& jobEvents){
+      q->updateGUIFromScheduler(ctkJobScheduler::jobEventsDetails(jobEvents));
+    }, ctkJobEvent::Progress, jobClasses);
 }
 
 //----------------------------------------------------------------------------
@@ -721,7 +737,34 @@ void ctkDICOMVisualBrowserWidgetPrivate::createPatients(bool queryRetrieve,
     return;
   }
 
-  QStringList patientList = this->DicomDatabase->patients();
+  // Read the fields of all the patients at once from the hierarchy snapshot if available,
+  // instead of running queries for each patient
+  QStringList patientList;
+  QStringList patientIDList;
+  QStringList patientNameList;
+  QStringList patientInsertTimestampList;
+  ctkDICOMHierarchySnapshot* hierarchySnapshot = this->DicomDatabase->hierarchySnapshot();
+  bool hierarchySnapshotFields = (hierarchySnapshot != nullptr);
+  if (hierarchySnapshotFields)
+  {
+    const ctkDICOMHierarchySnapshot::Level patientLevel = ctkDICOMHierarchySnapshot::PatientLevel;
+    QStringList fields = ctkDICOMHierarchySnapshot::fields(patientLevel);
+    int patientIDField = fields.indexOf("PatientID");
+    int patientNameField = fields.indexOf("PatientsName");
+    int insertTimestampField = fields.indexOf("InsertTimestamp");
+    int patientCount = hierarchySnapshot->count(patientLevel);
+    for (int patientRow = 0; patientRow < patientCount; ++patientRow)
+    {
+      patientList << hierarchySnapshot->uid(patientLevel, patientRow);
+      patientIDList << hierarchySnapshot->value(patientLevel, patientRow, patientIDField);
+      patientNameList << hierarchySnapshot->value(patientLevel, patientRow, patientNameField);
+      patientInsertTimestampList << hierarchySnapshot->value(patientLevel, patientRow, insertTimestampField);
+    }
+  }
+  else
+  {
+    patientList = this->DicomDatabase->patients();
+  }
   if (patientList.count() == 0)
   {
     this->patientsTabMenuToolButton->hide();
@@ -732,10 +775,13 @@ void ctkDICOMVisualBrowserWidgetPrivate::createPatients(bool queryRetrieve,
   this->IsGUIUpdating = true;
   int wasBlocking = this->PatientsTabWidget->blockSignals(true);
   QMap<QString, QDateTime> patientsInsertDateTimeList;
-  foreach (QString patientItem, patientList)
+  for (int patientIndex = 0; patientIndex < patientList.count(); ++patientIndex)
   {
-    QString patientID = this->DicomDatabase->fieldForPatient("PatientID", patientItem);
-    QString patientName = this->DicomDatabase->fieldForPatient("PatientsName", patientItem);
+    QString patientItem = patientList[patientIndex];
+    QString patientID = hierarchySnapshotFields ? patientIDList[patientIndex] :
+      this->DicomDatabase->fieldForPatient("PatientID", patientItem);
+    QString patientName = hierarchySnapshotFields ? patientNameList[patientIndex] :
+      this->DicomDatabase->fieldForPatient("PatientsName", patientItem);
     patientName.replace(R"(^)", R"( )");
     int index = this->findPatientTabIndexFromPatientItem(patientItem);
     if (index != -1)
@@ -752,7 +798,9 @@ void ctkDICOMVisualBrowserWidgetPrivate::createPatients(bool queryRetrieve,
 
     index = q->addPatientItemWidget(patientItem);
 
-    QDateTime patientInsertDateTime = this->DicomDatabase->insertDateTimeForPatient(patientItem);
+    QDateTime patientInsertDateTime = hierarchySnapshotFields ?
+      QDateTime::fromString(patientInsertTimestampList[patientIndex], Qt::ISODate) :
+      this->DicomDatabase->insertDateTimeForPatient(patientItem);
     patientsInsertDateTimeList[patientItem] = patientInsertDateTime;
   }
 
@@ -833,57 +881,33 @@ void ctkDICOMVisualBrowserWidgetPrivate::updateFiltersWarnings()
   // If there are no series, highlight which are the filters that produce no results
   this->setBackgroundColorToFilterWidgets();
 
+  // Each level is filtered with a single database query, which also applies the filters of the parent levels
   QColor color = ctkDICOMVisualBrowserWidgetWarningColor;
-  QStringList patientList = this->DicomDatabase->patients();
-  if (patientList.count() == 0)
-  {
-    this->setBackgroundColorToWidget(color, this->FilteringPatientIDSearchBox);
-    this->setBackgroundColorToWidget(color, this->FilteringPatientNameSearchBox);
-    return;
-  }
-
   QMap<QString, QVariant> filters;
   filters.insert("PatientsName", this->FilteringPatientName);
   filters.insert("PatientID", this->FilteringPatientID);
-  QStringList filteredPatientList = this->filterPatientList(patientList, filters);
-  if (filteredPatientList.count() == 0)
+  if (this->DicomDatabase->filteredPatients(filters).count() == 0)
   {
     this->setBackgroundColorToWidget(color, this->FilteringPatientIDSearchBox);
     this->setBackgroundColorToWidget(color, this->FilteringPatientNameSearchBox);
     return;
   }
 
-  QStringList studiesList;
-  foreach (QString patientItem, filteredPatientList)
-  {
-    studiesList.append(this->DicomDatabase->studiesForPatient(patientItem));
-  }
-
-  filters.clear();
-  filters.insert("StudyDate", QString::number(ctkDICOMPatientItemWidget::getNDaysFromFilteringDate(this->FilteringDate)));
+  filters.insert("StudyDate", ctkDICOMPatientItemWidget::getNDaysFromFilteringDate(this->FilteringDate));
   filters.insert("StudyDescription", this->FilteringStudyDescription);
-
-  QStringList filteredStudyList = this->filterStudyList(studiesList, filters);
-  if (filteredStudyList.count() == 0)
+  if (this->DicomDatabase->filteredStudies(filters).count() == 0)
   {
     this->setBackgroundColorToWidget(color, this->FilteringDateComboBox);
     this->setBackgroundColorToWidget(color, this->FilteringStudyDescriptionSearchBox);
     return;
   }
 
-  QStringList seriesList;
-  foreach (QString studyItem, filteredStudyList)
+  if (!this->FilteringModalities.contains("Any"))
   {
-    QString studyInstanceUID = this->DicomDatabase->fieldForStudy("StudyInstanceUID", studyItem);
-    seriesList.append(this->DicomDatabase->seriesForStudy(studyInstanceUID));
+    filters.insert("Modality", this->FilteringModalities);
   }
-
-  filters.clear();
-  filters.insert("Modality", this->FilteringModalities);
   filters.insert("SeriesDescription", this->FilteringSeriesDescription);
-
-  QStringList filteredSeriesList = this->filterSeriesList(seriesList, filters);
-  if (filteredSeriesList.count() == 0)
+  if (this->DicomDatabase->filteredSeries(filters).count() == 0)
   {
     this->setBackgroundColorToWidget(color, this->FilteringSeriesDescriptionSearchBox);
     this->setBackgroundColorToWidget(color, this->FilteringModalityCheckableComboBox);
@@ -1390,6 +1414,7 @@ QStringList ctkDICOMVisualBrowserWidgetPrivate::getStudyUIDsFromWidgets(ctkDICOM
     return selectedStudyUIDs;
   }
 
+  QStringList selectedPatientItems;
   foreach (QWidget* selectedWidget, selectedWidgets)
   {
     if (!selectedWidget)
@@ -1403,7 +1428,7 @@ QStringList ctkDICOMVisualBrowserWidgetPrivate::getStudyUIDsFromWidgets(ctkDICOM
         qobject_cast<ctkDICOMPatientItemWidget*>(selectedWidget);
       if (patientItemWidget)
       {
-        selectedStudyUIDs << this->DicomDatabase->studiesForPatient(patientItemWidget->patientItem());
+        selectedPatientItems << patientItemWidget->patientItem();
       }
     }
     else if (level == ctkDICOMModel::StudyType)
@@ -1417,202 +1442,52 @@ QStringList ctkDICOMVisualBrowserWidgetPrivate::getStudyUIDsFromWidgets(ctkDICOM
     }
   }
 
-  return selectedStudyUIDs;
-}
-
-//----------------------------------------------------------------------------
-QStringList ctkDICOMVisualBrowserWidgetPrivate::getSeriesUIDsFromWidgets(ctkDICOMModel::IndexType level,
-                                                                         QList<QWidget*> selectedWidgets)
-{
-  QStringList selectedStudyUIDs;
-  QStringList selectedSeriesUIDs;
-
-  if (!this->DicomDatabase)
-  {
-    return selectedSeriesUIDs;
-  }
-
-  foreach (QWidget* selectedWidget, selectedWidgets)
+  if (!selectedPatientItems.isEmpty())
   {
-    if (!selectedWidget)
+    QMap<QString, QStringList> studiesForPatients = this->DicomDatabase->studiesForPatients(selectedPatientItems);
+    foreach (const QString& patientItem, selectedPatientItems)
     {
-      continue;
-    }
-
-    if (level == ctkDICOMModel::PatientType)
-    {
-      ctkDICOMPatientItemWidget* patientItemWidget =
-        qobject_cast<ctkDICOMPatientItemWidget*>(selectedWidget);
-      if (patientItemWidget)
-      {
-        selectedStudyUIDs << this->DicomDatabase->studiesForPatient(patientItemWidget->patientItem());
-      }
-    }
-    else if (level == ctkDICOMModel::StudyType)
-    {
-      ctkDICOMStudyItemWidget* studyItemWidget =
-        qobject_cast<ctkDICOMStudyItemWidget*>(selectedWidget);
-      if (studyItemWidget)
-      {
-        selectedStudyUIDs << studyItemWidget->studyInstanceUID();
-      }
-    }
-
-    if (level == ctkDICOMModel::SeriesType)
-    {
-      ctkDICOMSeriesItemWidget* seriesItemWidget =
-        qobject_cast<ctkDICOMSeriesItemWidget*>(selectedWidget);
-      if (seriesItemWidget)
-      {
-        selectedSeriesUIDs << seriesItemWidget->seriesInstanceUID();
-      }
-    }
-    else
-    {
-      foreach (const QString& uid, selectedStudyUIDs)
-      {
-        selectedSeriesUIDs << this->DicomDatabase->seriesForStudy(uid);
-      }
+      selectedStudyUIDs << studiesForPatients.value(patientItem);
     }
   }
 
-  return selectedSeriesUIDs;
+  return selectedStudyUIDs;
 }
 
 //----------------------------------------------------------------------------
-QStringList ctkDICOMVisualBrowserWidgetPrivate::filterPatientList(const QStringList& patientList,
-                                                                  const QMap<QString, QVariant>& filters)
+QStringList ctkDICOMVisualBrowserWidgetPrivate::getSeriesUIDsFromWidgets(ctkDICOMModel::IndexType level,
+                                                                         QList<QWidget*> selectedWidgets)
 {
-  QStringList filteredPatientList;
-  if (!this->DicomDatabase)
-  {
-    logger.error("filterPatientList failed, no DICOM Database has been set. \n");
-    return filteredPatientList;
-  }
-
-  foreach (QString patientItem, patientList)
-  {
-    bool filtered = false;
-    for (QString key : filters.keys())
-    {
-      QString filter = this->DicomDatabase->fieldForPatient(key, patientItem);
-      QString filterValue = filters.value(key).toString();
-      if (!filter.contains(filterValue, Qt::CaseInsensitive))
-      {
-        filtered = true;
-        break;
-      }
-    }
-
-    if (filtered)
-    {
-      continue;
-    }
-
-    filteredPatientList.append(patientItem);
-  }
-
-  return filteredPatientList;
-}
+  QStringList selectedSeriesUIDs;
 
-//----------------------------------------------------------------------------
-QStringList ctkDICOMVisualBrowserWidgetPrivate::filterStudyList(const QStringList& studyList,
-                                                                const QMap<QString, QVariant>& filters)
-{
-  QStringList filteredStudyList;
   if (!this->DicomDatabase)
   {
-    logger.error("filterStudyList failed, no DICOM Database has been set. \n");
-    return filteredStudyList;
+    return selectedSeriesUIDs;
   }
 
-  foreach (QString studyItem, studyList)
+  if (level != ctkDICOMModel::SeriesType)
   {
-    bool filtered = false;
-    for (QString key : filters.keys())
-    {
-      QString filter = this->DicomDatabase->fieldForStudy(key, studyItem);
-      QString filterValue = filters.value(key).toString();
-      if (key == "StudyDate")
-      {
-        int nDays = filterValue.toInt();
-        if (nDays != -1)
-        {
-          QDate endDate = QDate::currentDate();
-          QDate startDate = endDate.addDays(-nDays);
-          filter.replace(QString("-"), QString(""));
-          QDate studyDate = QDate::fromString(filter, "yyyyMMdd");
-          if (studyDate < startDate || studyDate > endDate)
-          {
-            filtered = true;
-            break;
-          }
-        }
-      }
-      else if (!filter.contains(filterValue, Qt::CaseInsensitive))
-      {
-        filtered = true;
-        break;
-      }
-    }
-
-    if (filtered)
+    // Series of all the selected studies, looked up at once
+    QStringList selectedStudyUIDs = this->getStudyUIDsFromWidgets(level, selectedWidgets);
+    QMap<QString, QStringList> seriesForStudies = this->DicomDatabase->seriesForStudies(selectedStudyUIDs);
+    foreach (const QString& studyUID, selectedStudyUIDs)
     {
-      continue;
+      selectedSeriesUIDs << seriesForStudies.value(studyUID);
     }
-
-    filteredStudyList.append(studyItem);
-  }
-
-  return filteredStudyList;
-}
-
-//----------------------------------------------------------------------------
-QStringList ctkDICOMVisualBrowserWidgetPrivate::filterSeriesList(const QStringList& seriesList,
-                                                                 const QMap<QString, QVariant>& filters)
-{
-  QStringList filteredSeriesList;
-  if (!this->DicomDatabase)
-  {
-    logger.error("filterSeriesList failed, no DICOM Database has been set. \n");
-    return filteredSeriesList;
+    return selectedSeriesUIDs;
   }
 
-  foreach (QString seriesItem, seriesList)
+  foreach (QWidget* selectedWidget, selectedWidgets)
   {
-    bool filtered = false;
-    for (QString key : filters.keys())
-    {
-      QString filter = this->DicomDatabase->fieldForSeries(key, seriesItem);
-      if (key == "Modality")
-      {
-        QStringList filterValues = filters.value(key).toStringList();
-        if (!filterValues.contains("Any") && !filterValues.contains(filter))
-        {
-          filtered = true;
-          break;
-        }
-      }
-      else
-      {
-        QString filterValue = filters.value(key).toString();
-        if (!filter.contains(filterValue, Qt::CaseInsensitive))
-        {
-          filtered = true;
-          break;
-        }
-      }
-    }
-
-    if (filtered)
+    ctkDICOMSeriesItemWidget* seriesItemWidget =
+      qobject_cast<ctkDICOMSeriesItemWidget*>(selectedWidget);
+    if (seriesItemWidget)
     {
-      continue;
+      selectedSeriesUIDs << seriesItemWidget->seriesInstanceUID();
     }
-
-    filteredSeriesList.append(seriesItem);
   }
 
-  return filteredSeriesList;
+  return selectedSeriesUIDs;
 }
 
 //----------------------------------------------------------------------------
@@ -2643,10 +2518,11 @@ QStringList ctkDICOMVisualBrowserWidget::fileListForCurrentSelection(ctkDICOMMod
 
   QStringList selectedSeriesUIDs = d->getSeriesUIDsFromWidgets(level, selectedWidgets);
 
+  QMap<QString, QStringList> filesForSeries = d->DicomDatabase->filesForMultipleSeries(selectedSeriesUIDs);
   QStringList fileList;
   foreach (const QString& selectedSeriesUID, selectedSeriesUIDs)
   {
-    fileList << d->DicomDatabase->filesForSeries(selectedSeriesUID);
+    fileList << filesForSeries.value(selectedSeriesUID);
   }
   return fileList;
 }
@@ -2721,10 +2597,14 @@ void ctkDICOMVisualBrowserWidget::removeSelectedItems(ctkDICOMModel::IndexType l
       }
       QString patientItem = patientItemWidget->patientItem();
       QString patientID = patientItemWidget->patientID();
-      selectedStudyUIDs << d->DicomDatabase->studiesForPatient(patientItem);
       selectedPatientUIDs << patientID;
       selectedPatientItems << patientItem;
     }
+    QMap<QString, QStringList> studiesForPatients = d->DicomDatabase->studiesForPatients(selectedPatientItems);
+    foreach (const QString& patientItem, selectedPatientItems)
+    {
+      selectedStudyUIDs << studiesForPatients.value(patientItem);
+    }
 
     if (!this->confirmDeleteSelectedUIDs(selectedPatientUIDs))
     {
@@ -2771,10 +2651,7 @@ void ctkDICOMVisualBrowserWidget::removeSelectedItems(ctkDICOMModel::IndexType l
         qobject_cast<ctkDICOMPatientItemWidget*>(selectedWidget);
       if (patientItemWidget)
       {
-        QString patientItem = patientItemWidget->patientItem();
-        selectedStudyUIDs << d->DicomDatabase->studiesForPatient(patientItem);
-
-        this->removePatientItemWidget(patientItem);
+        this->removePatientItemWidget(patientItemWidget->patientItem());
       }
     }
     else if (level == ctkDICOMModel::StudyType)
@@ -2816,12 +2693,23 @@ void ctkDICOMVisualBrowserWidget::removeSelectedItems(ctkDICOMModel::IndexType l
         }
       }
     }
-    else
+  }
+
+  if (level == ctkDICOMModel::PatientType)
+  {
+    // Studies and series of all the selected items are looked up at once
+    QMap<QString, QStringList> studiesForPatients = d->DicomDatabase->studiesForPatients(selectedPatientItems);
+    foreach (const QString& patientItem, selectedPatientItems)
     {
-      foreach (const QString& uid, selectedStudyUIDs)
-      {
-        selectedSeriesUIDs << d->DicomDatabase->seriesForStudy(uid);
-      }
+      selectedStudyUIDs << studiesForPatients.value(patientItem);
+    }
+  }
+  if (level != ctkDICOMModel::SeriesType && !selectedWidgets.isEmpty())
+  {
+    QMap<QString, QStringList> seriesForStudies = d->DicomDatabase->seriesForStudies(selectedStudyUIDs);
+    foreach (const QString& uid, selectedStudyUIDs)
+    {
+      selectedSeriesUIDs << seriesForStudies.value(uid);
     }
   }
 
@@ -3777,9 +3665,14 @@ void ctkDICOMVisualBrowserWidget::exportSeries(const QString& dirPath, const QSt
     return;
   }
 
+  QMap<QString, QStringList> filesForMultipleSeries = d->DicomDatabase->filesForMultipleSeries(uids);
   foreach (const QString& uid, uids)
   {
-    QStringList filesForSeries = d->DicomDatabase->filesForSeries(uid);
+    QStringList filesForSeries = filesForMultipleSeries.value(uid);
+    if (filesForSeries.isEmpty())
+    {
+      continue;
+    }
 
     // Use the first file to get the overall series information
     QString firstFilePath = filesForSeries[0];
@@ -3974,7 +3867,17 @@ void ctkDICOMVisualBrowserWidget::onStop(bool stopPersistentTasks, bool removeJo
 //------------------------------------------------------------------------------
 void ctkDICOMVisualBrowserWidget::closeEvent(QCloseEvent* event)
 {
-  this->onStop(true, true);
+  Q_D(ctkDICOMVisualBrowserWidget);
+  // The jobs are not stopped by the user: they stay pending in the journal
+  // and can be resumed at the next start.
+  if (d->Scheduler)
+  {
+    QApplication::setOverrideCursor(QCursor(Qt::BusyCursor));
+    d->Scheduler->suspendAllJobs();
+    d->updateFiltersWarnings();
+    d->ProgressFrame->hide();
+    QApplication::restoreOverrideCursor();
+  }
   event->accept();
 }
 